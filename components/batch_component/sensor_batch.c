@@ -0,0 +1,123 @@
+/**
+ * @file sensor_batch.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Ring buffer for batching ChipCap2 samples into a single publish
+ * @version 0.1
+ * @date 2025-05-18
+ *
+ * Note: the batch is only used from the main event loop, so it is not
+ * protected by a mutex.
+ *
+ */
+
+#include "sensor_batch.h"
+
+#include "cjson_component.h"
+#include "cjson_writer.h"
+#include "uart_comm.h"
+
+#define FLUSH_INTERVAL_US \
+    ((int64_t)CONFIG_SENSOR_BATCH_FLUSH_INTERVAL * 1000 * 1000)
+
+static sensor_batch_sample_t batch_samples[SENSOR_BATCH_CAPACITY];
+// Index of the oldest sample
+static size_t batch_head = 0;
+static size_t batch_count = 0;
+
+void sensor_batch_add(const i2c_chipcap2_data_t *data, int64_t timestamp_us) {
+    size_t index = (batch_head + batch_count) % SENSOR_BATCH_CAPACITY;
+
+    if (batch_count == SENSOR_BATCH_CAPACITY) {
+        // Full, overwrite the oldest sample
+        batch_head = (batch_head + 1) % SENSOR_BATCH_CAPACITY;
+    } else {
+        batch_count++;
+    }
+
+    batch_samples[index].timestamp_us = timestamp_us;
+    batch_samples[index].data = *data;
+}
+
+size_t sensor_batch_count(void) { return batch_count; }
+
+bool sensor_batch_flush_due(int64_t now_us) {
+    if (batch_count == 0) {
+        return false;
+    }
+    if (batch_count >= SENSOR_BATCH_CAPACITY) {
+        return true;
+    }
+    return (now_us - batch_samples[batch_head].timestamp_us) >=
+           FLUSH_INTERVAL_US;
+}
+
+size_t sensor_batch_drain(sensor_batch_sample_t *samples, size_t max_samples) {
+    size_t count = 0;
+
+    while ((batch_count > 0) && (count < max_samples)) {
+        samples[count++] = batch_samples[batch_head];
+        batch_head = (batch_head + 1) % SENSOR_BATCH_CAPACITY;
+        batch_count--;
+    }
+    // Reset the indexes so the next batch starts at the beginning
+    if (batch_count == 0) {
+        batch_head = 0;
+    }
+
+    return count;
+}
+
+esp_err_t sensor_batch_format_json(const sensor_batch_sample_t *samples,
+                                   size_t sample_count, int64_t now_us,
+                                   char *buffer, uint16_t buffer_lenght) {
+    cjson_writer_t writer;
+
+    // Row format: field names and units are sent once per batch instead of
+    // once per sample
+    cjson_writer_init(&writer, buffer, buffer_lenght);
+    cjson_writer_object_begin(&writer);
+    cjson_writer_key(&writer, "sensor-batch");
+    cjson_writer_object_begin(&writer);
+
+    cjson_writer_key(&writer, "fields");
+    cjson_writer_array_begin(&writer);
+    cjson_writer_string(&writer, "age-ms");
+    cjson_writer_string(&writer, "humidity");
+    cjson_writer_string(&writer, "temperature");
+    cjson_writer_array_end(&writer);
+
+    cjson_writer_key(&writer, "units");
+    cjson_writer_array_begin(&writer);
+    cjson_writer_string(&writer, "ms");
+    cjson_writer_string(&writer, "%% (RH)");
+    cjson_writer_string(&writer, "°C");
+    cjson_writer_array_end(&writer);
+
+    cjson_writer_key(&writer, "samples");
+    cjson_writer_array_begin(&writer);
+    for (size_t i = 0; i < sample_count; i++) {
+        cjson_writer_array_begin(&writer);
+        if (samples[i].timestamp_us == SENSOR_BATCH_TIMESTAMP_UNKNOWN) {
+            cjson_writer_null(&writer);
+        } else {
+            // Age of the sample relative to the publish time
+            int64_t age_ms = (now_us - samples[i].timestamp_us) / 1000;
+            cjson_writer_number(&writer, (double)age_ms);
+        }
+        cjson_component_chipcap2_value(&writer, &samples[i].data.humidity);
+        cjson_component_chipcap2_value(&writer, &samples[i].data.temperature);
+        cjson_writer_array_end(&writer);
+    }
+    cjson_writer_array_end(&writer);
+
+    cjson_writer_object_end(&writer);
+    cjson_writer_object_end(&writer);
+
+    if (cjson_writer_finish(&writer) != ESP_OK) {
+        uart_comm_vsend(
+            "[CJSON-ERROR] Failed to create batch JSON string!\r\n");
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
@@ -0,0 +1,104 @@
+/**
+ * @file sensor_batch.h
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Ring buffer for batching ChipCap2 samples into a single publish
+ * @version 0.1
+ * @date 2025-05-18
+ *
+ */
+
+#ifndef SENSOR_BATCH_H
+#define SENSOR_BATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "i2c_chipcap2_data.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Maximum number of samples held by the batch
+ */
+#define SENSOR_BATCH_CAPACITY CONFIG_SENSOR_BATCH_SIZE
+
+/**
+ * @brief Timestamp of a sample whose measurement time is not known (e.g. a
+ * sample replayed from flash after a reboot), published with a null age
+ */
+#define SENSOR_BATCH_TIMESTAMP_UNKNOWN INT64_MIN
+
+/**
+ * @brief A single timestamped ChipCap2 sample
+ */
+typedef struct {
+    // Time of the measurement (esp_timer_get_time), or
+    // SENSOR_BATCH_TIMESTAMP_UNKNOWN
+    int64_t timestamp_us;
+    i2c_chipcap2_data_t data;
+} sensor_batch_sample_t;
+
+/**
+ * @brief Add a sample to the batch, the oldest sample is overwritten if the
+ * batch is full
+ *
+ * @param data ChipCap2 measurement data
+ * @param timestamp_us Time of the measurement
+ */
+void sensor_batch_add(const i2c_chipcap2_data_t *data, int64_t timestamp_us);
+
+/**
+ * @brief Number of samples currently in the batch
+ *
+ * @return size_t
+ */
+size_t sensor_batch_count(void);
+
+/**
+ * @brief Check if the batch should be published, either because it is full
+ * or because the oldest sample is older than the flush interval
+ *
+ * @param now_us Current time (esp_timer_get_time)
+ * @return true if the batch should be published
+ */
+bool sensor_batch_flush_due(int64_t now_us);
+
+/**
+ * @brief Move all samples (oldest first) into a contiguous array and empty
+ * the batch
+ *
+ * @param samples Output array
+ * @param max_samples Size of the output array
+ * @return size_t Number of samples copied
+ */
+size_t sensor_batch_drain(sensor_batch_sample_t *samples, size_t max_samples);
+
+/**
+ * @brief Format a JSON string with a batch of ChipCap2 samples using a
+ * pre-buffer (no heap allocations), e.g.:
+ * {"sensor-batch":{"fields":["age-ms","humidity","temperature"],
+ * "units":["ms","%% (RH)","°C"],"samples":[[5000,45.12,23.40],[0,...]]}}
+ *
+ * @param samples Samples, oldest first
+ * @param sample_count Number of samples
+ * @param now_us Publish time, used for the age of each sample (null for
+ * samples with an unknown timestamp)
+ * @param buffer Buffer for holding the generated JSON string
+ * @param buffer_lenght Size of the pre-buffer that will hold the generated JSON
+ * string
+ * @return esp_err_t
+ */
+esp_err_t sensor_batch_format_json(const sensor_batch_sample_t *samples,
+                                   size_t sample_count, int64_t now_us,
+                                   char *buffer, uint16_t buffer_lenght);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SENSOR_BATCH_H
@@ -0,0 +1,68 @@
+/**
+ * @file cert_store.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Shared, pre-parsed CA certificate store for the TLS clients (MQTT
+ * and OTA)
+ * @version 0.1
+ * @date 2025-05-21
+ *
+ */
+
+#include "cert_store.h"
+
+#include <stddef.h>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_tls.h"
+#include "mbedtls/x509_crt.h"
+
+static const char* TAG = "cert-store";
+static const uint8_t* added_buffers[CERT_STORE_MAX_BUFFERS];
+static cert_store_stats_t store_stats = {0};
+
+esp_err_t cert_store_add(const uint8_t* pem_start, const uint8_t* pem_end) {
+    if ((pem_start == NULL) || (pem_end <= pem_start)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < store_stats.buffers; i++) {
+        if (added_buffers[i] == pem_start) {
+            return ESP_OK;
+        }
+    }
+    if (store_stats.buffers >= CERT_STORE_MAX_BUFFERS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    size_t free_heap = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+    if (esp_tls_get_global_ca_store() == NULL) {
+        esp_err_t result = esp_tls_init_global_ca_store();
+        if (result != ESP_OK) {
+            return result;
+        }
+    }
+
+    // mbedtls_x509_crt_parse appends to the chain, so the certificates of
+    // all buffers end up in the same store (the length includes the null
+    // terminator, which PEM parsing requires)
+    int64_t start_us = esp_timer_get_time();
+    int ret = mbedtls_x509_crt_parse(esp_tls_get_global_ca_store(), pem_start,
+                                     (size_t)(pem_end - pem_start));
+    uint32_t parse_time_us = (uint32_t)(esp_timer_get_time() - start_us);
+    if (ret < 0) {
+        ESP_LOGE(TAG, "failed to parse certificates: -0x%x", -ret);
+        return ESP_FAIL;
+    }
+
+    added_buffers[store_stats.buffers++] = pem_start;
+    store_stats.parse_time_us += parse_time_us;
+    store_stats.heap_bytes +=
+        (uint32_t)(free_heap - heap_caps_get_free_size(MALLOC_CAP_DEFAULT));
+    ESP_LOGI(TAG, "certificates parsed in %lu us",
+             (unsigned long)parse_time_us);
+
+    return ESP_OK;
+}
+
+void cert_store_get_stats(cert_store_stats_t* stats) { *stats = store_stats; }
@@ -0,0 +1,66 @@
+/**
+ * @file cert_store.h
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Shared, pre-parsed CA certificate store for the TLS clients (MQTT
+ * and OTA)
+ * @version 0.1
+ * @date 2025-05-21
+ *
+ */
+
+#ifndef CERT_STORE_H
+#define CERT_STORE_H
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Maximum number of PEM buffers added to the store
+ */
+#define CERT_STORE_MAX_BUFFERS 4
+
+/**
+ * @brief Certificate store statistics
+ */
+typedef struct {
+    // PEM buffers parsed into the store
+    uint32_t buffers;
+    // Time spent parsing certificates, paid once instead of on every
+    // TLS handshake
+    uint32_t parse_time_us;
+    // Heap held by the parsed certificates
+    uint32_t heap_bytes;
+} cert_store_stats_t;
+
+/**
+ * @brief Parse the CA certificates of a PEM buffer into the esp-tls global CA
+ * store, TLS clients configured with use_global_ca_store verify against it
+ * without parsing the certificates on every handshake
+ *
+ * Adding the same buffer again does nothing. Not thread safe, the
+ * certificates are added from the main task.
+ *
+ * @param pem_start Start of the null terminated PEM buffer (EMBED_TXTFILES
+ * _start symbol)
+ * @param pem_end End of the PEM buffer (EMBED_TXTFILES _end symbol)
+ * @return esp_err_t
+ */
+esp_err_t cert_store_add(const uint8_t *pem_start, const uint8_t *pem_end);
+
+/**
+ * @brief Get the certificate store statistics
+ *
+ * @param stats Output statistics
+ */
+void cert_store_get_stats(cert_store_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // CERT_STORE_H
@@ -56,7 +56,8 @@
 #pragma GCC visibility pop
 #endif
 
-#include "cJSON.h"
+#include "cjson.h"
+#include "cjson_dtoa.h"
 
 /* define our own boolean type */
 #ifdef true
@@ -237,6 +238,31 @@ CJSON_PUBLIC(void) cJSON_InitHooks(cJSON_Hooks* hooks)
     }
 }
 
+/* Index of an object's members (hash table, open addressing with linear probing) or of an array's elements (in order). */
+struct cJSON_Index
+{
+    size_t count; /* number of members/elements */
+    size_t size; /* number of slots, a power of two */
+    cJSON *slots[1]; /* NULL is an empty slot */
+};
+
+static size_t index_threshold = CJSON_INDEX_THRESHOLD;
+
+CJSON_PUBLIC(void) cJSON_SetIndexThreshold(int threshold)
+{
+    index_threshold = (threshold > 0) ? (size_t)threshold : 0;
+}
+
+/* Drop the index of an object/array whose children changed. */
+static void delete_index(cJSON * const item)
+{
+    if (item->index != NULL)
+    {
+        global_hooks.deallocate(item->index);
+        item->index = NULL;
+    }
+}
+
 /* Internal constructor. */
 static cJSON *cJSON_New_Item(const internal_hooks * const hooks)
 {
@@ -270,6 +296,7 @@ CJSON_PUBLIC(void) cJSON_Delete(cJSON *item)
             global_hooks.deallocate(item->string);
             item->string = NULL;
         }
+        delete_index(item);
         global_hooks.deallocate(item);
         item = next;
     }
@@ -426,6 +453,31 @@ CJSON_PUBLIC(double) cJSON_SetNumberHelper(cJSON *object, double number)
     return object->valuedouble = number;
 }
 
+CJSON_PUBLIC(cJSON_bool) cJSON_SetNumberPrecision(cJSON *item, int precision)
+{
+    if ((item == NULL) || ((item->type & 0xFF) != cJSON_Number))
+    {
+        return false;
+    }
+
+    if ((precision < cJSON_PrecisionFloat) || (precision > CJSON_DTOA_MAX_DECIMALS))
+    {
+        return false;
+    }
+
+    item->type &= ~(cJSON_NumberIsFloat | cJSON_NumberIsFixed | cJSON_NumberDecimalsMask);
+    if (precision == cJSON_PrecisionFloat)
+    {
+        item->type |= cJSON_NumberIsFloat;
+    }
+    else if (precision >= 0)
+    {
+        item->type |= cJSON_NumberIsFixed | (precision << cJSON_NumberDecimalsShift);
+    }
+
+    return true;
+}
+
 /* Note: when passing a NULL valuestring, cJSON_SetValuestring treats this as an error and return NULL */
 CJSON_PUBLIC(char*) cJSON_SetValuestring(cJSON *object, const char *valuestring)
 {
@@ -593,39 +645,40 @@ static cJSON_bool print_number(const cJSON * const item, printbuffer * const out
     unsigned char *output_pointer = NULL;
     double d = item->valuedouble;
     int length = 0;
-    size_t i = 0;
-    unsigned char number_buffer[26] = {0}; /* temporary buffer to print the number into */
-    unsigned char decimal_point = get_decimal_point();
-    double test = 0.0;
+    char number_buffer[CJSON_DTOA_BUFFER_SIZE] = {0}; /* temporary buffer to print the number into */
 
     if (output_buffer == NULL)
     {
         return false;
     }
 
-    /* This checks for NaN and Infinity */
+    /* The conversions below never use sprintf/sscanf and always write '.'
+     * as the decimal point, independent of the locale */
     if (isnan(d) || isinf(d))
     {
-        length = sprintf((char*)number_buffer, "null");
+        /* This checks for NaN and Infinity */
+        memcpy(number_buffer, "null", sizeof("null"));
+        length = sizeof("null") - 1;
     }
-    else if(d == (double)item->valueint)
+    else if (item->type & cJSON_NumberIsFixed)
     {
-        length = sprintf((char*)number_buffer, "%d", item->valueint);
+        length = cjson_dtoa_fixed(d, (item->type & cJSON_NumberDecimalsMask) >> cJSON_NumberDecimalsShift, number_buffer);
+    }
+    else if (d == (double)item->valueint)
+    {
+        length = cjson_itoa(item->valueint, number_buffer);
+    }
+    else if (item->type & cJSON_NumberIsFloat)
+    {
+        length = cjson_ftoa_shortest((float)d, number_buffer);
     }
     else
     {
-        /* Try 15 decimal places of precision to avoid nonsignificant nonzero digits */
-        length = sprintf((char*)number_buffer, "%1.15g", d);
-
-        /* Check whether the original double can be recovered */
-        if ((sscanf((char*)number_buffer, "%lg", &test) != 1) || !compare_double((double)test, d))
-        {
-            /* If not, print with 17 decimal places of precision */
-            length = sprintf((char*)number_buffer, "%1.17g", d);
-        }
+        /* shortest representation that parses back to the same double */
+        length = cjson_dtoa_shortest(d, number_buffer);
     }
 
-    /* sprintf failed or buffer overrun occurred */
+    /* conversion failed or buffer overrun occurred */
     if ((length < 0) || (length > (int)(sizeof(number_buffer) - 1)))
     {
         return false;
@@ -638,19 +691,8 @@ static cJSON_bool print_number(const cJSON * const item, printbuffer * const out
         return false;
     }
 
-    /* copy the printed number to the output and replace locale
-     * dependent decimal point with '.' */
-    for (i = 0; i < ((size_t)length); i++)
-    {
-        if (number_buffer[i] == decimal_point)
-        {
-            output_pointer[i] = '.';
-            continue;
-        }
-
-        output_pointer[i] = number_buffer[i];
-    }
-    output_pointer[i] = '\0';
+    /* copy the printed number including the terminating null */
+    memcpy(output_pointer, number_buffer, (size_t)length + 1);
 
     output_buffer->offset += (size_t)length;
 
@@ -1880,6 +1922,170 @@ static cJSON_bool print_object(const cJSON * const item, printbuffer * const out
     return true;
 }
 
+static void* cast_away_const(const void* string);
+
+/* FNV-1a of the lower case name, so case sensitive and case insensitive lookups share the index */
+static size_t index_hash(const unsigned char *name)
+{
+    size_t hash = 2166136261U;
+
+    for (; *name != '\0'; name++)
+    {
+        hash = (hash ^ (size_t)tolower(*name)) * 16777619U;
+    }
+
+    return hash;
+}
+
+static struct cJSON_Index *allocate_index(const size_t slot_count)
+{
+    struct cJSON_Index *index = (struct cJSON_Index*)global_hooks.allocate(sizeof(struct cJSON_Index) + ((slot_count - 1) * sizeof(cJSON*)));
+    if (index == NULL)
+    {
+        return NULL;
+    }
+    memset(index->slots, '\0', slot_count * sizeof(cJSON*));
+    index->count = 0;
+    index->size = slot_count;
+
+    return index;
+}
+
+/* Insert a member into the hash table of an object's index, the caller makes sure that there is a free slot. */
+static void insert_member(struct cJSON_Index * const index, cJSON * const member)
+{
+    size_t slot = index_hash((const unsigned char*)member->string) & (index->size - 1);
+
+    while (index->slots[slot] != NULL)
+    {
+        slot = (slot + 1) & (index->size - 1);
+    }
+    index->slots[slot] = member;
+    index->count++;
+}
+
+/* Keep the hash table at most 2/3 full. */
+static size_t hash_slot_count(const size_t count)
+{
+    size_t slot_count = 4;
+
+    while (slot_count < (count + (count / 2) + 1))
+    {
+        slot_count *= 2;
+    }
+
+    return slot_count;
+}
+
+/* Index the members of an object or the elements of an array, the item stays without an index if that fails. */
+static void build_index(cJSON * const item)
+{
+    struct cJSON_Index *index = NULL;
+    cJSON *child = NULL;
+    size_t count = 0;
+    size_t slot_count = 4;
+
+    for (child = item->child; child != NULL; child = child->next)
+    {
+        if (cJSON_IsObject(item) && (child->string == NULL))
+        {
+            /* the linear lookup stops at nameless members */
+            return;
+        }
+        count++;
+    }
+
+    if (cJSON_IsObject(item))
+    {
+        slot_count = hash_slot_count(count);
+    }
+    else
+    {
+        /* leave room for appending */
+        while (slot_count < count)
+        {
+            slot_count *= 2;
+        }
+    }
+    index = allocate_index(slot_count);
+    if (index == NULL)
+    {
+        return;
+    }
+
+    /* Insert members in list order, so the first of several members with the same name comes first in its probe
+     * sequence and wins, like with the linear lookup */
+    for (child = item->child; child != NULL; child = child->next)
+    {
+        if (cJSON_IsObject(item))
+        {
+            insert_member(index, child);
+        }
+        else
+        {
+            index->slots[index->count++] = child;
+        }
+    }
+
+    item->index = index;
+}
+
+/* Should a lookup that walked 'visited' children index the item? References share the children of another item
+ * and are never indexed. */
+static cJSON_bool should_index(const cJSON * const item, const size_t visited)
+{
+    return (index_threshold > 0) && (visited >= index_threshold) && (cJSON_IsObject(item) || cJSON_IsArray(item)) && !(item->type & cJSON_IsReference);
+}
+
+/* Add an appended child to the parent's index, the index is dropped if that isn't possible. */
+static void append_to_index(cJSON * const parent, cJSON * const item)
+{
+    struct cJSON_Index *index = parent->index;
+    struct cJSON_Index *grown = NULL;
+
+    if (index == NULL)
+    {
+        return;
+    }
+
+    if (cJSON_IsObject(parent) && (item->string != NULL))
+    {
+        if (hash_slot_count(index->count + 1) <= index->size)
+        {
+            insert_member(index, item);
+        }
+        else
+        {
+            /* rebuild a larger table from the members, appends stay O(1) amortized */
+            delete_index(parent);
+            build_index(parent);
+        }
+        return;
+    }
+    else if (cJSON_IsArray(parent))
+    {
+        if (index->count == index->size)
+        {
+            /* double the capacity, appends stay O(1) amortized */
+            grown = allocate_index(index->size * 2);
+            if (grown != NULL)
+            {
+                memcpy(grown->slots, index->slots, index->count * sizeof(cJSON*));
+                grown->count = index->count;
+                global_hooks.deallocate(index);
+                parent->index = index = grown;
+            }
+        }
+        if (index->count < index->size)
+        {
+            index->slots[index->count++] = item;
+            return;
+        }
+    }
+
+    delete_index(parent);
+}
+
 /* Get Array size/item / object item. */
 CJSON_PUBLIC(int) cJSON_GetArraySize(const cJSON *array)
 {
@@ -1891,6 +2097,11 @@ CJSON_PUBLIC(int) cJSON_GetArraySize(const cJSON *array)
         return 0;
     }
 
+    if (array->index != NULL)
+    {
+        return (int)array->index->count;
+    }
+
     child = array->child;
 
     while(child != NULL)
@@ -1899,6 +2110,12 @@ CJSON_PUBLIC(int) cJSON_GetArraySize(const cJSON *array)
         child = child->next;
     }
 
+    /* Objects are only indexed by member lookups */
+    if (cJSON_IsArray(array) && should_index(array, size))
+    {
+        build_index((cJSON*)cast_away_const(array));
+    }
+
     /* FIXME: Can overflow here. Cannot be fixed without breaking the API */
 
     return (int)size;
@@ -1907,19 +2124,32 @@ CJSON_PUBLIC(int) cJSON_GetArraySize(const cJSON *array)
 static cJSON* get_array_item(const cJSON *array, size_t index)
 {
     cJSON *current_child = NULL;
+    size_t visited = 0;
 
     if (array == NULL)
     {
         return NULL;
     }
 
+    /* the index of an object is a hash table, positions in objects are walked */
+    if ((array->index != NULL) && cJSON_IsArray(array))
+    {
+        return (index < array->index->count) ? array->index->slots[index] : NULL;
+    }
+
     current_child = array->child;
     while ((current_child != NULL) && (index > 0))
     {
         index--;
+        visited++;
         current_child = current_child->next;
     }
 
+    if (cJSON_IsArray(array) && should_index(array, visited))
+    {
+        build_index((cJSON*)cast_away_const(array));
+    }
+
     return current_child;
 }
 
@@ -1933,21 +2163,46 @@ CJSON_PUBLIC(cJSON *) cJSON_GetArrayItem(const cJSON *array, int index)
     return get_array_item(array, (size_t)index);
 }
 
+static cJSON *find_in_index(const struct cJSON_Index * const index, const char * const name, const cJSON_bool case_sensitive)
+{
+    size_t slot = index_hash((const unsigned char*)name) & (index->size - 1);
+    cJSON *candidate = NULL;
+
+    while ((candidate = index->slots[slot]) != NULL)
+    {
+        if (case_sensitive ? (strcmp(name, candidate->string) == 0) : (case_insensitive_strcmp((const unsigned char*)name, (const unsigned char*)candidate->string) == 0))
+        {
+            return candidate;
+        }
+        slot = (slot + 1) & (index->size - 1);
+    }
+
+    return NULL;
+}
+
 static cJSON *get_object_item(const cJSON * const object, const char * const name, const cJSON_bool case_sensitive)
 {
     cJSON *current_element = NULL;
+    size_t visited = 0;
 
     if ((object == NULL) || (name == NULL))
     {
         return NULL;
     }
 
+    /* the index of an array is a list of elements, names in arrays are walked */
+    if ((object->index != NULL) && cJSON_IsObject(object))
+    {
+        return find_in_index(object->index, name, case_sensitive);
+    }
+
     current_element = object->child;
     if (case_sensitive)
     {
         while ((current_element != NULL) && (current_element->string != NULL) && (strcmp(name, current_element->string) != 0))
         {
             current_element = current_element->next;
+            visited++;
         }
     }
     else
@@ -1955,9 +2210,16 @@ static cJSON *get_object_item(const cJSON * const object, const char * const nam
         while ((current_element != NULL) && (case_insensitive_strcmp((const unsigned char*)name, (const unsigned char*)(current_element->string)) != 0))
         {
             current_element = current_element->next;
+            visited++;
         }
     }
 
+    /* Lookups near the start of an object stay linear, the index pays off once a lookup walks far */
+    if (cJSON_IsObject(object) && should_index(object, visited))
+    {
+        build_index((cJSON*)cast_away_const(object));
+    }
+
     if ((current_element == NULL) || (current_element->string == NULL)) {
         return NULL;
     }
@@ -2004,6 +2266,7 @@ static cJSON *create_reference(const cJSON *item, const internal_hooks * const h
 
     memcpy(reference, item, sizeof(cJSON));
     reference->string = NULL;
+    reference->index = NULL;
     reference->type |= cJSON_IsReference;
     reference->next = reference->prev = NULL;
     return reference;
@@ -2028,6 +2291,7 @@ static cJSON_bool add_item_to_array(cJSON *array, cJSON *item)
         array->child = item;
         item->prev = item;
         item->next = NULL;
+        append_to_index(array, item);
     }
     else
     {
@@ -2036,6 +2300,7 @@ static cJSON_bool add_item_to_array(cJSON *array, cJSON *item)
         {
             suffix_object(child->prev, item);
             array->child->prev = item;
+            append_to_index(array, item);
         }
     }
 
@@ -2247,6 +2512,7 @@ CJSON_PUBLIC(cJSON *) cJSON_DetachItemViaPointer(cJSON *parent, cJSON * const it
         return NULL;
     }
 
+    delete_index(parent);
     if (item != parent->child)
     {
         /* not the first element */
@@ -2336,6 +2602,7 @@ CJSON_PUBLIC(cJSON_bool) cJSON_InsertItemInArray(cJSON *array, int which, cJSON
         return false;
     }
 
+    delete_index(array);
     newitem->next = after_inserted;
     newitem->prev = after_inserted->prev;
     after_inserted->prev = newitem;
@@ -2362,6 +2629,7 @@ CJSON_PUBLIC(cJSON_bool) cJSON_ReplaceItemViaPointer(cJSON * const parent, cJSON
         return true;
     }
 
+    delete_index(parent);
     replacement->next = item->next;
     replacement->prev = item->prev;
 
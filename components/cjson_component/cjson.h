@@ -99,6 +99,12 @@ then using the CJSON_API_VISIBILITY flag to "export" the same symbols the way CJ
 #define cJSON_IsReference 256
 #define cJSON_StringIsConst 512
 
+/* Number print precision flags, see cJSON_SetNumberPrecision */
+#define cJSON_NumberIsFloat 1024
+#define cJSON_NumberIsFixed 2048
+#define cJSON_NumberDecimalsShift 12
+#define cJSON_NumberDecimalsMask (0xF << cJSON_NumberDecimalsShift)
+
 /* The cJSON structure: */
 typedef struct cJSON
 {
@@ -120,6 +126,9 @@ typedef struct cJSON
 
     /* The item's name string, if this item is the child of, or is in the list of subitems of an object. */
     char *string;
+
+    /* Internal lookup index of an object's members or an array's elements (see CJSON_INDEX_THRESHOLD), NULL if there is none. Uses the padding after 'string' on 32-bit targets. */
+    struct cJSON_Index *index;
 } cJSON;
 
 typedef struct cJSON_Hooks
@@ -143,11 +152,22 @@ typedef int cJSON_bool;
 #define CJSON_CIRCULAR_LIMIT 10000
 #endif
 
+/* A lookup (cJSON_GetObjectItem and friends) that walks at least this many members of an object builds a hash index of its members,
+ * a cJSON_GetArrayItem/cJSON_GetArraySize that walks at least this many elements of an array builds a list of its elements.
+ * Later lookups, cJSON_GetArrayItem and cJSON_GetArraySize calls are O(1), appending keeps the index. The index is allocated with the hooks
+ * and dropped by every other cJSON function that changes the children, code that edits the child list or member names directly must not
+ * look up children afterwards. 0 disables the index. */
+#ifndef CJSON_INDEX_THRESHOLD
+#define CJSON_INDEX_THRESHOLD 0
+#endif
+
 /* returns the version of cJSON as a string */
 CJSON_PUBLIC(const char*) cJSON_Version(void);
 
 /* Supply malloc, realloc and free functions to cJSON */
 CJSON_PUBLIC(void) cJSON_InitHooks(cJSON_Hooks* hooks);
+/* Change the CJSON_INDEX_THRESHOLD at runtime, existing indexes are kept */
+CJSON_PUBLIC(void) cJSON_SetIndexThreshold(int threshold);
 
 /* Memory Management: the caller is always responsible to free the results from all variants of cJSON_Parse (with cJSON_Delete) and cJSON_Print (with stdlib free, cJSON_Hooks.free_fn, or cJSON_free as appropriate). The exception is cJSON_PrintPreallocated, where the caller has full responsibility of the buffer. */
 /* Supply a block of JSON, and this returns a cJSON object you can interrogate. */
@@ -171,10 +191,14 @@ CJSON_PUBLIC(cJSON_bool) cJSON_PrintPreallocated(cJSON *item, char *buffer, cons
 CJSON_PUBLIC(void) cJSON_Delete(cJSON *item);
 
 /* Returns the number of items in an array (or object). */
+/* NOTE: despite the const array, cJSON_GetArraySize and cJSON_GetArrayItem may build the array's index (see CJSON_INDEX_THRESHOLD) and so
+ * modify it. They are not reentrant: threads that share a tree must serialize them like writes, or the index must be disabled. */
 CJSON_PUBLIC(int) cJSON_GetArraySize(const cJSON *array);
 /* Retrieve item number "index" from array "array". Returns NULL if unsuccessful. */
 CJSON_PUBLIC(cJSON *) cJSON_GetArrayItem(const cJSON *array, int index);
 /* Get item "string" from object. Case insensitive. */
+/* NOTE: despite the const object, a lookup may build the object's index (see CJSON_INDEX_THRESHOLD) and so modifies it. Lookups are not
+ * reentrant: threads that share a tree must serialize lookups in it like writes, or the index must be disabled. */
 CJSON_PUBLIC(cJSON *) cJSON_GetObjectItem(const cJSON * const object, const char * const string);
 CJSON_PUBLIC(cJSON *) cJSON_GetObjectItemCaseSensitive(const cJSON * const object, const char * const string);
 CJSON_PUBLIC(cJSON_bool) cJSON_HasObjectItem(const cJSON *object, const char *string);
@@ -282,6 +306,14 @@ CJSON_PUBLIC(cJSON*) cJSON_AddArrayToObject(cJSON * const object, const char * c
 /* helper for the cJSON_SetNumberValue macro */
 CJSON_PUBLIC(double) cJSON_SetNumberHelper(cJSON *object, double number);
 #define cJSON_SetNumberValue(object, number) ((object != NULL) ? cJSON_SetNumberHelper(object, (double)number) : (number))
+/* Select how a number item is printed:
+ * cJSON_PrecisionShortest - shortest text that parses back to the same double (default)
+ * cJSON_PrecisionFloat - shortest text that parses back to the same float (e.g. 23.1 for 23.1f)
+ * 0 to 9 - fixed number of decimals (e.g. 2: 45.678 -> 45.68)
+ * Returns false if the item is not a number or the precision is out of range. */
+#define cJSON_PrecisionShortest (-1)
+#define cJSON_PrecisionFloat (-2)
+CJSON_PUBLIC(cJSON_bool) cJSON_SetNumberPrecision(cJSON *item, int precision);
 /* Change the valuestring of a cJSON_String object, only takes effect when type of object is cJSON_String */
 CJSON_PUBLIC(char*) cJSON_SetValuestring(cJSON *object, const char *valuestring);
 
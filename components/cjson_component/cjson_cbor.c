@@ -0,0 +1,343 @@
+/**
+ * @file cjson_cbor.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Streaming CBOR (RFC 8949) writer that encodes directly into a
+ * caller-supplied buffer (no heap allocations), the binary counterpart of
+ * cjson_writer
+ * @version 0.1
+ * @date 2025-05-26
+ *
+ */
+
+#include "cjson_cbor.h"
+
+#include <math.h>
+#include <string.h>
+
+// Major types (upper 3 bits of the initial byte)
+#define CBOR_MAJOR_UNSIGNED 0
+#define CBOR_MAJOR_NEGATIVE 1
+#define CBOR_MAJOR_TEXT 3
+#define CBOR_MAJOR_ARRAY 4
+#define CBOR_MAJOR_MAP 5
+#define CBOR_MAJOR_SIMPLE 7
+
+// Additional information of major type 7
+#define CBOR_SIMPLE_FALSE 20
+#define CBOR_SIMPLE_TRUE 21
+#define CBOR_SIMPLE_NULL 22
+#define CBOR_SIMPLE_HALF 25
+#define CBOR_SIMPLE_SINGLE 26
+#define CBOR_SIMPLE_DOUBLE 27
+
+#define CBOR_MAX_DECIMALS 6
+
+/**
+ * @brief Helper for setting the sticky error (only the first one is kept)
+ *
+ */
+static void cjson_cbor_fail(cjson_cbor_writer_t *writer, esp_err_t error) {
+    if (writer->error == ESP_OK) {
+        writer->error = error;
+    }
+}
+
+/**
+ * @brief Helper for appending raw bytes
+ *
+ */
+static void cjson_cbor_append(cjson_cbor_writer_t *writer, const void *data,
+                              size_t length) {
+    if (writer->error != ESP_OK) {
+        return;
+    }
+    if (length > writer->length - writer->offset) {
+        cjson_cbor_fail(writer, ESP_ERR_NO_MEM);
+        return;
+    }
+    memcpy(writer->buffer + writer->offset, data, length);
+    writer->offset += length;
+}
+
+/**
+ * @brief Helper that counts a data item against the current container and
+ * checks that it is allowed at the current position
+ *
+ */
+static bool cjson_cbor_prepare_item(cjson_cbor_writer_t *writer) {
+    if (writer->error != ESP_OK) {
+        return false;
+    }
+    if (writer->remaining[writer->depth] == 0) {
+        // More items than the container (or top level) was opened with
+        cjson_cbor_fail(writer, ESP_ERR_INVALID_STATE);
+        return false;
+    }
+    writer->remaining[writer->depth]--;
+    return true;
+}
+
+/**
+ * @brief Helper for writing an initial byte with its argument in the
+ * shortest form (big endian, as required by CBOR)
+ *
+ */
+static void cjson_cbor_append_head(cjson_cbor_writer_t *writer, uint8_t major,
+                                   uint64_t argument) {
+    uint8_t head[9];
+    size_t size = 0;
+
+    if (argument < 24) {
+        head[0] = (uint8_t)((major << 5) | argument);
+        cjson_cbor_append(writer, head, 1);
+        return;
+    }
+    if (argument <= UINT8_MAX) {
+        head[0] = (uint8_t)((major << 5) | 24);
+        size = 1;
+    } else if (argument <= UINT16_MAX) {
+        head[0] = (uint8_t)((major << 5) | 25);
+        size = 2;
+    } else if (argument <= UINT32_MAX) {
+        head[0] = (uint8_t)((major << 5) | 26);
+        size = 4;
+    } else {
+        head[0] = (uint8_t)((major << 5) | 27);
+        size = 8;
+    }
+    for (size_t i = 0; i < size; i++) {
+        head[size - i] = (uint8_t)(argument >> (8 * i));
+    }
+    cjson_cbor_append(writer, head, size + 1);
+}
+
+/**
+ * @brief Helper for converting a float to a half precision float, only
+ * succeeds if the conversion is lossless
+ *
+ */
+static bool cjson_cbor_half_from_float(float number, uint16_t *half) {
+    uint32_t bits;
+    memcpy(&bits, &number, sizeof(bits));
+
+    uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    int32_t exponent = (int32_t)((bits >> 23) & 0xFF);
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if (exponent == 0xFF) {
+        // Infinity, or NaN (the payload is not kept, any NaN is a NaN)
+        *half = sign | 0x7C00 | ((mantissa != 0) ? 0x0200 : 0);
+        return true;
+    }
+    if ((exponent == 0) && (mantissa == 0)) {
+        *half = sign;
+        return true;
+    }
+    if (exponent == 0) {
+        // Single precision subnormals are far below the half range
+        return false;
+    }
+
+    exponent -= 127;
+    if ((exponent >= -14) && (exponent <= 15)) {
+        // Normal half, 10 of the 23 mantissa bits are kept
+        if ((mantissa & 0x1FFF) != 0) {
+            return false;
+        }
+        *half = sign | (uint16_t)((exponent + 15) << 10) |
+                (uint16_t)(mantissa >> 13);
+        return true;
+    }
+    if ((exponent >= -24) && (exponent < -14)) {
+        // Subnormal half (value = mantissa * 2^-24), the implicit bit becomes
+        // part of the mantissa
+        uint32_t shift = (uint32_t)(-(exponent + 1));
+        uint32_t full = mantissa | 0x800000;
+        if ((full & ((1UL << shift) - 1)) != 0) {
+            return false;
+        }
+        *half = sign | (uint16_t)(full >> shift);
+        return true;
+    }
+
+    return false;
+}
+
+void cjson_cbor_init(cjson_cbor_writer_t *writer, uint8_t *buffer,
+                     size_t buffer_length) {
+    memset(writer, 0, sizeof(*writer));
+    writer->buffer = buffer;
+    writer->length = buffer_length;
+    writer->error = ESP_OK;
+    // A CBOR document is a single data item
+    writer->remaining[0] = 1;
+
+    if ((buffer == NULL) || (buffer_length == 0)) {
+        writer->error = ESP_ERR_INVALID_ARG;
+    }
+}
+
+/**
+ * @brief Helper for opening a map/array
+ *
+ */
+static void cjson_cbor_container_begin(cjson_cbor_writer_t *writer,
+                                       uint8_t major, uint32_t items,
+                                       uint32_t length) {
+    if (!cjson_cbor_prepare_item(writer)) {
+        return;
+    }
+    if (writer->depth + 1 >= CJSON_CBOR_MAX_DEPTH) {
+        cjson_cbor_fail(writer, ESP_ERR_INVALID_STATE);
+        return;
+    }
+
+    cjson_cbor_append_head(writer, major, length);
+    writer->depth++;
+    writer->remaining[writer->depth] = items;
+}
+
+/**
+ * @brief Helper for closing a map/array
+ *
+ */
+static void cjson_cbor_container_end(cjson_cbor_writer_t *writer) {
+    if (writer->error != ESP_OK) {
+        return;
+    }
+    if ((writer->depth == 0) || (writer->remaining[writer->depth] != 0)) {
+        cjson_cbor_fail(writer, ESP_ERR_INVALID_STATE);
+        return;
+    }
+    writer->depth--;
+}
+
+void cjson_cbor_map_begin(cjson_cbor_writer_t *writer, uint32_t members) {
+    if (members > (UINT32_MAX / 2)) {
+        cjson_cbor_fail(writer, ESP_ERR_INVALID_ARG);
+        return;
+    }
+    cjson_cbor_container_begin(writer, CBOR_MAJOR_MAP, members * 2, members);
+}
+
+void cjson_cbor_map_end(cjson_cbor_writer_t *writer) {
+    cjson_cbor_container_end(writer);
+}
+
+void cjson_cbor_array_begin(cjson_cbor_writer_t *writer, uint32_t elements) {
+    cjson_cbor_container_begin(writer, CBOR_MAJOR_ARRAY, elements, elements);
+}
+
+void cjson_cbor_array_end(cjson_cbor_writer_t *writer) {
+    cjson_cbor_container_end(writer);
+}
+
+void cjson_cbor_int(cjson_cbor_writer_t *writer, int64_t number) {
+    if (!cjson_cbor_prepare_item(writer)) {
+        return;
+    }
+    if (number < 0) {
+        // Negative integers are encoded as -1 - n
+        cjson_cbor_append_head(writer, CBOR_MAJOR_NEGATIVE,
+                               (uint64_t)(-1 - number));
+    } else {
+        cjson_cbor_append_head(writer, CBOR_MAJOR_UNSIGNED, (uint64_t)number);
+    }
+}
+
+void cjson_cbor_float(cjson_cbor_writer_t *writer, float number) {
+    uint8_t encoded[5];
+    uint16_t half;
+    uint32_t bits;
+
+    if (!cjson_cbor_prepare_item(writer)) {
+        return;
+    }
+
+    if (cjson_cbor_half_from_float(number, &half)) {
+        encoded[0] = (CBOR_MAJOR_SIMPLE << 5) | CBOR_SIMPLE_HALF;
+        encoded[1] = (uint8_t)(half >> 8);
+        encoded[2] = (uint8_t)half;
+        cjson_cbor_append(writer, encoded, 3);
+        return;
+    }
+
+    memcpy(&bits, &number, sizeof(bits));
+    encoded[0] = (CBOR_MAJOR_SIMPLE << 5) | CBOR_SIMPLE_SINGLE;
+    encoded[1] = (uint8_t)(bits >> 24);
+    encoded[2] = (uint8_t)(bits >> 16);
+    encoded[3] = (uint8_t)(bits >> 8);
+    encoded[4] = (uint8_t)bits;
+    cjson_cbor_append(writer, encoded, sizeof(encoded));
+}
+
+void cjson_cbor_number_scaled(cjson_cbor_writer_t *writer, int32_t value,
+                              int decimals) {
+    static const double scales[CBOR_MAX_DECIMALS + 1] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6,
+    };
+
+    if ((decimals < 0) || (decimals > CBOR_MAX_DECIMALS)) {
+        cjson_cbor_fail(writer, ESP_ERR_INVALID_ARG);
+        return;
+    }
+
+    double number = value / scales[decimals];
+    float single = (float)number;
+    if (lround((double)single * scales[decimals]) == value) {
+        cjson_cbor_float(writer, single);
+        return;
+    }
+
+    // Too many digits for a single float, fall back to a double
+    uint8_t encoded[9];
+    uint64_t bits;
+    if (!cjson_cbor_prepare_item(writer)) {
+        return;
+    }
+    memcpy(&bits, &number, sizeof(bits));
+    encoded[0] = (CBOR_MAJOR_SIMPLE << 5) | CBOR_SIMPLE_DOUBLE;
+    for (size_t i = 0; i < 8; i++) {
+        encoded[8 - i] = (uint8_t)(bits >> (8 * i));
+    }
+    cjson_cbor_append(writer, encoded, sizeof(encoded));
+}
+
+void cjson_cbor_string(cjson_cbor_writer_t *writer, const char *string) {
+    size_t length = (string != NULL) ? strlen(string) : 0;
+
+    if (!cjson_cbor_prepare_item(writer)) {
+        return;
+    }
+    cjson_cbor_append_head(writer, CBOR_MAJOR_TEXT, length);
+    cjson_cbor_append(writer, string, length);
+}
+
+void cjson_cbor_bool(cjson_cbor_writer_t *writer, bool boolean) {
+    if (!cjson_cbor_prepare_item(writer)) {
+        return;
+    }
+    cjson_cbor_append_head(writer, CBOR_MAJOR_SIMPLE,
+                           boolean ? CBOR_SIMPLE_TRUE : CBOR_SIMPLE_FALSE);
+}
+
+void cjson_cbor_null(cjson_cbor_writer_t *writer) {
+    if (!cjson_cbor_prepare_item(writer)) {
+        return;
+    }
+    cjson_cbor_append_head(writer, CBOR_MAJOR_SIMPLE, CBOR_SIMPLE_NULL);
+}
+
+esp_err_t cjson_cbor_finish(cjson_cbor_writer_t *writer) {
+    if (writer->error != ESP_OK) {
+        return writer->error;
+    }
+    if ((writer->depth != 0) || (writer->remaining[0] != 0)) {
+        cjson_cbor_fail(writer, ESP_ERR_INVALID_STATE);
+    }
+    return writer->error;
+}
+
+size_t cjson_cbor_length(const cjson_cbor_writer_t *writer) {
+    return writer->offset;
+}
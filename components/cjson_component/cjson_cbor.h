@@ -0,0 +1,174 @@
+/**
+ * @file cjson_cbor.h
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Streaming CBOR (RFC 8949) writer that encodes directly into a
+ * caller-supplied buffer (no heap allocations), the binary counterpart of
+ * cjson_writer
+ * @version 0.1
+ * @date 2025-05-26
+ *
+ */
+
+#ifndef CJSON_CBOR_H
+#define CJSON_CBOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief MQTT5 content type of CBOR payloads
+ */
+#define CJSON_CBOR_CONTENT_TYPE "application/cbor"
+
+/**
+ * @brief Maximum nesting depth of maps/arrays supported by the writer
+ */
+#define CJSON_CBOR_MAX_DEPTH 16
+
+/**
+ * @brief Streaming CBOR writer state
+ *
+ * Maps and arrays have definite lengths: the number of members/elements is
+ * given when the container is opened and checked when it is closed. A map
+ * member is a key (usually a text string) followed by its value.
+ *
+ * Errors are sticky: after the first failure (buffer overflow, wrong number
+ * of items, ...) all further calls are ignored and the error is reported by
+ * cjson_cbor_finish().
+ */
+typedef struct {
+    uint8_t *buffer;
+    size_t length;
+    size_t offset;
+    uint8_t depth;
+    // Data items still expected per nesting level (level 0 is the single
+    // top-level item, a map member counts as two items)
+    uint32_t remaining[CJSON_CBOR_MAX_DEPTH];
+    esp_err_t error;
+} cjson_cbor_writer_t;
+
+/**
+ * @brief Initialize the writer over a pre-allocated buffer
+ *
+ * @param writer Writer state
+ * @param buffer Buffer for holding the encoded data
+ * @param buffer_length Size of the buffer
+ */
+void cjson_cbor_init(cjson_cbor_writer_t *writer, uint8_t *buffer,
+                     size_t buffer_length);
+
+/**
+ * @brief Open a map, must be followed by 'members' key/value pairs
+ *
+ * @param writer Writer state
+ * @param members Number of key/value pairs
+ */
+void cjson_cbor_map_begin(cjson_cbor_writer_t *writer, uint32_t members);
+
+/**
+ * @brief Close the current map (nothing is written, the map length was
+ * encoded up front)
+ *
+ * @param writer Writer state
+ */
+void cjson_cbor_map_end(cjson_cbor_writer_t *writer);
+
+/**
+ * @brief Open an array, must be followed by 'elements' values
+ *
+ * @param writer Writer state
+ * @param elements Number of elements
+ */
+void cjson_cbor_array_begin(cjson_cbor_writer_t *writer, uint32_t elements);
+
+/**
+ * @brief Close the current array (nothing is written, the array length was
+ * encoded up front)
+ *
+ * @param writer Writer state
+ */
+void cjson_cbor_array_end(cjson_cbor_writer_t *writer);
+
+/**
+ * @brief Write an integer in the shortest encoding (1 byte for -24..23)
+ *
+ * @param writer Writer state
+ * @param number The number to write
+ */
+void cjson_cbor_int(cjson_cbor_writer_t *writer, int64_t number);
+
+/**
+ * @brief Write a float as a half precision float if that is lossless,
+ * otherwise as a single precision float
+ *
+ * @param writer Writer state
+ * @param number The number to write
+ */
+void cjson_cbor_float(cjson_cbor_writer_t *writer, float number);
+
+/**
+ * @brief Write a scaled integer as the shortest float that reads back as the
+ * same value with 'decimals' decimals (e.g. 2 decimals: 2250 -> 22.5 as a
+ * half float, 4567 -> 45.67f as a single float), the CBOR counterpart of
+ * cjson_writer_number_scaled
+ *
+ * @param writer Writer state
+ * @param value The number to write, in units of 10^-decimals
+ * @param decimals Number of decimals, 0 to 6
+ */
+void cjson_cbor_number_scaled(cjson_cbor_writer_t *writer, int32_t value,
+                              int decimals);
+
+/**
+ * @brief Write a UTF-8 text string
+ *
+ * @param writer Writer state
+ * @param string Null terminated string, NULL writes ""
+ */
+void cjson_cbor_string(cjson_cbor_writer_t *writer, const char *string);
+
+/**
+ * @brief Write a boolean value
+ *
+ * @param writer Writer state
+ * @param boolean The value to write
+ */
+void cjson_cbor_bool(cjson_cbor_writer_t *writer, bool boolean);
+
+/**
+ * @brief Write a null value
+ *
+ * @param writer Writer state
+ */
+void cjson_cbor_null(cjson_cbor_writer_t *writer);
+
+/**
+ * @brief Finish writing and check the result
+ *
+ * @param writer Writer state
+ * @return esp_err_t ESP_OK if a single complete data item was written,
+ * ESP_ERR_NO_MEM if the buffer was too small, ESP_ERR_INVALID_STATE if the
+ * number of items did not match the container lengths
+ */
+esp_err_t cjson_cbor_finish(cjson_cbor_writer_t *writer);
+
+/**
+ * @brief Number of bytes written so far
+ *
+ * @param writer Writer state
+ * @return size_t
+ */
+size_t cjson_cbor_length(const cjson_cbor_writer_t *writer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // CJSON_CBOR_H
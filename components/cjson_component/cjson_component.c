@@ -9,11 +9,44 @@
 
 #include "cjson_component.h"
 
+#include <math.h>
 #include <stddef.h>
 
 #include "cjson.h"
+#include "cjson_cbor.h"
+#include "cjson_writer.h"
+#include "sdkconfig.h"
 #include "uart_comm.h"
 
+// Humidity/temperature are published with 2 decimals, which covers the
+// ChipCap2's 14-bit resolution (~0.01 %RH / ~0.01 °C)
+#define CHIPCAP2_JSON_DECIMALS 2
+
+void cjson_component_chipcap2_value(cjson_writer_t *writer,
+                                    const i2c_chipcap2_mixed_number_t *number) {
+#if CONFIG_CHIPCAP2_FIXED_POINT
+    // Printed directly from the hundredths, no floating point math
+    cjson_writer_number_scaled(writer, number->centi, CHIPCAP2_JSON_DECIMALS);
+#else
+    cjson_writer_number_fixed(writer, number->value, CHIPCAP2_JSON_DECIMALS);
+#endif
+}
+
+/**
+ * @brief Helper for writing a humidity/temperature value as CBOR with the
+ * same CHIPCAP2_JSON_DECIMALS decimals as the JSON string
+ *
+ */
+static void cjson_cbor_chipcap2_value(
+    cjson_cbor_writer_t *writer, const i2c_chipcap2_mixed_number_t *number) {
+#if CONFIG_CHIPCAP2_FIXED_POINT
+    cjson_cbor_number_scaled(writer, number->centi, CHIPCAP2_JSON_DECIMALS);
+#else
+    cjson_cbor_number_scaled(writer, (int32_t)lroundf(number->value * 100),
+                             CHIPCAP2_JSON_DECIMALS);
+#endif
+}
+
 char *cjson_format_chipcap2_data_unfomatted(
     i2c_chipcap2_data_t *chipcap2_data) {
     cJSON *data = cJSON_CreateObject();
@@ -25,8 +58,10 @@ char *cjson_format_chipcap2_data_unfomatted(
     if (obj == NULL) {
         return NULL;
     }
-    if (cJSON_AddNumberToObject(obj, "humidity",
-                                chipcap2_data->humidity.value) == NULL) {
+    if (cJSON_SetNumberPrecision(
+            cJSON_AddNumberToObject(obj, "humidity",
+                                    chipcap2_data->humidity.value),
+            CHIPCAP2_JSON_DECIMALS) == false) {
         cJSON_Delete(obj);
         return NULL;
     }
@@ -41,8 +76,10 @@ char *cjson_format_chipcap2_data_unfomatted(
     if (obj == NULL) {
         return NULL;
     }
-    if (cJSON_AddNumberToObject(obj, "temperature",
-                                chipcap2_data->temperature.value) == NULL) {
+    if (cJSON_SetNumberPrecision(
+            cJSON_AddNumberToObject(obj, "temperature",
+                                    chipcap2_data->temperature.value),
+            CHIPCAP2_JSON_DECIMALS) == false) {
         cJSON_Delete(obj);
         return NULL;
     }
@@ -63,59 +100,78 @@ char *cjson_format_chipcap2_data_unfomatted(
 
 esp_err_t cjson_format_chipcap2_data_prebuffered(
     i2c_chipcap2_data_t *chipcap2_data, char *buffer, uint16_t buffer_lenght) {
-    cJSON *data = cJSON_CreateObject();
-    cJSON *sensor_data = cJSON_AddArrayToObject(data, "sensor-data");
-    cJSON *humidity = NULL;
-    cJSON *temperature = NULL;
+    cjson_writer_t writer;
+
+    // Stream the JSON directly into the buffer, no cJSON tree is built so
+    // the periodic read&publish path does not touch the heap
+    cjson_writer_init(&writer, buffer, buffer_lenght);
+    cjson_writer_object_begin(&writer);
+    cjson_writer_key(&writer, "sensor-data");
+    cjson_writer_array_begin(&writer);
 
     // Humidity
-    humidity = cJSON_CreateObject();
-    if (humidity == NULL) {
-        uart_comm_vsend("[CJSON-ERROR] Failed to create humidity object!\r\n");
-        return ESP_FAIL;
-    }
-    if (cJSON_AddNumberToObject(humidity, "humidity",
-                                chipcap2_data->humidity.value) == NULL) {
-        uart_comm_vsend("[CJSON-ERROR] Failed to create humidity value!\r\n");
-        cJSON_Delete(data);
-        return ESP_FAIL;
-    }
-    if (cJSON_AddStringToObject(humidity, "unit", "%% (RH)") == NULL) {
-        uart_comm_vsend("[CJSON-ERROR] Failed to create humidity unit!\r\n");
-        cJSON_Delete(data);
-        return ESP_FAIL;
-    }
-    cJSON_AddItemToArray(sensor_data, humidity);
+    cjson_writer_object_begin(&writer);
+    cjson_writer_key(&writer, "humidity");
+    cjson_component_chipcap2_value(&writer, &chipcap2_data->humidity);
+    cjson_writer_key(&writer, "unit");
+    cjson_writer_string(&writer, "%% (RH)");
+    cjson_writer_object_end(&writer);
 
     // Temperature
-    temperature = cJSON_CreateObject();
-    if (temperature == NULL) {
-        uart_comm_vsend(
-            "[CJSON-ERROR] Failed to create temperature object!\r\n");
-        return ESP_FAIL;
-    }
-    if (cJSON_AddNumberToObject(temperature, "temperature",
-                                chipcap2_data->temperature.value) == NULL) {
-        uart_comm_vsend(
-            "[CJSON-ERROR] Failed to create temperature value!\r\n");
-        cJSON_Delete(data);
-        return ESP_FAIL;
-    }
-    if (cJSON_AddStringToObject(temperature, "unit", "°C") == NULL) {
-        uart_comm_vsend("[CJSON-ERROR] Failed to create temperature unit!\r\n");
-        cJSON_Delete(data);
+    cjson_writer_object_begin(&writer);
+    cjson_writer_key(&writer, "temperature");
+    cjson_component_chipcap2_value(&writer, &chipcap2_data->temperature);
+    cjson_writer_key(&writer, "unit");
+    cjson_writer_string(&writer, "°C");
+    cjson_writer_object_end(&writer);
+
+    cjson_writer_array_end(&writer);
+    cjson_writer_object_end(&writer);
+
+    if (cjson_writer_finish(&writer) != ESP_OK) {
+        uart_comm_vsend("[CJSON-ERROR] Failed to create JSON string!\r\n");
         return ESP_FAIL;
     }
-    cJSON_AddItemToArray(sensor_data, temperature);
 
-    cJSON_bool result =
-        cJSON_PrintPreallocated(data, buffer, buffer_lenght, false);
-    cJSON_Delete(data);
+    return ESP_OK;
+}
 
-    if (result == false) {
-        uart_comm_vsend("[CJSON-ERROR] Failed to create JSON string!\r\n");
+esp_err_t cjson_format_chipcap2_data_cbor_prebuffered(
+    i2c_chipcap2_data_t *chipcap2_data, uint8_t *buffer, size_t buffer_lenght,
+    size_t *length) {
+    cjson_cbor_writer_t writer;
+
+    // Same document as the JSON string, the keys and units are kept so a
+    // generic CBOR decoder gives the same result as a JSON parser
+    cjson_cbor_init(&writer, buffer, buffer_lenght);
+    cjson_cbor_map_begin(&writer, 1);
+    cjson_cbor_string(&writer, "sensor-data");
+    cjson_cbor_array_begin(&writer, 2);
+
+    // Humidity
+    cjson_cbor_map_begin(&writer, 2);
+    cjson_cbor_string(&writer, "humidity");
+    cjson_cbor_chipcap2_value(&writer, &chipcap2_data->humidity);
+    cjson_cbor_string(&writer, "unit");
+    cjson_cbor_string(&writer, "%% (RH)");
+    cjson_cbor_map_end(&writer);
+
+    // Temperature
+    cjson_cbor_map_begin(&writer, 2);
+    cjson_cbor_string(&writer, "temperature");
+    cjson_cbor_chipcap2_value(&writer, &chipcap2_data->temperature);
+    cjson_cbor_string(&writer, "unit");
+    cjson_cbor_string(&writer, "°C");
+    cjson_cbor_map_end(&writer);
+
+    cjson_cbor_array_end(&writer);
+    cjson_cbor_map_end(&writer);
+
+    if (cjson_cbor_finish(&writer) != ESP_OK) {
+        uart_comm_vsend("[CJSON-ERROR] Failed to encode CBOR data!\r\n");
         return ESP_FAIL;
     }
 
+    *length = cjson_cbor_length(&writer);
     return ESP_OK;
-}
\ No newline at end of file
+}
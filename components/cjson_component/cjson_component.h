@@ -10,6 +10,7 @@
 #ifndef CJSON_COMPONENT_H
 #define CJSON_COMPONENT_H
 
+#include "cjson_writer.h"
 #include "i2c_chipcap2.h"
 
 #ifdef __cplusplus
@@ -27,6 +28,9 @@ char *cjson_format_chipcap2_data(i2c_chipcap2_data_t *chipcap2_data);
 /**
  * @brief Format a JSON string with ChipCap2 sensor data using a pre-buffer
  *
+ * The JSON is streamed directly into the buffer with the cjson_writer, no
+ * cJSON tree is built and no heap memory is used.
+ *
  * @param chipcap2_data ChipCap2 sensor data refeence
  * @param buffer Buffer for holding the generated JSON string
  * @param buffer_lenght Size of the pre-buffer that will hold the generated JSON
@@ -36,6 +40,33 @@ char *cjson_format_chipcap2_data(i2c_chipcap2_data_t *chipcap2_data);
 esp_err_t cjson_format_chipcap2_data_prebuffered(
     i2c_chipcap2_data_t *chipcap2_data, char *buffer, uint16_t buffer_lenght);
 
+/**
+ * @brief Encode ChipCap2 sensor data as CBOR using a pre-buffer (no heap
+ * allocations), the same document as
+ * cjson_format_chipcap2_data_prebuffered with the values as the shortest
+ * float that keeps their 2 decimals (~20% smaller than the JSON string,
+ * the keys and units are most of both documents)
+ *
+ * @param chipcap2_data ChipCap2 sensor data refeence
+ * @param buffer Buffer for holding the encoded data
+ * @param buffer_lenght Size of the pre-buffer
+ * @param length Output number of encoded bytes, only written on ESP_OK
+ * @return esp_err_t
+ */
+esp_err_t cjson_format_chipcap2_data_cbor_prebuffered(
+    i2c_chipcap2_data_t *chipcap2_data, uint8_t *buffer, size_t buffer_lenght,
+    size_t *length);
+
+/**
+ * @brief Write a ChipCap2 humidity/temperature value with the decimals of the
+ * sensor data payload (from the hundredths with CONFIG_CHIPCAP2_FIXED_POINT)
+ *
+ * @param writer JSON writer
+ * @param number Humidity or temperature
+ */
+void cjson_component_chipcap2_value(cjson_writer_t *writer,
+                                    const i2c_chipcap2_mixed_number_t *number);
+
 #ifdef __cplusplus
 }
 #endif
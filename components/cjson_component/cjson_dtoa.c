@@ -0,0 +1,608 @@
+/**
+ * @file cjson_dtoa.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Fast number-to-text conversion for JSON printing (shortest
+ * round-trip Grisu2 and fixed-precision modes, no printf/scanf)
+ * @version 0.1
+ * @date 2025-05-14
+ *
+ * The shortest mode is an implementation of Florian Loitsch's Grisu2
+ * algorithm ("Printing Floating-Point Numbers Quickly and Accurately with
+ * Integers", PLDI 2010). Only integer arithmetic is used, which matters on
+ * the ESP32-C3 that has no FPU. The produced digits always parse back to the
+ * original value and are the shortest such digits in the vast majority of
+ * cases.
+ *
+ */
+
+#include "cjson_dtoa.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+// Grisu2 target range of the binary exponent of the scaled value
+#define GRISU_ALPHA (-60)
+#define GRISU_GAMMA (-32)
+#define CACHED_POWERS_MIN_DEC_EXP (-300)
+#define CACHED_POWERS_DEC_STEP 8
+
+// Decimal point positions outside [MIN, MAX] use scientific notation
+#define FORMAT_MIN_EXP (-4)
+#define FORMAT_MAX_EXP 15
+
+/**
+ * @brief "Do-it-yourself" floating point number: f * 2^e
+ */
+typedef struct {
+    uint64_t f;
+    int e;
+} diy_fp_t;
+
+/**
+ * @brief Normalized diy-fp approximation of 10^k
+ */
+typedef struct {
+    uint64_t f;
+    int e;
+    int k;
+} cached_power_t;
+
+/**
+ * @brief A value and its normalized rounding boundaries
+ */
+typedef struct {
+    diy_fp_t w;
+    diy_fp_t minus;
+    diy_fp_t plus;
+} boundaries_t;
+
+// Powers of ten 10^-300 ... 10^324 in steps of 8, rounded to 64 bits
+static const cached_power_t cached_powers[] = {
+    {0xAB70FE17C79AC6CA, -1060, -300},
+    {0xFF77B1FCBEBCDC4F, -1034, -292},
+    {0xBE5691EF416BD60C, -1007, -284},
+    {0x8DD01FAD907FFC3C, -980, -276},
+    {0xD3515C2831559A83, -954, -268},
+    {0x9D71AC8FADA6C9B5, -927, -260},
+    {0xEA9C227723EE8BCB, -901, -252},
+    {0xAECC49914078536D, -874, -244},
+    {0x823C12795DB6CE57, -847, -236},
+    {0xC21094364DFB5637, -821, -228},
+    {0x9096EA6F3848984F, -794, -220},
+    {0xD77485CB25823AC7, -768, -212},
+    {0xA086CFCD97BF97F4, -741, -204},
+    {0xEF340A98172AACE5, -715, -196},
+    {0xB23867FB2A35B28E, -688, -188},
+    {0x84C8D4DFD2C63F3B, -661, -180},
+    {0xC5DD44271AD3CDBA, -635, -172},
+    {0x936B9FCEBB25C996, -608, -164},
+    {0xDBAC6C247D62A584, -582, -156},
+    {0xA3AB66580D5FDAF6, -555, -148},
+    {0xF3E2F893DEC3F126, -529, -140},
+    {0xB5B5ADA8AAFF80B8, -502, -132},
+    {0x87625F056C7C4A8B, -475, -124},
+    {0xC9BCFF6034C13053, -449, -116},
+    {0x964E858C91BA2655, -422, -108},
+    {0xDFF9772470297EBD, -396, -100},
+    {0xA6DFBD9FB8E5B88F, -369, -92},
+    {0xF8A95FCF88747D94, -343, -84},
+    {0xB94470938FA89BCF, -316, -76},
+    {0x8A08F0F8BF0F156B, -289, -68},
+    {0xCDB02555653131B6, -263, -60},
+    {0x993FE2C6D07B7FAC, -236, -52},
+    {0xE45C10C42A2B3B06, -210, -44},
+    {0xAA242499697392D3, -183, -36},
+    {0xFD87B5F28300CA0E, -157, -28},
+    {0xBCE5086492111AEB, -130, -20},
+    {0x8CBCCC096F5088CC, -103, -12},
+    {0xD1B71758E219652C, -77, -4},
+    {0x9C40000000000000, -50, 4},
+    {0xE8D4A51000000000, -24, 12},
+    {0xAD78EBC5AC620000, 3, 20},
+    {0x813F3978F8940984, 30, 28},
+    {0xC097CE7BC90715B3, 56, 36},
+    {0x8F7E32CE7BEA5C70, 83, 44},
+    {0xD5D238A4ABE98068, 109, 52},
+    {0x9F4F2726179A2245, 136, 60},
+    {0xED63A231D4C4FB27, 162, 68},
+    {0xB0DE65388CC8ADA8, 189, 76},
+    {0x83C7088E1AAB65DB, 216, 84},
+    {0xC45D1DF942711D9A, 242, 92},
+    {0x924D692CA61BE758, 269, 100},
+    {0xDA01EE641A708DEA, 295, 108},
+    {0xA26DA3999AEF774A, 322, 116},
+    {0xF209787BB47D6B85, 348, 124},
+    {0xB454E4A179DD1877, 375, 132},
+    {0x865B86925B9BC5C2, 402, 140},
+    {0xC83553C5C8965D3D, 428, 148},
+    {0x952AB45CFA97A0B3, 455, 156},
+    {0xDE469FBD99A05FE3, 481, 164},
+    {0xA59BC234DB398C25, 508, 172},
+    {0xF6C69A72A3989F5C, 534, 180},
+    {0xB7DCBF5354E9BECE, 561, 188},
+    {0x88FCF317F22241E2, 588, 196},
+    {0xCC20CE9BD35C78A5, 614, 204},
+    {0x98165AF37B2153DF, 641, 212},
+    {0xE2A0B5DC971F303A, 667, 220},
+    {0xA8D9D1535CE3B396, 694, 228},
+    {0xFB9B7CD9A4A7443C, 720, 236},
+    {0xBB764C4CA7A44410, 747, 244},
+    {0x8BAB8EEFB6409C1A, 774, 252},
+    {0xD01FEF10A657842C, 800, 260},
+    {0x9B10A4E5E9913129, 827, 268},
+    {0xE7109BFBA19C0C9D, 853, 276},
+    {0xAC2820D9623BF429, 880, 284},
+    {0x80444B5E7AA7CF85, 907, 292},
+    {0xBF21E44003ACDD2D, 933, 300},
+    {0x8E679C2F5E44FF8F, 960, 308},
+    {0xD433179D9C8CB841, 986, 316},
+    {0x9E19DB92B4E31BA9, 1013, 324},
+};
+
+static diy_fp_t diy_fp_sub(diy_fp_t x, diy_fp_t y) {
+    diy_fp_t result = {x.f - y.f, x.e};
+    return result;
+}
+
+/**
+ * @brief Upper 64 bits of the 128-bit product, rounded
+ *
+ */
+static diy_fp_t diy_fp_mul(diy_fp_t x, diy_fp_t y) {
+    const uint64_t u_lo = x.f & 0xFFFFFFFFu;
+    const uint64_t u_hi = x.f >> 32;
+    const uint64_t v_lo = y.f & 0xFFFFFFFFu;
+    const uint64_t v_hi = y.f >> 32;
+
+    const uint64_t p0 = u_lo * v_lo;
+    const uint64_t p1 = u_lo * v_hi;
+    const uint64_t p2 = u_hi * v_lo;
+    const uint64_t p3 = u_hi * v_hi;
+
+    uint64_t q = (p0 >> 32) + (p1 & 0xFFFFFFFFu) + (p2 & 0xFFFFFFFFu);
+    // Round, ties up
+    q += (uint64_t)1 << 31;
+
+    diy_fp_t result = {p3 + (p2 >> 32) + (p1 >> 32) + (q >> 32),
+                       x.e + y.e + 64};
+    return result;
+}
+
+static diy_fp_t diy_fp_normalize(diy_fp_t x) {
+    while ((x.f >> 63) == 0) {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+static diy_fp_t diy_fp_normalize_to(diy_fp_t x, int target_exponent) {
+    diy_fp_t result = {x.f << (x.e - target_exponent), target_exponent};
+    return result;
+}
+
+/**
+ * @brief Compute the normalized value and its boundaries m- and m+ for an
+ * IEEE-754 number given as raw significand/exponent bits
+ *
+ * @param fraction Significand bits without the hidden bit
+ * @param biased_exponent Raw exponent bits
+ * @param precision Significand precision including the hidden bit (53 or 24)
+ * @param bias Exponent bias including the significand shift
+ */
+static boundaries_t compute_boundaries(uint64_t fraction, int biased_exponent,
+                                       int precision, int bias) {
+    const uint64_t hidden_bit = (uint64_t)1 << (precision - 1);
+    diy_fp_t v;
+    diy_fp_t m_minus;
+    diy_fp_t m_plus;
+    boundaries_t result;
+
+    if (biased_exponent == 0) {
+        // Subnormal
+        v.f = fraction;
+        v.e = 1 - bias;
+    } else {
+        v.f = fraction | hidden_bit;
+        v.e = biased_exponent - bias;
+    }
+
+    // The lower boundary is closer if the significand is a power of two
+    const bool lower_boundary_is_closer =
+        (fraction == 0) && (biased_exponent > 1);
+    m_plus.f = 2 * v.f + 1;
+    m_plus.e = v.e - 1;
+    if (lower_boundary_is_closer) {
+        m_minus.f = 4 * v.f - 1;
+        m_minus.e = v.e - 2;
+    } else {
+        m_minus.f = 2 * v.f - 1;
+        m_minus.e = v.e - 1;
+    }
+
+    result.plus = diy_fp_normalize(m_plus);
+    result.minus = diy_fp_normalize_to(m_minus, result.plus.e);
+    result.w = diy_fp_normalize(v);
+    return result;
+}
+
+/**
+ * @brief Find a cached power of ten c = 10^-k such that the binary exponent
+ * of c * 2^e lies within [GRISU_ALPHA, GRISU_GAMMA]
+ *
+ */
+static cached_power_t get_cached_power(int e) {
+    const int f = GRISU_ALPHA - e - 1;
+    // 78913 / 2^18 approximates log10(2)
+    const int k = (f * 78913) / (1 << 18) + (f > 0 ? 1 : 0);
+    const int index = (-CACHED_POWERS_MIN_DEC_EXP + k +
+                       (CACHED_POWERS_DEC_STEP - 1)) /
+                      CACHED_POWERS_DEC_STEP;
+    return cached_powers[index];
+}
+
+/**
+ * @brief Number of decimal digits of n and the largest power of ten <= n
+ *
+ */
+static int find_largest_pow10(uint32_t n, uint32_t *pow10) {
+    static const uint32_t powers[] = {
+        1u,      10u,      100u,      1000u,      10000u,
+        100000u, 1000000u, 10000000u, 100000000u, 1000000000u};
+    int digits = 10;
+
+    while ((digits > 1) && (n < powers[digits - 1])) {
+        digits--;
+    }
+    *pow10 = powers[digits - 1];
+    return digits;
+}
+
+static void grisu2_round(char *buffer, int length, uint64_t distance,
+                         uint64_t delta, uint64_t rest, uint64_t ten_k) {
+    // Move the last digit towards the exact value while staying in the
+    // rounding interval
+    while ((rest < distance) && (delta - rest >= ten_k) &&
+           ((rest + ten_k < distance) ||
+            (distance - rest > rest + ten_k - distance))) {
+        buffer[length - 1]--;
+        rest += ten_k;
+    }
+}
+
+/**
+ * @brief Generate the digits of w within the interval (m_minus, m_plus)
+ *
+ */
+static int grisu2_digit_gen(char *buffer, int *decimal_exponent,
+                            diy_fp_t m_minus, diy_fp_t w, diy_fp_t m_plus) {
+    uint64_t delta = diy_fp_sub(m_plus, m_minus).f;
+    uint64_t distance = diy_fp_sub(m_plus, w).f;
+    const diy_fp_t one = {(uint64_t)1 << -m_plus.e, m_plus.e};
+    uint32_t p1 = (uint32_t)(m_plus.f >> -one.e);
+    uint64_t p2 = m_plus.f & (one.f - 1);
+    uint32_t pow10 = 0;
+    int length = 0;
+    int n = find_largest_pow10(p1, &pow10);
+
+    // Integral part
+    while (n > 0) {
+        const uint32_t digit = p1 / pow10;
+        p1 %= pow10;
+        buffer[length++] = (char)('0' + digit);
+        n--;
+
+        const uint64_t rest = ((uint64_t)p1 << -one.e) + p2;
+        if (rest <= delta) {
+            *decimal_exponent += n;
+            grisu2_round(buffer, length, distance, delta, rest,
+                         (uint64_t)pow10 << -one.e);
+            return length;
+        }
+        pow10 /= 10;
+    }
+
+    // Fractional part
+    int m = 0;
+    for (;;) {
+        p2 *= 10;
+        buffer[length++] = (char)('0' + (p2 >> -one.e));
+        p2 &= one.f - 1;
+        m++;
+
+        delta *= 10;
+        distance *= 10;
+        if (p2 <= delta) {
+            break;
+        }
+    }
+    *decimal_exponent -= m;
+    grisu2_round(buffer, length, distance, delta, p2, one.f);
+    return length;
+}
+
+static int grisu2(char *buffer, int *decimal_exponent,
+                  boundaries_t boundaries) {
+    const cached_power_t cached = get_cached_power(boundaries.plus.e);
+    const diy_fp_t c_minus_k = {cached.f, cached.e};
+
+    const diy_fp_t w = diy_fp_mul(boundaries.w, c_minus_k);
+    const diy_fp_t w_minus = diy_fp_mul(boundaries.minus, c_minus_k);
+    const diy_fp_t w_plus = diy_fp_mul(boundaries.plus, c_minus_k);
+
+    // Shrink the interval by one unit to be safe against the rounding
+    // errors of the multiplications
+    const diy_fp_t m_minus = {w_minus.f + 1, w_minus.e};
+    const diy_fp_t m_plus = {w_plus.f - 1, w_plus.e};
+
+    *decimal_exponent = -cached.k;
+    return grisu2_digit_gen(buffer, decimal_exponent, m_minus, w, m_plus);
+}
+
+/**
+ * @brief Write digits * 10^decimal_exponent in plain or scientific notation
+ *
+ */
+static int format_digits(char *buffer, const char *digits, int length,
+                         int decimal_exponent) {
+    // Position of the decimal point relative to the first digit
+    const int n = length + decimal_exponent;
+    char *output = buffer;
+
+    if ((length <= n) && (n <= FORMAT_MAX_EXP)) {
+        // dddd00
+        memcpy(output, digits, (size_t)length);
+        output += length;
+        memset(output, '0', (size_t)(n - length));
+        output += n - length;
+    } else if ((0 < n) && (n <= FORMAT_MAX_EXP)) {
+        // dd.dd
+        memcpy(output, digits, (size_t)n);
+        output += n;
+        *output++ = '.';
+        memcpy(output, digits + n, (size_t)(length - n));
+        output += length - n;
+    } else if ((FORMAT_MIN_EXP < n) && (n <= 0)) {
+        // 0.00dddd
+        *output++ = '0';
+        *output++ = '.';
+        memset(output, '0', (size_t)-n);
+        output += -n;
+        memcpy(output, digits, (size_t)length);
+        output += length;
+    } else {
+        // d.ddde+XX, at least two exponent digits like printf's %g
+        int exponent = n - 1;
+        *output++ = digits[0];
+        if (length > 1) {
+            *output++ = '.';
+            memcpy(output, digits + 1, (size_t)(length - 1));
+            output += length - 1;
+        }
+        *output++ = 'e';
+        if (exponent < 0) {
+            *output++ = '-';
+            exponent = -exponent;
+        } else {
+            *output++ = '+';
+        }
+        if (exponent >= 100) {
+            *output++ = (char)('0' + exponent / 100);
+            exponent %= 100;
+        }
+        *output++ = (char)('0' + exponent / 10);
+        *output++ = (char)('0' + exponent % 10);
+    }
+
+    *output = '\0';
+    return (int)(output - buffer);
+}
+
+/**
+ * @brief Helper for the special values shared by the shortest modes,
+ * returns the written length or -1 if the value is a regular number
+ *
+ */
+static int write_special(bool negative, bool is_zero, bool is_finite,
+                         char *buffer) {
+    if (!is_finite) {
+        memcpy(buffer, "null", sizeof("null"));
+        return 4;
+    }
+    if (is_zero) {
+        buffer[0] = '0';
+        buffer[1] = '\0';
+        return 1;
+    }
+    if (negative) {
+        buffer[0] = '-';
+    }
+    return -1;
+}
+
+int cjson_dtoa_shortest(double value, char *buffer) {
+    char digits[20];
+    int decimal_exponent = 0;
+    uint64_t bits = 0;
+
+    memcpy(&bits, &value, sizeof(bits));
+    const bool negative = (bits >> 63) != 0;
+    const int biased_exponent = (int)((bits >> 52) & 0x7FF);
+    const uint64_t fraction = bits & (((uint64_t)1 << 52) - 1);
+
+    const int special =
+        write_special(negative, (biased_exponent == 0) && (fraction == 0),
+                      biased_exponent != 0x7FF, buffer);
+    if (special >= 0) {
+        return special;
+    }
+
+    const int length =
+        grisu2(digits, &decimal_exponent,
+               compute_boundaries(fraction, biased_exponent, 53, 1075));
+    return (negative ? 1 : 0) + format_digits(buffer + (negative ? 1 : 0),
+                                              digits, length,
+                                              decimal_exponent);
+}
+
+int cjson_ftoa_shortest(float value, char *buffer) {
+    char digits[20];
+    int decimal_exponent = 0;
+    uint32_t bits = 0;
+
+    memcpy(&bits, &value, sizeof(bits));
+    const bool negative = (bits >> 31) != 0;
+    const int biased_exponent = (int)((bits >> 23) & 0xFF);
+    const uint64_t fraction = bits & ((1u << 23) - 1);
+
+    const int special =
+        write_special(negative, (biased_exponent == 0) && (fraction == 0),
+                      biased_exponent != 0xFF, buffer);
+    if (special >= 0) {
+        return special;
+    }
+
+    const int length =
+        grisu2(digits, &decimal_exponent,
+               compute_boundaries(fraction, biased_exponent, 24, 150));
+    return (negative ? 1 : 0) + format_digits(buffer + (negative ? 1 : 0),
+                                              digits, length,
+                                              decimal_exponent);
+}
+
+int cjson_dtoa_fixed(double value, int decimals, char *buffer) {
+    static const uint32_t scales[CJSON_DTOA_MAX_DECIMALS + 1] = {
+        1u,      10u,      100u,      1000u,      10000u,
+        100000u, 1000000u, 10000000u, 100000000u, 1000000000u};
+    char digits[24];
+    char *output = buffer;
+    int length = 0;
+
+    if (decimals < 0) {
+        decimals = 0;
+    } else if (decimals > CJSON_DTOA_MAX_DECIMALS) {
+        decimals = CJSON_DTOA_MAX_DECIMALS;
+    }
+
+    // NaN fails both comparisons, too large values can't be scaled exactly
+    const double scaled = value * scales[decimals];
+    if (!((scaled < 9007199254740992.0) && (scaled > -9007199254740992.0))) {
+        return cjson_dtoa_shortest(value, buffer);
+    }
+
+    // Rounded half away from zero on the shortest digits, not on value *
+    // scale: the multiplication adds binary error (1.005 * 100 is
+    // 100.49999999999999), the shortest digits are what a reader sees
+    const bool negative = value < 0;
+    uint64_t integer = 0;
+    if (value != 0) {
+        char shortest[20];
+        int decimal_exponent = 0;
+        uint64_t bits = 0;
+
+        memcpy(&bits, &value, sizeof(bits));
+        const int shortest_length = grisu2(
+            shortest, &decimal_exponent,
+            compute_boundaries(bits & (((uint64_t)1 << 52) - 1),
+                               (int)((bits >> 52) & 0x7FF), 53, 1075));
+        // Number of digits left of the last kept decimal
+        const int kept = shortest_length + decimal_exponent + decimals;
+
+        for (int i = 0; (i < kept) && (i < shortest_length); i++) {
+            integer = integer * 10 + (uint64_t)(shortest[i] - '0');
+        }
+        for (int i = shortest_length; i < kept; i++) {
+            integer *= 10;
+        }
+        if ((kept >= 0) && (kept < shortest_length) &&
+            (shortest[kept] >= '5')) {
+            integer++;
+        }
+    }
+
+    if (negative && (integer != 0)) {
+        *output++ = '-';
+    }
+
+    // Digits in reverse, padded so there is at least one integral digit
+    do {
+        digits[length++] = (char)('0' + integer % 10);
+        integer /= 10;
+    } while ((integer != 0) || (length <= decimals));
+
+    while (length > decimals) {
+        *output++ = digits[--length];
+    }
+    if (decimals > 0) {
+        *output++ = '.';
+        while (length > 0) {
+            *output++ = digits[--length];
+        }
+    }
+
+    *output = '\0';
+    return (int)(output - buffer);
+}
+
+int cjson_itoa(int32_t value, char *buffer) {
+    char digits[10];
+    char *output = buffer;
+    int length = 0;
+    // Unsigned to handle INT32_MIN
+    uint32_t magnitude = (uint32_t)value;
+
+    if (value < 0) {
+        *output++ = '-';
+        magnitude = 0u - magnitude;
+    }
+
+    do {
+        digits[length++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+
+    while (length > 0) {
+        *output++ = digits[--length];
+    }
+
+    *output = '\0';
+    return (int)(output - buffer);
+}
+
+int cjson_itoa_scaled(int32_t value, int decimals, char *buffer) {
+    char digits[12];
+    char *output = buffer;
+    int length = 0;
+    // Unsigned to handle INT32_MIN
+    uint32_t magnitude = (uint32_t)value;
+
+    if (decimals < 0) {
+        decimals = 0;
+    } else if (decimals > CJSON_DTOA_MAX_DECIMALS) {
+        decimals = CJSON_DTOA_MAX_DECIMALS;
+    }
+
+    if (value < 0) {
+        *output++ = '-';
+        magnitude = 0u - magnitude;
+    }
+
+    // Digits in reverse, padded so there is at least one integral digit
+    do {
+        digits[length++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while ((magnitude != 0) || (length <= decimals));
+
+    while (length > decimals) {
+        *output++ = digits[--length];
+    }
+    if (decimals > 0) {
+        *output++ = '.';
+        while (length > 0) {
+            *output++ = digits[--length];
+        }
+    }
+
+    *output = '\0';
+    return (int)(output - buffer);
+}
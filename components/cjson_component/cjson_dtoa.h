@@ -0,0 +1,93 @@
+/**
+ * @file cjson_dtoa.h
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Fast number-to-text conversion for JSON printing (shortest
+ * round-trip Grisu2 and fixed-precision modes, no printf/scanf)
+ * @version 0.1
+ * @date 2025-05-14
+ *
+ */
+
+#ifndef CJSON_DTOA_H
+#define CJSON_DTOA_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Minimum size of the output buffer for all conversion functions
+ */
+#define CJSON_DTOA_BUFFER_SIZE 32
+
+/**
+ * @brief Maximum number of decimals supported by the fixed-precision mode
+ */
+#define CJSON_DTOA_MAX_DECIMALS 9
+
+/**
+ * @brief Convert a double to the shortest string that parses back to the
+ * exact same double
+ *
+ * Uses plain notation for decimal exponents in [-4, 15) and scientific
+ * notation (e.g. 1.5e+20) otherwise. NaN and Infinity are written as null.
+ *
+ * @param value The number to convert
+ * @param buffer Output buffer of at least CJSON_DTOA_BUFFER_SIZE bytes
+ * @return int Length of the null terminated string written to the buffer
+ */
+int cjson_dtoa_shortest(double value, char *buffer);
+
+/**
+ * @brief Convert a float to the shortest string that parses back (strtof) to
+ * the exact same float, e.g. 23.1f is written as 23.1 instead of
+ * 23.100000381469727
+ *
+ * @param value The number to convert
+ * @param buffer Output buffer of at least CJSON_DTOA_BUFFER_SIZE bytes
+ * @return int Length of the null terminated string written to the buffer
+ */
+int cjson_ftoa_shortest(float value, char *buffer);
+
+/**
+ * @brief Convert a double to a string with a fixed number of decimals,
+ * rounded half away from zero on the shortest digits that round-trip the
+ * double, as cjson_dtoa_shortest prints them (e.g. 2 decimals: 45.678 ->
+ * 45.68, 1.005 -> 1.01, 2.675 -> 2.68)
+ *
+ * Values too large to be scaled exactly fall back to cjson_dtoa_shortest.
+ *
+ * @param value The number to convert
+ * @param decimals Number of decimals, 0 to CJSON_DTOA_MAX_DECIMALS
+ * @param buffer Output buffer of at least CJSON_DTOA_BUFFER_SIZE bytes
+ * @return int Length of the null terminated string written to the buffer
+ */
+int cjson_dtoa_fixed(double value, int decimals, char *buffer);
+
+/**
+ * @brief Convert a 32-bit integer to a decimal string
+ *
+ * @param value The number to convert
+ * @param buffer Output buffer of at least CJSON_DTOA_BUFFER_SIZE bytes
+ * @return int Length of the null terminated string written to the buffer
+ */
+int cjson_itoa(int32_t value, char *buffer);
+
+/**
+ * @brief Convert a scaled 32-bit integer to a decimal string without any
+ * floating point math (e.g. 2 decimals: 2345 -> 23.45, -5 -> -0.05)
+ *
+ * @param value The number to convert, in units of 10^-decimals
+ * @param decimals Number of decimals, 0 to CJSON_DTOA_MAX_DECIMALS
+ * @param buffer Output buffer of at least CJSON_DTOA_BUFFER_SIZE bytes
+ * @return int Length of the null terminated string written to the buffer
+ */
+int cjson_itoa_scaled(int32_t value, int decimals, char *buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // CJSON_DTOA_H
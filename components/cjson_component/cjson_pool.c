@@ -0,0 +1,163 @@
+/**
+ * @file cjson_pool.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Fixed-size slot pool for cJSON items (and other cJSON allocations
+ * that fit a slot, e.g. member names) with a heap fallback
+ * @version 0.1
+ * @date 2025-05-29
+ *
+ */
+
+#include "cjson_pool.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "cjson.h"
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+
+#define POOL_SLOTS CONFIG_CJSON_POOL_SLOTS
+// Alignment of every slot (cJSON items hold a double)
+#define POOL_ALIGNMENT 8
+#define POOL_SLOT_SIZE \
+    ((sizeof(cJSON) + (POOL_ALIGNMENT - 1)) & ~(size_t)(POOL_ALIGNMENT - 1))
+
+#if POOL_SLOTS > 0
+// A free slot holds the link to the next free slot
+typedef union pool_slot {
+    union pool_slot *next;
+    uint8_t data[POOL_SLOT_SIZE];
+} pool_slot_t;
+
+static pool_slot_t pool[POOL_SLOTS] __attribute__((aligned(POOL_ALIGNMENT)));
+static pool_slot_t *pool_free_list = NULL;
+// Slots below this index have been handed out at least once, the ones above
+// it are taken in order, so the free list needs no initialization
+static size_t pool_untouched = 0;
+#endif
+static portMUX_TYPE pool_lock = portMUX_INITIALIZER_UNLOCKED;
+static cjson_pool_stats_t pool_stats = {
+    .capacity = POOL_SLOTS,
+    .slot_size = POOL_SLOT_SIZE,
+};
+
+/**
+ * @brief Helper that checks if a pointer belongs to the pool
+ *
+ */
+static bool cjson_pool_contains(const void *pointer) {
+#if POOL_SLOTS > 0
+    return ((const uint8_t *)pointer >= (const uint8_t *)pool) &&
+           ((const uint8_t *)pointer < (const uint8_t *)&pool[POOL_SLOTS]);
+#else
+    (void)pointer;
+    return false;
+#endif
+}
+
+void *cjson_pool_malloc(size_t size) {
+    void *pointer = NULL;
+
+    if (size > POOL_SLOT_SIZE) {
+        pointer = malloc(size);
+        portENTER_CRITICAL(&pool_lock);
+        pool_stats.oversized++;
+        if (pointer != NULL) {
+            pool_stats.heap_used++;
+        }
+        portEXIT_CRITICAL(&pool_lock);
+        return pointer;
+    }
+
+    portENTER_CRITICAL(&pool_lock);
+#if POOL_SLOTS > 0
+    if (pool_free_list != NULL) {
+        pointer = pool_free_list;
+        pool_free_list = pool_free_list->next;
+    } else if (pool_untouched < POOL_SLOTS) {
+        pointer = &pool[pool_untouched++];
+    }
+#endif
+    if (pointer != NULL) {
+        pool_stats.hits++;
+        pool_stats.used++;
+        if (pool_stats.used > pool_stats.high_water_mark) {
+            pool_stats.high_water_mark = pool_stats.used;
+        }
+        if (pool_stats.used > pool_stats.cycle_high_water_mark) {
+            pool_stats.cycle_high_water_mark = pool_stats.used;
+        }
+        portEXIT_CRITICAL(&pool_lock);
+        return pointer;
+    }
+    pool_stats.misses++;
+    portEXIT_CRITICAL(&pool_lock);
+
+    pointer = malloc(size);
+    if (pointer != NULL) {
+        portENTER_CRITICAL(&pool_lock);
+        pool_stats.heap_used++;
+        portEXIT_CRITICAL(&pool_lock);
+    }
+    return pointer;
+}
+
+void cjson_pool_free(void *pointer) {
+    if (pointer == NULL) {
+        return;
+    }
+    if (!cjson_pool_contains(pointer)) {
+        free(pointer);
+        portENTER_CRITICAL(&pool_lock);
+        if (pool_stats.heap_used > 0) {
+            pool_stats.heap_used--;
+        }
+        portEXIT_CRITICAL(&pool_lock);
+        return;
+    }
+
+#if POOL_SLOTS > 0
+    pool_slot_t *slot = pointer;
+    portENTER_CRITICAL(&pool_lock);
+    slot->next = pool_free_list;
+    pool_free_list = slot;
+    pool_stats.used--;
+    portEXIT_CRITICAL(&pool_lock);
+#endif
+}
+
+esp_err_t cjson_pool_init(void) {
+    cJSON_Hooks hooks = {
+        .malloc_fn = cjson_pool_malloc,
+        .free_fn = cjson_pool_free,
+    };
+    cJSON_InitHooks(&hooks);
+
+    return ESP_OK;
+}
+
+esp_err_t cjson_pool_reset(void) {
+    esp_err_t result = ESP_OK;
+
+    portENTER_CRITICAL(&pool_lock);
+    if ((pool_stats.used != 0) || (pool_stats.heap_used != 0)) {
+        result = ESP_ERR_INVALID_STATE;
+    } else {
+#if POOL_SLOTS > 0
+        // All slots are free, the untouched range alone describes them
+        pool_free_list = NULL;
+        pool_untouched = 0;
+#endif
+        pool_stats.cycle_high_water_mark = 0;
+    }
+    portEXIT_CRITICAL(&pool_lock);
+
+    return result;
+}
+
+void cjson_pool_get_stats(cjson_pool_stats_t *stats) {
+    portENTER_CRITICAL(&pool_lock);
+    *stats = pool_stats;
+    portEXIT_CRITICAL(&pool_lock);
+}
@@ -0,0 +1,96 @@
+/**
+ * @file cjson_pool.h
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Fixed-size slot pool for cJSON items (and other cJSON allocations
+ * that fit a slot, e.g. member names) with a heap fallback
+ * @version 0.1
+ * @date 2025-05-29
+ *
+ */
+
+#ifndef CJSON_POOL_H
+#define CJSON_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Pool usage statistics
+ */
+typedef struct {
+    // Number of slots of the static backing region
+    size_t capacity;
+    // Size of a slot in bytes (sizeof(cJSON), aligned)
+    size_t slot_size;
+    // Slots currently allocated
+    size_t used;
+    // Highest number of slots ever allocated
+    size_t high_water_mark;
+    // Highest number of slots allocated since the last cjson_pool_reset()
+    size_t cycle_high_water_mark;
+    // Heap allocations (oversized or while the pool was full) not freed yet
+    size_t heap_used;
+    // Allocations served by the pool
+    uint32_t hits;
+    // Allocations that fit a slot but were served by the heap because the
+    // pool was full
+    uint32_t misses;
+    // Allocations larger than a slot, served by the heap
+    uint32_t oversized;
+} cjson_pool_stats_t;
+
+/**
+ * @brief Install the pool allocator as the global cJSON hooks
+ * (cJSON_InitHooks)
+ *
+ * @return esp_err_t
+ */
+esp_err_t cjson_pool_init(void);
+
+/**
+ * @brief Allocate from the pool if the size fits a slot, from the heap
+ * otherwise or if the pool is full
+ *
+ * Safe to call from any task.
+ *
+ * @param size Size in bytes
+ * @return void* The allocation, NULL if out of memory
+ */
+void *cjson_pool_malloc(size_t size);
+
+/**
+ * @brief Free an allocation of cjson_pool_malloc()
+ *
+ * @param pointer The allocation (slot or heap), NULL is ignored
+ */
+void cjson_pool_free(void *pointer);
+
+/**
+ * @brief End a publish/command cycle: if every allocation of the cycle was
+ * freed, the pool is returned to its initial state in O(1) (the free list is
+ * dropped, the slots are handed out in address order again) and the cycle
+ * high-water mark restarts from 0
+ *
+ * @return esp_err_t ESP_ERR_INVALID_STATE if slots or heap allocations are
+ * still in use (a leaked or still living cJSON tree), the pool is unchanged
+ */
+esp_err_t cjson_pool_reset(void);
+
+/**
+ * @brief Get the pool usage statistics
+ *
+ * @param stats Output statistics
+ */
+void cjson_pool_get_stats(cjson_pool_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // CJSON_POOL_H
@@ -0,0 +1,580 @@
+/**
+ * @file cjson_tokens.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief In-place JSON tokenizer (JSMN style): validates a JSON text and
+ * describes its values as a token array pointing into the original buffer,
+ * nothing is copied or allocated
+ * @version 0.1
+ * @date 2025-05-27
+ *
+ */
+
+#include "cjson_tokens.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Longest number text that is converted, longer numbers have more digits
+// than a double can hold anyway
+#define NUMBER_TEXT_SIZE 64
+
+/**
+ * @brief What the tokenizer expects next
+ */
+typedef enum {
+    EXPECT_VALUE,
+    // First element of an array or its end
+    EXPECT_VALUE_OR_CLOSE,
+    EXPECT_KEY,
+    // First member of an object or its end
+    EXPECT_KEY_OR_CLOSE,
+    EXPECT_COLON,
+    // ',' or the end of the enclosing object/array
+    AFTER_VALUE,
+} cjson_tokens_state_t;
+
+static bool cjson_tokens_is_whitespace(char character) {
+    return (character == ' ') || (character == '\t') || (character == '\n') ||
+           (character == '\r');
+}
+
+static bool cjson_tokens_is_digit(char character) {
+    return (character >= '0') && (character <= '9');
+}
+
+/**
+ * @brief Helper for reading the 4 hex digits of a \u escape
+ *
+ */
+static bool cjson_tokens_hex4(const char *json, size_t length,
+                              size_t position, uint32_t *value) {
+    *value = 0;
+    if ((position > length) || ((length - position) < 4)) {
+        return false;
+    }
+    for (size_t i = 0; i < 4; i++) {
+        char character = json[position + i];
+        uint32_t digit;
+        if (cjson_tokens_is_digit(character)) {
+            digit = (uint32_t)(character - '0');
+        } else if ((character >= 'a') && (character <= 'f')) {
+            digit = (uint32_t)(character - 'a' + 10);
+        } else if ((character >= 'A') && (character <= 'F')) {
+            digit = (uint32_t)(character - 'A' + 10);
+        } else {
+            return false;
+        }
+        *value = (*value << 4) | digit;
+    }
+    return true;
+}
+
+/**
+ * @brief Helper for scanning a string starting at its opening quote, the
+ * escapes are validated (including the UTF-16 surrogate pairs) but not
+ * decoded
+ *
+ */
+static bool cjson_tokens_scan_string(const char *json, size_t length,
+                                     size_t *position, cjson_token_t *token) {
+    size_t i = *position + 1;
+
+    token->type = CJSON_TOKEN_STRING;
+    token->start = (uint32_t)i;
+    token->escaped = false;
+    while (true) {
+        if (i >= length) {
+            return false;
+        }
+        unsigned char character = (unsigned char)json[i];
+        if (character == '\"') {
+            break;
+        }
+        if (character < 0x20) {
+            return false;
+        }
+        if (character != '\\') {
+            i++;
+            continue;
+        }
+
+        if ((i + 1) >= length) {
+            return false;
+        }
+        token->escaped = true;
+        // strchr would also match the terminator
+        if ((json[i + 1] != '\0') &&
+            (strchr("\"\\/bfnrt", json[i + 1]) != NULL)) {
+            i += 2;
+            continue;
+        }
+        if (json[i + 1] != 'u') {
+            return false;
+        }
+
+        uint32_t code;
+        if (!cjson_tokens_hex4(json, length, i + 2, &code) ||
+            ((code >= 0xDC00) && (code <= 0xDFFF))) {
+            return false;
+        }
+        i += 6;
+        if ((code >= 0xD800) && (code <= 0xDBFF)) {
+            // A high surrogate must be followed by a low surrogate
+            uint32_t low;
+            if (((i + 1) >= length) || (json[i] != '\\') ||
+                (json[i + 1] != 'u') ||
+                !cjson_tokens_hex4(json, length, i + 2, &low) ||
+                (low < 0xDC00) || (low > 0xDFFF)) {
+                return false;
+            }
+            i += 6;
+        }
+    }
+
+    token->end = (uint32_t)i;
+    *position = i + 1;
+    return true;
+}
+
+/**
+ * @brief Helper for scanning a number (RFC 8259 grammar, no leading zeros)
+ *
+ */
+static bool cjson_tokens_scan_number(const char *json, size_t length,
+                                     size_t *position, cjson_token_t *token) {
+    size_t i = *position;
+
+    token->type = CJSON_TOKEN_NUMBER;
+    token->start = (uint32_t)i;
+    if ((i < length) && (json[i] == '-')) {
+        i++;
+    }
+    if ((i < length) && (json[i] == '0')) {
+        i++;
+    } else if ((i < length) && cjson_tokens_is_digit(json[i])) {
+        while ((i < length) && cjson_tokens_is_digit(json[i])) {
+            i++;
+        }
+    } else {
+        return false;
+    }
+
+    if ((i < length) && (json[i] == '.')) {
+        i++;
+        if ((i >= length) || !cjson_tokens_is_digit(json[i])) {
+            return false;
+        }
+        while ((i < length) && cjson_tokens_is_digit(json[i])) {
+            i++;
+        }
+    }
+    if ((i < length) && ((json[i] == 'e') || (json[i] == 'E'))) {
+        i++;
+        if ((i < length) && ((json[i] == '+') || (json[i] == '-'))) {
+            i++;
+        }
+        if ((i >= length) || !cjson_tokens_is_digit(json[i])) {
+            return false;
+        }
+        while ((i < length) && cjson_tokens_is_digit(json[i])) {
+            i++;
+        }
+    }
+
+    token->end = (uint32_t)i;
+    *position = i;
+    return true;
+}
+
+/**
+ * @brief Helper for scanning true/false/null
+ *
+ */
+static bool cjson_tokens_scan_literal(const char *json, size_t length,
+                                      size_t *position, cjson_token_t *token) {
+    static const struct {
+        const char *text;
+        size_t length;
+        cjson_token_type_t type;
+    } literals[] = {
+        {"true", 4, CJSON_TOKEN_TRUE},
+        {"false", 5, CJSON_TOKEN_FALSE},
+        {"null", 4, CJSON_TOKEN_NULL},
+    };
+
+    for (size_t i = 0; i < sizeof(literals) / sizeof(literals[0]); i++) {
+        if (((length - *position) >= literals[i].length) &&
+            (memcmp(json + *position, literals[i].text, literals[i].length) ==
+             0)) {
+            token->type = literals[i].type;
+            token->start = (uint32_t)*position;
+            token->end = (uint32_t)(*position + literals[i].length);
+            *position += literals[i].length;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Helper for decoding the character (or escape) at 'position' of a
+ * validated string to UTF-8, returns the number of bytes
+ *
+ */
+static size_t cjson_tokens_unescape(const char *json, uint32_t *position,
+                                    char utf8[4]) {
+    uint32_t code;
+
+    if (json[*position] != '\\') {
+        utf8[0] = json[(*position)++];
+        return 1;
+    }
+
+    char escape = json[*position + 1];
+    if (escape != 'u') {
+        static const char escaped[] = "\"\\/bfnrt";
+        static const char unescaped[] = "\"\\/\b\f\n\r\t";
+        utf8[0] = unescaped[strchr(escaped, escape) - escaped];
+        *position += 2;
+        return 1;
+    }
+
+    // Validated by the tokenizer, the length check can't fail
+    cjson_tokens_hex4(json, *position + 6, *position + 2, &code);
+    *position += 6;
+    if ((code >= 0xD800) && (code <= 0xDBFF)) {
+        uint32_t low;
+        cjson_tokens_hex4(json, *position + 6, *position + 2, &low);
+        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+        *position += 6;
+    }
+
+    if (code < 0x80) {
+        utf8[0] = (char)code;
+        return 1;
+    }
+    if (code < 0x800) {
+        utf8[0] = (char)(0xC0 | (code >> 6));
+        utf8[1] = (char)(0x80 | (code & 0x3F));
+        return 2;
+    }
+    if (code < 0x10000) {
+        utf8[0] = (char)(0xE0 | (code >> 12));
+        utf8[1] = (char)(0x80 | ((code >> 6) & 0x3F));
+        utf8[2] = (char)(0x80 | (code & 0x3F));
+        return 3;
+    }
+    utf8[0] = (char)(0xF0 | (code >> 18));
+    utf8[1] = (char)(0x80 | ((code >> 12) & 0x3F));
+    utf8[2] = (char)(0x80 | ((code >> 6) & 0x3F));
+    utf8[3] = (char)(0x80 | (code & 0x3F));
+    return 4;
+}
+
+/**
+ * @brief Helper for closing the innermost object/array
+ *
+ */
+static void cjson_tokens_close(cjson_token_t *tokens, const uint16_t *stack,
+                               size_t *depth, size_t count, size_t position) {
+    cjson_token_t *container = &tokens[stack[*depth - 1]];
+    container->end = (uint32_t)(position + 1);
+    container->next = (uint16_t)count;
+    (*depth)--;
+}
+
+esp_err_t cjson_tokens_parse(cjson_tokens_t *document, const char *json,
+                             size_t length, cjson_token_t *tokens,
+                             size_t max_tokens) {
+    // Token indices of the open objects/arrays
+    uint16_t stack[CJSON_TOKENS_MAX_DEPTH];
+    size_t depth = 0;
+    size_t count = 0;
+    size_t position = 0;
+    cjson_tokens_state_t state = EXPECT_VALUE;
+
+    if ((document == NULL) || (tokens == NULL) || (max_tokens == 0) ||
+        ((json == NULL) && (length != 0)) || (length >= UINT32_MAX)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (max_tokens > UINT16_MAX) {
+        max_tokens = UINT16_MAX;
+    }
+    document->json = json;
+    document->tokens = tokens;
+    document->count = 0;
+
+    while (true) {
+        while ((position < length) &&
+               cjson_tokens_is_whitespace(json[position])) {
+            position++;
+        }
+        if ((state == AFTER_VALUE) && (depth == 0)) {
+            // Only whitespace may follow the top-level value
+            if (position != length) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            break;
+        }
+        if (position >= length) {
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        char character = json[position];
+        cjson_token_t *container =
+            (depth > 0) ? &tokens[stack[depth - 1]] : NULL;
+        bool in_object =
+            (container != NULL) && (container->type == CJSON_TOKEN_OBJECT);
+
+        if (state == EXPECT_COLON) {
+            if (character != ':') {
+                return ESP_ERR_INVALID_ARG;
+            }
+            position++;
+            state = EXPECT_VALUE;
+            continue;
+        }
+        if ((state == AFTER_VALUE) && (character == ',')) {
+            position++;
+            state = in_object ? EXPECT_KEY : EXPECT_VALUE;
+            continue;
+        }
+        if (((state == AFTER_VALUE) && in_object && (character == '}')) ||
+            ((state == AFTER_VALUE) && !in_object && (character == ']')) ||
+            ((state == EXPECT_KEY_OR_CLOSE) && (character == '}')) ||
+            ((state == EXPECT_VALUE_OR_CLOSE) && (character == ']'))) {
+            cjson_tokens_close(tokens, stack, &depth, count, position);
+            position++;
+            state = AFTER_VALUE;
+            continue;
+        }
+        if (state == AFTER_VALUE) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (state == EXPECT_KEY_OR_CLOSE) {
+            state = EXPECT_KEY;
+        } else if (state == EXPECT_VALUE_OR_CLOSE) {
+            state = EXPECT_VALUE;
+        }
+
+        // A key or a value, members are counted at their key
+        if (count >= max_tokens) {
+            return ESP_ERR_NO_MEM;
+        }
+        if ((container != NULL) && ((state == EXPECT_KEY) || !in_object)) {
+            container->size++;
+        }
+        cjson_token_t *token = &tokens[count];
+        token->size = 0;
+        token->escaped = false;
+
+        if (state == EXPECT_KEY) {
+            if ((character != '\"') ||
+                !cjson_tokens_scan_string(json, length, &position, token)) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            count++;
+            token->next = (uint16_t)count;
+            state = EXPECT_COLON;
+            continue;
+        }
+
+        bool valid = false;
+        if ((character == '{') || (character == '[')) {
+            if (depth >= CJSON_TOKENS_MAX_DEPTH) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            token->type = (character == '{') ? CJSON_TOKEN_OBJECT
+                                             : CJSON_TOKEN_ARRAY;
+            token->start = (uint32_t)position;
+            stack[depth++] = (uint16_t)count;
+            count++;
+            position++;
+            state = (character == '{') ? EXPECT_KEY_OR_CLOSE
+                                       : EXPECT_VALUE_OR_CLOSE;
+            continue;
+        } else if (character == '\"') {
+            valid = cjson_tokens_scan_string(json, length, &position, token);
+        } else if ((character == '-') || cjson_tokens_is_digit(character)) {
+            valid = cjson_tokens_scan_number(json, length, &position, token);
+        } else {
+            valid = cjson_tokens_scan_literal(json, length, &position, token);
+        }
+        if (!valid) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        count++;
+        token->next = (uint16_t)count;
+        state = AFTER_VALUE;
+    }
+
+    document->count = (uint16_t)count;
+    return ESP_OK;
+}
+
+bool cjson_tokens_is(const cjson_tokens_t *document, int token,
+                     cjson_token_type_t type) {
+    return (token >= 0) && (token < document->count) &&
+           (document->tokens[token].type == type);
+}
+
+int cjson_tokens_find(const cjson_tokens_t *document, int object,
+                      const char *key) {
+    if (!cjson_tokens_is(document, object, CJSON_TOKEN_OBJECT)) {
+        return CJSON_TOKENS_NONE;
+    }
+
+    int member = object + 1;
+    for (uint16_t i = 0; i < document->tokens[object].size; i++) {
+        if (cjson_tokens_string_equals(document, member, key)) {
+            return member + 1;
+        }
+        // Skip the key and the value with all of its children
+        member = document->tokens[member + 1].next;
+    }
+    return CJSON_TOKENS_NONE;
+}
+
+int cjson_tokens_element(const cjson_tokens_t *document, int array,
+                         size_t index) {
+    if (!cjson_tokens_is(document, array, CJSON_TOKEN_ARRAY) ||
+        (index >= document->tokens[array].size)) {
+        return CJSON_TOKENS_NONE;
+    }
+
+    int element = array + 1;
+    for (size_t i = 0; i < index; i++) {
+        element = document->tokens[element].next;
+    }
+    return element;
+}
+
+bool cjson_tokens_string_equals(const cjson_tokens_t *document, int token,
+                                const char *string) {
+    char utf8[4];
+
+    if (!cjson_tokens_is(document, token, CJSON_TOKEN_STRING)) {
+        return false;
+    }
+
+    const cjson_token_t *string_token = &document->tokens[token];
+    if (!string_token->escaped) {
+        size_t length = string_token->end - string_token->start;
+        return (strncmp(string, document->json + string_token->start,
+                        length) == 0) &&
+               (string[length] == '\0');
+    }
+
+    uint32_t position = string_token->start;
+    while (position < string_token->end) {
+        size_t size = cjson_tokens_unescape(document->json, &position, utf8);
+        for (size_t i = 0; i < size; i++) {
+            if ((*string == '\0') || (*string != utf8[i])) {
+                return false;
+            }
+            string++;
+        }
+    }
+    return *string == '\0';
+}
+
+esp_err_t cjson_tokens_get_string(const cjson_tokens_t *document, int token,
+                                  char *buffer, size_t buffer_size) {
+    char utf8[4];
+    size_t offset = 0;
+
+    if (!cjson_tokens_is(document, token, CJSON_TOKEN_STRING)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if ((buffer == NULL) || (buffer_size == 0)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    const cjson_token_t *string_token = &document->tokens[token];
+    if (!string_token->escaped) {
+        size_t length = string_token->end - string_token->start;
+        if (length >= buffer_size) {
+            buffer[0] = '\0';
+            return ESP_ERR_INVALID_SIZE;
+        }
+        memcpy(buffer, document->json + string_token->start, length);
+        buffer[length] = '\0';
+        return ESP_OK;
+    }
+
+    uint32_t position = string_token->start;
+    while (position < string_token->end) {
+        size_t size = cjson_tokens_unescape(document->json, &position, utf8);
+        // One byte is always reserved for the null terminator
+        if (size >= buffer_size - offset) {
+            buffer[offset] = '\0';
+            return ESP_ERR_INVALID_SIZE;
+        }
+        memcpy(buffer + offset, utf8, size);
+        offset += size;
+    }
+    buffer[offset] = '\0';
+    return ESP_OK;
+}
+
+esp_err_t cjson_tokens_get_number(const cjson_tokens_t *document, int token,
+                                  double *value) {
+    char text[NUMBER_TEXT_SIZE];
+
+    if (!cjson_tokens_is(document, token, CJSON_TOKEN_NUMBER)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // strtod needs a null terminated copy
+    const cjson_token_t *number = &document->tokens[token];
+    size_t length = number->end - number->start;
+    if (length >= sizeof(text)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(text, document->json + number->start, length);
+    text[length] = '\0';
+    *value = strtod(text, NULL);
+    return ESP_OK;
+}
+
+esp_err_t cjson_tokens_get_int(const cjson_tokens_t *document, int token,
+                               int32_t *value) {
+    if (!cjson_tokens_is(document, token, CJSON_TOKEN_NUMBER)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const cjson_token_t *number = &document->tokens[token];
+    const char *text = document->json + number->start;
+    size_t length = number->end - number->start;
+    bool negative = (text[0] == '-');
+    int64_t magnitude = 0;
+
+    for (size_t i = negative ? 1 : 0; i < length; i++) {
+        if (!cjson_tokens_is_digit(text[i])) {
+            // Fraction or exponent
+            return ESP_ERR_INVALID_ARG;
+        }
+        magnitude = (magnitude * 10) + (text[i] - '0');
+        if (magnitude > ((int64_t)INT32_MAX + 1)) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+    }
+    if (!negative && (magnitude > INT32_MAX)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    *value = (int32_t)(negative ? -magnitude : magnitude);
+    return ESP_OK;
+}
+
+esp_err_t cjson_tokens_get_bool(const cjson_tokens_t *document, int token,
+                                bool *value) {
+    if (cjson_tokens_is(document, token, CJSON_TOKEN_TRUE)) {
+        *value = true;
+    } else if (cjson_tokens_is(document, token, CJSON_TOKEN_FALSE)) {
+        *value = false;
+    } else {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,196 @@
+/**
+ * @file cjson_tokens.h
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief In-place JSON tokenizer (JSMN style): validates a JSON text and
+ * describes its values as a token array pointing into the original buffer,
+ * nothing is copied or allocated
+ * @version 0.1
+ * @date 2025-05-27
+ *
+ */
+
+#ifndef CJSON_TOKENS_H
+#define CJSON_TOKENS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Maximum nesting depth of objects/arrays accepted by the tokenizer
+ */
+#define CJSON_TOKENS_MAX_DEPTH 16
+
+/**
+ * @brief Token index returned when a value does not exist
+ */
+#define CJSON_TOKENS_NONE (-1)
+
+/**
+ * @brief Token types
+ */
+typedef enum {
+    CJSON_TOKEN_OBJECT,
+    CJSON_TOKEN_ARRAY,
+    CJSON_TOKEN_STRING,
+    CJSON_TOKEN_NUMBER,
+    CJSON_TOKEN_TRUE,
+    CJSON_TOKEN_FALSE,
+    CJSON_TOKEN_NULL,
+} cjson_token_type_t;
+
+/**
+ * @brief A value (or an object member key) of the JSON text
+ *
+ * The tokens are in document order. An object member is two tokens, the key
+ * (a string) followed by its value.
+ */
+typedef struct {
+    // Offsets into the JSON text, strings exclude the quotes and are still
+    // escaped
+    uint32_t start;
+    uint32_t end;
+    // Index of the token after this value and all of its children
+    uint16_t next;
+    // Number of members (objects) or elements (arrays), 0 otherwise
+    uint16_t size;
+    uint8_t type;
+    // The string contains escapes, strings without them are compared and
+    // copied directly
+    bool escaped;
+} cjson_token_t;
+
+/**
+ * @brief Tokenized JSON text
+ */
+typedef struct {
+    const char *json;
+    const cjson_token_t *tokens;
+    uint16_t count;
+} cjson_tokens_t;
+
+/**
+ * @brief Tokenize a JSON text (RFC 8259, a single value surrounded by
+ * optional whitespace)
+ *
+ * The text does not have to be null terminated and must stay valid while the
+ * tokens are used.
+ *
+ * @param document Output tokenized document
+ * @param json The JSON text
+ * @param length Length of the JSON text
+ * @param tokens Token array
+ * @param max_tokens Number of tokens in the array, at most UINT16_MAX
+ * @return esp_err_t ESP_ERR_NO_MEM if the text has more values than
+ * max_tokens, ESP_ERR_INVALID_ARG if it is not valid JSON (or nested deeper
+ * than CJSON_TOKENS_MAX_DEPTH)
+ */
+esp_err_t cjson_tokens_parse(cjson_tokens_t *document, const char *json,
+                             size_t length, cjson_token_t *tokens,
+                             size_t max_tokens);
+
+/**
+ * @brief Get the type of a token
+ *
+ * @param document Tokenized document
+ * @param token Token index
+ * @return true if the token exists and has the given type
+ */
+bool cjson_tokens_is(const cjson_tokens_t *document, int token,
+                     cjson_token_type_t type);
+
+/**
+ * @brief Find an object member by its key (case sensitive), the first member
+ * wins if the key is repeated (same as cJSON_GetObjectItem)
+ *
+ * @param document Tokenized document
+ * @param object Token index of the object
+ * @param key Null terminated key
+ * @return int Token index of the member's value, CJSON_TOKENS_NONE if the
+ * object has no such member or 'object' is not an object
+ */
+int cjson_tokens_find(const cjson_tokens_t *document, int object,
+                      const char *key);
+
+/**
+ * @brief Get an array element
+ *
+ * @param document Tokenized document
+ * @param array Token index of the array
+ * @param index Element index
+ * @return int Token index of the element, CJSON_TOKENS_NONE if there is no
+ * such element or 'array' is not an array
+ */
+int cjson_tokens_element(const cjson_tokens_t *document, int array,
+                         size_t index);
+
+/**
+ * @brief Compare a string token with a string (after unescaping)
+ *
+ * @param document Tokenized document
+ * @param token Token index of the string
+ * @param string Null terminated string
+ * @return true if the token is a string equal to 'string'
+ */
+bool cjson_tokens_string_equals(const cjson_tokens_t *document, int token,
+                                const char *string);
+
+/**
+ * @brief Copy a string token (unescaped, null terminated)
+ *
+ * @param document Tokenized document
+ * @param token Token index of the string
+ * @param buffer Output buffer
+ * @param buffer_size Size of the output buffer
+ * @return esp_err_t ESP_ERR_INVALID_ARG if the token is not a string,
+ * ESP_ERR_INVALID_SIZE if the buffer is too small
+ */
+esp_err_t cjson_tokens_get_string(const cjson_tokens_t *document, int token,
+                                  char *buffer, size_t buffer_size);
+
+/**
+ * @brief Get the value of a number token
+ *
+ * @param document Tokenized document
+ * @param token Token index of the number
+ * @param value Output value
+ * @return esp_err_t ESP_ERR_INVALID_ARG if the token is not a number
+ */
+esp_err_t cjson_tokens_get_number(const cjson_tokens_t *document, int token,
+                                  double *value);
+
+/**
+ * @brief Get the value of an integer number token
+ *
+ * @param document Tokenized document
+ * @param token Token index of the number
+ * @param value Output value
+ * @return esp_err_t ESP_ERR_INVALID_ARG if the token is not a number or
+ * has a fraction or an exponent, ESP_ERR_INVALID_SIZE if it is out of the
+ * int32_t range
+ */
+esp_err_t cjson_tokens_get_int(const cjson_tokens_t *document, int token,
+                               int32_t *value);
+
+/**
+ * @brief Get the value of a true/false token
+ *
+ * @param document Tokenized document
+ * @param token Token index of the boolean
+ * @param value Output value
+ * @return esp_err_t ESP_ERR_INVALID_ARG if the token is not a boolean
+ */
+esp_err_t cjson_tokens_get_bool(const cjson_tokens_t *document, int token,
+                                bool *value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // CJSON_TOKENS_H
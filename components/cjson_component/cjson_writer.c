@@ -0,0 +1,350 @@
+/**
+ * @file cjson_writer.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Streaming JSON writer that prints directly into a caller-supplied
+ * buffer without building a cJSON tree (no heap allocations)
+ * @version 0.1
+ * @date 2025-05-12
+ *
+ */
+
+#include "cjson_writer.h"
+
+#include <limits.h>
+#include <string.h>
+
+#include "cjson_dtoa.h"
+
+#define LEVEL_BIT(depth) (1UL << (depth))
+
+/**
+ * @brief Helper for setting the sticky error (only the first one is kept)
+ *
+ */
+static void cjson_writer_fail(cjson_writer_t *writer, esp_err_t error) {
+    if (writer->error == ESP_OK) {
+        writer->error = error;
+    }
+}
+
+/**
+ * @brief Helper for appending raw characters, always keeps the buffer null
+ * terminated
+ *
+ */
+static void cjson_writer_append(cjson_writer_t *writer, const char *data,
+                                size_t length) {
+    if (writer->error != ESP_OK) {
+        return;
+    }
+    // One byte is always reserved for the null terminator
+    if (length >= writer->length - writer->offset) {
+        cjson_writer_fail(writer, ESP_ERR_NO_MEM);
+        return;
+    }
+    memcpy(writer->buffer + writer->offset, data, length);
+    writer->offset += length;
+    writer->buffer[writer->offset] = '\0';
+}
+
+static void cjson_writer_append_char(cjson_writer_t *writer, char character) {
+    cjson_writer_append(writer, &character, 1);
+}
+
+/**
+ * @brief Helper that writes the ',' separator and checks that a value is
+ * allowed at the current position
+ *
+ */
+static bool cjson_writer_prepare_value(cjson_writer_t *writer) {
+    if (writer->error != ESP_OK) {
+        return false;
+    }
+
+    if (writer->depth == 0) {
+        // Only a single top-level value is allowed
+        if (writer->offset != 0) {
+            cjson_writer_fail(writer, ESP_ERR_INVALID_STATE);
+            return false;
+        }
+        return true;
+    }
+
+    if (writer->object_mask & LEVEL_BIT(writer->depth)) {
+        // Object members need a key first, the separator was written with it
+        if (!writer->key_pending) {
+            cjson_writer_fail(writer, ESP_ERR_INVALID_STATE);
+            return false;
+        }
+        writer->key_pending = false;
+        return true;
+    }
+
+    if (writer->element_mask & LEVEL_BIT(writer->depth)) {
+        cjson_writer_append_char(writer, ',');
+    }
+    writer->element_mask |= LEVEL_BIT(writer->depth);
+
+    return writer->error == ESP_OK;
+}
+
+/**
+ * @brief Helper for writing an escaped, quoted string
+ *
+ */
+static void cjson_writer_append_string(cjson_writer_t *writer,
+                                       const char *string) {
+    static const char hex_digits[] = "0123456789abcdef";
+    const unsigned char *input = (const unsigned char *)string;
+    const unsigned char *run_start = NULL;
+    char escape[6] = {'\\', 'u', '0', '0', 0, 0};
+
+    cjson_writer_append_char(writer, '\"');
+    if (input == NULL) {
+        cjson_writer_append_char(writer, '\"');
+        return;
+    }
+
+    // Copy runs of characters that need no escaping in one go
+    run_start = input;
+    for (; *input != '\0'; input++) {
+        if ((*input > 31) && (*input != '\"') && (*input != '\\')) {
+            continue;
+        }
+        cjson_writer_append(writer, (const char *)run_start,
+                            (size_t)(input - run_start));
+        run_start = input + 1;
+
+        switch (*input) {
+            case '\\':
+                cjson_writer_append(writer, "\\\\", 2);
+                break;
+            case '\"':
+                cjson_writer_append(writer, "\\\"", 2);
+                break;
+            case '\b':
+                cjson_writer_append(writer, "\\b", 2);
+                break;
+            case '\f':
+                cjson_writer_append(writer, "\\f", 2);
+                break;
+            case '\n':
+                cjson_writer_append(writer, "\\n", 2);
+                break;
+            case '\r':
+                cjson_writer_append(writer, "\\r", 2);
+                break;
+            case '\t':
+                cjson_writer_append(writer, "\\t", 2);
+                break;
+            default:
+                // Escape and print as unicode codepoint
+                escape[4] = hex_digits[*input >> 4];
+                escape[5] = hex_digits[*input & 0x0F];
+                cjson_writer_append(writer, escape, sizeof(escape));
+                break;
+        }
+    }
+    cjson_writer_append(writer, (const char *)run_start,
+                        (size_t)(input - run_start));
+    cjson_writer_append_char(writer, '\"');
+}
+
+/**
+ * @brief Helper for opening an object/array
+ *
+ */
+static void cjson_writer_container_begin(cjson_writer_t *writer,
+                                         bool is_object) {
+    if (!cjson_writer_prepare_value(writer)) {
+        return;
+    }
+    if (writer->depth + 1 >= CJSON_WRITER_MAX_DEPTH) {
+        cjson_writer_fail(writer, ESP_ERR_INVALID_STATE);
+        return;
+    }
+
+    cjson_writer_append_char(writer, is_object ? '{' : '[');
+
+    writer->depth++;
+    writer->element_mask &= ~LEVEL_BIT(writer->depth);
+    if (is_object) {
+        writer->object_mask |= LEVEL_BIT(writer->depth);
+    } else {
+        writer->object_mask &= ~LEVEL_BIT(writer->depth);
+    }
+}
+
+/**
+ * @brief Helper for closing an object/array
+ *
+ */
+static void cjson_writer_container_end(cjson_writer_t *writer,
+                                       bool is_object) {
+    if (writer->error != ESP_OK) {
+        return;
+    }
+    if ((writer->depth == 0) || writer->key_pending ||
+        (((writer->object_mask & LEVEL_BIT(writer->depth)) != 0) !=
+         is_object)) {
+        cjson_writer_fail(writer, ESP_ERR_INVALID_STATE);
+        return;
+    }
+
+    cjson_writer_append_char(writer, is_object ? '}' : ']');
+    writer->depth--;
+}
+
+void cjson_writer_init(cjson_writer_t *writer, char *buffer,
+                       size_t buffer_length) {
+    memset(writer, 0, sizeof(*writer));
+    writer->buffer = buffer;
+    writer->length = buffer_length;
+    writer->error = ESP_OK;
+
+    if ((buffer == NULL) || (buffer_length == 0)) {
+        writer->error = ESP_ERR_INVALID_ARG;
+        return;
+    }
+    buffer[0] = '\0';
+}
+
+void cjson_writer_object_begin(cjson_writer_t *writer) {
+    cjson_writer_container_begin(writer, true);
+}
+
+void cjson_writer_object_end(cjson_writer_t *writer) {
+    cjson_writer_container_end(writer, true);
+}
+
+void cjson_writer_array_begin(cjson_writer_t *writer) {
+    cjson_writer_container_begin(writer, false);
+}
+
+void cjson_writer_array_end(cjson_writer_t *writer) {
+    cjson_writer_container_end(writer, false);
+}
+
+void cjson_writer_key(cjson_writer_t *writer, const char *key) {
+    if (writer->error != ESP_OK) {
+        return;
+    }
+    if ((writer->depth == 0) ||
+        !(writer->object_mask & LEVEL_BIT(writer->depth)) ||
+        writer->key_pending || (key == NULL)) {
+        cjson_writer_fail(writer, ESP_ERR_INVALID_STATE);
+        return;
+    }
+
+    if (writer->element_mask & LEVEL_BIT(writer->depth)) {
+        cjson_writer_append_char(writer, ',');
+    }
+    writer->element_mask |= LEVEL_BIT(writer->depth);
+
+    cjson_writer_append_string(writer, key);
+    cjson_writer_append_char(writer, ':');
+    writer->key_pending = true;
+}
+
+void cjson_writer_number(cjson_writer_t *writer, double number) {
+    char number_buffer[CJSON_DTOA_BUFFER_SIZE];
+    int length = 0;
+
+    if (!cjson_writer_prepare_value(writer)) {
+        return;
+    }
+
+    // Same rules as cJSON's print_number, so the output is interchangeable
+    if ((number >= INT_MIN) && (number <= INT_MAX) &&
+        (number == (double)(int)number)) {
+        length = cjson_itoa((int32_t)number, number_buffer);
+    } else {
+        length = cjson_dtoa_shortest(number, number_buffer);
+    }
+    cjson_writer_append(writer, number_buffer, (size_t)length);
+}
+
+void cjson_writer_number_fixed(cjson_writer_t *writer, double number,
+                               int decimals) {
+    char number_buffer[CJSON_DTOA_BUFFER_SIZE];
+    int length = 0;
+
+    if (!cjson_writer_prepare_value(writer)) {
+        return;
+    }
+    if ((decimals < 0) || (decimals > CJSON_DTOA_MAX_DECIMALS)) {
+        cjson_writer_fail(writer, ESP_ERR_INVALID_ARG);
+        return;
+    }
+
+    length = cjson_dtoa_fixed(number, decimals, number_buffer);
+    cjson_writer_append(writer, number_buffer, (size_t)length);
+}
+
+void cjson_writer_number_scaled(cjson_writer_t *writer, int32_t value,
+                                int decimals) {
+    char number_buffer[CJSON_DTOA_BUFFER_SIZE];
+    int length = 0;
+
+    if (!cjson_writer_prepare_value(writer)) {
+        return;
+    }
+    if ((decimals < 0) || (decimals > CJSON_DTOA_MAX_DECIMALS)) {
+        cjson_writer_fail(writer, ESP_ERR_INVALID_ARG);
+        return;
+    }
+
+    length = cjson_itoa_scaled(value, decimals, number_buffer);
+    cjson_writer_append(writer, number_buffer, (size_t)length);
+}
+
+void cjson_writer_float(cjson_writer_t *writer, float number) {
+    char number_buffer[CJSON_DTOA_BUFFER_SIZE];
+    int length = 0;
+
+    if (!cjson_writer_prepare_value(writer)) {
+        return;
+    }
+
+    length = cjson_ftoa_shortest(number, number_buffer);
+    cjson_writer_append(writer, number_buffer, (size_t)length);
+}
+
+void cjson_writer_string(cjson_writer_t *writer, const char *string) {
+    if (!cjson_writer_prepare_value(writer)) {
+        return;
+    }
+    cjson_writer_append_string(writer, string);
+}
+
+void cjson_writer_bool(cjson_writer_t *writer, bool boolean) {
+    if (!cjson_writer_prepare_value(writer)) {
+        return;
+    }
+    if (boolean) {
+        cjson_writer_append(writer, "true", 4);
+    } else {
+        cjson_writer_append(writer, "false", 5);
+    }
+}
+
+void cjson_writer_null(cjson_writer_t *writer) {
+    if (!cjson_writer_prepare_value(writer)) {
+        return;
+    }
+    cjson_writer_append(writer, "null", 4);
+}
+
+esp_err_t cjson_writer_finish(cjson_writer_t *writer) {
+    if (writer->error != ESP_OK) {
+        return writer->error;
+    }
+    if ((writer->depth != 0) || writer->key_pending || (writer->offset == 0)) {
+        cjson_writer_fail(writer, ESP_ERR_INVALID_STATE);
+    }
+    return writer->error;
+}
+
+size_t cjson_writer_length(const cjson_writer_t *writer) {
+    return writer->offset;
+}
@@ -0,0 +1,181 @@
+/**
+ * @file cjson_writer.h
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Streaming JSON writer that prints directly into a caller-supplied
+ * buffer without building a cJSON tree (no heap allocations)
+ * @version 0.1
+ * @date 2025-05-12
+ *
+ */
+
+#ifndef CJSON_WRITER_H
+#define CJSON_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Maximum nesting depth of objects/arrays supported by the writer
+ */
+#define CJSON_WRITER_MAX_DEPTH 16
+
+/**
+ * @brief Streaming JSON writer state
+ *
+ * Errors are sticky: after the first failure (buffer overflow, unbalanced
+ * container, value without a key, ...) all further calls are ignored and the
+ * error is reported by cjson_writer_finish().
+ */
+typedef struct {
+    char *buffer;
+    size_t length;
+    size_t offset;
+    uint8_t depth;
+    // Bit per nesting level: 1 if the level is an object, 0 if an array
+    uint32_t object_mask;
+    // Bit per nesting level: 1 if the level already holds an element
+    uint32_t element_mask;
+    // A key was written and the matching value is pending
+    bool key_pending;
+    esp_err_t error;
+} cjson_writer_t;
+
+/**
+ * @brief Initialize the writer over a pre-allocated buffer
+ *
+ * @param writer Writer state
+ * @param buffer Buffer for holding the generated JSON string
+ * @param buffer_length Size of the buffer (including the null terminator)
+ */
+void cjson_writer_init(cjson_writer_t *writer, char *buffer,
+                       size_t buffer_length);
+
+/**
+ * @brief Open a JSON object ('{')
+ *
+ * @param writer Writer state
+ */
+void cjson_writer_object_begin(cjson_writer_t *writer);
+
+/**
+ * @brief Close the current JSON object ('}')
+ *
+ * @param writer Writer state
+ */
+void cjson_writer_object_end(cjson_writer_t *writer);
+
+/**
+ * @brief Open a JSON array ('[')
+ *
+ * @param writer Writer state
+ */
+void cjson_writer_array_begin(cjson_writer_t *writer);
+
+/**
+ * @brief Close the current JSON array (']')
+ *
+ * @param writer Writer state
+ */
+void cjson_writer_array_end(cjson_writer_t *writer);
+
+/**
+ * @brief Write an object member key, must be followed by exactly one value
+ *
+ * @param writer Writer state
+ * @param key Null terminated key string (escaped as needed)
+ */
+void cjson_writer_key(cjson_writer_t *writer, const char *key);
+
+/**
+ * @brief Write a number value with the shortest text that parses back to the
+ * same double, formatted the same way as cJSON_Print
+ *
+ * @param writer Writer state
+ * @param number The number to write (NaN and Infinity are written as null)
+ */
+void cjson_writer_number(cjson_writer_t *writer, double number);
+
+/**
+ * @brief Write a number value with a fixed number of decimals (e.g. 2
+ * decimals: 45.678 -> 45.68)
+ *
+ * @param writer Writer state
+ * @param number The number to write
+ * @param decimals Number of decimals, 0 to CJSON_DTOA_MAX_DECIMALS
+ */
+void cjson_writer_number_fixed(cjson_writer_t *writer, double number,
+                               int decimals);
+
+/**
+ * @brief Write a scaled integer as a number with a fixed number of decimals
+ * without any floating point math (e.g. 2 decimals: 2345 -> 23.45)
+ *
+ * @param writer Writer state
+ * @param value The number to write, in units of 10^-decimals
+ * @param decimals Number of decimals, 0 to CJSON_DTOA_MAX_DECIMALS
+ */
+void cjson_writer_number_scaled(cjson_writer_t *writer, int32_t value,
+                                int decimals);
+
+/**
+ * @brief Write a float value with the shortest text that parses back to the
+ * same float (e.g. 23.1f is written as 23.1)
+ *
+ * @param writer Writer state
+ * @param number The number to write (NaN and Infinity are written as null)
+ */
+void cjson_writer_float(cjson_writer_t *writer, float number);
+
+/**
+ * @brief Write a string value
+ *
+ * @param writer Writer state
+ * @param string Null terminated string (escaped as needed), NULL writes ""
+ */
+void cjson_writer_string(cjson_writer_t *writer, const char *string);
+
+/**
+ * @brief Write a boolean value
+ *
+ * @param writer Writer state
+ * @param boolean The value to write
+ */
+void cjson_writer_bool(cjson_writer_t *writer, bool boolean);
+
+/**
+ * @brief Write a null value
+ *
+ * @param writer Writer state
+ */
+void cjson_writer_null(cjson_writer_t *writer);
+
+/**
+ * @brief Finish writing and check the result
+ *
+ * @param writer Writer state
+ * @return esp_err_t ESP_OK if a complete, balanced document was written,
+ * ESP_ERR_NO_MEM if the buffer was too small, ESP_ERR_INVALID_STATE if the
+ * calls were not properly nested
+ */
+esp_err_t cjson_writer_finish(cjson_writer_t *writer);
+
+/**
+ * @brief Number of characters written so far (without the null terminator)
+ *
+ * @param writer Writer state
+ * @return size_t
+ */
+size_t cjson_writer_length(const cjson_writer_t *writer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // CJSON_WRITER_H
@@ -0,0 +1,533 @@
+/**
+ * @file cbor_roundtrip.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Checks the CBOR writer on a host: RFC 8949 encoding examples, a
+ * decoder round trip of the sensor data document against the JSON writer and
+ * a size/encode time comparison of the two encodings (not part of the
+ * firmware build)
+ * @version 0.1
+ * @date 2025-05-26
+ *
+ * Build (the writers only need esp_err.h from ESP-IDF):
+ *   gcc -O2 -I$IDF_PATH/components/esp_common/include
+ *       -Icomponents/cjson_component
+ *       components/cjson_component/host/cbor_roundtrip.c
+ *       components/cjson_component/cjson_cbor.c
+ *       components/cjson_component/cjson_writer.c
+ *       components/cjson_component/cjson_dtoa.c -lm -o cbor_roundtrip
+ *
+ * Usage:
+ *   cbor_roundtrip [ITERATIONS]
+ *
+ * Exits with 1 if any check fails.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cjson_cbor.h"
+#include "cjson_writer.h"
+
+// Same as CHIPCAP2_JSON_DECIMALS in cjson_component.c
+#define SENSOR_DECIMALS 2
+// ChipCap2 ranges in hundredths
+#define HUMIDITY_CENTI_MAX 10000
+#define TEMPERATURE_CENTI_MIN -4000
+#define TEMPERATURE_CENTI_MAX 12500
+#define DECODE_MAX_DEPTH 16
+
+static unsigned int failures = 0;
+
+/**
+ * @brief Reader state of the decoder
+ */
+typedef struct {
+    const uint8_t* data;
+    size_t length;
+    size_t offset;
+} cbor_reader_t;
+
+/**
+ * @brief Helper for reading an initial byte and its argument, indefinite
+ * lengths and reserved values are rejected
+ *
+ */
+static bool cbor_read_head(cbor_reader_t* reader, uint8_t* major,
+                           uint8_t* info, uint64_t* argument) {
+    if (reader->offset >= reader->length) {
+        return false;
+    }
+    uint8_t initial = reader->data[reader->offset++];
+    size_t size = 0;
+
+    *major = initial >> 5;
+    *info = initial & 0x1F;
+    if (*info < 24) {
+        *argument = *info;
+        return true;
+    }
+    if (*info > 27) {
+        return false;
+    }
+    size = (size_t)1 << (*info - 24);
+    if (size > reader->length - reader->offset) {
+        return false;
+    }
+    *argument = 0;
+    for (size_t i = 0; i < size; i++) {
+        *argument = (*argument << 8) | reader->data[reader->offset++];
+    }
+    return true;
+}
+
+/**
+ * @brief Helper for converting a half precision float
+ *
+ */
+static double cbor_half_to_double(uint16_t half) {
+    int exponent = (half >> 10) & 0x1F;
+    int mantissa = half & 0x3FF;
+    double value;
+
+    if (exponent == 0) {
+        value = ldexp(mantissa, -24);
+    } else if (exponent == 31) {
+        value = (mantissa == 0) ? INFINITY : NAN;
+    } else {
+        value = ldexp(mantissa + 1024, exponent - 25);
+    }
+    return (half & 0x8000) ? -value : value;
+}
+
+/**
+ * @brief Decode one data item into JSON, floats are written with 'decimals'
+ * decimals (or the shortest text if negative) so the output can be compared
+ * with the JSON document byte for byte
+ *
+ */
+static bool cbor_decode_item(cbor_reader_t* reader, cjson_writer_t* writer,
+                             int decimals, int depth, bool is_key) {
+    uint8_t major;
+    uint8_t info;
+    uint64_t argument;
+    char text[128];
+
+    if ((depth > DECODE_MAX_DEPTH) ||
+        !cbor_read_head(reader, &major, &info, &argument)) {
+        return false;
+    }
+    // JSON object keys must be strings
+    if (is_key && (major != 3)) {
+        return false;
+    }
+
+    switch (major) {
+        case 0:
+            cjson_writer_number(writer, (double)argument);
+            return true;
+        case 1:
+            cjson_writer_number(writer, -1.0 - (double)argument);
+            return true;
+        case 3:
+            if ((argument >= sizeof(text)) ||
+                (argument > reader->length - reader->offset)) {
+                return false;
+            }
+            memcpy(text, reader->data + reader->offset, (size_t)argument);
+            text[argument] = '\0';
+            reader->offset += (size_t)argument;
+            if (is_key) {
+                cjson_writer_key(writer, text);
+            } else {
+                cjson_writer_string(writer, text);
+            }
+            return true;
+        case 4:
+            cjson_writer_array_begin(writer);
+            for (uint64_t i = 0; i < argument; i++) {
+                if (!cbor_decode_item(reader, writer, decimals, depth + 1,
+                                      false)) {
+                    return false;
+                }
+            }
+            cjson_writer_array_end(writer);
+            return true;
+        case 5:
+            cjson_writer_object_begin(writer);
+            for (uint64_t i = 0; i < argument; i++) {
+                if (!cbor_decode_item(reader, writer, decimals, depth + 1,
+                                      true) ||
+                    !cbor_decode_item(reader, writer, decimals, depth + 1,
+                                      false)) {
+                    return false;
+                }
+            }
+            cjson_writer_object_end(writer);
+            return true;
+        case 7:
+            break;
+        default:
+            // Byte strings and tags have no JSON counterpart here
+            return false;
+    }
+
+    double value;
+    switch (info) {
+        case 20:
+            cjson_writer_bool(writer, false);
+            return true;
+        case 21:
+            cjson_writer_bool(writer, true);
+            return true;
+        case 22:
+            cjson_writer_null(writer);
+            return true;
+        case 25:
+            value = cbor_half_to_double((uint16_t)argument);
+            break;
+        case 26: {
+            uint32_t bits = (uint32_t)argument;
+            float single;
+            memcpy(&single, &bits, sizeof(single));
+            value = single;
+            break;
+        }
+        case 27:
+            memcpy(&value, &argument, sizeof(value));
+            break;
+        default:
+            return false;
+    }
+    if (decimals >= 0) {
+        cjson_writer_number_fixed(writer, value, decimals);
+    } else if (info == 27) {
+        cjson_writer_number(writer, value);
+    } else {
+        cjson_writer_float(writer, (float)value);
+    }
+    return true;
+}
+
+/**
+ * @brief Decode a complete CBOR document into a JSON string
+ *
+ */
+static bool cbor_decode(const uint8_t* data, size_t length, int decimals,
+                        char* json, size_t json_size) {
+    cbor_reader_t reader = {.data = data, .length = length, .offset = 0};
+    cjson_writer_t writer;
+
+    cjson_writer_init(&writer, json, json_size);
+    if (!cbor_decode_item(&reader, &writer, decimals, 0, false)) {
+        return false;
+    }
+    // Trailing bytes are an error
+    return (reader.offset == length) &&
+           (cjson_writer_finish(&writer) == ESP_OK);
+}
+
+/**
+ * @brief The JSON document of cjson_format_chipcap2_data_prebuffered (fixed
+ * point build)
+ *
+ */
+static size_t format_json(int16_t humidity_centi, int16_t temperature_centi,
+                          char* buffer, size_t buffer_size) {
+    cjson_writer_t writer;
+
+    cjson_writer_init(&writer, buffer, buffer_size);
+    cjson_writer_object_begin(&writer);
+    cjson_writer_key(&writer, "sensor-data");
+    cjson_writer_array_begin(&writer);
+    cjson_writer_object_begin(&writer);
+    cjson_writer_key(&writer, "humidity");
+    cjson_writer_number_scaled(&writer, humidity_centi, SENSOR_DECIMALS);
+    cjson_writer_key(&writer, "unit");
+    cjson_writer_string(&writer, "%% (RH)");
+    cjson_writer_object_end(&writer);
+    cjson_writer_object_begin(&writer);
+    cjson_writer_key(&writer, "temperature");
+    cjson_writer_number_scaled(&writer, temperature_centi, SENSOR_DECIMALS);
+    cjson_writer_key(&writer, "unit");
+    cjson_writer_string(&writer, "°C");
+    cjson_writer_object_end(&writer);
+    cjson_writer_array_end(&writer);
+    cjson_writer_object_end(&writer);
+
+    return (cjson_writer_finish(&writer) == ESP_OK)
+               ? cjson_writer_length(&writer)
+               : 0;
+}
+
+/**
+ * @brief The CBOR document of cjson_format_chipcap2_data_cbor_prebuffered
+ * (fixed point build)
+ *
+ */
+static size_t format_cbor(int16_t humidity_centi, int16_t temperature_centi,
+                          uint8_t* buffer, size_t buffer_size) {
+    cjson_cbor_writer_t writer;
+
+    cjson_cbor_init(&writer, buffer, buffer_size);
+    cjson_cbor_map_begin(&writer, 1);
+    cjson_cbor_string(&writer, "sensor-data");
+    cjson_cbor_array_begin(&writer, 2);
+    cjson_cbor_map_begin(&writer, 2);
+    cjson_cbor_string(&writer, "humidity");
+    cjson_cbor_number_scaled(&writer, humidity_centi, SENSOR_DECIMALS);
+    cjson_cbor_string(&writer, "unit");
+    cjson_cbor_string(&writer, "%% (RH)");
+    cjson_cbor_map_end(&writer);
+    cjson_cbor_map_begin(&writer, 2);
+    cjson_cbor_string(&writer, "temperature");
+    cjson_cbor_number_scaled(&writer, temperature_centi, SENSOR_DECIMALS);
+    cjson_cbor_string(&writer, "unit");
+    cjson_cbor_string(&writer, "°C");
+    cjson_cbor_map_end(&writer);
+    cjson_cbor_array_end(&writer);
+    cjson_cbor_map_end(&writer);
+
+    return (cjson_cbor_finish(&writer) == ESP_OK) ? cjson_cbor_length(&writer)
+                                                  : 0;
+}
+
+/**
+ * @brief Helper for comparing an encoding with its expected hex string
+ *
+ */
+static void expect_hex(const char* name, const cjson_cbor_writer_t* writer,
+                       const char* hex) {
+    char actual[64] = {0};
+
+    for (size_t i = 0; (i < writer->offset) && (i < 31); i++) {
+        sprintf(&actual[2 * i], "%02x", writer->buffer[i]);
+    }
+    if ((writer->error != ESP_OK) || (strcmp(actual, hex) != 0)) {
+        printf("FAIL %s: got %s (error 0x%x), expected %s\n", name, actual,
+               writer->error, hex);
+        failures++;
+    }
+}
+
+#define EXPECT_ITEM(call, hex)                            \
+    do {                                                  \
+        uint8_t buffer[32];                               \
+        cjson_cbor_writer_t writer;                       \
+        cjson_cbor_init(&writer, buffer, sizeof(buffer)); \
+        call;                                             \
+        cjson_cbor_finish(&writer);                       \
+        expect_hex(#call, &writer, hex);                  \
+    } while (0)
+
+/**
+ * @brief Encoding examples of RFC 8949 Appendix A and the error handling
+ *
+ */
+static void check_encoding(void) {
+    EXPECT_ITEM(cjson_cbor_int(&writer, 0), "00");
+    EXPECT_ITEM(cjson_cbor_int(&writer, 23), "17");
+    EXPECT_ITEM(cjson_cbor_int(&writer, 24), "1818");
+    EXPECT_ITEM(cjson_cbor_int(&writer, 100), "1864");
+    EXPECT_ITEM(cjson_cbor_int(&writer, 1000), "1903e8");
+    EXPECT_ITEM(cjson_cbor_int(&writer, 1000000), "1a000f4240");
+    EXPECT_ITEM(cjson_cbor_int(&writer, 1000000000000), "1b000000e8d4a51000");
+    EXPECT_ITEM(cjson_cbor_int(&writer, -1), "20");
+    EXPECT_ITEM(cjson_cbor_int(&writer, -1000), "3903e7");
+    EXPECT_ITEM(cjson_cbor_float(&writer, 0.0f), "f90000");
+    EXPECT_ITEM(cjson_cbor_float(&writer, -0.0f), "f98000");
+    EXPECT_ITEM(cjson_cbor_float(&writer, 1.5f), "f93e00");
+    EXPECT_ITEM(cjson_cbor_float(&writer, 65504.0f), "f97bff");
+    EXPECT_ITEM(cjson_cbor_float(&writer, 100000.0f), "fa47c35000");
+    EXPECT_ITEM(cjson_cbor_float(&writer, 3.4028234663852886e+38f),
+                "fa7f7fffff");
+    EXPECT_ITEM(cjson_cbor_float(&writer, 5.960464477539063e-8f), "f90001");
+    EXPECT_ITEM(cjson_cbor_float(&writer, 0.00006103515625f), "f90400");
+    EXPECT_ITEM(cjson_cbor_float(&writer, -4.0f), "f9c400");
+    EXPECT_ITEM(cjson_cbor_float(&writer, INFINITY), "f97c00");
+    EXPECT_ITEM(cjson_cbor_float(&writer, NAN), "f97e00");
+    EXPECT_ITEM(cjson_cbor_number_scaled(&writer, 2250, 2), "f94da0");
+    EXPECT_ITEM(cjson_cbor_number_scaled(&writer, 123456789, 2),
+                "fb4132d687e3d70a3d");
+    EXPECT_ITEM(cjson_cbor_bool(&writer, false), "f4");
+    EXPECT_ITEM(cjson_cbor_bool(&writer, true), "f5");
+    EXPECT_ITEM(cjson_cbor_null(&writer), "f6");
+    EXPECT_ITEM(cjson_cbor_string(&writer, ""), "60");
+    EXPECT_ITEM(cjson_cbor_string(&writer, "IETF"), "6449455446");
+    EXPECT_ITEM(cjson_cbor_string(&writer, "\xc3\xbc"), "62c3bc");
+    EXPECT_ITEM(
+        {
+            cjson_cbor_array_begin(&writer, 3);
+            cjson_cbor_int(&writer, 1);
+            cjson_cbor_int(&writer, 2);
+            cjson_cbor_int(&writer, 3);
+            cjson_cbor_array_end(&writer);
+        },
+        "83010203");
+    EXPECT_ITEM(
+        {
+            cjson_cbor_map_begin(&writer, 1);
+            cjson_cbor_string(&writer, "a");
+            cjson_cbor_array_begin(&writer, 0);
+            cjson_cbor_array_end(&writer);
+            cjson_cbor_map_end(&writer);
+        },
+        "a1616180");
+
+    // Errors are sticky and reported by finish
+    uint8_t buffer[4];
+    cjson_cbor_writer_t writer;
+    cjson_cbor_init(&writer, buffer, sizeof(buffer));
+    cjson_cbor_string(&writer, "IETF");
+    if (cjson_cbor_finish(&writer) != ESP_ERR_NO_MEM) {
+        printf("FAIL overflow not reported\n");
+        failures++;
+    }
+    cjson_cbor_init(&writer, buffer, sizeof(buffer));
+    cjson_cbor_array_begin(&writer, 2);
+    cjson_cbor_int(&writer, 1);
+    cjson_cbor_array_end(&writer);
+    if (cjson_cbor_finish(&writer) != ESP_ERR_INVALID_STATE) {
+        printf("FAIL missing array element not reported\n");
+        failures++;
+    }
+    cjson_cbor_init(&writer, buffer, sizeof(buffer));
+    cjson_cbor_int(&writer, 1);
+    cjson_cbor_int(&writer, 2);
+    if (cjson_cbor_finish(&writer) != ESP_ERR_INVALID_STATE) {
+        printf("FAIL second top-level item not reported\n");
+        failures++;
+    }
+}
+
+/**
+ * @brief Helper for the samples of the round trip and the timing, covers the
+ * full humidity and temperature ranges
+ *
+ */
+static void sample_at(int index, int16_t* humidity_centi,
+                      int16_t* temperature_centi) {
+    *humidity_centi = (int16_t)(index % (HUMIDITY_CENTI_MAX + 1));
+    *temperature_centi = (int16_t)(TEMPERATURE_CENTI_MIN + index);
+}
+
+/**
+ * @brief Round trip of every sample: the decoded CBOR document must be the
+ * JSON document
+ *
+ */
+static void check_round_trip(int sample_count) {
+    char json[160];
+    char decoded[160];
+    uint8_t cbor[96];
+
+    for (int i = 0; i < sample_count; i++) {
+        int16_t humidity_centi;
+        int16_t temperature_centi;
+        sample_at(i, &humidity_centi, &temperature_centi);
+
+        size_t json_length =
+            format_json(humidity_centi, temperature_centi, json, sizeof(json));
+        size_t cbor_length = format_cbor(humidity_centi, temperature_centi,
+                                         cbor, sizeof(cbor));
+        if ((json_length == 0) || (cbor_length == 0) ||
+            !cbor_decode(cbor, cbor_length, SENSOR_DECIMALS, decoded,
+                         sizeof(decoded)) ||
+            (strcmp(json, decoded) != 0)) {
+            printf("FAIL round trip %d/%d:\n  json %s\n  cbor %s\n",
+                   humidity_centi, temperature_centi, json, decoded);
+            if (++failures > 10) {
+                return;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Helper for the current time in nanoseconds
+ *
+ */
+static double now_ns(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec * 1e9 + (double)time.tv_nsec;
+}
+
+/**
+ * @brief Size and encode time of both encodings over all samples
+ *
+ */
+static void compare(int sample_count, int iterations) {
+    char json[160];
+    uint8_t cbor[96];
+    size_t json_min = SIZE_MAX, json_max = 0, json_total = 0;
+    size_t cbor_min = SIZE_MAX, cbor_max = 0, cbor_total = 0;
+    double json_ns = 0;
+    double cbor_ns = 0;
+
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        double start = now_ns();
+        for (int i = 0; i < sample_count; i++) {
+            int16_t humidity_centi;
+            int16_t temperature_centi;
+            sample_at(i, &humidity_centi, &temperature_centi);
+            size_t length = format_json(humidity_centi, temperature_centi,
+                                        json, sizeof(json));
+            if (iteration == 0) {
+                json_min = (length < json_min) ? length : json_min;
+                json_max = (length > json_max) ? length : json_max;
+                json_total += length;
+            }
+        }
+        double middle = now_ns();
+        for (int i = 0; i < sample_count; i++) {
+            int16_t humidity_centi;
+            int16_t temperature_centi;
+            sample_at(i, &humidity_centi, &temperature_centi);
+            size_t length = format_cbor(humidity_centi, temperature_centi,
+                                        cbor, sizeof(cbor));
+            if (iteration == 0) {
+                cbor_min = (length < cbor_min) ? length : cbor_min;
+                cbor_max = (length > cbor_max) ? length : cbor_max;
+                cbor_total += length;
+            }
+        }
+        double end = now_ns();
+        json_ns += middle - start;
+        cbor_ns += end - middle;
+    }
+
+    double documents = (double)sample_count * iterations;
+    printf("%d documents x %d iterations\n", sample_count, iterations);
+    printf("  encoding  bytes min   avg    max   encode ns/doc\n");
+    printf("  json      %5zu  %6.1f  %5zu   %8.1f\n", json_min,
+           (double)json_total / sample_count, json_max, json_ns / documents);
+    printf("  cbor      %5zu  %6.1f  %5zu   %8.1f\n", cbor_min,
+           (double)cbor_total / sample_count, cbor_max, cbor_ns / documents);
+    printf("  cbor/json %5.2f  %6.2f  %5.2f   %8.2f\n",
+           (double)cbor_min / json_min, (double)cbor_total / json_total,
+           (double)cbor_max / json_max, cbor_ns / json_ns);
+}
+
+int main(int argc, char** argv) {
+    int iterations = (argc > 1) ? atoi(argv[1]) : 20;
+    int sample_count = TEMPERATURE_CENTI_MAX - TEMPERATURE_CENTI_MIN + 1;
+
+    if (iterations <= 0) {
+        fprintf(stderr, "usage: %s [ITERATIONS]\n", argv[0]);
+        return 2;
+    }
+
+    check_encoding();
+    check_round_trip(sample_count);
+    compare(sample_count, iterations);
+
+    if (failures != 0) {
+        printf("%u checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
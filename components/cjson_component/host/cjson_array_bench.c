@@ -0,0 +1,187 @@
+/**
+ * @file cjson_array_bench.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Compares iterating cJSON arrays by index with and without the
+ * element index on a host (not part of the firmware build)
+ * @version 0.1
+ * @date 2025-05-29
+ *
+ * Build:
+ *   gcc -O2 -Icomponents/cjson_component
+ *       components/cjson_component/host/cjson_array_bench.c
+ *       components/cjson_component/cjson.c
+ *       components/cjson_component/cjson_dtoa.c -lm -o cjson_array_bench
+ *
+ * Usage:
+ *   cjson_array_bench [ROUNDS]
+ *
+ * Every round iterates a parsed array of sensor-batch style samples the way
+ * batch consumers do: for (i = 0; i < cJSON_GetArraySize(a); i++)
+ * cJSON_GetArrayItem(a, i). cJSON_ArrayForEach (which walks the list and is
+ * unaffected by the index) is the baseline.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cjson.h"
+
+// Same as the CJSON_INDEX_THRESHOLD default in menuconfig
+#define BENCH_INDEX_THRESHOLD 8
+
+static const int sizes[] = {16, 128, 1000};
+
+// Keeps the compiler from dropping the benchmarked calls
+static volatile double sink = 0;
+static size_t allocated_bytes = 0;
+
+static void *counting_malloc(size_t size) {
+    allocated_bytes += size;
+    return malloc(size);
+}
+
+/**
+ * @brief Helper for the current time in nanoseconds
+ *
+ */
+static double now_ns(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec * 1e9 + (double)time.tv_nsec;
+}
+
+/**
+ * @brief Helper that builds the JSON text of an array of 'elements'
+ * [humidity, temperature] samples
+ *
+ */
+static char *make_array(int elements) {
+    char *json = malloc((size_t)elements * 24 + 2);
+    size_t length = 0;
+
+    json[length++] = '[';
+    for (int i = 0; i < elements; i++) {
+        length += (size_t)sprintf(&json[length], "%s[%d.%02d,%d.%d]",
+                                  (i > 0) ? "," : "", 40 + (i % 20), i % 100,
+                                  20 + (i % 5), i % 10);
+    }
+    json[length++] = ']';
+    json[length] = '\0';
+    return json;
+}
+
+/**
+ * @brief Iterate by index, returns the sum of the humidity values
+ *
+ */
+static double run_indexed_loop(const cJSON *array) {
+    double sum = 0;
+    for (int i = 0; i < cJSON_GetArraySize(array); i++) {
+        sum += cJSON_GetArrayItem(cJSON_GetArrayItem(array, i), 0)->valuedouble;
+    }
+    return sum;
+}
+
+/**
+ * @brief Iterate the list, returns the sum of the humidity values
+ *
+ */
+static double run_for_each(const cJSON *array) {
+    const cJSON *sample = NULL;
+    double sum = 0;
+    cJSON_ArrayForEach(sample, array) {
+        sum += sample->child->valuedouble;
+    }
+    return sum;
+}
+
+int main(int argc, char **argv) {
+    cJSON_Hooks hooks = {.malloc_fn = counting_malloc, .free_fn = free};
+    long total = (argc > 1) ? atol(argv[1]) : 2000000;
+
+    if (total <= 0) {
+        fprintf(stderr, "usage: %s [ROUNDS]\n", argv[0]);
+        return 2;
+    }
+    cJSON_InitHooks(&hooks);
+
+    printf("%ld elements visited per size, index threshold %d\n", total,
+           BENCH_INDEX_THRESHOLD);
+    printf("  elements  linear ns  indexed ns  for-each ns  speedup  "
+           "index bytes  append ns\n");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        int elements = sizes[i];
+        // At least one round, also for fewer visits than elements
+        long rounds = (total / elements > 0) ? total / elements : 1;
+        char *json = make_array(elements);
+
+        cJSON *linear = cJSON_Parse(json);
+        cJSON *indexed = cJSON_Parse(json);
+        if ((linear == NULL) || (indexed == NULL)) {
+            printf("FAIL %d elements: parse\n", elements);
+            return 1;
+        }
+
+        // The first cJSON_GetArraySize builds the index
+        cJSON_SetIndexThreshold(BENCH_INDEX_THRESHOLD);
+        allocated_bytes = 0;
+        double expected = run_indexed_loop(indexed);
+        size_t index_bytes = allocated_bytes;
+        cJSON_SetIndexThreshold(0);
+        if ((run_indexed_loop(linear) != expected) ||
+            (run_for_each(indexed) != expected)) {
+            printf("FAIL %d elements: sums differ\n", elements);
+            return 1;
+        }
+
+        // The quadratic loop is only timed for a fraction of the rounds
+        long linear_rounds = (rounds / elements > 0) ? rounds / elements : 1;
+        double start = now_ns();
+        for (long j = 0; j < linear_rounds; j++) {
+            sink += run_indexed_loop(linear);
+        }
+        double linear_ns = (now_ns() - start) / linear_rounds / elements;
+
+        start = now_ns();
+        for (long j = 0; j < rounds; j++) {
+            sink += run_indexed_loop(indexed);
+        }
+        double indexed_ns = (now_ns() - start) / rounds / elements;
+
+        start = now_ns();
+        for (long j = 0; j < rounds; j++) {
+            sink += run_for_each(indexed);
+        }
+        double for_each_ns = (now_ns() - start) / rounds / elements;
+
+        // Appending to an indexed array keeps the index
+        cJSON_SetIndexThreshold(BENCH_INDEX_THRESHOLD);
+        cJSON *built = cJSON_CreateArray();
+        start = now_ns();
+        for (int j = 0; j < elements; j++) {
+            cJSON_AddItemToArray(built, cJSON_CreateNumber(j));
+            sink += cJSON_GetArraySize(built);
+        }
+        double append_ns = (now_ns() - start) / elements;
+        if ((cJSON_GetArraySize(built) != elements) ||
+            (cJSON_GetArrayItem(built, elements - 1)->valueint !=
+             elements - 1)) {
+            printf("FAIL %d elements: append\n", elements);
+            return 1;
+        }
+        cJSON_SetIndexThreshold(0);
+
+        printf("  %8d %10.1f %11.1f %12.1f %7.1fx %12zu %10.1f\n", elements,
+               linear_ns, indexed_ns, for_each_ns, linear_ns / indexed_ns,
+               index_bytes, append_ns);
+
+        cJSON_Delete(built);
+        cJSON_Delete(linear);
+        cJSON_Delete(indexed);
+        free(json);
+    }
+
+    return 0;
+}
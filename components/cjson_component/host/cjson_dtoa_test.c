@@ -0,0 +1,322 @@
+/**
+ * @file cjson_dtoa_test.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Checks the number-to-text kernel on a host: a corpus of expected
+ * strings, bit-exact round trips of random doubles and a float sweep, and a
+ * time comparison with the sprintf/sscanf path cJSON used before (not part of
+ * the firmware build)
+ * @version 0.1
+ * @date 2025-05-30
+ *
+ * Build:
+ *   gcc -O2 -Icomponents/cjson_component
+ *       components/cjson_component/host/cjson_dtoa_test.c
+ *       components/cjson_component/cjson_dtoa.c -lm -o cjson_dtoa_test
+ *
+ * Usage:
+ *   cjson_dtoa_test [DOUBLES [FLOAT_STRIDE]]
+ *
+ * DOUBLES random bit patterns (default 1000000) are converted and parsed
+ * back with strtod, every FLOAT_STRIDE-th float bit pattern (default 97, 1
+ * for all of them) with strtof. Exits with 1 if any check fails.
+ */
+
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cjson_dtoa.h"
+
+#define BENCH_VALUES 1000
+#define BENCH_ROUNDS 1000
+
+static unsigned int failures = 0;
+
+/**
+ * @brief Expected output of a conversion
+ */
+typedef struct {
+    double value;
+    int decimals;  // -1: cjson_dtoa_shortest
+    const char *expected;
+} dtoa_case_t;
+
+static const dtoa_case_t corpus[] = {
+    {0.0, -1, "0"},
+    {0.1, -1, "0.1"},
+    {0.3, -1, "0.3"},
+    {1.0 / 3, -1, "0.3333333333333333"},
+    {1e-5, -1, "1e-05"},
+    {1e-4, -1, "0.0001"},
+    {0.000123, -1, "0.000123"},
+    {123456789012345.0, -1, "123456789012345"},
+    {1e15, -1, "1e+15"},
+    {1e21, -1, "1e+21"},
+    {5e-324, -1, "5e-324"},
+    {1.7976931348623157e308, -1, "1.7976931348623157e+308"},
+    {2.2250738585072014e-308, -1, "2.2250738585072014e-308"},
+    {-42.125, -1, "-42.125"},
+    {23.100000381469727, -1, "23.100000381469727"},
+    {45.678, 2, "45.68"},
+    // Halves of the shortest digits round up although the doubles are
+    // slightly below them (1.005 is 1.00499999999999989...)
+    {1.005, 2, "1.01"},
+    {2.675, 2, "2.68"},
+    {0.015, 2, "0.02"},
+    {-1.005, 2, "-1.01"},
+    {1.0049999999999997, 2, "1.00"},
+    {0.125, 2, "0.13"},
+    {-0.004, 2, "0.00"},
+    {-0.005, 2, "-0.01"},
+    {0.005, 2, "0.01"},
+    {2.5, 2, "2.50"},
+    {119.98474, 2, "119.98"},
+    {-40, 2, "-40.00"},
+    {7.5, 0, "8"},
+    {0.5, 9, "0.500000000"},
+    {1e20, 2, "1e+20"},
+};
+
+/**
+ * @brief Helper for a random 64-bit value (xorshift64)
+ *
+ */
+static uint64_t random_next(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/**
+ * @brief Helper for the current time in nanoseconds
+ *
+ */
+static double now_ns(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec * 1e9 + (double)time.tv_nsec;
+}
+
+/**
+ * @brief Helper for the number of significant digits of a converted number
+ *
+ */
+static int significant_digits(const char *text) {
+    int digits = 0;
+    bool leading = true;
+    for (; (*text != '\0') && (*text != 'e'); text++) {
+        if ((*text < '0') || (*text > '9') || (leading && (*text == '0'))) {
+            continue;
+        }
+        leading = false;
+        digits++;
+    }
+    return digits;
+}
+
+/**
+ * @brief Helper for the fewest significant digits printf needs to round
+ * trip a double
+ *
+ */
+static int shortest_printf_digits(double value) {
+    char text[40];
+    for (int precision = 1; precision < 17; precision++) {
+        snprintf(text, sizeof(text), "%.*g", precision, value);
+        if (strtod(text, NULL) == value) {
+            return significant_digits(text);
+        }
+    }
+    return 17;
+}
+
+static void check_corpus(void) {
+    char buffer[CJSON_DTOA_BUFFER_SIZE];
+    for (size_t i = 0; i < sizeof(corpus) / sizeof(corpus[0]); i++) {
+        const dtoa_case_t *test = &corpus[i];
+        int length = (test->decimals < 0)
+                         ? cjson_dtoa_shortest(test->value, buffer)
+                         : cjson_dtoa_fixed(test->value, test->decimals,
+                                            buffer);
+        if ((strcmp(buffer, test->expected) != 0) ||
+            (length != (int)strlen(test->expected))) {
+            printf("FAIL %.17g (%d decimals): %s, expected %s\n", test->value,
+                   test->decimals, buffer, test->expected);
+            failures++;
+        }
+    }
+
+    float floats[] = {23.1f, 45.5f, 99.97f, 0.1f, 1e-10f, 3.4e38f};
+    const char *float_expected[] = {"23.1",  "45.5",  "99.97",
+                                    "0.1",   "1e-10", "3.4e+38"};
+    for (size_t i = 0; i < sizeof(floats) / sizeof(floats[0]); i++) {
+        cjson_ftoa_shortest(floats[i], buffer);
+        if (strcmp(buffer, float_expected[i]) != 0) {
+            printf("FAIL float %.9g: %s, expected %s\n", floats[i], buffer,
+                   float_expected[i]);
+            failures++;
+        }
+    }
+
+    cjson_dtoa_shortest(NAN, buffer);
+    if (strcmp(buffer, "null") != 0) {
+        printf("FAIL NaN: %s\n", buffer);
+        failures++;
+    }
+}
+
+static void check_integers(void) {
+    char buffer[CJSON_DTOA_BUFFER_SIZE];
+    char expected[CJSON_DTOA_BUFFER_SIZE];
+    int32_t values[] = {0, 1, -1, 9, 10, -10, 1234, INT32_MAX, INT32_MIN};
+
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        cjson_itoa(values[i], buffer);
+        snprintf(expected, sizeof(expected), "%ld", (long)values[i]);
+        if (strcmp(buffer, expected) != 0) {
+            printf("FAIL itoa %s: %s\n", expected, buffer);
+            failures++;
+        }
+    }
+
+    // Scaled integers and fixed decimals must agree over the sensor ranges
+    for (int32_t centi = -100000; centi <= 100000; centi++) {
+        cjson_itoa_scaled(centi, 2, buffer);
+        cjson_dtoa_fixed(centi / 100.0, 2, expected);
+        if (strcmp(buffer, expected) != 0) {
+            printf("FAIL scaled %ld: %s, fixed %s\n", (long)centi, buffer,
+                   expected);
+            failures++;
+            break;
+        }
+    }
+}
+
+static void check_doubles(long count) {
+    char buffer[CJSON_DTOA_BUFFER_SIZE];
+    uint64_t state = 88172645463325252ULL;
+    long converted = 0;
+    long longer = 0;
+    long bad = 0;
+
+    for (long i = 0; i < count; i++) {
+        uint64_t bits = random_next(&state);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        if (!isfinite(value)) {
+            continue;
+        }
+        converted++;
+        cjson_dtoa_shortest(value, buffer);
+        double parsed = strtod(buffer, NULL);
+        if (memcmp(&parsed, &value, sizeof(value)) != 0) {
+            if (bad++ < 5) {
+                printf("FAIL %.17g: %s\n", value, buffer);
+            }
+        } else if (significant_digits(buffer) >
+                   shortest_printf_digits(value)) {
+            // Grisu2 is not always shortest (about 0.1% of the doubles get
+            // one more digit), which still round-trips
+            longer++;
+        }
+    }
+    failures += (unsigned int)bad;
+    printf("doubles: %ld converted, %ld not round-tripped, %ld longer than "
+           "necessary\n",
+           converted, bad, longer);
+}
+
+static void check_floats(uint64_t stride) {
+    char buffer[CJSON_DTOA_BUFFER_SIZE];
+    long converted = 0;
+    long bad = 0;
+
+    for (uint64_t bits = 0; bits <= UINT32_MAX; bits += stride) {
+        uint32_t pattern = (uint32_t)bits;
+        float value;
+        memcpy(&value, &pattern, sizeof(value));
+        if (!isfinite(value)) {
+            continue;
+        }
+        converted++;
+        cjson_ftoa_shortest(value, buffer);
+        float parsed = strtof(buffer, NULL);
+        if (memcmp(&parsed, &value, sizeof(value)) != 0) {
+            if (bad++ < 5) {
+                printf("FAIL float %.9g: %s\n", value, buffer);
+            }
+        }
+    }
+    failures += (unsigned int)bad;
+    printf("floats: %ld converted, %ld not round-tripped\n", converted, bad);
+}
+
+/**
+ * @brief The number printing of cJSON before the kernel: %1.15g, parsed
+ * back with sscanf, %1.17g if that did not round-trip
+ *
+ */
+static int print_number_printf(double value, char *buffer) {
+    double test = 0.0;
+    int length = sprintf(buffer, "%1.15g", value);
+    if ((sscanf(buffer, "%lg", &test) != 1) || (test != value)) {
+        length = sprintf(buffer, "%1.17g", value);
+    }
+    return length;
+}
+
+static void benchmark(void) {
+    static double values[BENCH_VALUES];
+    char buffer[CJSON_DTOA_BUFFER_SIZE];
+    uint64_t state = 2463534242ULL;
+    volatile int sink = 0;
+
+    // Sensor-like values: -40.000 to 59.999
+    for (int i = 0; i < BENCH_VALUES; i++) {
+        values[i] = (double)(random_next(&state) % 100000) / 1000.0 - 40.0;
+    }
+
+    double start = now_ns();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (int i = 0; i < BENCH_VALUES; i++) {
+            sink += cjson_dtoa_shortest(values[i], buffer);
+        }
+    }
+    double middle = now_ns();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (int i = 0; i < BENCH_VALUES; i++) {
+            sink += print_number_printf(values[i], buffer);
+        }
+    }
+    double end = now_ns();
+
+    double count = (double)BENCH_VALUES * BENCH_ROUNDS;
+    double kernel_ns = (middle - start) / count;
+    double printf_ns = (end - middle) / count;
+    printf("time per number: kernel %.1f ns, sprintf/sscanf %.1f ns (%.1fx)\n",
+           kernel_ns, printf_ns, printf_ns / kernel_ns);
+}
+
+int main(int argc, char **argv) {
+    long doubles = (argc > 1) ? atol(argv[1]) : 1000000;
+    long stride = (argc > 2) ? atol(argv[2]) : 97;
+
+    if ((doubles < 0) || (stride <= 0)) {
+        fprintf(stderr, "usage: %s [DOUBLES [FLOAT_STRIDE]]\n", argv[0]);
+        return 2;
+    }
+
+    check_corpus();
+    check_integers();
+    check_doubles(doubles);
+    check_floats((uint64_t)stride);
+    benchmark();
+
+    printf("%s: %u failures\n", (failures == 0) ? "OK" : "FAIL", failures);
+    return (failures == 0) ? 0 : 1;
+}
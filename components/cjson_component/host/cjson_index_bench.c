@@ -0,0 +1,205 @@
+/**
+ * @file cjson_index_bench.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Compares cJSON object member lookups with and without the member
+ * index for objects of 4 to 256 members on a host (not part of the firmware
+ * build)
+ * @version 0.1
+ * @date 2025-05-28
+ *
+ * Build:
+ *   gcc -O2 -Icomponents/cjson_component
+ *       components/cjson_component/host/cjson_index_bench.c
+ *       components/cjson_component/cjson.c
+ *       components/cjson_component/cjson_dtoa.c -lm -o cjson_index_bench
+ *
+ * Usage:
+ *   cjson_index_bench [LOOKUPS]
+ *
+ * Every round looks up all members of the object once (case sensitive, then
+ * case insensitive with an upper case name) and one missing member, the
+ * results are checked against the linear lookup first.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cjson.h"
+
+// Same as the CJSON_INDEX_THRESHOLD default in menuconfig
+#define BENCH_INDEX_THRESHOLD 8
+#define BENCH_MAX_MEMBERS 256
+#define BENCH_NAME_SIZE 32
+
+typedef char bench_name_t[BENCH_NAME_SIZE];
+
+static const int sizes[] = {4, 8, 16, 32, 64, 128, 256};
+
+// Keeps the compiler from dropping the benchmarked calls
+static volatile size_t sink = 0;
+static size_t allocated_bytes = 0;
+
+static void *counting_malloc(size_t size) {
+    allocated_bytes += size;
+    return malloc(size);
+}
+
+/**
+ * @brief Helper for the current time in nanoseconds
+ *
+ */
+static double now_ns(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec * 1e9 + (double)time.tv_nsec;
+}
+
+/**
+ * @brief Helper that builds the member names (config style, sharing a
+ * prefix) and the JSON text of an object with 'members' members, the last
+ * member repeats the first name in upper case
+ *
+ */
+static char *make_object(int members, bench_name_t *names,
+                         bench_name_t *upper) {
+    char *json = malloc((size_t)members * 48 + 2);
+    size_t length = 0;
+
+    json[length++] = '{';
+    for (int i = 0; i < members; i++) {
+        snprintf(names[i], BENCH_NAME_SIZE, "sensor_setting_%d", i);
+        for (size_t j = 0; j < BENCH_NAME_SIZE; j++) {
+            upper[i][j] = (char)toupper((unsigned char)names[i][j]);
+        }
+        length += (size_t)sprintf(&json[length], "%s\"%s\": %d",
+                                  (i > 0) ? ", " : "",
+                                  (i == members - 1) ? upper[0] : names[i], i);
+    }
+    json[length++] = '}';
+    json[length] = '\0';
+    return json;
+}
+
+/**
+ * @brief Look up every member once, returns a checksum of the results
+ *
+ */
+static size_t run_lookups(const cJSON *object, int members,
+                          bench_name_t *names, bench_name_t *upper) {
+    size_t found = 0;
+    for (int i = 0; i < members; i++) {
+        found += (size_t)cJSON_GetObjectItemCaseSensitive(object, names[i]);
+        found += (size_t)cJSON_GetObjectItem(object, upper[i]);
+    }
+    found += (size_t)cJSON_GetObjectItem(object, "missing");
+    return found;
+}
+
+/**
+ * @brief Check that the indexed lookups return the same members as the
+ * linear ones
+ *
+ */
+static int check(const cJSON *linear, const cJSON *indexed, int members,
+                 bench_name_t *names, bench_name_t *upper) {
+    for (int i = 0; i < members; i++) {
+        const cJSON *expected[2] = {
+            cJSON_GetObjectItemCaseSensitive(linear, names[i]),
+            cJSON_GetObjectItem(linear, upper[i]),
+        };
+        const cJSON *actual[2] = {
+            cJSON_GetObjectItemCaseSensitive(indexed, names[i]),
+            cJSON_GetObjectItem(indexed, upper[i]),
+        };
+        for (int j = 0; j < 2; j++) {
+            if ((expected[j] == NULL) != (actual[j] == NULL) ||
+                ((expected[j] != NULL) &&
+                 (expected[j]->valueint != actual[j]->valueint))) {
+                printf("FAIL %d members: lookup of %s differs\n", members,
+                       (j == 0) ? names[i] : upper[i]);
+                return 1;
+            }
+        }
+    }
+    if ((cJSON_GetObjectItem(indexed, "missing") != NULL) ||
+        (cJSON_GetObjectItemCaseSensitive(indexed, upper[0]) == NULL)) {
+        printf("FAIL %d members: missing/repeated member\n", members);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    static bench_name_t names[BENCH_MAX_MEMBERS];
+    static bench_name_t upper[BENCH_MAX_MEMBERS];
+    cJSON_Hooks hooks = {.malloc_fn = counting_malloc, .free_fn = free};
+    long lookups = (argc > 1) ? atol(argv[1]) : 4000000;
+
+    if (lookups <= 0) {
+        fprintf(stderr, "usage: %s [LOOKUPS]\n", argv[0]);
+        return 2;
+    }
+    cJSON_InitHooks(&hooks);
+
+    printf("%ld lookups per size, index threshold %d\n", lookups,
+           BENCH_INDEX_THRESHOLD);
+    printf("  members  linear ns  indexed ns  speedup  index build ns  "
+           "index bytes\n");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        int members = sizes[i];
+        char *json = make_object(members, names, upper);
+
+        cJSON *linear = cJSON_Parse(json);
+        cJSON *indexed = cJSON_Parse(json);
+        if ((linear == NULL) || (indexed == NULL)) {
+            printf("FAIL %d members: parse\n", members);
+            return 1;
+        }
+
+        // The first lookup that walks past the threshold builds the index,
+        // without a threshold the existing index is kept and no other
+        // object gets one
+        cJSON_SetIndexThreshold(BENCH_INDEX_THRESHOLD);
+        allocated_bytes = 0;
+        double start = now_ns();
+        sink += (size_t)cJSON_GetObjectItem(indexed, "missing");
+        double build_ns = now_ns() - start;
+        size_t index_bytes = allocated_bytes;
+        cJSON_SetIndexThreshold(0);
+
+        if (check(linear, indexed, members, names, upper) != 0) {
+            return 1;
+        }
+
+        // Lookups per round: every member twice and one missing member, at
+        // least one round even for few lookups
+        long rounds = lookups / (2 * members + 1);
+        if (rounds < 1) {
+            rounds = 1;
+        }
+        start = now_ns();
+        for (long j = 0; j < rounds; j++) {
+            sink += run_lookups(linear, members, names, upper);
+        }
+        double middle = now_ns();
+        for (long j = 0; j < rounds; j++) {
+            sink += run_lookups(indexed, members, names, upper);
+        }
+        double end = now_ns();
+
+        double count = (double)rounds * (2 * members + 1);
+        double linear_ns = (middle - start) / count;
+        double indexed_ns = (end - middle) / count;
+        printf("  %7d %10.1f %11.1f %7.2fx %15.0f %12zu\n", members, linear_ns,
+               indexed_ns, linear_ns / indexed_ns, build_ns, index_bytes);
+
+        cJSON_Delete(linear);
+        cJSON_Delete(indexed);
+        free(json);
+    }
+
+    return 0;
+}
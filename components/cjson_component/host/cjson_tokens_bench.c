@@ -0,0 +1,207 @@
+/**
+ * @file cjson_tokens_bench.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Compares the in-place tokenizer with cJSON_ParseWithLength on MQTT
+ * command payloads on a host (not part of the firmware build)
+ * @version 0.1
+ * @date 2025-05-27
+ *
+ * Build:
+ *   gcc -O2 -I$IDF_PATH/components/esp_common/include
+ *       -Icomponents/cjson_component
+ *       components/cjson_component/host/cjson_tokens_bench.c
+ *       components/cjson_component/cjson_tokens.c
+ *       components/cjson_component/cjson.c
+ *       components/cjson_component/cjson_dtoa.c -lm -o cjson_tokens_bench
+ *
+ * Usage:
+ *   cjson_tokens_bench [ITERATIONS]
+ *
+ * Every iteration does what mqtt_commands_dispatch and a command handler
+ * do: parse the payload, look up "command" and "args" and read the
+ * arguments.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cjson.h"
+#include "cjson_tokens.h"
+
+// Same as MQTT_COMMANDS_MAX_TOKENS
+#define BENCH_MAX_TOKENS 32
+
+/**
+ * @brief A benchmarked payload and the argument members read from it
+ */
+typedef struct {
+    const char *name;
+    const char *json;
+    const char *arguments[8];
+} bench_payload_t;
+
+static const bench_payload_t payloads[] = {
+    {
+        .name = "plain",
+        .json = "{\"command\": \"read-and-publish\"}",
+    },
+    {
+        .name = "set-sampling",
+        .json = "{\"command\": \"set-sampling\", \"args\": {\"min_ms\": 2000, "
+                "\"max_ms\": 600000, \"humidity\": 0.5, \"temperature\": "
+                "0.2}}",
+        .arguments = {"min_ms", "max_ms", "humidity", "temperature"},
+    },
+    {
+        .name = "config",
+        .json = "{\"command\": \"configure\", \"args\": {\"name\": "
+                "\"greenhouse-3\", \"topic\": \"sensors/greenhouse/3\", "
+                "\"min_ms\": 2000, \"max_ms\": 600000, \"humidity\": 0.5, "
+                "\"temperature\": 0.2, \"batch\": true, \"heartbeat_s\": "
+                "900, \"alarms\": [{\"humidity\": 80}, {\"temperature\": "
+                "35.5}], \"note\": \"installed \\u00e0 l'est\"}}",
+        .arguments = {"name", "min_ms", "max_ms", "humidity", "temperature",
+                      "batch", "heartbeat_s", "note"},
+    },
+};
+
+// Keeps the compiler from dropping the benchmarked calls
+static volatile int sink = 0;
+static size_t allocations = 0;
+static size_t allocated_bytes = 0;
+
+static void *counting_malloc(size_t size) {
+    allocations++;
+    allocated_bytes += size;
+    return malloc(size);
+}
+
+/**
+ * @brief Helper for the current time in nanoseconds
+ *
+ */
+static double now_ns(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec * 1e9 + (double)time.tv_nsec;
+}
+
+/**
+ * @brief Parse and read a payload with the tokenizer, returns the number of
+ * arguments found
+ *
+ */
+static int run_tokens(const bench_payload_t *payload, size_t length,
+                      uint16_t *token_count) {
+    cjson_token_t tokens[BENCH_MAX_TOKENS];
+    cjson_tokens_t document;
+    char text[64];
+    double number;
+    bool boolean;
+    int found = 0;
+
+    if (cjson_tokens_parse(&document, payload->json, length, tokens,
+                           BENCH_MAX_TOKENS) != ESP_OK) {
+        return -1;
+    }
+    *token_count = document.count;
+    if (!cjson_tokens_is(&document, cjson_tokens_find(&document, 0, "command"),
+                         CJSON_TOKEN_STRING)) {
+        return -1;
+    }
+    int args = cjson_tokens_find(&document, 0, "args");
+    for (size_t i = 0; (i < 8) && (payload->arguments[i] != NULL); i++) {
+        int value = cjson_tokens_find(&document, args, payload->arguments[i]);
+        if ((cjson_tokens_get_number(&document, value, &number) == ESP_OK) ||
+            (cjson_tokens_get_bool(&document, value, &boolean) == ESP_OK) ||
+            (cjson_tokens_get_string(&document, value, text, sizeof(text)) ==
+             ESP_OK)) {
+            found++;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Parse and read a payload with cJSON, returns the number of
+ * arguments found
+ *
+ */
+static int run_cjson(const bench_payload_t *payload, size_t length) {
+    int found = 0;
+
+    cJSON *json = cJSON_ParseWithLength(payload->json, length);
+    if (json == NULL) {
+        return -1;
+    }
+    if (!cJSON_IsString(cJSON_GetObjectItemCaseSensitive(json, "command"))) {
+        cJSON_Delete(json);
+        return -1;
+    }
+    const cJSON *args = cJSON_GetObjectItemCaseSensitive(json, "args");
+    for (size_t i = 0; (i < 8) && (payload->arguments[i] != NULL); i++) {
+        const cJSON *value =
+            cJSON_GetObjectItemCaseSensitive(args, payload->arguments[i]);
+        if (cJSON_IsNumber(value) || cJSON_IsBool(value) ||
+            cJSON_IsString(value)) {
+            found++;
+        }
+    }
+    cJSON_Delete(json);
+    return found;
+}
+
+int main(int argc, char **argv) {
+    cJSON_Hooks hooks = {.malloc_fn = counting_malloc, .free_fn = free};
+    long iterations = (argc > 1) ? atol(argv[1]) : 200000;
+
+    if (iterations <= 0) {
+        fprintf(stderr, "usage: %s [ITERATIONS]\n", argv[0]);
+        return 2;
+    }
+    cJSON_InitHooks(&hooks);
+
+    printf("%ld iterations\n", iterations);
+    printf("  payload        bytes tokens   tokens ns   cJSON ns  speedup  "
+           "cJSON allocs/bytes\n");
+    for (size_t i = 0; i < sizeof(payloads) / sizeof(payloads[0]); i++) {
+        const bench_payload_t *payload = &payloads[i];
+        size_t length = strlen(payload->json);
+        uint16_t token_count = 0;
+
+        // Both must read the same arguments
+        int tokens_found = run_tokens(payload, length, &token_count);
+        allocations = 0;
+        allocated_bytes = 0;
+        int cjson_found = run_cjson(payload, length);
+        size_t parse_allocations = allocations;
+        size_t parse_bytes = allocated_bytes;
+        if ((tokens_found < 0) || (tokens_found != cjson_found)) {
+            printf("FAIL %s: tokens found %d, cJSON found %d\n", payload->name,
+                   tokens_found, cjson_found);
+            return 1;
+        }
+
+        double start = now_ns();
+        for (long j = 0; j < iterations; j++) {
+            sink += run_tokens(payload, length, &token_count);
+        }
+        double middle = now_ns();
+        for (long j = 0; j < iterations; j++) {
+            sink += run_cjson(payload, length);
+        }
+        double end = now_ns();
+
+        double tokens_ns = (middle - start) / iterations;
+        double cjson_ns = (end - middle) / iterations;
+        printf("  %-13s %6zu %6u %11.1f %10.1f %7.2fx %8zu/%zu\n",
+               payload->name, length, token_count, tokens_ns, cjson_ns,
+               cjson_ns / tokens_ns, parse_allocations, parse_bytes);
+    }
+    printf("tokens: no allocations, %zu bytes of tokens on the stack\n",
+           sizeof(cjson_token_t) * BENCH_MAX_TOKENS);
+
+    return 0;
+}
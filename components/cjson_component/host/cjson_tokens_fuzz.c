@@ -0,0 +1,328 @@
+/**
+ * @file cjson_tokens_fuzz.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Fuzz target of the in-place JSON tokenizer, checks the token
+ * invariants and compares every accepted document with the cJSON parser
+ * (not part of the firmware build)
+ * @version 0.1
+ * @date 2025-05-27
+ *
+ * libFuzzer build:
+ *   clang -g -O1 -fsanitize=fuzzer,address,undefined
+ *       -I$IDF_PATH/components/esp_common/include
+ *       -Icomponents/cjson_component
+ *       components/cjson_component/host/cjson_tokens_fuzz.c
+ *       components/cjson_component/cjson_tokens.c
+ *       components/cjson_component/cjson.c
+ *       components/cjson_component/cjson_dtoa.c -lm -o cjson_tokens_fuzz
+ *
+ * Without libFuzzer add -DCJSON_TOKENS_FUZZ_STANDALONE (and replace
+ * -fsanitize=fuzzer with e.g. -fsanitize=address,undefined), the program
+ * then runs the files given as arguments or, without arguments, random
+ * mutations of a built-in corpus:
+ *   cjson_tokens_fuzz [--iterations N] [file...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cjson.h"
+#include "cjson_tokens.h"
+
+#define FUZZ_MAX_TOKENS 256
+
+/**
+ * @brief Abort with a message, the fuzzer keeps the input that caused it
+ *
+ */
+static void fuzz_fail(const char *message, int token) {
+    fprintf(stderr, "cjson_tokens_fuzz: %s (token %d)\n", message, token);
+    abort();
+}
+
+/**
+ * @brief Check that every container's children end exactly at its 'next'
+ *
+ */
+static void check_invariants(const cjson_tokens_t *document, size_t length) {
+    for (int i = 0; i < document->count; i++) {
+        const cjson_token_t *token = &document->tokens[i];
+        if ((token->start > token->end) || (token->end > length)) {
+            fuzz_fail("token outside of the text", i);
+        }
+        if ((token->next <= i) || (token->next > document->count)) {
+            fuzz_fail("invalid next token", i);
+        }
+        if ((token->type != CJSON_TOKEN_OBJECT) &&
+            (token->type != CJSON_TOKEN_ARRAY)) {
+            if ((token->size != 0) || (token->next != (i + 1))) {
+                fuzz_fail("scalar with children", i);
+            }
+            continue;
+        }
+
+        int child = i + 1;
+        for (uint16_t j = 0; j < token->size; j++) {
+            if (token->type == CJSON_TOKEN_OBJECT) {
+                if (!cjson_tokens_is(document, child, CJSON_TOKEN_STRING)) {
+                    fuzz_fail("member without a string key", child);
+                }
+                child++;
+            }
+            if (child >= document->count) {
+                fuzz_fail("missing child", i);
+            }
+            child = document->tokens[child].next;
+        }
+        if (child != token->next) {
+            fuzz_fail("children don't end at next", i);
+        }
+    }
+    if ((document->count == 0) ||
+        (document->tokens[0].next != document->count)) {
+        fuzz_fail("top-level value doesn't cover the document", 0);
+    }
+}
+
+/**
+ * @brief Helper for checking if a string contains \u0000, which ends the
+ * unescaped (null terminated) string early
+ *
+ */
+static bool has_null_escape(const cjson_tokens_t *document, int token) {
+    const cjson_token_t *string = &document->tokens[token];
+    for (uint32_t i = string->start; (i + 6) <= string->end; i++) {
+        if (memcmp(document->json + i, "\\u0000", 6) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Compare a token (and its children) with a cJSON item
+ *
+ */
+static void compare(const cjson_tokens_t *document, int token,
+                    const cJSON *item, char *text, size_t text_size) {
+    const cjson_token_t *value = &document->tokens[token];
+    double number;
+
+    switch (value->type) {
+        case CJSON_TOKEN_OBJECT:
+        case CJSON_TOKEN_ARRAY: {
+            bool is_object = (value->type == CJSON_TOKEN_OBJECT);
+            if (is_object ? !cJSON_IsObject(item) : !cJSON_IsArray(item)) {
+                fuzz_fail("container type differs", token);
+            }
+            const cJSON *child = item->child;
+            int member = token + 1;
+            for (uint16_t i = 0; i < value->size; i++) {
+                if (child == NULL) {
+                    fuzz_fail("cJSON has fewer children", token);
+                }
+                if (is_object) {
+                    if ((cjson_tokens_get_string(document, member, text,
+                                                 text_size) != ESP_OK) ||
+                        (strcmp(text, child->string) != 0)) {
+                        fuzz_fail("key differs", member);
+                    }
+                    if (!has_null_escape(document, member) &&
+                        (cjson_tokens_find(document, token, child->string) ==
+                         CJSON_TOKENS_NONE)) {
+                        fuzz_fail("key not found", member);
+                    }
+                    member++;
+                } else if (cjson_tokens_element(document, token, i) !=
+                           member) {
+                    fuzz_fail("element index differs", member);
+                }
+                compare(document, member, child, text, text_size);
+                member = document->tokens[member].next;
+                child = child->next;
+            }
+            if (child != NULL) {
+                fuzz_fail("cJSON has more children", token);
+            }
+            break;
+        }
+        case CJSON_TOKEN_STRING:
+            if (!cJSON_IsString(item) ||
+                (cjson_tokens_get_string(document, token, text, text_size) !=
+                 ESP_OK) ||
+                (strcmp(text, item->valuestring) != 0)) {
+                fuzz_fail("string differs", token);
+            }
+            if (!has_null_escape(document, token) &&
+                !cjson_tokens_string_equals(document, token, text)) {
+                fuzz_fail("string_equals differs", token);
+            }
+            break;
+        case CJSON_TOKEN_NUMBER:
+            if (!cJSON_IsNumber(item) ||
+                (cjson_tokens_get_number(document, token, &number) != ESP_OK) ||
+                (number != item->valuedouble)) {
+                fuzz_fail("number differs", token);
+            }
+            break;
+        case CJSON_TOKEN_TRUE:
+            if (!cJSON_IsTrue(item)) {
+                fuzz_fail("true differs", token);
+            }
+            break;
+        case CJSON_TOKEN_FALSE:
+            if (!cJSON_IsFalse(item)) {
+                fuzz_fail("false differs", token);
+            }
+            break;
+        case CJSON_TOKEN_NULL:
+            if (!cJSON_IsNull(item)) {
+                fuzz_fail("null differs", token);
+            }
+            break;
+        default:
+            fuzz_fail("unknown token type", token);
+    }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    cjson_token_t tokens[FUZZ_MAX_TOKENS];
+    cjson_tokens_t document;
+
+    // Copy into an exactly sized buffer so ASan catches any read past the end
+    char *json = malloc((size > 0) ? size : 1);
+    if (json == NULL) {
+        return 0;
+    }
+    memcpy(json, data, size);
+
+    esp_err_t result =
+        cjson_tokens_parse(&document, json, size, tokens, FUZZ_MAX_TOKENS);
+    if (result != ESP_OK) {
+        free(json);
+        return 0;
+    }
+    check_invariants(&document, size);
+
+    // cJSON truncates numbers of 64 or more characters, skip the comparison
+    for (int i = 0; i < document.count; i++) {
+        if ((tokens[i].type == CJSON_TOKEN_NUMBER) &&
+            ((tokens[i].end - tokens[i].start) >= 64)) {
+            free(json);
+            return 0;
+        }
+    }
+
+    // Every string unescapes to at most its escaped length
+    char *text = malloc(size + 1);
+    cJSON *item = cJSON_ParseWithLength(json, size);
+    if (item == NULL) {
+        fuzz_fail("rejected by cJSON", 0);
+    }
+    compare(&document, 0, item, text, size + 1);
+
+    cJSON_Delete(item);
+    free(text);
+    free(json);
+    return 0;
+}
+
+#ifdef CJSON_TOKENS_FUZZ_STANDALONE
+static const char *corpus[] = {
+    "{\"command\":\"read-and-publish\"}",
+    "{\"command\": \"set-sampling\", \"args\": {\"min_ms\": 2000, "
+    "\"max_ms\": 600000, \"humidity\": 0.5, \"temperature\": 0.2}}",
+    "[1, -0.5e+3, 2E-7, 0, true, false, null, \"\", [], {}]",
+    "{\"a\\\"b\":\"\\u00fc\\ud83d\\ude00\\n\\t\\/\",\"a\":{\"a\":[[[1]]]}}",
+    " \"just a string\" ",
+    "-12345678901234567890",
+    "{\"\\u0000key\": \"x\\u0000y\", \"key\": 1}",
+};
+
+/**
+ * @brief Helper for a random byte (xorshift32)
+ *
+ */
+static uint32_t random_next(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static int run_file(const char *path) {
+    FILE *file = fopen(path, "rb");
+    static uint8_t data[1 << 16];
+
+    if (file == NULL) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return 1;
+    }
+    size_t size = fread(data, 1, sizeof(data), file);
+    fclose(file);
+    LLVMFuzzerTestOneInput(data, size);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    long iterations = 1000000;
+    uint32_t random_state = 2463534242u;
+    uint8_t data[512];
+    int first_file = 1;
+
+    if ((argc > 2) && (strcmp(argv[1], "--iterations") == 0)) {
+        iterations = atol(argv[2]);
+        first_file = 3;
+    }
+    if (first_file < argc) {
+        int failures = 0;
+        for (int i = first_file; i < argc; i++) {
+            failures += run_file(argv[i]);
+        }
+        return failures != 0;
+    }
+
+    // Byte flips, inserts and deletes of the corpus entries
+    static const char interesting[] = "{}[]\",:\\u0123456789.eE+-tfn \x01\xff";
+    for (long i = 0; i < iterations; i++) {
+        const char *seed =
+            corpus[random_next(&random_state) % (sizeof(corpus) /
+                                                 sizeof(corpus[0]))];
+        size_t size = strlen(seed);
+        memcpy(data, seed, size);
+        int mutations = 1 + (int)(random_next(&random_state) % 4);
+        for (int j = 0; j < mutations; j++) {
+            size_t position = (size > 0) ? random_next(&random_state) % size
+                                         : 0;
+            char character = interesting[random_next(&random_state) %
+                                         (sizeof(interesting) - 1)];
+            switch (random_next(&random_state) % 3) {
+                case 0:
+                    if (size > 0) {
+                        data[position] = (uint8_t)character;
+                    }
+                    break;
+                case 1:
+                    if (size < sizeof(data)) {
+                        memmove(&data[position + 1], &data[position],
+                                size - position);
+                        data[position] = (uint8_t)character;
+                        size++;
+                    }
+                    break;
+                default:
+                    if (size > 0) {
+                        memmove(&data[position], &data[position + 1],
+                                size - position - 1);
+                        size--;
+                    }
+                    break;
+            }
+        }
+        LLVMFuzzerTestOneInput(data, size);
+    }
+    printf("%ld inputs, no failures\n", iterations);
+    return 0;
+}
+#endif
@@ -0,0 +1,209 @@
+/**
+ * @file cjson_writer_bench.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Compares the streaming JSON writer with the cJSON tree path
+ * (cJSON_CreateObject... + cJSON_PrintPreallocated) for the sensor data
+ * payload on a host: output, heap allocations and time (not part of the
+ * firmware build)
+ * @version 0.1
+ * @date 2025-05-30
+ *
+ * Build (the writer only needs esp_err.h from ESP-IDF):
+ *   gcc -O2 -I$IDF_PATH/components/esp_common/include
+ *       -Icomponents/cjson_component
+ *       components/cjson_component/host/cjson_writer_bench.c
+ *       components/cjson_component/cjson_writer.c
+ *       components/cjson_component/cjson.c
+ *       components/cjson_component/cjson_dtoa.c -lm -o cjson_writer_bench
+ *
+ * Usage:
+ *   cjson_writer_bench [ITERATIONS]
+ *
+ * Both paths must produce the same bytes for every humidity/temperature value
+ * of the ChipCap2 range, exits with 1 if they don't.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cjson.h"
+#include "cjson_writer.h"
+
+// Same as CHIPCAP2_JSON_DECIMALS in cjson_component.c
+#define SENSOR_DECIMALS 2
+// ChipCap2 ranges in hundredths
+#define HUMIDITY_CENTI_MAX 10000
+#define TEMPERATURE_CENTI_MIN -4000
+#define TEMPERATURE_CENTI_MAX 12500
+// Same as the message buffer in main
+#define PAYLOAD_BUFFER_SIZE 200
+
+// Keeps the compiler from dropping the benchmarked calls
+static volatile size_t sink = 0;
+static size_t allocations = 0;
+static size_t allocated_bytes = 0;
+
+static void *counting_malloc(size_t size) {
+    allocations++;
+    allocated_bytes += size;
+    return malloc(size);
+}
+
+/**
+ * @brief Helper for the current time in nanoseconds
+ *
+ */
+static double now_ns(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec * 1e9 + (double)time.tv_nsec;
+}
+
+/**
+ * @brief The payload with the writer, as
+ * cjson_format_chipcap2_data_prebuffered
+ *
+ */
+static size_t format_writer(double humidity, double temperature, char *buffer,
+                            size_t size) {
+    cjson_writer_t writer;
+
+    cjson_writer_init(&writer, buffer, size);
+    cjson_writer_object_begin(&writer);
+    cjson_writer_key(&writer, "sensor-data");
+    cjson_writer_array_begin(&writer);
+
+    cjson_writer_object_begin(&writer);
+    cjson_writer_key(&writer, "humidity");
+    cjson_writer_number_fixed(&writer, humidity, SENSOR_DECIMALS);
+    cjson_writer_key(&writer, "unit");
+    cjson_writer_string(&writer, "%% (RH)");
+    cjson_writer_object_end(&writer);
+
+    cjson_writer_object_begin(&writer);
+    cjson_writer_key(&writer, "temperature");
+    cjson_writer_number_fixed(&writer, temperature, SENSOR_DECIMALS);
+    cjson_writer_key(&writer, "unit");
+    cjson_writer_string(&writer, "°C");
+    cjson_writer_object_end(&writer);
+
+    cjson_writer_array_end(&writer);
+    cjson_writer_object_end(&writer);
+
+    if (cjson_writer_finish(&writer) != ESP_OK) {
+        return 0;
+    }
+    return cjson_writer_length(&writer);
+}
+
+/**
+ * @brief Helper for one {"<name>": value, "unit": unit} object of the tree
+ *
+ */
+static bool add_tree_value(cJSON *array, const char *name, double value,
+                           const char *unit) {
+    cJSON *object = cJSON_CreateObject();
+    if (object == NULL) {
+        return false;
+    }
+    if (!cJSON_SetNumberPrecision(cJSON_AddNumberToObject(object, name, value),
+                                  SENSOR_DECIMALS) ||
+        (cJSON_AddStringToObject(object, "unit", unit) == NULL)) {
+        cJSON_Delete(object);
+        return false;
+    }
+    return cJSON_AddItemToArray(array, object);
+}
+
+/**
+ * @brief The payload with a cJSON tree, as
+ * cjson_format_chipcap2_data_prebuffered did before the writer
+ *
+ */
+static size_t format_tree(double humidity, double temperature, char *buffer,
+                          size_t size) {
+    cJSON *data = cJSON_CreateObject();
+    cJSON *sensor_data = cJSON_AddArrayToObject(data, "sensor-data");
+    size_t length = 0;
+
+    if ((sensor_data != NULL) &&
+        add_tree_value(sensor_data, "humidity", humidity, "%% (RH)") &&
+        add_tree_value(sensor_data, "temperature", temperature, "°C") &&
+        cJSON_PrintPreallocated(data, buffer, (int)size, false)) {
+        length = strlen(buffer);
+    }
+    cJSON_Delete(data);
+    return length;
+}
+
+int main(int argc, char **argv) {
+    cJSON_Hooks hooks = {.malloc_fn = counting_malloc, .free_fn = free};
+    long iterations = (argc > 1) ? atol(argv[1]) : 1000000;
+    char writer_buffer[PAYLOAD_BUFFER_SIZE];
+    char tree_buffer[PAYLOAD_BUFFER_SIZE];
+    unsigned int failures = 0;
+
+    if (iterations <= 0) {
+        fprintf(stderr, "usage: %s [ITERATIONS]\n", argv[0]);
+        return 2;
+    }
+    cJSON_InitHooks(&hooks);
+
+    // Every value of the sensor ranges, paired with a value of the other
+    for (int centi = TEMPERATURE_CENTI_MIN; centi <= TEMPERATURE_CENTI_MAX;
+         centi++) {
+        double temperature = centi / 100.0;
+        double humidity =
+            ((centi - TEMPERATURE_CENTI_MIN) % (HUMIDITY_CENTI_MAX + 1)) /
+            100.0;
+        size_t writer_length = format_writer(humidity, temperature,
+                                             writer_buffer,
+                                             sizeof(writer_buffer));
+        size_t tree_length = format_tree(humidity, temperature, tree_buffer,
+                                         sizeof(tree_buffer));
+        if ((writer_length == 0) || (writer_length != tree_length) ||
+            (memcmp(writer_buffer, tree_buffer, writer_length) != 0)) {
+            if (failures++ < 5) {
+                printf("FAIL %.2f/%.2f:\n  writer %.*s\n  tree   %s\n",
+                       humidity, temperature, (int)writer_length,
+                       writer_buffer, tree_buffer);
+            }
+        }
+    }
+    printf("%d payloads compared, %u differ\n",
+           TEMPERATURE_CENTI_MAX - TEMPERATURE_CENTI_MIN + 1, failures);
+    if (failures != 0) {
+        return 1;
+    }
+
+    allocations = 0;
+    allocated_bytes = 0;
+    size_t length = format_tree(45.12, 23.4, tree_buffer, sizeof(tree_buffer));
+    printf("payload %zu bytes: %s\n", length, tree_buffer);
+    printf("tree:   %zu allocations, %zu bytes per payload\n", allocations,
+           allocated_bytes);
+    allocations = 0;
+    format_writer(45.12, 23.4, writer_buffer, sizeof(writer_buffer));
+    printf("writer: %zu allocations\n", allocations);
+
+    double start = now_ns();
+    for (long i = 0; i < iterations; i++) {
+        sink += format_tree((i % 10001) / 100.0, (i % 16501) / 100.0 - 40.0,
+                            tree_buffer, sizeof(tree_buffer));
+    }
+    double middle = now_ns();
+    for (long i = 0; i < iterations; i++) {
+        sink += format_writer((i % 10001) / 100.0, (i % 16501) / 100.0 - 40.0,
+                              writer_buffer, sizeof(writer_buffer));
+    }
+    double end = now_ns();
+
+    double tree_ns = (middle - start) / iterations;
+    double writer_ns = (end - middle) / iterations;
+    printf("%ld iterations: tree %.1f ns, writer %.1f ns (%.1fx)\n",
+           iterations, tree_ns, writer_ns, tree_ns / writer_ns);
+
+    return 0;
+}
@@ -10,6 +10,8 @@
 #ifndef CUSTOM_DATA_TYPES_H
 #define CUSTOM_DATA_TYPES_H
 
+#include <stdint.h>
+
 #define DEFAULT_TOPIC "/matic_esp32c3/testing"
 #define RESPONSE_TOPIC "/matic_esp32c3/testing/response"
 
@@ -18,7 +20,7 @@ extern "C" {
 #endif
 
 /**
- * @brief Event enumeration for use with the general queue
+ * @brief Event enumeration for use with the event bus
  *
  */
 typedef enum {
@@ -29,11 +31,15 @@ typedef enum {
     EVENT_MESSAGE_UPDATE_FIRMWARE,
     EVENT_MQTT_CONNECTED,
     EVENT_MQTT_DISCONNECTED,
-    EVENT_BUTTON_HOLD
+    EVENT_BUTTON_HOLD,
+    EVENT_SENSOR_DATA_READY,
+    EVENT_SAMPLE_LOG_REPLAY,
+    EVENT_MESSAGE_DUMP_LATENCY,
+    EVENT_TELEMETRY,
+    EVENT_SAMPLING_POLICY,
+    EVENT_MQTT_RECONNECT
 } event_t;
 
-extern int64_t start_time;
-
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,186 @@
+/**
+ * @file event_bus.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Event bus between the components and the main event loop, with
+ * payloads, priority lanes and coalescing of repeated events
+ * @version 0.1
+ * @date 2025-05-22
+ *
+ */
+
+#include "event_bus.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "esp_timer.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+#define EVENT_BUS_TOTAL_LENGTH                                  \
+    (EVENT_BUS_HIGH_LANE_LENGTH + EVENT_BUS_NORMAL_LANE_LENGTH + \
+     EVENT_BUS_LOW_LANE_LENGTH)
+
+/**
+ * @brief Lane counters, updated by the posting tasks
+ */
+typedef struct {
+    atomic_uint_fast32_t posted;
+    atomic_uint_fast32_t received;
+    atomic_uint_fast32_t dropped;
+    atomic_uint_fast32_t peak;
+} event_bus_lane_counters_t;
+
+static const UBaseType_t lane_lengths[EVENT_BUS_LANE_COUNT] = {
+    EVENT_BUS_HIGH_LANE_LENGTH,
+    EVENT_BUS_NORMAL_LANE_LENGTH,
+    EVENT_BUS_LOW_LANE_LENGTH,
+};
+static QueueHandle_t lanes[EVENT_BUS_LANE_COUNT] = {NULL};
+// Counts the queued events of all lanes, the receiver waits on it
+static SemaphoreHandle_t events_available = NULL;
+static event_bus_lane_counters_t lane_counters[EVENT_BUS_LANE_COUNT];
+// Bit per coalesced event type that is currently queued
+static atomic_uint_fast32_t coalesced_pending = 0;
+static atomic_uint_fast32_t coalesced_count = 0;
+
+/**
+ * @brief Helper for the lane of an event type
+ *
+ */
+static event_bus_lane_t event_bus_lane(event_t type) {
+    switch (type) {
+        case EVENT_BUTTON_PRESS:
+        case EVENT_BUTTON_HOLD:
+        case EVENT_MESSAGE_UPDATE_FIRMWARE:
+        case EVENT_MQTT_CONNECTED:
+        case EVENT_MQTT_DISCONNECTED:
+        case EVENT_MQTT_RECONNECT:
+            return EVENT_BUS_LANE_HIGH;
+
+        case EVENT_TIMER_ELAPSED:
+        case EVENT_SAMPLE_LOG_REPLAY:
+        case EVENT_TELEMETRY:
+            return EVENT_BUS_LANE_LOW;
+
+        default:
+            return EVENT_BUS_LANE_NORMAL;
+    }
+}
+
+/**
+ * @brief Helper for checking if repeated posts of an event type are merged,
+ * only for events where handling one instead of several loses nothing
+ *
+ */
+static bool event_bus_coalesced(event_t type) {
+    return (type == EVENT_TIMER_ELAPSED) || (type == EVENT_SAMPLE_LOG_REPLAY) ||
+           (type == EVENT_TELEMETRY);
+}
+
+_Static_assert((EVENT_SAMPLE_LOG_REPLAY < 32) && (EVENT_TELEMETRY < 32),
+               "coalesced event types need a bit in coalesced_pending");
+
+esp_err_t event_bus_init(void) {
+    for (size_t i = 0; i < EVENT_BUS_LANE_COUNT; i++) {
+        lanes[i] = xQueueCreate(lane_lengths[i], sizeof(event_bus_event_t));
+        if (lanes[i] == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    events_available = xSemaphoreCreateCounting(EVENT_BUS_TOTAL_LENGTH, 0);
+    if (events_available == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t event_bus_post(event_t type) {
+    return event_bus_post_value(type, 0);
+}
+
+esp_err_t event_bus_post_value(event_t type, uint32_t value) {
+    if (events_available == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    event_bus_lane_t lane = event_bus_lane(type);
+    event_bus_lane_counters_t* counters = &lane_counters[lane];
+    uint_fast32_t coalesce_bit = 0;
+
+    if (event_bus_coalesced(type)) {
+        coalesce_bit = (uint_fast32_t)1 << type;
+        if (atomic_fetch_or(&coalesced_pending, coalesce_bit) &
+            coalesce_bit) {
+            atomic_fetch_add_explicit(&coalesced_count, 1,
+                                      memory_order_relaxed);
+            return ESP_OK;
+        }
+    }
+
+    event_bus_event_t event = {
+        .type = type,
+        .timestamp_us = esp_timer_get_time(),
+        .value = value,
+    };
+    if (xQueueSend(lanes[lane], &event, 0) != pdPASS) {
+        atomic_fetch_and(&coalesced_pending, ~coalesce_bit);
+        atomic_fetch_add_explicit(&counters->dropped, 1, memory_order_relaxed);
+        return ESP_ERR_NO_MEM;
+    }
+    xSemaphoreGive(events_available);
+    atomic_fetch_add_explicit(&counters->posted, 1, memory_order_relaxed);
+
+    // Lane high-water mark
+    uint_fast32_t waiting = uxQueueMessagesWaiting(lanes[lane]);
+    uint_fast32_t peak =
+        atomic_load_explicit(&counters->peak, memory_order_relaxed);
+    while ((waiting > peak) &&
+           !atomic_compare_exchange_weak(&counters->peak, &peak, waiting)) {
+    }
+
+    return ESP_OK;
+}
+
+bool event_bus_receive(event_bus_event_t* event, TickType_t timeout) {
+    if ((events_available == NULL) ||
+        (xSemaphoreTake(events_available, timeout) != pdTRUE)) {
+        return false;
+    }
+
+    // Every semaphore count belongs to a queued event, one of the lanes
+    // holds it
+    for (size_t i = 0; i < EVENT_BUS_LANE_COUNT; i++) {
+        if (xQueueReceive(lanes[i], event, 0) == pdPASS) {
+            if (event_bus_coalesced(event->type)) {
+                // Posts from now on queue a new event
+                atomic_fetch_and(&coalesced_pending,
+                                 ~((uint_fast32_t)1 << event->type));
+            }
+            atomic_fetch_add_explicit(&lane_counters[i].received, 1,
+                                      memory_order_relaxed);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void event_bus_get_stats(event_bus_stats_t* stats) {
+    for (size_t i = 0; i < EVENT_BUS_LANE_COUNT; i++) {
+        stats->lanes[i].posted = atomic_load_explicit(&lane_counters[i].posted,
+                                                      memory_order_relaxed);
+        stats->lanes[i].received = atomic_load_explicit(
+            &lane_counters[i].received, memory_order_relaxed);
+        stats->lanes[i].dropped = atomic_load_explicit(
+            &lane_counters[i].dropped, memory_order_relaxed);
+        stats->lanes[i].peak =
+            atomic_load_explicit(&lane_counters[i].peak, memory_order_relaxed);
+        stats->lanes[i].waiting =
+            (lanes[i] != NULL) ? uxQueueMessagesWaiting(lanes[i]) : 0;
+    }
+    stats->coalesced =
+        atomic_load_explicit(&coalesced_count, memory_order_relaxed);
+}
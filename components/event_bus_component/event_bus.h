@@ -0,0 +1,133 @@
+/**
+ * @file event_bus.h
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Event bus between the components and the main event loop, with
+ * payloads, priority lanes and coalescing of repeated events
+ * @version 0.1
+ * @date 2025-05-22
+ *
+ */
+
+#ifndef EVENT_BUS_H
+#define EVENT_BUS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "custom_data_types.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Lane lengths (number of queued events per lane)
+ */
+#define EVENT_BUS_HIGH_LANE_LENGTH 8
+#define EVENT_BUS_NORMAL_LANE_LENGTH 8
+#define EVENT_BUS_LOW_LANE_LENGTH 4
+
+/**
+ * @brief Priority lanes, a lane is only served when all higher priority
+ * lanes are empty
+ */
+typedef enum {
+    // User and connection events (button, OTA, MQTT connection state)
+    EVENT_BUS_LANE_HIGH,
+    // Requests and their completions (MQTT commands, sensor data)
+    EVENT_BUS_LANE_NORMAL,
+    // Periodic work (timer ticks, replays), coalesced
+    EVENT_BUS_LANE_LOW,
+    EVENT_BUS_LANE_COUNT
+} event_bus_lane_t;
+
+/**
+ * @brief Event with its payload
+ */
+typedef struct {
+    event_t type;
+    // Time of the post (esp_timer_get_time)
+    int64_t timestamp_us;
+    // Event specific value, 0 if the event has no payload
+    uint32_t value;
+} event_bus_event_t;
+
+/**
+ * @brief Per lane statistics
+ */
+typedef struct {
+    uint32_t posted;
+    uint32_t received;
+    // Posts rejected because the lane was full
+    uint32_t dropped;
+    // Most events queued at the same time
+    uint32_t peak;
+    // Events queued right now
+    uint32_t waiting;
+} event_bus_lane_stats_t;
+
+/**
+ * @brief Event bus statistics
+ */
+typedef struct {
+    event_bus_lane_stats_t lanes[EVENT_BUS_LANE_COUNT];
+    // Posts merged into an already queued event of the same type
+    uint32_t coalesced;
+} event_bus_stats_t;
+
+/**
+ * @brief Create the event bus, must be called before any component posts
+ *
+ * @return esp_err_t
+ */
+esp_err_t event_bus_init(void);
+
+/**
+ * @brief Post an event without a payload, see event_bus_post_value
+ *
+ * @param type The event
+ * @return esp_err_t
+ */
+esp_err_t event_bus_post(event_t type);
+
+/**
+ * @brief Post an event, never blocks so it can be used from timer and event
+ * callbacks
+ *
+ * Coalesced event types (e.g. EVENT_TIMER_ELAPSED) are not queued again
+ * while one of them is waiting to be received, the post succeeds and the
+ * queued event is delivered once (with its original payload).
+ *
+ * @param type The event
+ * @param value Event specific payload
+ * @return esp_err_t ESP_ERR_NO_MEM if the event's lane is full (counted as
+ * dropped), ESP_ERR_INVALID_STATE if the bus is not initialized
+ */
+esp_err_t event_bus_post_value(event_t type, uint32_t value);
+
+/**
+ * @brief Wait for the next event, the highest priority lane is served first
+ * and events of the same lane are received in posting order
+ *
+ * Only one task (the main event loop) may receive.
+ *
+ * @param event Output event
+ * @param timeout Ticks to wait for an event
+ * @return true if an event was received
+ */
+bool event_bus_receive(event_bus_event_t *event, TickType_t timeout);
+
+/**
+ * @brief Get the event bus statistics
+ *
+ * @param stats Output statistics
+ */
+void event_bus_get_stats(event_bus_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // EVENT_BUS_H
@@ -0,0 +1,23 @@
+/**
+ * @file esp_timer.h
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Host stand-in for esp_timer_get_time (not part of the firmware
+ * build)
+ * @version 0.1
+ * @date 2025-05-30
+ *
+ */
+
+#ifndef EVENT_BUS_HOST_ESP_TIMER_H
+#define EVENT_BUS_HOST_ESP_TIMER_H
+
+#include <stdint.h>
+
+/**
+ * @brief Microseconds of a monotonic clock
+ *
+ * @return int64_t
+ */
+int64_t esp_timer_get_time(void);
+
+#endif  // EVENT_BUS_HOST_ESP_TIMER_H
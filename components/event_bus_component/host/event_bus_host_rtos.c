@@ -0,0 +1,155 @@
+/**
+ * @file event_bus_host_rtos.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief FreeRTOS queues, counting semaphores and esp_timer_get_time with
+ * POSIX threads for the event bus host harness (not part of the firmware
+ * build)
+ * @version 0.1
+ * @date 2025-05-30
+ *
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+struct host_queue {
+    pthread_mutex_t lock;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+    unsigned char *items;
+};
+
+struct host_semaphore {
+    pthread_mutex_t lock;
+    pthread_cond_t available;
+    UBaseType_t max_count;
+    UBaseType_t count;
+};
+
+int64_t esp_timer_get_time(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    QueueHandle_t queue = calloc(1, sizeof(*queue));
+    if (queue == NULL) {
+        return NULL;
+    }
+    queue->items = malloc(length * item_size);
+    if (queue->items == NULL) {
+        free(queue);
+        return NULL;
+    }
+    pthread_mutex_init(&queue->lock, NULL);
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+// The event bus only sends and receives without waiting
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item,
+                      TickType_t timeout) {
+    BaseType_t result = pdFALSE;
+
+    (void)timeout;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->count < queue->length) {
+        UBaseType_t tail = (queue->head + queue->count) % queue->length;
+        memcpy(&queue->items[tail * queue->item_size], item,
+               queue->item_size);
+        queue->count++;
+        result = pdPASS;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return result;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t timeout) {
+    BaseType_t result = pdFALSE;
+
+    (void)timeout;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->count > 0) {
+        memcpy(item, &queue->items[queue->head * queue->item_size],
+               queue->item_size);
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        result = pdPASS;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return result;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count,
+                                           UBaseType_t initial_count) {
+    SemaphoreHandle_t semaphore = calloc(1, sizeof(*semaphore));
+    if (semaphore == NULL) {
+        return NULL;
+    }
+    pthread_mutex_init(&semaphore->lock, NULL);
+    pthread_cond_init(&semaphore->available, NULL);
+    semaphore->max_count = max_count;
+    semaphore->count = initial_count;
+    return semaphore;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    BaseType_t result = pdFALSE;
+
+    pthread_mutex_lock(&semaphore->lock);
+    if (semaphore->count < semaphore->max_count) {
+        semaphore->count++;
+        pthread_cond_signal(&semaphore->available);
+        result = pdTRUE;
+    }
+    pthread_mutex_unlock(&semaphore->lock);
+    return result;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t timeout) {
+    struct timespec deadline;
+    int wait_result = 0;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout / 1000;
+    deadline.tv_nsec += (long)(timeout % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&semaphore->lock);
+    while ((semaphore->count == 0) && (timeout > 0) &&
+           (wait_result != ETIMEDOUT)) {
+        if (timeout == portMAX_DELAY) {
+            pthread_cond_wait(&semaphore->available, &semaphore->lock);
+        } else {
+            wait_result = pthread_cond_timedwait(&semaphore->available,
+                                                 &semaphore->lock, &deadline);
+        }
+    }
+    BaseType_t result = pdFALSE;
+    if (semaphore->count > 0) {
+        semaphore->count--;
+        result = pdTRUE;
+    }
+    pthread_mutex_unlock(&semaphore->lock);
+    return result;
+}
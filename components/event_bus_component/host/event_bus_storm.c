@@ -0,0 +1,312 @@
+/**
+ * @file event_bus_storm.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Synthetic event storm for the event bus on a host: producer
+ * threads flood all lanes while one consumer thread plays the main event
+ * loop (not part of the firmware build)
+ * @version 0.1
+ * @date 2025-05-30
+ *
+ * Build (FreeRTOS and esp_timer are emulated with POSIX threads, only
+ * esp_err.h comes from ESP-IDF):
+ *   gcc -O2 -pthread -I$IDF_PATH/components/esp_common/include
+ *       -Icomponents/event_bus_component/host
+ *       -Icomponents/event_bus_component -Icomponents/custom_data_types
+ *       components/event_bus_component/host/event_bus_storm.c
+ *       components/event_bus_component/host/event_bus_host_rtos.c
+ *       components/event_bus_component/event_bus.c -o event_bus_storm
+ *
+ * Usage:
+ *   event_bus_storm [MILLISECONDS [HANDLER_US]]
+ *
+ * For MILLISECONDS (default 2000), two threads post bursts of 16 sensor /
+ * command events every 500 us (normal lane, more than the consumer can
+ * handle), one thread a button press every millisecond (high lane) and one
+ * thread timer and telemetry ticks every 50 us (low lane, coalesced). The
+ * consumer spends HANDLER_US (default 20) on every event. Checked: events of
+ * a producer are received in posting order, every post is either received,
+ * dropped or coalesced, and coalescing keeps the low lane from overflowing.
+ * Printed: the drops and the post to receive latency of every lane (the
+ * latencies include the host's thread scheduling, they are only comparable
+ * between the lanes of one run). Exits with 1 if a check fails.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_timer.h"
+#include "event_bus.h"
+
+// Producer id in the upper byte of the event value, sequence number below
+#define VALUE_PRODUCER_SHIFT 24
+#define VALUE_SEQUENCE_MASK ((1u << VALUE_PRODUCER_SHIFT) - 1)
+#define BUTTON_PERIOD_US 1000
+#define BURST_POSTS 16
+#define BURST_PERIOD_US 500
+#define TICK_PERIOD_US 50
+#define MAX_LATENCY_SAMPLES (1 << 20)
+// Both coalesced event types of the storm can be queued at the same time
+#define COALESCED_TYPES 2
+
+/**
+ * @brief Posts of one producer thread
+ */
+typedef struct {
+    uint32_t id;
+    event_t type;
+    // Posts without a pause, then a pause of period_us
+    uint32_t burst;
+    int64_t period_us;
+    uint32_t attempts;
+    uint32_t accepted;
+    uint32_t rejected;
+    // Next sequence number the consumer expects at least
+    uint32_t next_expected;
+} producer_t;
+
+/**
+ * @brief Received latencies of one lane
+ */
+typedef struct {
+    uint32_t *samples;
+    size_t count;
+} lane_latency_t;
+
+static atomic_bool storm_running = true;
+static unsigned int failures = 0;
+
+/**
+ * @brief Helper that busy waits, sleeping would be far too coarse
+ *
+ */
+static void spin_us(int64_t duration_us) {
+    int64_t end = esp_timer_get_time() + duration_us;
+    while (esp_timer_get_time() < end) {
+    }
+}
+
+static void *producer_thread(void *argument) {
+    producer_t *producer = argument;
+    uint32_t sequence = 0;
+
+    while (atomic_load(&storm_running)) {
+        uint32_t value = (producer->id << VALUE_PRODUCER_SHIFT) |
+                         (sequence & VALUE_SEQUENCE_MASK);
+        esp_err_t result = event_bus_post_value(producer->type, value);
+        producer->attempts++;
+        if (result == ESP_OK) {
+            producer->accepted++;
+        } else if (result == ESP_ERR_NO_MEM) {
+            producer->rejected++;
+        } else {
+            printf("FAIL post %d: error 0x%x\n", producer->type, result);
+            failures++;
+        }
+        sequence++;
+        if ((sequence % producer->burst) == 0) {
+            spin_us(producer->period_us);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Ticks thread, alternates the two coalesced event types
+ *
+ */
+static void *ticks_thread(void *argument) {
+    producer_t *producers = argument;
+
+    while (atomic_load(&storm_running)) {
+        for (size_t i = 0; i < COALESCED_TYPES; i++) {
+            producers[i].attempts++;
+            if (event_bus_post(producers[i].type) == ESP_OK) {
+                producers[i].accepted++;
+            } else {
+                producers[i].rejected++;
+            }
+        }
+        spin_us(TICK_PERIOD_US);
+    }
+    return NULL;
+}
+
+static int compare_latency(const void *a, const void *b) {
+    uint32_t left = *(const uint32_t *)a;
+    uint32_t right = *(const uint32_t *)b;
+    return (left > right) - (left < right);
+}
+
+/**
+ * @brief Helper for a percentile of sorted latencies
+ *
+ */
+static uint32_t percentile(const lane_latency_t *latency, unsigned int p) {
+    if (latency->count == 0) {
+        return 0;
+    }
+    return latency->samples[(latency->count - 1) * p / 100];
+}
+
+/**
+ * @brief Helper that checks the posting order of a received event
+ *
+ */
+static void check_order(producer_t *producers, size_t producer_count,
+                        const event_bus_event_t *event) {
+    uint32_t id = event->value >> VALUE_PRODUCER_SHIFT;
+    uint32_t sequence = event->value & VALUE_SEQUENCE_MASK;
+
+    for (size_t i = 0; i < producer_count; i++) {
+        if ((producers[i].type != event->type) || (producers[i].id != id)) {
+            continue;
+        }
+        // Dropped posts leave gaps, but a lane never reorders
+        if (sequence < producers[i].next_expected) {
+            if (failures++ < 5) {
+                printf("FAIL producer %u: sequence %u after %u\n", id,
+                       sequence, producers[i].next_expected - 1);
+            }
+        }
+        producers[i].next_expected = sequence + 1;
+        return;
+    }
+}
+
+int main(int argc, char **argv) {
+    long duration_ms = (argc > 1) ? atol(argv[1]) : 2000;
+    long handler_us = (argc > 2) ? atol(argv[2]) : 20;
+    static const char *lane_names[EVENT_BUS_LANE_COUNT] = {"high", "normal",
+                                                           "low"};
+    producer_t producers[] = {
+        {.id = 1,
+         .type = EVENT_SENSOR_DATA_READY,
+         .burst = BURST_POSTS,
+         .period_us = BURST_PERIOD_US},
+        {.id = 2,
+         .type = EVENT_MESSAGE_READ_AND_PUBLISH,
+         .burst = BURST_POSTS,
+         .period_us = BURST_PERIOD_US},
+        {.id = 3,
+         .type = EVENT_BUTTON_PRESS,
+         .burst = 1,
+         .period_us = BUTTON_PERIOD_US},
+    };
+    producer_t ticks[COALESCED_TYPES] = {
+        {.type = EVENT_TIMER_ELAPSED},
+        {.type = EVENT_TELEMETRY},
+    };
+    const size_t producer_count = sizeof(producers) / sizeof(producers[0]);
+    lane_latency_t latencies[EVENT_BUS_LANE_COUNT];
+    pthread_t threads[sizeof(producers) / sizeof(producers[0]) + 1];
+    uint32_t received[EVENT_BUS_LANE_COUNT] = {0};
+    event_bus_event_t event;
+    event_bus_stats_t stats;
+
+    if ((duration_ms <= 0) || (handler_us < 0)) {
+        fprintf(stderr, "usage: %s [MILLISECONDS [HANDLER_US]]\n", argv[0]);
+        return 2;
+    }
+    if (event_bus_init() != ESP_OK) {
+        printf("FAIL: event_bus_init\n");
+        return 1;
+    }
+    for (size_t i = 0; i < EVENT_BUS_LANE_COUNT; i++) {
+        latencies[i].samples =
+            malloc(MAX_LATENCY_SAMPLES * sizeof(*latencies[i].samples));
+        latencies[i].count = 0;
+    }
+
+    for (size_t i = 0; i < producer_count; i++) {
+        pthread_create(&threads[i], NULL, producer_thread, &producers[i]);
+    }
+    pthread_create(&threads[producer_count], NULL, ticks_thread, ticks);
+
+    // The main event loop, until the storm is over and the lanes are empty
+    int64_t end_us = esp_timer_get_time() + duration_ms * 1000;
+    bool draining = false;
+    for (;;) {
+        if (!draining && (esp_timer_get_time() >= end_us)) {
+            atomic_store(&storm_running, false);
+            for (size_t i = 0; i <= producer_count; i++) {
+                pthread_join(threads[i], NULL);
+            }
+            draining = true;
+        }
+        if (!event_bus_receive(&event, draining ? 0 : 10)) {
+            if (draining) {
+                break;
+            }
+            continue;
+        }
+
+        size_t lane = (event.type == EVENT_BUTTON_PRESS) ? EVENT_BUS_LANE_HIGH
+                      : ((event.type == EVENT_TIMER_ELAPSED) ||
+                         (event.type == EVENT_TELEMETRY))
+                          ? EVENT_BUS_LANE_LOW
+                          : EVENT_BUS_LANE_NORMAL;
+        lane_latency_t *latency = &latencies[lane];
+        if (latency->count < MAX_LATENCY_SAMPLES) {
+            latency->samples[latency->count++] =
+                (uint32_t)(esp_timer_get_time() - event.timestamp_us);
+        }
+        received[lane]++;
+        if (lane != EVENT_BUS_LANE_LOW) {
+            check_order(producers, producer_count, &event);
+        }
+        spin_us(handler_us);
+    }
+
+    event_bus_get_stats(&stats);
+
+    // Every post was received, dropped or merged into a queued event
+    uint32_t attempts[EVENT_BUS_LANE_COUNT] = {0};
+    uint32_t rejected[EVENT_BUS_LANE_COUNT] = {0};
+    attempts[EVENT_BUS_LANE_HIGH] = producers[2].attempts;
+    rejected[EVENT_BUS_LANE_HIGH] = producers[2].rejected;
+    attempts[EVENT_BUS_LANE_NORMAL] =
+        producers[0].attempts + producers[1].attempts;
+    rejected[EVENT_BUS_LANE_NORMAL] =
+        producers[0].rejected + producers[1].rejected;
+    attempts[EVENT_BUS_LANE_LOW] = ticks[0].attempts + ticks[1].attempts;
+    rejected[EVENT_BUS_LANE_LOW] = ticks[0].rejected + ticks[1].rejected;
+
+    printf("%ld ms storm, %ld us per event\n", duration_ms, handler_us);
+    printf("  lane      posts  received   dropped  coalesced  peak  "
+           "p50 us  p99 us  max us\n");
+    for (size_t i = 0; i < EVENT_BUS_LANE_COUNT; i++) {
+        const event_bus_lane_stats_t *lane = &stats.lanes[i];
+        uint32_t coalesced =
+            (i == EVENT_BUS_LANE_LOW) ? (uint32_t)stats.coalesced : 0;
+
+        qsort(latencies[i].samples, latencies[i].count,
+              sizeof(*latencies[i].samples), compare_latency);
+        printf("  %-6s %9u %9u %9u %10u %5u %7u %7u %7u\n", lane_names[i],
+               attempts[i], received[i], lane->dropped, coalesced, lane->peak,
+               percentile(&latencies[i], 50), percentile(&latencies[i], 99),
+               percentile(&latencies[i], 100));
+
+        if ((lane->received != received[i]) || (lane->waiting != 0) ||
+            (lane->posted != received[i]) ||
+            (lane->dropped != rejected[i]) ||
+            (attempts[i] != lane->posted + lane->dropped + coalesced)) {
+            printf("FAIL %s lane: posts not accounted for\n", lane_names[i]);
+            failures++;
+        }
+    }
+    // One coalesced event of each type at most, the low lane never fills
+    if ((stats.lanes[EVENT_BUS_LANE_LOW].peak > COALESCED_TYPES) ||
+        (stats.lanes[EVENT_BUS_LANE_LOW].dropped != 0)) {
+        printf("FAIL low lane: coalescing let it fill up\n");
+        failures++;
+    }
+
+    for (size_t i = 0; i < EVENT_BUS_LANE_COUNT; i++) {
+        free(latencies[i].samples);
+    }
+    printf("%s: %u failures\n", (failures == 0) ? "OK" : "FAIL", failures);
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,49 @@
+/**
+ * @file FreeRTOS.h
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief The part of the FreeRTOS API used by the event bus, implemented
+ * with POSIX threads for the host harness (not part of the firmware build)
+ * @version 0.1
+ * @date 2025-05-30
+ *
+ */
+
+#ifndef EVENT_BUS_HOST_FREERTOS_H
+#define EVENT_BUS_HOST_FREERTOS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+// One tick is one millisecond on the host
+typedef uint32_t TickType_t;
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdPASS pdTRUE
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS ((TickType_t)1)
+
+typedef struct host_queue *QueueHandle_t;
+typedef struct host_semaphore *SemaphoreHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item,
+                      TickType_t timeout);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t timeout);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count,
+                                           UBaseType_t initial_count);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // EVENT_BUS_HOST_FREERTOS_H
@@ -0,0 +1,11 @@
+/**
+ * @file queue.h
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Host stand-in for freertos/queue.h, everything is declared in
+ * FreeRTOS.h (not part of the firmware build)
+ * @version 0.1
+ * @date 2025-05-30
+ *
+ */
+
+#include "freertos/FreeRTOS.h"
@@ -18,6 +18,7 @@
 #include "driver/gpio.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "event_bus.h"
 #include "led.h"
 #include "sdkconfig.h"
 
@@ -30,7 +31,7 @@
 static const char* TAG = "MQTT-Controller";
 static volatile int64_t last_isr_time = 0;
 static QueueHandle_t gpio_event_queue = NULL;
-static QueueHandle_t* general_event_queue_reference;
+static TaskHandle_t button_task = NULL;
 
 // Button states
 typedef enum { BUTTON_IDLE, BUTTON_PRESSED, BUTTON_HELD } button_state_t;
@@ -60,10 +61,8 @@ static void gpio_controller_button_task(void* pvParameter) {
                     button_state = BUTTON_IDLE;
 
                     if (press_flag) {
-                        // Add a button press event to the queue
-                        event_t new_event = EVENT_BUTTON_PRESS;
-                        xQueueSend(*general_event_queue_reference, &new_event,
-                                   portMAX_DELAY);
+                        // Post a button press event
+                        event_bus_post(EVENT_BUTTON_PRESS);
                     }
                     press_flag = false;
                 } else {
@@ -78,10 +77,8 @@ static void gpio_controller_button_task(void* pvParameter) {
                             press_flag = false;
                             button_state = BUTTON_HELD;
 
-                            // Add a button hold event to the queue
-                            event_t new_event = EVENT_BUTTON_HOLD;
-                            xQueueSend(*general_event_queue_reference,
-                                       &new_event, portMAX_DELAY);
+                            // Post a button hold event
+                            event_bus_post(EVENT_BUTTON_HOLD);
                         }
                     }
                 }
@@ -100,7 +97,7 @@ static void gpio_controller_button_task(void* pvParameter) {
     }
 }
 
-void gpio_controller_init(QueueHandle_t* general_event_queue) {
+void gpio_controller_init(void) {
     // Configure the peripheral according to the LED type
     led_initialize();
 
@@ -114,9 +111,6 @@ void gpio_controller_init(QueueHandle_t* general_event_queue) {
     };
     gpio_config(&io_conf);
 
-    // Initialize reference to the main module's general queue
-    general_event_queue_reference = general_event_queue;
-
     // Create a queue to handle gpio event from isr
     gpio_event_queue = xQueueCreate(10, sizeof(uint32_t));
     if (gpio_event_queue == NULL) {
@@ -126,9 +120,11 @@ void gpio_controller_init(QueueHandle_t* general_event_queue) {
 
     // Start gpio task
     xTaskCreate(gpio_controller_button_task, "gpio_controller_button_task",
-                2048, NULL, 10, NULL);
+                2048, NULL, 10, &button_task);
 }
 
 int gpio_controller_get_button_state(void) {
     return gpio_get_level(BUTTON_INPUT_GPIO);
-}
\ No newline at end of file
+}
+
+TaskHandle_t gpio_controller_get_task_handle(void) { return button_task; }
\ No newline at end of file
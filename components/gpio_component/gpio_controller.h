@@ -22,10 +22,11 @@ extern "C" {
 #endif
 
 /**
- * @brief Initialize the global GPIO functionality
+ * @brief Initialize the global GPIO functionality, the button events are
+ * posted to the event bus
  *
  */
-void gpio_controller_init(QueueHandle_t* general_event_queue);
+void gpio_controller_init(void);
 
 /**
  * @brief
@@ -34,6 +35,14 @@ void gpio_controller_init(QueueHandle_t* general_event_queue);
  */
 int gpio_controller_get_button_state(void);
 
+/**
+ * @brief Get the handle of the button task (e.g. for its stack high-water
+ * mark)
+ *
+ * @return TaskHandle_t NULL before gpio_controller_init
+ */
+TaskHandle_t gpio_controller_get_task_handle(void);
+
 #ifdef __cplusplus
 }
 #endif
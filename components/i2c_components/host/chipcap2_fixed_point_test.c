@@ -0,0 +1,171 @@
+/**
+ * @file chipcap2_fixed_point_test.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Checks the fixed-point ChipCap2 conversion against the datasheet
+ * float formula for all 16384 14-bit codes on a host, and compares the cost
+ * of both conversions (not part of the firmware build)
+ * @version 0.1
+ * @date 2025-05-30
+ *
+ * Build:
+ *   gcc -O2 -Icomponents/i2c_components -Icomponents/cjson_component
+ *       components/i2c_components/host/chipcap2_fixed_point_test.c
+ *       components/cjson_component/cjson_dtoa.c -lm
+ *       -o chipcap2_fixed_point_test
+ *
+ * Usage:
+ *   chipcap2_fixed_point_test [ROUNDS]
+ *
+ * For every code, the hundredths must print the same 2 decimals as the float
+ * formula (what CONFIG_CHIPCAP2_FIXED_POINT disabled publishes) and be within
+ * half a hundredth of the exact value. Exits with 1 if any code differs.
+ * The benchmark converts all codes ROUNDS times (default 1000) and reports
+ * CPU cycles per conversion on x86 hosts, nanoseconds elsewhere. The host has
+ * an FPU, the gap is larger on the C3, which emulates float math in software.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "cjson_dtoa.h"
+#include "i2c_chipcap2_data.h"
+
+#define RAW_CODES (1 << CC2_RAW_RESOLUTION_BITS)
+#define PUBLISHED_DECIMALS 2
+
+// Keeps the compiler from dropping the benchmarked conversions
+static volatile float float_sink = 0;
+static volatile int32_t centi_sink = 0;
+
+/**
+ * @brief Helper for a time stamp, CPU cycles if available
+ *
+ */
+static double now_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return (double)__rdtsc();
+#else
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec * 1e9 + (double)time.tv_nsec;
+#endif
+}
+
+/**
+ * @brief Humidity from the datasheet, as i2c_chipcap2_convert() without
+ * CONFIG_CHIPCAP2_FIXED_POINT
+ *
+ */
+static float humidity_float(uint8_t high_byte, uint8_t low_byte) {
+    return ((((float)(high_byte * 256) + (float)low_byte) / 16384.0) * 100.0);
+}
+
+/**
+ * @brief Temperature from the datasheet, as i2c_chipcap2_convert() without
+ * CONFIG_CHIPCAP2_FIXED_POINT (the low byte holds the 6 lower bits of the
+ * code in its upper bits)
+ *
+ */
+static float temperature_float(uint8_t high_byte, uint8_t low_byte) {
+    return ((((float)(high_byte * 64) + ((float)low_byte / 4)) / 16384.0) *
+            165.0) -
+           40;
+}
+
+/**
+ * @brief Helper that compares one code of one quantity, returns 1 if the
+ * conversions differ
+ *
+ */
+static unsigned int check_code(const char *name, uint16_t raw, float value,
+                               int32_t span, int32_t offset) {
+    char fixed_text[CJSON_DTOA_BUFFER_SIZE];
+    char float_text[CJSON_DTOA_BUFFER_SIZE];
+    int16_t centi = i2c_chipcap2_raw_to_centi(raw, span, offset);
+    double exact = ((double)raw * span / RAW_CODES + offset) / 100.0;
+
+    cjson_itoa_scaled(centi, PUBLISHED_DECIMALS, fixed_text);
+    cjson_dtoa_fixed(value, PUBLISHED_DECIMALS, float_text);
+    if ((strcmp(fixed_text, float_text) != 0) ||
+        (fabs(centi / 100.0 - exact) > 0.005 + 1e-9)) {
+        printf("FAIL %s raw %u: fixed %s, float %s, exact %.6f\n", name, raw,
+               fixed_text, float_text, exact);
+        return 1;
+    }
+    return 0;
+}
+
+static unsigned int check_all_codes(void) {
+    unsigned int failures = 0;
+
+    for (uint16_t raw = 0; raw < RAW_CODES; raw++) {
+        // Data-Fetch byte layout of i2c_chipcap2_convert()
+        uint8_t humidity_high = raw >> 8;
+        uint8_t humidity_low = raw & 0xff;
+        uint8_t temperature_high = raw >> 6;
+        uint8_t temperature_low = (raw & 0x3f) << 2;
+
+        failures += check_code(
+            "humidity", raw, humidity_float(humidity_high, humidity_low),
+            CC2_HUMIDITY_CENTI_SPAN, CC2_HUMIDITY_CENTI_OFFSET);
+        failures += check_code(
+            "temperature", raw,
+            temperature_float(temperature_high, temperature_low),
+            CC2_TEMPERATURE_CENTI_SPAN, CC2_TEMPERATURE_CENTI_OFFSET);
+    }
+    printf("%d codes x 2 quantities compared, %u differ\n", RAW_CODES,
+           failures);
+    return failures;
+}
+
+static void benchmark(long rounds) {
+    double start = now_ticks();
+    for (long round = 0; round < rounds; round++) {
+        for (uint16_t raw = 0; raw < RAW_CODES; raw++) {
+            float_sink = humidity_float(raw >> 8, raw & 0xff);
+            float_sink = temperature_float(raw >> 6, (raw & 0x3f) << 2);
+        }
+    }
+    double middle = now_ticks();
+    for (long round = 0; round < rounds; round++) {
+        for (uint16_t raw = 0; raw < RAW_CODES; raw++) {
+            centi_sink = i2c_chipcap2_raw_to_centi(
+                raw, CC2_HUMIDITY_CENTI_SPAN, CC2_HUMIDITY_CENTI_OFFSET);
+            centi_sink = i2c_chipcap2_raw_to_centi(
+                raw, CC2_TEMPERATURE_CENTI_SPAN, CC2_TEMPERATURE_CENTI_OFFSET);
+        }
+    }
+    double end = now_ticks();
+
+    double conversions = (double)rounds * RAW_CODES * 2;
+    double float_ticks = (middle - start) / conversions;
+    double fixed_ticks = (end - middle) / conversions;
+#if defined(__x86_64__) || defined(__i386__)
+    const char *unit = "cycles";
+#else
+    const char *unit = "ns";
+#endif
+    printf("%s per conversion: float %.2f, fixed point %.2f (%.1fx)\n", unit,
+           float_ticks, fixed_ticks, float_ticks / fixed_ticks);
+}
+
+int main(int argc, char **argv) {
+    long rounds = (argc > 1) ? atol(argv[1]) : 1000;
+
+    if (rounds <= 0) {
+        fprintf(stderr, "usage: %s [ROUNDS]\n", argv[0]);
+        return 2;
+    }
+
+    unsigned int failures = check_all_codes();
+    benchmark(rounds);
+
+    printf("%s: %u failures\n", (failures == 0) ? "OK" : "FAIL", failures);
+    return (failures == 0) ? 0 : 1;
+}
@@ -10,15 +10,27 @@
 #include "i2c_chipcap2.h"
 
 #include <math.h>
+#include <string.h>
 
+#include "custom_data_types.h"
 #include "esp_check.h"
+#include "esp_timer.h"
+#include "event_bus.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "sdkconfig.h"
+
+// Retry delay for posting the completion event when the queue is full
+#define CC2_EVENT_RETRY_US (10 * 1000)
 
 static const char TAG[] = "i2c-chipcap2";
 static i2c_chipcap2_handle_t chipcap2_handle;
-static uint8_t chipcap2_read_buffer[4] = {0};
+static uint8_t chipcap2_read_buffer[CC2_DATA_LENGTH] = {0};
 static i2c_chipcap2_data_t chipcap2_data = {0};
+// Asynchronous measurement
+static esp_timer_handle_t chipcap2_conversion_timer = NULL;
+static volatile bool chipcap2_measurement_busy = false;
+static uint8_t chipcap2_stale_retries = 0;
 
 /**
  * @brief Helper for reseting the ChipCap2 measurement data
@@ -26,11 +38,27 @@ static i2c_chipcap2_data_t chipcap2_data = {0};
  */
 static void i2c_chipcap2_reset_data(void) {
     chipcap2_data.humidity.value = 0.0;
+    chipcap2_data.humidity.centi = 0;
     chipcap2_data.humidity.high_byte = 0;
     chipcap2_data.humidity.low_byte = 0;
     chipcap2_data.temperature.value = 0.0;
+    chipcap2_data.temperature.centi = 0;
     chipcap2_data.temperature.high_byte = 0;
     chipcap2_data.temperature.low_byte = 0;
+    chipcap2_data.status = I2C_CHIPCAP2_STATUS_RESERVED;
+    chipcap2_data.stale_retries = 0;
+}
+
+/**
+ * @brief Callback that fires when the measurement conversion time elapsed,
+ * runs in the esp_timer task so it must not block
+ *
+ */
+static void i2c_chipcap2_conversion_timer_callback(void* arg) {
+    if (event_bus_post(EVENT_SENSOR_DATA_READY) != ESP_OK) {
+        // Lane full, try again shortly
+        esp_timer_start_once(chipcap2_conversion_timer, CC2_EVENT_RETRY_US);
+    }
 }
 
 esp_err_t i2c_chipcap2_init(i2c_master_bus_handle_t bus_handle,
@@ -47,6 +75,13 @@ esp_err_t i2c_chipcap2_init(i2c_master_bus_handle_t bus_handle,
                           err, TAG, "i2c new bus failed");
     }
 
+    const esp_timer_create_args_t timer_args = {
+        .callback = i2c_chipcap2_conversion_timer_callback,
+        .name = "chipcap2-conversion",
+    };
+    ESP_GOTO_ON_ERROR(esp_timer_create(&timer_args, &chipcap2_conversion_timer),
+                      err, TAG, "conversion timer create failed");
+
     return ESP_OK;
 
 err:
@@ -54,6 +89,7 @@ err:
         i2c_master_bus_rm_device(chipcap2_handle->i2c_dev);
     }
     free(chipcap2_handle);
+    chipcap2_handle = NULL;
     return ret;
 }
 
@@ -68,35 +104,33 @@ esp_err_t i2c_chipcap2_data_fetch(uint8_t* buffer) {
     ESP_RETURN_ON_FALSE(chipcap2_handle, ESP_ERR_NO_MEM, TAG,
                         "no mem for buffer");
 
-    // Reset the ChipCap2 read buffer
-    for (int i = 0; i < 4; i++) {
-        chipcap2_read_buffer[i] = 0;
-    }
+    // Reset the read buffer
+    memset(buffer, 0, CC2_DATA_LENGTH);
 
-    return i2c_master_receive(chipcap2_handle->i2c_dev, buffer, sizeof(buffer),
-                              -1);
+    return i2c_master_receive(chipcap2_handle->i2c_dev, buffer,
+                              CC2_DATA_LENGTH, -1);
 }
 
-esp_err_t i2c_chipcap2_read(i2c_chipcap2_data_t* out_data) {
-    esp_err_t result = ESP_OK;
-
-    // Do a ChipCap2 measurement
-    result = i2c_chipcap2_measurement_request();
-    if (result != ESP_OK) {
-        return result;
-    }
-
-    // Measurement delay
-    vTaskDelay(30 / portTICK_PERIOD_MS);
-
-    // Fetch both the humidity and temperature data
-    result = i2c_chipcap2_data_fetch(chipcap2_read_buffer);
-    if (result != ESP_OK) {
-        return result;
-    }
+/**
+ * @brief Helper for decoding the status bits of the last Data-Fetch
+ *
+ */
+static i2c_chipcap2_status_t i2c_chipcap2_status(void) {
+    return (i2c_chipcap2_status_t)(chipcap2_read_buffer[0] >>
+                                   CC2_STATUS_SHIFT);
+}
 
+/**
+ * @brief Helper for converting the raw data in the read buffer into humidity
+ * and temperature values
+ *
+ */
+static void i2c_chipcap2_convert(i2c_chipcap2_data_t* out_data) {
     i2c_chipcap2_reset_data();
 
+    chipcap2_data.status = i2c_chipcap2_status();
+    chipcap2_data.stale_retries = chipcap2_stale_retries;
+
     unsigned char rh_byte_1 = chipcap2_read_buffer[0];
     unsigned char rh_byte_2 = chipcap2_read_buffer[1];
     unsigned char temp_byte_1 = chipcap2_read_buffer[2];
@@ -104,26 +138,133 @@ esp_err_t i2c_chipcap2_read(i2c_chipcap2_data_t* out_data) {
 
     // The upper two bits of the first result byte are STATUS BITS
     rh_byte_1 &= 0b00111111;
+    // Lower two bits of the second temperature byte are unused
+    temp_byte_2 &= 0b11111100;
+
+    // Integer conversion, no floating point math is needed
+    uint16_t rh_raw = ((uint16_t)rh_byte_1 << 8) | rh_byte_2;
+    uint16_t temp_raw = ((uint16_t)temp_byte_1 << 6) | (temp_byte_2 >> 2);
+    chipcap2_data.humidity.centi = i2c_chipcap2_raw_to_centi(
+        rh_raw, CC2_HUMIDITY_CENTI_SPAN, CC2_HUMIDITY_CENTI_OFFSET);
+    chipcap2_data.temperature.centi = i2c_chipcap2_raw_to_centi(
+        temp_raw, CC2_TEMPERATURE_CENTI_SPAN, CC2_TEMPERATURE_CENTI_OFFSET);
+
+#if CONFIG_CHIPCAP2_FIXED_POINT
+    // Single precision only, the C3 has no FPU and doubles are much slower
+    chipcap2_data.humidity.value = (float)chipcap2_data.humidity.centi / 100.0f;
+    chipcap2_data.temperature.value =
+        (float)chipcap2_data.temperature.centi / 100.0f;
+#else
     // Humidity calculated according to the datasheet
     chipcap2_data.humidity.value =
         ((((float)(rh_byte_1 * 256) + (float)rh_byte_2) / 16384.0) * 100.0);
-    // Store the bytes
-    chipcap2_data.humidity.high_byte = rh_byte_1;
-    chipcap2_data.humidity.low_byte = rh_byte_2;
-
-    // Lower two bits of the second temperature byte are unused
-    temp_byte_2 &= 0b11111100;
     // Temperature calculated according to the datasheet
     chipcap2_data.temperature.value =
         ((((float)(temp_byte_1 * 64) + ((float)temp_byte_2 / 4)) / 16384.0) *
          165.0) -
         40;
+#endif
+
     // Store the bytes
+    chipcap2_data.humidity.high_byte = rh_byte_1;
+    chipcap2_data.humidity.low_byte = rh_byte_2;
     chipcap2_data.temperature.high_byte = temp_byte_1;
     chipcap2_data.temperature.low_byte = temp_byte_2;
 
     // Copy data to the caller
     *out_data = chipcap2_data;
+}
+
+esp_err_t i2c_chipcap2_read(i2c_chipcap2_data_t* out_data) {
+    esp_err_t result = ESP_OK;
+
+    // Do a ChipCap2 measurement
+    result = i2c_chipcap2_measurement_request();
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    // Measurement delay
+    vTaskDelay(CC2_MEASUREMENT_TIME_MS / portTICK_PERIOD_MS);
+
+    // Fetch both the humidity and temperature data, re-fetch only if the
+    // sensor reports the data as stale
+    chipcap2_stale_retries = 0;
+    for (;;) {
+        result = i2c_chipcap2_data_fetch(chipcap2_read_buffer);
+        if (result != ESP_OK) {
+            return result;
+        }
+        if ((i2c_chipcap2_status() != I2C_CHIPCAP2_STATUS_STALE) ||
+            (chipcap2_stale_retries >= CC2_STALE_MAX_RETRIES)) {
+            break;
+        }
+        chipcap2_stale_retries++;
+        vTaskDelay(pdMS_TO_TICKS(CC2_STALE_RETRY_MS));
+    }
+
+    i2c_chipcap2_convert(out_data);
+
+    return (out_data->status == I2C_CHIPCAP2_STATUS_VALID)
+               ? ESP_OK
+               : ESP_ERR_INVALID_RESPONSE;
+}
+
+esp_err_t i2c_chipcap2_measurement_start(void) {
+    ESP_RETURN_ON_FALSE(chipcap2_conversion_timer, ESP_ERR_INVALID_STATE, TAG,
+                        "not initialized");
+    ESP_RETURN_ON_FALSE(!chipcap2_measurement_busy, ESP_ERR_INVALID_STATE, TAG,
+                        "measurement already in progress");
+
+    esp_err_t result = i2c_chipcap2_measurement_request();
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    chipcap2_measurement_busy = true;
+    chipcap2_stale_retries = 0;
+    result = esp_timer_start_once(chipcap2_conversion_timer,
+                                  CC2_MEASUREMENT_TIME_MS * 1000);
+    if (result != ESP_OK) {
+        chipcap2_measurement_busy = false;
+    }
 
     return result;
 }
+
+bool i2c_chipcap2_measurement_busy(void) { return chipcap2_measurement_busy; }
+
+esp_err_t i2c_chipcap2_measurement_fetch(i2c_chipcap2_data_t* out_data) {
+    ESP_RETURN_ON_FALSE(chipcap2_measurement_busy, ESP_ERR_INVALID_STATE, TAG,
+                        "no measurement in progress");
+    ESP_RETURN_ON_FALSE(!esp_timer_is_active(chipcap2_conversion_timer),
+                        ESP_ERR_INVALID_STATE, TAG,
+                        "conversion not finished yet");
+
+    // Fetch both the humidity and temperature data
+    esp_err_t result = i2c_chipcap2_data_fetch(chipcap2_read_buffer);
+    if (result != ESP_OK) {
+        chipcap2_measurement_busy = false;
+        return result;
+    }
+
+    // Stale data, schedule a re-fetch instead of a whole new measurement
+    if ((i2c_chipcap2_status() == I2C_CHIPCAP2_STATUS_STALE) &&
+        (chipcap2_stale_retries < CC2_STALE_MAX_RETRIES)) {
+        chipcap2_stale_retries++;
+        result = esp_timer_start_once(chipcap2_conversion_timer,
+                                      CC2_STALE_RETRY_MS * 1000);
+        if (result != ESP_OK) {
+            chipcap2_measurement_busy = false;
+            return result;
+        }
+        return ESP_ERR_NOT_FINISHED;
+    }
+
+    chipcap2_measurement_busy = false;
+    i2c_chipcap2_convert(out_data);
+
+    return (out_data->status == I2C_CHIPCAP2_STATUS_VALID)
+               ? ESP_OK
+               : ESP_ERR_INVALID_RESPONSE;
+}
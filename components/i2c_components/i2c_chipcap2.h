@@ -10,8 +10,13 @@
 #ifndef I2C_CHIPCAP2_H
 #define I2C_CHIPCAP2_H
 
+#include <stdbool.h>
+
 #include "driver/i2c_master.h"
 #include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "i2c_chipcap2_data.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -24,15 +29,15 @@ extern "C" {
 #define CC2_I2C_DEVICE_ADDRESS 0b0101000
 #define CC2_I2C_DATA_FETCH COMBINE(CC2_I2C_DEVICE_ADDRESS, 0b1)
 #define CC2_I2C_MEASUREMENT_REQ COMBINE(CC2_I2C_DEVICE_ADDRESS, 0b0)
-
-/**
- * @brief Base struct for storing humidity/temperature data
- */
-typedef struct {
-    float value;
-    unsigned char high_byte;
-    unsigned char low_byte;
-} i2c_chipcap2_mixed_number_t;
+// Time between the measurement request and valid data
+#define CC2_MEASUREMENT_TIME_MS 30
+// Number of bytes returned by a Data-Fetch (humidity + temperature)
+#define CC2_DATA_LENGTH 4
+// Status bits are the upper two bits of the first data byte
+#define CC2_STATUS_SHIFT 6
+// Re-fetch delay and maximum number of re-fetches when the data is stale
+#define CC2_STALE_RETRY_MS 5
+#define CC2_STALE_MAX_RETRIES 3
 
 /**
  * @brief ChipCap2 device struct
@@ -43,19 +48,11 @@ typedef struct {
 typedef i2c_chipcap2_t *i2c_chipcap2_handle_t;
 
 /**
- * @brief ChipCap2 struct for holding measurement data
- */
-typedef struct {
-    i2c_chipcap2_mixed_number_t humidity;
-    i2c_chipcap2_mixed_number_t temperature;
-} i2c_chipcap2_data_t;
-
-/**
- * @brief ChipCap2 sensor initialization
+ * @brief ChipCap2 sensor initialization, EVENT_SENSOR_DATA_READY is posted
+ * to the event bus when an asynchronous measurement is ready to be fetched
  *
  * @param bus_handle I2C master bus handle
  * @param i2c_device I2C device configuration
- * @param chipcap2_handle ChipCap2 device handle
  * @return esp_err_t
  */
 esp_err_t i2c_chipcap2_init(i2c_master_bus_handle_t bus_handle,
@@ -80,13 +77,48 @@ esp_err_t i2c_chipcap2_measurement_request(void);
 esp_err_t i2c_chipcap2_data_fetch(uint8_t *buffer);
 
 /**
- * @brief Read measurement data
+ * @brief Read measurement data (blocks for the conversion time), stale data
+ * is re-fetched up to CC2_STALE_MAX_RETRIES times
  *
  * @param out_data Pointer to ChipCap2 measurement data
- * @return esp_err_t
+ * @return esp_err_t ESP_ERR_INVALID_RESPONSE if the data is not valid, the
+ * status is available in out_data->status
  */
 esp_err_t i2c_chipcap2_read(i2c_chipcap2_data_t *out_data);
 
+/**
+ * @brief Start an asynchronous measurement, EVENT_SENSOR_DATA_READY is posted
+ * to the event bus when the conversion time elapsed and the data can be
+ * retrieved with i2c_chipcap2_measurement_fetch
+ *
+ * @return esp_err_t ESP_ERR_INVALID_STATE if a measurement is already in
+ * progress
+ */
+esp_err_t i2c_chipcap2_measurement_start(void);
+
+/**
+ * @brief Check if an asynchronous measurement is in progress (started but not
+ * fetched yet)
+ *
+ * @return true if a measurement is in progress
+ */
+bool i2c_chipcap2_measurement_busy(void);
+
+/**
+ * @brief Fetch the result of an asynchronous measurement, call after
+ * EVENT_SENSOR_DATA_READY was received
+ *
+ * If the sensor reports stale data, a re-fetch is scheduled and
+ * ESP_ERR_NOT_FINISHED is returned, EVENT_SENSOR_DATA_READY is then posted
+ * again and this function has to be called again.
+ *
+ * @param out_data Pointer to ChipCap2 measurement data
+ * @return esp_err_t ESP_OK on valid data, ESP_ERR_NOT_FINISHED if a re-fetch
+ * is pending, ESP_ERR_INVALID_RESPONSE if the data is not valid (the status
+ * is available in out_data->status)
+ */
+esp_err_t i2c_chipcap2_measurement_fetch(i2c_chipcap2_data_t *out_data);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,91 @@
+/**
+ * @file i2c_chipcap2_data.h
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief ChipCap2 measurement data and the fixed-point conversion of the raw
+ * 14-bit values, without ESP-IDF dependencies so they can also be built on a
+ * host
+ * @version 0.1
+ * @date 2025-05-30
+ *
+ */
+
+#ifndef I2C_CHIPCAP2_DATA_H
+#define I2C_CHIPCAP2_DATA_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief ChipCap2 status bits of a Data-Fetch
+ */
+typedef enum {
+    // Valid data that has not been fetched since the last measurement
+    I2C_CHIPCAP2_STATUS_VALID = 0b00,
+    // Data was already fetched or the measurement is not finished yet
+    I2C_CHIPCAP2_STATUS_STALE = 0b01,
+    // The sensor is in command mode
+    I2C_CHIPCAP2_STATUS_COMMAND_MODE = 0b10,
+    I2C_CHIPCAP2_STATUS_RESERVED = 0b11
+} i2c_chipcap2_status_t;
+
+/**
+ * @brief Base struct for storing humidity/temperature data
+ */
+typedef struct {
+    float value;
+    // Value in hundredths (centi-%RH / centi-°C), integer conversion
+    int16_t centi;
+    unsigned char high_byte;
+    unsigned char low_byte;
+} i2c_chipcap2_mixed_number_t;
+
+/**
+ * @brief ChipCap2 struct for holding measurement data
+ */
+typedef struct {
+    i2c_chipcap2_mixed_number_t humidity;
+    i2c_chipcap2_mixed_number_t temperature;
+    // Status bits of the Data-Fetch the values were read from
+    i2c_chipcap2_status_t status;
+    // Number of re-fetches needed because the data was stale
+    uint8_t stale_retries;
+} i2c_chipcap2_data_t;
+
+// Fixed-point conversion: value = raw * span / 2^14 + offset, in hundredths
+#define CC2_RAW_RESOLUTION_BITS 14
+#define CC2_HUMIDITY_CENTI_SPAN 10000
+#define CC2_HUMIDITY_CENTI_OFFSET 0
+#define CC2_TEMPERATURE_CENTI_SPAN 16500
+#define CC2_TEMPERATURE_CENTI_OFFSET -4000
+
+/**
+ * @brief Convert a 14-bit raw value to hundredths with integer math only,
+ * rounded half away from zero (same result as rounding the float formula to
+ * 2 decimals)
+ *
+ * @param raw Raw 14-bit value
+ * @param span Span of the range in hundredths
+ * @param offset Value of raw 0 in hundredths
+ * @return int16_t The value in hundredths
+ */
+static inline int16_t i2c_chipcap2_raw_to_centi(uint16_t raw, int32_t span,
+                                                int32_t offset) {
+    // Scaled by 2^14, at most 16383 * 16500 so it fits into 32 bits
+    const int32_t half = 1L << (CC2_RAW_RESOLUTION_BITS - 1);
+    int32_t scaled =
+        (int32_t)raw * span + (offset * (1L << CC2_RAW_RESOLUTION_BITS));
+
+    if (scaled >= 0) {
+        return (int16_t)((scaled + half) >> CC2_RAW_RESOLUTION_BITS);
+    }
+    return (int16_t)-((-scaled + half) >> CC2_RAW_RESOLUTION_BITS);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // I2C_CHIPCAP2_DATA_H
@@ -12,13 +12,16 @@
 
 #include "driver/i2c_master.h"
 #include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /**
- * @brief I2C initialization routine
+ * @brief I2C initialization routine, the sensor events are posted to the
+ * event bus
  *
  */
 void i2c_controller_init(void);
@@ -0,0 +1,37 @@
+/**
+ * @file FreeRTOS.h
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief The part of the FreeRTOS API used by the latency trace, the host
+ * test implements it single threaded (not part of the firmware build)
+ * @version 0.1
+ * @date 2025-05-30
+ *
+ */
+
+#ifndef LATENCY_TRACE_HOST_FREERTOS_H
+#define LATENCY_TRACE_HOST_FREERTOS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef long BaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+
+typedef struct host_mutex *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LATENCY_TRACE_HOST_FREERTOS_H
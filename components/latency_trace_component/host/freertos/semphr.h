@@ -0,0 +1,11 @@
+/**
+ * @file semphr.h
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Host stand-in for freertos/semphr.h, everything is declared in
+ * FreeRTOS.h (not part of the firmware build)
+ * @version 0.1
+ * @date 2025-05-30
+ *
+ */
+
+#include "freertos/FreeRTOS.h"
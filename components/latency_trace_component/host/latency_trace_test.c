@@ -0,0 +1,333 @@
+/**
+ * @file latency_trace_test.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Tests the latency histograms on a host: bucket bounds, p50/p99
+ * against the percentiles of the sorted samples, the PUBACK matching and the
+ * JSON output (not part of the firmware build)
+ * @version 0.1
+ * @date 2025-05-30
+ *
+ * Build (latency_trace.c is included to reach its bucket helpers, FreeRTOS
+ * and esp_timer are emulated by the test, only esp_err.h comes from ESP-IDF):
+ *   gcc -O2 -I$IDF_PATH/components/esp_common/include
+ *       -Icomponents/latency_trace_component/host
+ *       -Icomponents/latency_trace_component
+ *       components/latency_trace_component/host/latency_trace_test.c
+ *       -o latency_trace_test
+ *
+ * Usage:
+ *   latency_trace_test [SAMPLES]
+ *
+ * SAMPLES (default 10007) is the number of samples of every percentile
+ * distribution. Exits with 1 if any check fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "latency_trace.c"
+
+#define CHECK(condition)                                                   \
+    do {                                                                   \
+        if (!(condition)) {                                                \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition);   \
+            failures++;                                                    \
+        }                                                                  \
+    } while (0)
+
+#define SWEEP_LIMIT (1u << 20)
+#define RANDOM_VALUES 1000000
+#define SMALL_COUNTS 3
+#define JSON_BUFFER_SIZE 2048
+
+struct host_mutex {
+    int locked;
+};
+
+static unsigned int failures = 0;
+static int64_t host_time_us = 0;
+static struct host_mutex host_mutex;
+
+int64_t esp_timer_get_time(void) { return host_time_us; }
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) { return &host_mutex; }
+
+// Single threaded, the mutex only checks that it is used in pairs
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t timeout) {
+    (void)timeout;
+    CHECK(!semaphore->locked);
+    semaphore->locked = 1;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    CHECK(semaphore->locked);
+    semaphore->locked = 0;
+    return pdTRUE;
+}
+
+/**
+ * @brief Helper for a random 64-bit value (xorshift64)
+ *
+ */
+static uint64_t random_next(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static int compare_latency(const void *a, const void *b) {
+    uint32_t left = *(const uint32_t *)a;
+    uint32_t right = *(const uint32_t *)b;
+    return (left > right) - (left < right);
+}
+
+/**
+ * @brief Helper that checks that a value lies within the bounds of its
+ * bucket, returns 1 if it doesn't
+ *
+ */
+static unsigned int check_value_bucket(uint32_t value) {
+    size_t index = latency_trace_bucket(value);
+
+    if ((index >= LATENCY_TRACE_BUCKETS) ||
+        (latency_trace_bucket_lower(index) > value) ||
+        (latency_trace_bucket_upper(index) < value)) {
+        printf("FAIL value %lu: bucket %zu\n", (unsigned long)value, index);
+        return 1;
+    }
+    return 0;
+}
+
+static void test_bucket_bounds(void) {
+    unsigned int bad = 0;
+    uint64_t state = 88172645463325252ULL;
+
+    // The buckets tile 0..UINT32_MAX without gaps or overlaps, every bucket
+    // but the last is at most 1/SUB_BUCKETS of its lower bound wide
+    CHECK(latency_trace_bucket_lower(0) == 0);
+    CHECK(latency_trace_bucket_upper(LATENCY_TRACE_BUCKETS - 1) == UINT32_MAX);
+    for (size_t i = 0; i < LATENCY_TRACE_BUCKETS; i++) {
+        uint32_t lower = latency_trace_bucket_lower(i);
+        uint32_t upper = latency_trace_bucket_upper(i);
+
+        CHECK(lower <= upper);
+        CHECK(latency_trace_bucket(lower) == i);
+        CHECK(latency_trace_bucket(upper) == i);
+        if (i + 1 < LATENCY_TRACE_BUCKETS) {
+            CHECK(latency_trace_bucket_lower(i + 1) == upper + 1);
+            CHECK((lower < SUB_BUCKETS) ? (upper == lower)
+                                        : (upper - lower + 1 <=
+                                           lower / SUB_BUCKETS));
+        }
+    }
+    // The last bucket holds everything from 2^24 us on
+    CHECK(latency_trace_bucket_lower(LATENCY_TRACE_BUCKETS - 1) < (1u << 24));
+    CHECK(latency_trace_bucket(1u << 24) == LATENCY_TRACE_BUCKETS - 1);
+
+    for (uint32_t value = 0; value < SWEEP_LIMIT; value++) {
+        bad += check_value_bucket(value);
+    }
+    for (long i = 0; i < RANDOM_VALUES; i++) {
+        bad += check_value_bucket((uint32_t)random_next(&state));
+    }
+    bad += check_value_bucket(UINT32_MAX);
+    failures += bad;
+}
+
+/**
+ * @brief Helper that records samples into a stage and checks its summary
+ * against the sorted samples, returns the largest relative error of the
+ * percentiles below the last bucket
+ *
+ */
+static double check_percentiles(const char *name, uint32_t *samples,
+                                size_t count) {
+    static const uint32_t percents[] = {50, 99};
+    latency_trace_summary_t summary;
+    double worst = 0;
+
+    latency_trace_reset();
+    for (size_t i = 0; i < count; i++) {
+        latency_trace_record(LATENCY_TRACE_STAGE_QUEUE, samples[i]);
+    }
+    latency_trace_get_summary(LATENCY_TRACE_STAGE_QUEUE, &summary);
+    qsort(samples, count, sizeof(*samples), compare_latency);
+
+    CHECK(summary.count == count);
+    CHECK(summary.min == samples[0]);
+    CHECK(summary.max == samples[count - 1]);
+    for (size_t i = 0; i < sizeof(percents) / sizeof(percents[0]); i++) {
+        // Nearest rank percentile of the samples
+        size_t rank = (count * percents[i] + 99) / 100;
+        uint32_t exact = samples[(rank > 0) ? rank - 1 : 0];
+        uint32_t reported = (percents[i] == 50) ? summary.p50 : summary.p99;
+        uint32_t expected =
+            latency_trace_bucket_upper(latency_trace_bucket(exact));
+
+        // The upper bound of the exact percentile's bucket, clamped
+        if (expected > summary.max) {
+            expected = summary.max;
+        }
+        if (reported != expected) {
+            printf("FAIL %s p%lu: %lu, exact %lu, expected %lu\n", name,
+                   (unsigned long)percents[i], (unsigned long)reported,
+                   (unsigned long)exact, (unsigned long)expected);
+            failures++;
+        }
+        // The last bucket is open ended, it has no error bound
+        if ((exact > 0) &&
+            (latency_trace_bucket(exact) < LATENCY_TRACE_BUCKETS - 1)) {
+            double error = ((double)reported - exact) / exact;
+            worst = (error > worst) ? error : worst;
+        }
+    }
+    return worst;
+}
+
+static void test_percentiles(size_t count) {
+    // Room for the small count cases below
+    size_t capacity = (count < SMALL_COUNTS) ? SMALL_COUNTS : count;
+    uint32_t *samples = malloc(capacity * sizeof(*samples));
+    uint64_t state = 2463534242ULL;
+    double worst = 0;
+    double error;
+
+    if (samples == NULL) {
+        printf("FAIL: out of memory\n");
+        failures++;
+        return;
+    }
+
+    // Uniform queue waits up to 1 ms
+    for (size_t i = 0; i < count; i++) {
+        samples[i] = (uint32_t)(random_next(&state) % 1000);
+    }
+    error = check_percentiles("uniform", samples, count);
+    worst = (error > worst) ? error : worst;
+
+    // Log-uniform from 1 us to 33 s, beyond the last bucket
+    for (size_t i = 0; i < count; i++) {
+        uint32_t exponent = (uint32_t)(random_next(&state) % 25);
+        samples[i] = (uint32_t)(random_next(&state) % (1u << exponent)) +
+                     (1u << exponent);
+    }
+    error = check_percentiles("log-uniform", samples, count);
+    worst = (error > worst) ? error : worst;
+
+    // Fast path with a slow tail: 98% around 200 us, 2% around 80 ms
+    for (size_t i = 0; i < count; i++) {
+        uint64_t random = random_next(&state);
+        samples[i] = ((random % 100) < 98)
+                         ? 150 + (uint32_t)((random >> 8) % 100)
+                         : 60000 + (uint32_t)((random >> 8) % 40000);
+    }
+    error = check_percentiles("bimodal", samples, count);
+    worst = (error > worst) ? error : worst;
+
+    // Small counts, where the rank rounding matters
+    for (size_t n = 1; n <= SMALL_COUNTS; n++) {
+        for (size_t i = 0; i < n; i++) {
+            samples[i] = (uint32_t)(1000 * (n - i));
+        }
+        check_percentiles("small", samples, n);
+    }
+
+    samples[0] = 4242;
+    samples[1] = 4242;
+    check_percentiles("constant", samples, 2);
+
+    printf("percentiles of %zu samples: largest error %.1f%%\n", count,
+           worst * 100);
+    CHECK(worst <= 1.0 / SUB_BUCKETS);
+    free(samples);
+}
+
+static void test_clamping(void) {
+    latency_trace_summary_t summary;
+
+    latency_trace_reset();
+    latency_trace_record(LATENCY_TRACE_STAGE_ENCODE, -5);
+    latency_trace_record(LATENCY_TRACE_STAGE_ENCODE, 1LL << 40);
+    latency_trace_record(LATENCY_TRACE_STAGE_COUNT, 1);
+    latency_trace_get_summary(LATENCY_TRACE_STAGE_ENCODE, &summary);
+    CHECK(summary.count == 2);
+    CHECK(summary.min == 0);
+    CHECK(summary.max == UINT32_MAX);
+
+    latency_trace_get_summary(LATENCY_TRACE_STAGE_MEASURE, &summary);
+    CHECK((summary.count == 0) && (summary.p50 == 0) && (summary.p99 == 0));
+}
+
+static void test_acks(void) {
+    latency_trace_summary_t summary;
+
+    latency_trace_reset();
+
+    // PUBACK after the publish was registered
+    host_time_us = 1000;
+    latency_trace_expect_ack(7, 900, 100);
+    host_time_us = 1500;
+    latency_trace_ack(7);
+    latency_trace_get_summary(LATENCY_TRACE_STAGE_ACK, &summary);
+    CHECK((summary.count == 1) && (summary.min == 600));
+    latency_trace_get_summary(LATENCY_TRACE_STAGE_TOTAL, &summary);
+    CHECK((summary.count == 1) && (summary.max == 1400));
+
+    // PUBACK that wins the race against the publishing task
+    host_time_us = 2000;
+    latency_trace_ack(8);
+    latency_trace_expect_ack(8, 1990, 1000);
+    latency_trace_get_summary(LATENCY_TRACE_STAGE_ACK, &summary);
+    CHECK((summary.count == 2) && (summary.min == 10));
+
+    // A PUBACK of another message doesn't match
+    latency_trace_expect_ack(9, 1, 1);
+    latency_trace_ack(99);
+    latency_trace_expect_ack(10, 1, 1);
+    CHECK(latency_trace_unacknowledged() == 1);
+    latency_trace_get_summary(LATENCY_TRACE_STAGE_ACK, &summary);
+    CHECK(summary.count == 2);
+}
+
+static void test_json(void) {
+    char buffer[JSON_BUFFER_SIZE];
+
+    latency_trace_reset();
+    latency_trace_record(LATENCY_TRACE_STAGE_QUEUE, 100);
+    latency_trace_record(LATENCY_TRACE_STAGE_QUEUE, 100);
+    latency_trace_record(LATENCY_TRACE_STAGE_QUEUE, 130);
+
+    CHECK(latency_trace_format_json(buffer, sizeof(buffer)) == ESP_OK);
+    CHECK(strstr(buffer, "\"queue\":{\"n\":3,\"min\":100,\"max\":130,"
+                         "\"p50\":111,\"p99\":130,"
+                         "\"buckets\":[[96,2],[128,1]]}") != NULL);
+    CHECK(strstr(buffer, "\"ack\":{\"n\":0,") != NULL);
+    CHECK(strstr(buffer, "\"unacked\":1}") != NULL);
+    CHECK(latency_trace_format_json(buffer, 50) == ESP_ERR_INVALID_SIZE);
+    CHECK(latency_trace_format_json(buffer, 0) == ESP_ERR_INVALID_ARG);
+}
+
+int main(int argc, char **argv) {
+    long count = (argc > 1) ? atol(argv[1]) : 10007;
+
+    if (count <= 0) {
+        fprintf(stderr, "usage: %s [SAMPLES]\n", argv[0]);
+        return 2;
+    }
+    if (latency_trace_init() != ESP_OK) {
+        printf("FAIL: latency_trace_init\n");
+        return 1;
+    }
+
+    test_bucket_bounds();
+    test_percentiles((size_t)count);
+    test_clamping();
+    test_acks();
+    test_json();
+
+    printf("%s: %u failures\n", (failures == 0) ? "OK" : "FAIL", failures);
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,373 @@
+/**
+ * @file latency_trace.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Latency histograms of the stages of the MQTT command to publish
+ * round trip
+ * @version 0.1
+ * @date 2025-05-23
+ *
+ */
+
+#include "latency_trace.h"
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#define SUB_BUCKETS (1u << LATENCY_TRACE_SUB_BUCKET_BITS)
+
+/**
+ * @brief Histogram of a stage, updated lock free by the recording tasks
+ */
+typedef struct {
+    atomic_uint_fast32_t min;
+    atomic_uint_fast32_t max;
+    atomic_uint_fast32_t buckets[LATENCY_TRACE_BUCKETS];
+} latency_trace_histogram_t;
+
+/**
+ * @brief The traced publish waiting for its PUBACK
+ */
+typedef struct {
+    bool active;
+    int msg_id;
+    int64_t publish_us;
+    int64_t origin_us;
+} latency_trace_pending_ack_t;
+
+static const char *stage_names[LATENCY_TRACE_STAGE_COUNT] = {
+    "receive", "queue", "measure", "encode", "publish", "ack", "total",
+};
+static latency_trace_histogram_t histograms[LATENCY_TRACE_STAGE_COUNT];
+// Guards the pending and the early acknowledgement
+static SemaphoreHandle_t ack_mutex = NULL;
+static latency_trace_pending_ack_t pending_ack = {0};
+// A PUBACK that arrived before its publish was registered
+static bool early_ack_valid = false;
+static int early_ack_msg_id = 0;
+static int64_t early_ack_us = 0;
+static uint32_t unacknowledged = 0;
+
+/**
+ * @brief Helper for the bucket of a duration, values below SUB_BUCKETS get
+ * a bucket each, above that every power of two is split into SUB_BUCKETS
+ * equally wide buckets
+ *
+ */
+static size_t latency_trace_bucket(uint32_t value) {
+    if (value < SUB_BUCKETS) {
+        return value;
+    }
+
+    uint32_t exponent = 31 - __builtin_clz(value);
+    size_t index =
+        (exponent - LATENCY_TRACE_SUB_BUCKET_BITS + 1) * SUB_BUCKETS +
+        ((value >> (exponent - LATENCY_TRACE_SUB_BUCKET_BITS)) &
+         (SUB_BUCKETS - 1));
+    return (index < LATENCY_TRACE_BUCKETS) ? index : LATENCY_TRACE_BUCKETS - 1;
+}
+
+/**
+ * @brief Helper for the lowest duration of a bucket
+ *
+ */
+static uint32_t latency_trace_bucket_lower(size_t index) {
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+
+    uint32_t exponent =
+        index / SUB_BUCKETS + LATENCY_TRACE_SUB_BUCKET_BITS - 1;
+    return (SUB_BUCKETS + (index % SUB_BUCKETS))
+           << (exponent - LATENCY_TRACE_SUB_BUCKET_BITS);
+}
+
+/**
+ * @brief Helper for the highest duration of a bucket
+ *
+ */
+static uint32_t latency_trace_bucket_upper(size_t index) {
+    if (index == (LATENCY_TRACE_BUCKETS - 1)) {
+        return UINT32_MAX;
+    }
+    return latency_trace_bucket_lower(index + 1) - 1;
+}
+
+/**
+ * @brief Helper for a percentile of a histogram, the upper bound of the
+ * bucket holding the sample of that rank
+ *
+ */
+static uint32_t latency_trace_percentile(const uint32_t *buckets,
+                                         uint32_t count, uint32_t percent) {
+    uint32_t rank = (uint32_t)(((uint64_t)count * percent + 99) / 100);
+    uint32_t seen = 0;
+
+    for (size_t i = 0; i < LATENCY_TRACE_BUCKETS; i++) {
+        seen += buckets[i];
+        if ((seen >= rank) && (seen > 0)) {
+            return latency_trace_bucket_upper(i);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Helper for taking a snapshot of a histogram and its summary
+ *
+ */
+static void latency_trace_snapshot(latency_trace_stage_t stage,
+                                   uint32_t *buckets,
+                                   latency_trace_summary_t *summary) {
+    latency_trace_histogram_t *histogram = &histograms[stage];
+
+    // The count is the sum of the copied buckets, so the percentiles stay
+    // consistent with it while spans are being recorded
+    summary->count = 0;
+    for (size_t i = 0; i < LATENCY_TRACE_BUCKETS; i++) {
+        buckets[i] = atomic_load_explicit(&histogram->buckets[i],
+                                          memory_order_relaxed);
+        summary->count += buckets[i];
+    }
+    if (summary->count == 0) {
+        *summary = (latency_trace_summary_t){0};
+        return;
+    }
+
+    summary->min = atomic_load_explicit(&histogram->min, memory_order_relaxed);
+    summary->max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+    summary->p50 = latency_trace_percentile(buckets, summary->count, 50);
+    summary->p99 = latency_trace_percentile(buckets, summary->count, 99);
+    // The exact extremes are better bounds than the bucket edges
+    if (summary->p50 > summary->max) {
+        summary->p50 = summary->max;
+    }
+    if (summary->p99 > summary->max) {
+        summary->p99 = summary->max;
+    }
+    if (summary->p50 < summary->min) {
+        summary->p50 = summary->min;
+    }
+    if (summary->p99 < summary->min) {
+        summary->p99 = summary->min;
+    }
+}
+
+/**
+ * @brief Helper for appending to the JSON output, returns false when the
+ * buffer is full
+ *
+ */
+static bool latency_trace_append(char *buffer, size_t buffer_size,
+                                 size_t *length, const char *format, ...) {
+    va_list args;
+
+    va_start(args, format);
+    int written = vsnprintf(buffer + *length, buffer_size - *length, format,
+                            args);
+    va_end(args);
+    if ((written < 0) || ((size_t)written >= (buffer_size - *length))) {
+        return false;
+    }
+    *length += (size_t)written;
+    return true;
+}
+
+esp_err_t latency_trace_init(void) {
+    if (ack_mutex == NULL) {
+        ack_mutex = xSemaphoreCreateMutex();
+        if (ack_mutex == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    latency_trace_reset();
+    return ESP_OK;
+}
+
+void latency_trace_record(latency_trace_stage_t stage, int64_t duration_us) {
+    if (stage >= LATENCY_TRACE_STAGE_COUNT) {
+        return;
+    }
+
+    uint32_t value = (duration_us < 0)            ? 0
+                     : (duration_us > UINT32_MAX) ? UINT32_MAX
+                                                  : (uint32_t)duration_us;
+    latency_trace_histogram_t *histogram = &histograms[stage];
+
+    atomic_fetch_add_explicit(&histogram->buckets[latency_trace_bucket(value)],
+                              1, memory_order_relaxed);
+
+    uint_fast32_t min =
+        atomic_load_explicit(&histogram->min, memory_order_relaxed);
+    while ((value < min) &&
+           !atomic_compare_exchange_weak(&histogram->min, &min, value)) {
+    }
+    uint_fast32_t max =
+        atomic_load_explicit(&histogram->max, memory_order_relaxed);
+    while ((value > max) &&
+           !atomic_compare_exchange_weak(&histogram->max, &max, value)) {
+    }
+}
+
+void latency_trace_expect_ack(int msg_id, int64_t publish_us,
+                              int64_t origin_us) {
+    if (ack_mutex == NULL) {
+        return;
+    }
+
+    int64_t ack_us = 0;
+    bool acked = false;
+
+    xSemaphoreTake(ack_mutex, portMAX_DELAY);
+    if (early_ack_valid && (early_ack_msg_id == msg_id)) {
+        ack_us = early_ack_us;
+        acked = true;
+    } else {
+        if (pending_ack.active) {
+            unacknowledged++;
+        }
+        pending_ack = (latency_trace_pending_ack_t){
+            .active = true,
+            .msg_id = msg_id,
+            .publish_us = publish_us,
+            .origin_us = origin_us,
+        };
+    }
+    early_ack_valid = false;
+    xSemaphoreGive(ack_mutex);
+
+    if (acked) {
+        latency_trace_record(LATENCY_TRACE_STAGE_ACK, ack_us - publish_us);
+        latency_trace_record(LATENCY_TRACE_STAGE_TOTAL, ack_us - origin_us);
+    }
+}
+
+void latency_trace_ack(int msg_id) {
+    if (ack_mutex == NULL) {
+        return;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    latency_trace_pending_ack_t acked = {0};
+
+    xSemaphoreTake(ack_mutex, portMAX_DELAY);
+    if (pending_ack.active && (pending_ack.msg_id == msg_id)) {
+        acked = pending_ack;
+        pending_ack.active = false;
+    } else {
+        // Possibly the traced publish, its task hasn't registered it yet
+        early_ack_valid = true;
+        early_ack_msg_id = msg_id;
+        early_ack_us = now_us;
+    }
+    xSemaphoreGive(ack_mutex);
+
+    if (acked.active) {
+        latency_trace_record(LATENCY_TRACE_STAGE_ACK,
+                             now_us - acked.publish_us);
+        latency_trace_record(LATENCY_TRACE_STAGE_TOTAL,
+                             now_us - acked.origin_us);
+    }
+}
+
+void latency_trace_get_summary(latency_trace_stage_t stage,
+                               latency_trace_summary_t *summary) {
+    uint32_t buckets[LATENCY_TRACE_BUCKETS];
+
+    if (stage >= LATENCY_TRACE_STAGE_COUNT) {
+        *summary = (latency_trace_summary_t){0};
+        return;
+    }
+    latency_trace_snapshot(stage, buckets, summary);
+}
+
+const char *latency_trace_stage_name(latency_trace_stage_t stage) {
+    if (stage >= LATENCY_TRACE_STAGE_COUNT) {
+        return "unknown";
+    }
+    return stage_names[stage];
+}
+
+uint32_t latency_trace_unacknowledged(void) {
+    if (ack_mutex == NULL) {
+        return 0;
+    }
+
+    xSemaphoreTake(ack_mutex, portMAX_DELAY);
+    uint32_t count = unacknowledged;
+    xSemaphoreGive(ack_mutex);
+    return count;
+}
+
+esp_err_t latency_trace_format_json(char *buffer, size_t buffer_size) {
+    uint32_t buckets[LATENCY_TRACE_BUCKETS];
+    latency_trace_summary_t summary;
+    size_t length = 0;
+
+    if ((buffer == NULL) || (buffer_size == 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    buffer[0] = '\0';
+
+    if (!latency_trace_append(buffer, buffer_size, &length, "{\"latency\":{")) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    for (size_t stage = 0; stage < LATENCY_TRACE_STAGE_COUNT; stage++) {
+        latency_trace_snapshot(stage, buckets, &summary);
+        if (!latency_trace_append(
+                buffer, buffer_size, &length,
+                "%s\"%s\":{\"n\":%lu,\"min\":%lu,\"max\":%lu,\"p50\":%lu,"
+                "\"p99\":%lu,\"buckets\":[",
+                (stage > 0) ? "," : "", stage_names[stage],
+                (unsigned long)summary.count, (unsigned long)summary.min,
+                (unsigned long)summary.max, (unsigned long)summary.p50,
+                (unsigned long)summary.p99)) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        bool first = true;
+        for (size_t i = 0; i < LATENCY_TRACE_BUCKETS; i++) {
+            if (buckets[i] == 0) {
+                continue;
+            }
+            if (!latency_trace_append(
+                    buffer, buffer_size, &length, "%s[%lu,%lu]",
+                    first ? "" : ",",
+                    (unsigned long)latency_trace_bucket_lower(i),
+                    (unsigned long)buckets[i])) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            first = false;
+        }
+        if (!latency_trace_append(buffer, buffer_size, &length, "]}")) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+    }
+    if (!latency_trace_append(buffer, buffer_size, &length,
+                              "},\"unacked\":%lu}",
+                              (unsigned long)latency_trace_unacknowledged())) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    return ESP_OK;
+}
+
+void latency_trace_reset(void) {
+    for (size_t stage = 0; stage < LATENCY_TRACE_STAGE_COUNT; stage++) {
+        latency_trace_histogram_t *histogram = &histograms[stage];
+        for (size_t i = 0; i < LATENCY_TRACE_BUCKETS; i++) {
+            atomic_store_explicit(&histogram->buckets[i], 0,
+                                  memory_order_relaxed);
+        }
+        atomic_store_explicit(&histogram->min, UINT32_MAX,
+                              memory_order_relaxed);
+        atomic_store_explicit(&histogram->max, 0, memory_order_relaxed);
+    }
+}
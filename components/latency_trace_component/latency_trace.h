@@ -0,0 +1,154 @@
+/**
+ * @file latency_trace.h
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Latency histograms of the stages of the MQTT command to publish
+ * round trip
+ * @version 0.1
+ * @date 2025-05-23
+ *
+ */
+
+#ifndef LATENCY_TRACE_H
+#define LATENCY_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Sub-buckets per power of two, the bucket width is 1/4 of an octave
+ * (at most 25% above the bucket's lower bound)
+ */
+#define LATENCY_TRACE_SUB_BUCKET_BITS 2
+
+/**
+ * @brief Number of histogram buckets, the last one also holds everything
+ * above 2^24 us (~16.8 s)
+ */
+#define LATENCY_TRACE_BUCKETS 92
+
+/**
+ * @brief Stages of the round trip, each one is a span between two
+ * consecutive timestamps
+ */
+typedef enum {
+    // MQTT message received -> command event posted
+    LATENCY_TRACE_STAGE_RECEIVE = 0,
+    // Event posted -> received by the main loop
+    LATENCY_TRACE_STAGE_QUEUE,
+    // Received by the main loop -> ChipCap2 sample fetched over I2C
+    LATENCY_TRACE_STAGE_MEASURE,
+    // JSON encoding of the sample
+    LATENCY_TRACE_STAGE_ENCODE,
+    // Publish handed to the MQTT client
+    LATENCY_TRACE_STAGE_PUBLISH,
+    // Publish handed to the client -> PUBACK received
+    LATENCY_TRACE_STAGE_ACK,
+    // MQTT message received -> PUBACK received
+    LATENCY_TRACE_STAGE_TOTAL,
+    LATENCY_TRACE_STAGE_COUNT,
+} latency_trace_stage_t;
+
+/**
+ * @brief Summary of a stage histogram, all times in microseconds
+ */
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    // Upper bounds of the buckets holding the percentiles (clamped to the
+    // min/max)
+    uint32_t p50;
+    uint32_t p99;
+} latency_trace_summary_t;
+
+/**
+ * @brief Initialize the trace, must be called before the first publish is
+ * traced
+ *
+ * @return esp_err_t
+ */
+esp_err_t latency_trace_init(void);
+
+/**
+ * @brief Add a span to the histogram of a stage, can be called from any task
+ * (lock free)
+ *
+ * @param stage The stage
+ * @param duration_us Duration of the span, clamped to 0..UINT32_MAX
+ */
+void latency_trace_record(latency_trace_stage_t stage, int64_t duration_us);
+
+/**
+ * @brief Wait for the PUBACK of a traced publish, the ACK and TOTAL spans are
+ * recorded by latency_trace_ack(). A publish that is still waiting for its
+ * PUBACK is replaced (counted as unacknowledged).
+ *
+ * @param msg_id Message id returned by the MQTT client
+ * @param publish_us Time the publish was handed to the client
+ * @param origin_us Time the MQTT command was received
+ */
+void latency_trace_expect_ack(int msg_id, int64_t publish_us,
+                              int64_t origin_us);
+
+/**
+ * @brief Report a PUBACK, called from the MQTT event handler for every
+ * MQTT_EVENT_PUBLISHED (also before latency_trace_expect_ack of the same
+ * message, the PUBACK can win the race against the publishing task)
+ *
+ * @param msg_id Message id of the acknowledged publish
+ */
+void latency_trace_ack(int msg_id);
+
+/**
+ * @brief Get the summary of a stage histogram
+ *
+ * @param stage The stage
+ * @param summary Output summary
+ */
+void latency_trace_get_summary(latency_trace_stage_t stage,
+                               latency_trace_summary_t *summary);
+
+/**
+ * @brief Get the short name of a stage (e.g. "queue")
+ *
+ * @param stage The stage
+ * @return const char*
+ */
+const char *latency_trace_stage_name(latency_trace_stage_t stage);
+
+/**
+ * @brief Number of traced publishes whose PUBACK never arrived
+ *
+ * @return uint32_t
+ */
+uint32_t latency_trace_unacknowledged(void);
+
+/**
+ * @brief Format all histograms as JSON, per stage the summary and the
+ * non-empty buckets as [lower bound in us, count] pairs:
+ * {"latency":{"queue":{"n":3,"min":..,"max":..,"p50":..,"p99":..,
+ * "buckets":[[96,2],[128,1]]},...},"unacked":0}
+ *
+ * @param buffer Output buffer
+ * @param buffer_size Size of the output buffer
+ * @return esp_err_t ESP_ERR_INVALID_SIZE if the buffer is too small
+ */
+esp_err_t latency_trace_format_json(char *buffer, size_t buffer_size);
+
+/**
+ * @brief Clear all histograms
+ *
+ */
+void latency_trace_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LATENCY_TRACE_H
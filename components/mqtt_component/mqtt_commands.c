@@ -0,0 +1,230 @@
+/**
+ * @file mqtt_commands.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief MQTT command dispatch table
+ * @version 0.1
+ * @date 2025-05-19
+ *
+ */
+
+#include "mqtt_commands.h"
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "event_bus.h"
+
+#define TABLE_MASK (MQTT_COMMANDS_TABLE_SIZE - 1)
+// Longest command name with escapes in a JSON payload
+#define ESCAPED_NAME_SIZE 48
+_Static_assert((MQTT_COMMANDS_TABLE_SIZE & TABLE_MASK) == 0,
+               "MQTT_COMMANDS_TABLE_SIZE must be a power of two");
+
+// FNV-1a 32-bit
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+/**
+ * @brief Hash table slot, the key is the (topic, name) pair
+ */
+typedef struct {
+    bool used;
+    uint32_t hash;
+    size_t topic_length;
+    size_t name_length;
+    mqtt_command_t command;
+} mqtt_commands_slot_t;
+
+static const char* TAG = "mqtt-commands";
+static mqtt_commands_slot_t command_table[MQTT_COMMANDS_TABLE_SIZE];
+static size_t command_count = 0;
+// Only the MQTT task dispatches, the tokens don't need to be on its stack
+static cjson_token_t command_tokens[MQTT_COMMANDS_MAX_TOKENS];
+
+/**
+ * @brief Helper for hashing the (topic, name) key, the 0 separator keeps
+ * e.g. ("ab", "c") and ("a", "bc") apart
+ *
+ */
+static uint32_t mqtt_commands_hash(const char* topic, size_t topic_length,
+                                   const char* name, size_t name_length) {
+    uint32_t hash = FNV_OFFSET_BASIS;
+
+    for (size_t i = 0; i < topic_length; i++) {
+        hash = (hash ^ (uint8_t)topic[i]) * FNV_PRIME;
+    }
+    hash = (hash ^ 0u) * FNV_PRIME;
+    for (size_t i = 0; i < name_length; i++) {
+        hash = (hash ^ (uint8_t)name[i]) * FNV_PRIME;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Helper for finding the slot of a key (linear probing), returns the
+ * first free slot of the probe sequence if the key is not in the table
+ *
+ */
+static mqtt_commands_slot_t* mqtt_commands_find(const char* topic,
+                                                size_t topic_length,
+                                                const char* name,
+                                                size_t name_length) {
+    uint32_t hash = mqtt_commands_hash(topic, topic_length, name, name_length);
+
+    for (size_t i = 0; i < MQTT_COMMANDS_TABLE_SIZE; i++) {
+        mqtt_commands_slot_t* slot = &command_table[(hash + i) & TABLE_MASK];
+        if (!slot->used) {
+            return slot;
+        }
+        // The string compares only run on a full hash match
+        if ((slot->hash == hash) && (slot->topic_length == topic_length) &&
+            (slot->name_length == name_length) &&
+            (memcmp(slot->command.name, name, name_length) == 0) &&
+            ((topic_length == 0) ||
+             (memcmp(slot->command.topic, topic, topic_length) == 0))) {
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Helper for looking up a registered command, commands registered for
+ * the topic take precedence over the ones accepted on any topic
+ *
+ */
+static const mqtt_command_t* mqtt_commands_lookup(const char* topic,
+                                                  size_t topic_length,
+                                                  const char* name,
+                                                  size_t name_length) {
+    mqtt_commands_slot_t* slot =
+        mqtt_commands_find(topic, topic_length, name, name_length);
+    if ((slot == NULL) || !slot->used) {
+        slot = mqtt_commands_find(NULL, 0, name, name_length);
+    }
+    if ((slot == NULL) || !slot->used) {
+        return NULL;
+    }
+    return &slot->command;
+}
+
+/**
+ * @brief Helper for running a command and posting its event, the event's
+ * value is the time since the message was received
+ *
+ */
+static esp_err_t mqtt_commands_run(const mqtt_command_t* command,
+                                   const cjson_tokens_t* json, int args,
+                                   int64_t received_us) {
+    esp_err_t result = ESP_OK;
+
+    if (command->handler != NULL) {
+        result = command->handler(json, args, command->context);
+        if (result != ESP_OK) {
+            ESP_LOGW(TAG, "command '%s' failed: %s", command->name,
+                     esp_err_to_name(result));
+            return result;
+        }
+    }
+
+    if (command->event != EVENT_NONE) {
+        result = event_bus_post_value(
+            command->event, (uint32_t)(esp_timer_get_time() - received_us));
+        if (result != ESP_OK) {
+            ESP_LOGW(TAG, "command '%s' event dropped", command->name);
+        }
+    }
+
+    return result;
+}
+
+esp_err_t mqtt_commands_register(const mqtt_command_t* command) {
+    if ((command == NULL) || (command->name == NULL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Keep the load factor at or below 1/2
+    if (command_count >= (MQTT_COMMANDS_TABLE_SIZE / 2)) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    size_t topic_length = (command->topic != NULL) ? strlen(command->topic) : 0;
+    size_t name_length = strlen(command->name);
+    mqtt_commands_slot_t* slot = mqtt_commands_find(
+        command->topic, topic_length, command->name, name_length);
+    if (slot == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (slot->used) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    slot->hash = mqtt_commands_hash(command->topic, topic_length,
+                                    command->name, name_length);
+    slot->topic_length = topic_length;
+    slot->name_length = name_length;
+    slot->command = *command;
+    slot->used = true;
+    command_count++;
+
+    return ESP_OK;
+}
+
+esp_err_t mqtt_commands_dispatch(const char* topic, size_t topic_length,
+                                 const char* data, size_t data_length) {
+    int64_t received_us = esp_timer_get_time();
+    const mqtt_command_t* command = NULL;
+
+    // Plain text command, trailing whitespace (e.g. "\r\n") is ignored
+    if ((data_length == 0) || (data[0] != '{')) {
+        while ((data_length > 0) &&
+               isspace((unsigned char)data[data_length - 1])) {
+            data_length--;
+        }
+        command = mqtt_commands_lookup(topic, topic_length, data, data_length);
+        if (command == NULL) {
+            ESP_LOGD(TAG, "unknown command '%.*s'", (int)data_length, data);
+            return ESP_ERR_NOT_FOUND;
+        }
+        return mqtt_commands_run(command, NULL, CJSON_TOKENS_NONE,
+                                 received_us);
+    }
+
+    // JSON command with arguments, tokenized in place (no allocations)
+    cjson_tokens_t json;
+    esp_err_t result = cjson_tokens_parse(&json, data, data_length,
+                                          command_tokens,
+                                          MQTT_COMMANDS_MAX_TOKENS);
+    if (result != ESP_OK) {
+        ESP_LOGD(TAG, "invalid JSON command: %s", esp_err_to_name(result));
+        return result;
+    }
+
+    int name = cjson_tokens_find(&json, 0, "command");
+    if (cjson_tokens_is(&json, name, CJSON_TOKEN_STRING)) {
+        const cjson_token_t* name_token = &json.tokens[name];
+        char escaped_name[ESCAPED_NAME_SIZE];
+        if (!name_token->escaped) {
+            command = mqtt_commands_lookup(
+                topic, topic_length, data + name_token->start,
+                name_token->end - name_token->start);
+        } else if (cjson_tokens_get_string(&json, name, escaped_name,
+                                           sizeof(escaped_name)) == ESP_OK) {
+            command = mqtt_commands_lookup(topic, topic_length, escaped_name,
+                                           strlen(escaped_name));
+        }
+    }
+    if (command == NULL) {
+        ESP_LOGD(TAG, "unknown JSON command");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    return mqtt_commands_run(command, &json,
+                             cjson_tokens_find(&json, 0, "args"),
+                             received_us);
+}
@@ -0,0 +1,102 @@
+/**
+ * @file mqtt_commands.h
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief MQTT command dispatch table
+ * @version 0.1
+ * @date 2025-05-19
+ *
+ */
+
+#ifndef MQTT_COMMANDS_H
+#define MQTT_COMMANDS_H
+
+#include <stddef.h>
+
+#include "cjson_tokens.h"
+#include "custom_data_types.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Number of hash table slots, at most half of them should be used so
+ * the probe sequences stay short (must be a power of two)
+ */
+#define MQTT_COMMANDS_TABLE_SIZE 32
+
+/**
+ * @brief Most JSON values (including object keys) of a JSON command payload,
+ * larger payloads are rejected
+ */
+#define MQTT_COMMANDS_MAX_TOKENS 32
+
+/**
+ * @brief Command handler, called from the MQTT task
+ *
+ * The JSON payload is tokenized in place, the tokens point into the MQTT
+ * message and are only valid during the call.
+ *
+ * @param json The tokenized JSON command payload, NULL for plain text
+ * commands
+ * @param args Token index of the "args" member, CJSON_TOKENS_NONE for plain
+ * text commands or when there are no arguments
+ * @param context The context pointer of the command
+ * @return esp_err_t The command's event is only posted on ESP_OK
+ */
+typedef esp_err_t (*mqtt_command_handler_t)(const cjson_tokens_t *json,
+                                            int args, void *context);
+
+/**
+ * @brief Command table entry
+ */
+typedef struct {
+    // Topic the command is accepted on, NULL accepts it on any topic
+    const char *topic;
+    // Command name, the whole plain text payload (trailing whitespace is
+    // ignored) or the "command" member of a JSON payload
+    const char *name;
+    // Optional handler, called before the event is posted
+    mqtt_command_handler_t handler;
+    void *context;
+    // Event posted to the event bus, EVENT_NONE posts nothing. The event's
+    // value is the time in microseconds between the message's arrival and
+    // the post (JSON parsing, lookup and handler).
+    event_t event;
+} mqtt_command_t;
+
+/**
+ * @brief Register a command, should be done before mqtt_controller_init so no
+ * message is dispatched while the table is modified
+ *
+ * @param command The command, the strings must stay valid (copied by value)
+ * @return esp_err_t ESP_ERR_INVALID_STATE if the command is already
+ * registered, ESP_ERR_NO_MEM if the table is full
+ */
+esp_err_t mqtt_commands_register(const mqtt_command_t *command);
+
+/**
+ * @brief Look up and run the command of a received message
+ *
+ * Plain text payloads are the command name, JSON payloads have the form
+ * {"command": "<name>", "args": {...}}. JSON payloads are tokenized in place
+ * into a static token array, dispatching never allocates memory. Only call it
+ * from the MQTT task, the token array is not reentrant.
+ *
+ * @param topic Topic of the message (not null terminated)
+ * @param topic_length Length of the topic
+ * @param data Payload of the message (not null terminated)
+ * @param data_length Length of the payload
+ * @return esp_err_t ESP_ERR_NOT_FOUND for unknown commands,
+ * ESP_ERR_INVALID_ARG for invalid JSON, ESP_ERR_NO_MEM for JSON payloads with
+ * more than MQTT_COMMANDS_MAX_TOKENS values
+ */
+esp_err_t mqtt_commands_dispatch(const char *topic, size_t topic_length,
+                                 const char *data, size_t data_length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // MQTT_COMMANDS_H
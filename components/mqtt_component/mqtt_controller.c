@@ -14,17 +14,23 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "cert_store.h"
 #include "custom_data_types.h"
 #include "esp_event.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
+#include "esp_random.h"
 #include "esp_system.h"
 #include "esp_timer.h"
+#include "esp_transport_ssl.h"
+#include "event_bus.h"
+#include "latency_trace.h"
+#include "mqtt_commands.h"
 #include "sdkconfig.h"
 
 // General
 static const char* TAG = "mqtt5";
 static esp_mqtt_client_handle_t mqtt_client;
-static QueueHandle_t* general_event_queue_reference;
 // Certificate file
 extern const uint8_t _binary_cacert_pem_start[];
 extern const uint8_t _binary_cacert_pem_end[];
@@ -40,6 +46,56 @@ esp_mqtt5_disconnect_property_config_t disconnect_property = {
     .disconnect_reason = 0,
 };
 
+// Reconnect manager, the client is created once and reconnected with a
+// jittered exponential backoff
+static esp_timer_handle_t reconnect_timer = NULL;
+static void mqtt_controller_schedule_reconnect(void);
+static uint32_t reconnect_attempt = 0;
+static volatile bool session_connected = false;
+// The next reconnect restarts the client task, which drops the outbox
+static volatile bool reconnect_restart = false;
+// Connect measurement (TCP + TLS handshake + CONNACK)
+static int64_t connect_start_us = 0;
+static size_t connect_free_heap = 0;
+// Client task, captured from its event handler
+static volatile TaskHandle_t client_task = NULL;
+// Backoff ceilings are doubled at most this many times (overflow guard)
+#define RECONNECT_BACKOFF_MAX_SHIFT 16
+
+// Publish properties are built once and reused by every publish, the user
+// property list is only rebuilt after mqtt_controller_invalidate_properties
+static bool publish_property_dirty = true;
+// The statistics and the connect measurement are written from the client
+// task, the reconnect path and the publishing tasks
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static mqtt_controller_stats_t publish_stats = {0};
+
+#if CONFIG_MQTT_TOPIC_ALIAS_ENABLED
+/**
+ * @brief Outgoing topic alias, the alias number is the index + 1
+ */
+typedef struct {
+    // Copy of the topic, the caller's string may not outlive the publish
+    char topic[CONFIG_MQTT_TOPIC_ALIAS_TOPIC_LENGTH + 1];
+    size_t topic_length;
+    // Session generation in which the full topic was sent with the alias
+    uint32_t generation;
+} mqtt_topic_alias_t;
+
+// Topic aliases only live for one network connection, the generation is
+// bumped on every connect so the full topic is sent again first
+static mqtt_topic_alias_t topic_aliases[CONFIG_MQTT_TOPIC_ALIAS_MAXIMUM];
+static size_t topic_alias_count = 0;
+static volatile uint32_t session_generation = 0;
+// Generation in which a publish was sent with only the topic alias
+static volatile uint32_t alias_only_generation = UINT32_MAX;
+// Number of aliases the broker accepted in the current session
+static uint32_t topic_alias_limit_generation = UINT32_MAX;
+static size_t topic_alias_limit = 0;
+// Topic alias property: identifier byte + 2 byte alias
+#define TOPIC_ALIAS_PROPERTY_SIZE 3
+#endif
+
 static esp_mqtt5_publish_property_config_t publish_property = {
     .payload_format_indicator = 1,
     .message_expiry_interval = 1000,
@@ -75,6 +131,73 @@ void print_user_property(mqtt5_user_property_handle_t user_property) {
     }
 }
 
+/**
+ * @brief Helper for the delay of a reconnect attempt, the ceiling doubles
+ * with every attempt and the delay is randomized between half the ceiling and
+ * the ceiling ("equal jitter")
+ *
+ * @param attempt Number of failed attempts since the last connection
+ */
+static uint32_t mqtt_controller_backoff_ms(uint32_t attempt) {
+    uint32_t shift = (attempt < RECONNECT_BACKOFF_MAX_SHIFT)
+                         ? attempt
+                         : RECONNECT_BACKOFF_MAX_SHIFT;
+    uint64_t ceiling = (uint64_t)CONFIG_MQTT_RECONNECT_BACKOFF_MIN_MS << shift;
+    if (ceiling > CONFIG_MQTT_RECONNECT_BACKOFF_MAX_MS) {
+        ceiling = CONFIG_MQTT_RECONNECT_BACKOFF_MAX_MS;
+    }
+
+    uint32_t half = (uint32_t)(ceiling / 2);
+    return half + (esp_random() % ((uint32_t)ceiling - half + 1));
+}
+
+/**
+ * @brief Reconnect timer callback, stopping the client blocks, so the
+ * reconnect is handed to the event bus receiver
+ *
+ */
+static void mqtt_controller_reconnect_timer(void* arg) {
+    if (event_bus_post(EVENT_MQTT_RECONNECT) != ESP_OK) {
+        ESP_LOGE(TAG, "failed to post the reconnect!");
+        mqtt_controller_schedule_reconnect();
+    }
+}
+
+void mqtt_controller_reconnect(void) {
+    portENTER_CRITICAL(&stats_lock);
+    publish_stats.reconnect_attempts++;
+    portEXIT_CRITICAL(&stats_lock);
+
+    if (!reconnect_restart &&
+        (esp_mqtt_client_reconnect(mqtt_client) == ESP_OK)) {
+        return;
+    }
+
+    // The client task is not waiting for a reconnect (or its outbox has to
+    // go), restart it, the handle and its configuration are kept
+    reconnect_restart = false;
+    portENTER_CRITICAL(&stats_lock);
+    publish_stats.client_restarts++;
+    portEXIT_CRITICAL(&stats_lock);
+    esp_mqtt_client_stop(mqtt_client);
+    if (esp_mqtt_client_start(mqtt_client) != ESP_OK) {
+        ESP_LOGE(TAG, "failed to restart the client!");
+        mqtt_controller_schedule_reconnect();
+    }
+}
+
+static void mqtt_controller_schedule_reconnect(void) {
+    uint32_t delay_ms = mqtt_controller_backoff_ms(reconnect_attempt);
+    if (reconnect_attempt < UINT32_MAX) {
+        reconnect_attempt++;
+    }
+
+    ESP_LOGI(TAG, "reconnect attempt %" PRIu32 " in %" PRIu32 " ms",
+             reconnect_attempt, delay_ms);
+    esp_timer_stop(reconnect_timer);
+    esp_timer_start_once(reconnect_timer, (uint64_t)delay_ms * 1000);
+}
+
 /**
  * @brief Event handler registered to receive MQTT events
  *
@@ -92,31 +215,86 @@ static void mqtt5_event_handler(void* handler_args, esp_event_base_t base,
     esp_mqtt_event_handle_t event = event_data;
     esp_mqtt_client_handle_t client = event->client;
 
-    event_t new_event;
-
     ESP_LOGD(TAG, "free heap size is %" PRIu32 ", minimum %" PRIu32,
              esp_get_free_heap_size(), esp_get_minimum_free_heap_size());
     switch ((esp_mqtt_event_id_t)event_id) {
         case MQTT_EVENT_CONNECTED:
-            ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
+            ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED, session present: %d",
+                     event->session_present);
+#if CONFIG_MQTT_TOPIC_ALIAS_ENABLED
+            // New network connection, previously sent aliases are invalid
+            session_generation++;
+#endif
+            session_connected = true;
+            reconnect_attempt = 0;
+            {
+                // Measured outside of the critical section
+                int64_t connected_us = esp_timer_get_time();
+                size_t minimum_free_heap =
+                    heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT);
+                portENTER_CRITICAL(&stats_lock);
+                publish_stats.connects++;
+                publish_stats.last_connect_time_ms =
+                    (uint32_t)((connected_us - connect_start_us) / 1000);
+                publish_stats.last_connect_heap_peak =
+                    (uint32_t)(connect_free_heap - minimum_free_heap);
+                if (event->session_present) {
+                    publish_stats.sessions_resumed++;
+                }
+                portEXIT_CRITICAL(&stats_lock);
+            }
+            heap_caps_monitor_local_minimum_free_size_stop();
 
-            // Send a connection message to the general queue
-            new_event = EVENT_MQTT_CONNECTED;
-            xQueueSend(*general_event_queue_reference, &new_event,
-                       portMAX_DELAY);
+            // Post a connection event (high priority lane)
+            event_bus_post(EVENT_MQTT_CONNECTED);
 
-            // Subscribe to the default topic to receive data
-            esp_mqtt_client_subscribe(client, DEFAULT_TOPIC, 1);
+            // A resumed session keeps its subscriptions
+            if (!event->session_present) {
+                // Subscribe to the default topic to receive data
+                esp_mqtt_client_subscribe(client, DEFAULT_TOPIC, 1);
+            }
             break;
 
         case MQTT_EVENT_DISCONNECTED:
             ESP_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
+            heap_caps_monitor_local_minimum_free_size_stop();
+#if CONFIG_MQTT_TOPIC_ALIAS_ENABLED
+            // Unacknowledged alias-only publishes would be resent from the
+            // outbox on the next connection, where the alias is unknown to
+            // the broker, so the outbox is dropped instead
+            if ((alias_only_generation == session_generation) &&
+                (esp_mqtt_client_get_outbox_size(client) > 0)) {
+                reconnect_restart = true;
+            }
+            // Messages queued while disconnected are sent on the next
+            // connection, they must carry the full topic
+            session_generation++;
+#endif
+            mqtt_controller_schedule_reconnect();
+
+            // Failed reconnect attempts are not reported again
+            if (session_connected) {
+                session_connected = false;
+
+                // Post a disconnection event (high priority lane)
+                event_bus_post(EVENT_MQTT_DISCONNECTED);
+            }
+            break;
 
-            // Send a disconnection message to the general queue
-            new_event = EVENT_MQTT_DISCONNECTED;
-            xQueueSend(*general_event_queue_reference, &new_event,
-                       portMAX_DELAY);
-
+        case MQTT_EVENT_BEFORE_CONNECT:
+            // The heap minimum is tracked from here, so the peak usage of
+            // the handshake can be reported on MQTT_EVENT_CONNECTED
+            {
+                int64_t start_us = esp_timer_get_time();
+                size_t free_heap = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+                portENTER_CRITICAL(&stats_lock);
+                connect_start_us = start_us;
+                connect_free_heap = free_heap;
+                portEXIT_CRITICAL(&stats_lock);
+            }
+            // Every (re)started client task connects first
+            client_task = xTaskGetCurrentTaskHandle();
+            heap_caps_monitor_local_minimum_free_size_start();
             break;
 
         case MQTT_EVENT_SUBSCRIBED:
@@ -138,40 +316,38 @@ static void mqtt5_event_handler(void* handler_args, esp_event_base_t base,
 
         case MQTT_EVENT_PUBLISHED:
             ESP_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+            latency_trace_ack(event->msg_id);
             print_user_property(event->property->user_property);
             break;
 
         case MQTT_EVENT_DATA:
-            ESP_LOGI(TAG, "MQTT_EVENT_DATA");
-            print_user_property(event->property->user_property);
-            ESP_LOGI(TAG, "payload_format_indicator is %d",
-                     event->property->payload_format_indicator);
-            ESP_LOGI(TAG, "response_topic is %.*s",
-                     event->property->response_topic_len,
-                     event->property->response_topic);
-            ESP_LOGI(TAG, "correlation_data is %.*s",
-                     event->property->correlation_data_len,
-                     event->property->correlation_data);
-            ESP_LOGI(TAG, "content_type is %.*s",
-                     event->property->content_type_len,
-                     event->property->content_type);
-            ESP_LOGI(TAG, "TOPIC=%.*s", event->topic_len, event->topic);
-            ESP_LOGI(TAG, "DATA=%.*s", event->data_len, event->data);
-
-            if (event->data_len == 16 &&
-                strncmp(event->data, "read-and-publish", event->data_len) ==
-                    0) {
-                start_time = esp_timer_get_time();
-                event_t new_event = EVENT_MESSAGE_READ_AND_PUBLISH;
-                xQueueSend(*general_event_queue_reference, &new_event,
-                           portMAX_DELAY);
-            } else if (event->data_len == 17 &&
-                       strncmp(event->data, "update-firmware\r\n",
-                               event->data_len) == 0) {
-                event_t new_event = EVENT_MESSAGE_UPDATE_FIRMWARE;
-                xQueueSend(*general_event_queue_reference, &new_event,
-                           portMAX_DELAY);
+            // Message details are only logged at debug level, this is the
+            // command hot path
+            if (esp_log_level_get(TAG) >= ESP_LOG_DEBUG) {
+                ESP_LOGD(TAG, "MQTT_EVENT_DATA");
+                print_user_property(event->property->user_property);
+                ESP_LOGD(TAG, "payload_format_indicator is %d",
+                         event->property->payload_format_indicator);
+                ESP_LOGD(TAG, "response_topic is %.*s",
+                         event->property->response_topic_len,
+                         event->property->response_topic);
+                ESP_LOGD(TAG, "correlation_data is %.*s",
+                         event->property->correlation_data_len,
+                         event->property->correlation_data);
+                ESP_LOGD(TAG, "content_type is %.*s",
+                         event->property->content_type_len,
+                         event->property->content_type);
+                ESP_LOGD(TAG, "TOPIC=%.*s", event->topic_len, event->topic);
+                ESP_LOGD(TAG, "DATA=%.*s", event->data_len, event->data);
+            }
+
+            // Commands are never fragmented, skip multi-part messages
+            if ((event->current_data_offset != 0) ||
+                (event->data_len != event->total_data_len)) {
+                break;
             }
+            mqtt_commands_dispatch(event->topic, event->topic_len, event->data,
+                                   event->data_len);
             break;
 
         case MQTT_EVENT_ERROR:
@@ -202,7 +378,7 @@ static void mqtt5_event_handler(void* handler_args, esp_event_base_t base,
 
 static void mqtt5_app_start() {
     esp_mqtt5_connection_property_config_t connect_property = {
-        .session_expiry_interval = 10,
+        .session_expiry_interval = CONFIG_MQTT_SESSION_EXPIRY_INTERVAL,
         .maximum_packet_size = 1024,
         .receive_maximum = 65535,
         .topic_alias_maximum = 2,
@@ -219,9 +395,12 @@ static void mqtt5_app_start() {
     esp_mqtt_client_config_t mqtt5_cfg = {
         .broker.address.uri = CONFIG_BROKER_URL,
         .broker.address.port = 8883,
-        .broker.verification.certificate =
-            (const char*)_binary_cacert_pem_start,
+        // Verified against the pre-parsed certificates of the cert store
+        .broker.verification.use_global_ca_store = true,
         .session.protocol_ver = MQTT_PROTOCOL_V_5,
+        // Resume the session on reconnects (MQTT5 clean start = 0)
+        .session.disable_clean_session = true,
+        // Reconnects are scheduled by the controller
         .network.disable_auto_reconnect = true,
         .credentials.username = "testuser",
         .credentials.authentication.password = "testpassword",
@@ -232,6 +411,22 @@ static void mqtt5_app_start() {
         .session.last_will.retain = true,
     };
 
+#if CONFIG_TLS_SESSION_RESUMPTION
+    // The client's own SSL transport doesn't expose session tickets, so it
+    // gets a transport that keeps the ticket of the last connection and
+    // offers it on the next handshake (abbreviated handshake). The client
+    // owns and destroys the transport.
+    if (strncmp(CONFIG_BROKER_URL, "mqtts://", 8) == 0) {
+        esp_transport_handle_t transport = esp_transport_ssl_init();
+        if (transport != NULL) {
+            esp_transport_ssl_enable_global_ca_store(transport);
+            esp_transport_ssl_session_tickets_enable(transport);
+            esp_transport_set_default_port(transport, 8883);
+            mqtt5_cfg.network.transport = transport;
+        }
+    }
+#endif
+
     mqtt_client = esp_mqtt_client_init(&mqtt5_cfg);
 
     /* Set connection properties and user properties */
@@ -257,9 +452,43 @@ static void mqtt5_app_start() {
     esp_mqtt_client_start(mqtt_client);
 }
 
-esp_err_t mqtt_controller_init(QueueHandle_t* general_event_queue) {
+/**
+ * @brief Helper for (re)building the cached publish user property list
+ *
+ */
+static esp_err_t mqtt_controller_build_publish_properties(void) {
+    if (publish_property.user_property != NULL) {
+        esp_mqtt5_client_delete_user_property(publish_property.user_property);
+        publish_property.user_property = NULL;
+    }
+
+    esp_err_t result = esp_mqtt5_client_set_user_property(
+        &publish_property.user_property, user_property_arr,
+        user_property_arr_size);
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    // List handle plus an item, key and value copy per property
+    portENTER_CRITICAL(&stats_lock);
+    publish_stats.property_builds++;
+    publish_stats.property_allocations +=
+        MQTT_USER_PROPERTY_ALLOCATIONS(user_property_arr_size);
+    portEXIT_CRITICAL(&stats_lock);
+    publish_property_dirty = false;
+
+    return ESP_OK;
+}
+
+esp_err_t mqtt_controller_init(void) {
     esp_err_t result = ESP_OK;
 
+    // The client is reused for the whole runtime, reconnects are handled by
+    // the controller
+    if (mqtt_client != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
     ESP_LOGI(TAG, "[mqtt5] Startup..");
     ESP_LOGI(TAG, "[mqtt5] Free memory: %" PRIu32 " bytes",
              esp_get_free_heap_size());
@@ -273,26 +502,195 @@ esp_err_t mqtt_controller_init(QueueHandle_t* general_event_queue) {
     esp_log_level_set("transport", ESP_LOG_VERBOSE);
     esp_log_level_set("outbox", ESP_LOG_VERBOSE);
 
-    // Initialize reference to the main module's general queue
-    general_event_queue_reference = general_event_queue;
+    // Parsed once, reused by every (re)connect
+    result = cert_store_add(_binary_cacert_pem_start, _binary_cacert_pem_end);
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    const esp_timer_create_args_t reconnect_timer_args = {
+        .callback = mqtt_controller_reconnect_timer,
+        .name = "mqtt-reconnect",
+    };
+    result = esp_timer_create(&reconnect_timer_args, &reconnect_timer);
+    if (result != ESP_OK) {
+        return result;
+    }
 
     mqtt5_app_start();
 
+    // Build the publish properties up front, so the first publish is as
+    // cheap as the following ones
+    result = mqtt_controller_build_publish_properties();
+
     return result;
 }
 
-void mqtt_controller_publish(char* data) {
+void mqtt_controller_invalidate_properties(void) {
+    publish_property_dirty = true;
+}
+
+void mqtt_controller_get_stats(mqtt_controller_stats_t* stats) {
+    portENTER_CRITICAL(&stats_lock);
+    *stats = publish_stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+TaskHandle_t mqtt_controller_get_task_handle(void) { return client_task; }
+
+size_t mqtt_controller_get_outbox_size(void) {
+    if (mqtt_client == NULL) {
+        return 0;
+    }
+    return (size_t)esp_mqtt_client_get_outbox_size(mqtt_client);
+}
+
+#if CONFIG_MQTT_TOPIC_ALIAS_ENABLED
+/**
+ * @brief Helper for getting the topic alias of a topic, a free alias is
+ * assigned on first use
+ *
+ * @return mqtt_topic_alias_t* NULL if all aliases are taken or the topic is
+ * longer than CONFIG_MQTT_TOPIC_ALIAS_TOPIC_LENGTH
+ */
+static mqtt_topic_alias_t* mqtt_controller_topic_alias(const char* topic) {
+    size_t topic_length =
+        strnlen(topic, CONFIG_MQTT_TOPIC_ALIAS_TOPIC_LENGTH + 1);
+
+    if (topic_length > CONFIG_MQTT_TOPIC_ALIAS_TOPIC_LENGTH) {
+        return NULL;
+    }
+    for (size_t i = 0; i < topic_alias_count; i++) {
+        if ((topic_aliases[i].topic_length == topic_length) &&
+            (memcmp(topic_aliases[i].topic, topic, topic_length) == 0)) {
+            return &topic_aliases[i];
+        }
+    }
+    if (topic_alias_count >= CONFIG_MQTT_TOPIC_ALIAS_MAXIMUM) {
+        return NULL;
+    }
+
+    mqtt_topic_alias_t* alias = &topic_aliases[topic_alias_count++];
+    memcpy(alias->topic, topic, topic_length);
+    alias->topic[topic_length] = '\0';
+    alias->topic_length = topic_length;
+    // Not established in any session yet
+    alias->generation = session_generation - 1;
+    return alias;
+}
+#endif
+
+esp_err_t mqtt_controller_publish(char* data) {
+    return mqtt_controller_publish_to(DEFAULT_TOPIC, data);
+}
+
+esp_err_t mqtt_controller_publish_to(const char* topic, const char* data) {
+    int msg_id;
+    return mqtt_controller_publish_with_id(topic, data, &msg_id);
+}
+
+esp_err_t mqtt_controller_publish_with_id(const char* topic, const char* data,
+                                          int* msg_id) {
+    // Length 0 lets the client use strlen(data)
+    return mqtt_controller_publish_binary(topic, data, 0, NULL, msg_id);
+}
+
+esp_err_t mqtt_controller_publish_binary(const char* topic, const void* data,
+                                         size_t length,
+                                         const char* content_type,
+                                         int* msg_id) {
     if (mqtt_client == NULL) {
         ESP_LOGE(TAG, "cannot publish, client not initialized!");
-        return;
+        return ESP_ERR_INVALID_STATE;
     }
-    esp_mqtt5_client_set_user_property(&publish_property.user_property,
-                                       user_property_arr,
-                                       user_property_arr_size);
-    esp_mqtt5_client_set_publish_property(mqtt_client, &publish_property);
-    int msg_id =
-        esp_mqtt_client_publish(mqtt_client, DEFAULT_TOPIC, data, 0, 1, 1);
-    esp_mqtt5_client_delete_user_property(publish_property.user_property);
-    publish_property.user_property = NULL;
-    ESP_LOGI(TAG, "sent publish successful, msg_id=%d", msg_id);
+    if (publish_property_dirty &&
+        (mqtt_controller_build_publish_properties() != ESP_OK)) {
+        ESP_LOGE(TAG, "cannot publish, failed to build the properties!");
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_mqtt5_publish_property_config_t property = publish_property;
+    if (content_type != NULL) {
+        // Not UTF-8 text, the content type tells the subscribers the format
+        property.payload_format_indicator = 0;
+        property.content_type = content_type;
+    }
+    const char* publish_topic = topic;
+#if CONFIG_MQTT_TOPIC_ALIAS_ENABLED
+    uint32_t generation = session_generation;
+    if (topic_alias_limit_generation != generation) {
+        topic_alias_limit_generation = generation;
+        topic_alias_limit = CONFIG_MQTT_TOPIC_ALIAS_MAXIMUM;
+    }
+    mqtt_topic_alias_t* alias =
+        session_connected ? mqtt_controller_topic_alias(topic) : NULL;
+    if ((alias != NULL) &&
+        ((size_t)(alias - topic_aliases) < topic_alias_limit)) {
+        property.topic_alias = (alias - topic_aliases) + 1;
+        if (alias->generation == generation) {
+            // Established, the broker maps the alias to the topic
+            publish_topic = "";
+        }
+    } else {
+        alias = NULL;
+    }
+#endif
+
+    // The client keeps its own copy of the properties for the next publish
+    // only, the user property list stays owned by the controller
+    esp_err_t result =
+        esp_mqtt5_client_set_publish_property(mqtt_client, &property);
+#if CONFIG_MQTT_TOPIC_ALIAS_ENABLED
+    if ((result != ESP_OK) && (alias != NULL)) {
+        // The broker's topic alias maximum is lower, don't use this alias
+        // (nor the higher ones) until the next connect
+        topic_alias_limit = (size_t)(alias - topic_aliases);
+        alias = NULL;
+        property.topic_alias = 0;
+        publish_topic = topic;
+        result = esp_mqtt5_client_set_publish_property(mqtt_client, &property);
+    }
+#endif
+    if (result != ESP_OK) {
+        ESP_LOGE(TAG, "cannot publish, failed to set the properties!");
+        return result;
+    }
+
+#if CONFIG_MQTT_TOPIC_ALIAS_ENABLED
+    bool alias_only = (alias != NULL) && (publish_topic != topic);
+    if (alias_only) {
+        alias_only_generation = generation;
+    }
+#endif
+    int publish_msg_id = esp_mqtt_client_publish(
+        mqtt_client, publish_topic, data, (int)length, 1, 1);
+#if CONFIG_MQTT_TOPIC_ALIAS_ENABLED
+    if (alias_only && (generation != session_generation)) {
+        // Disconnected while publishing, the message may be in the outbox
+        reconnect_restart = true;
+    }
+#endif
+    portENTER_CRITICAL(&stats_lock);
+    publish_stats.publishes++;
+#if CONFIG_MQTT_TOPIC_ALIAS_ENABLED
+    if ((alias != NULL) && (publish_msg_id >= 0)) {
+        if (publish_topic == topic) {
+            alias->generation = generation;
+            publish_stats.alias_registrations++;
+            publish_stats.alias_bytes_saved -= TOPIC_ALIAS_PROPERTY_SIZE;
+        } else {
+            publish_stats.aliased_publishes++;
+            publish_stats.alias_bytes_saved +=
+                (int32_t)alias->topic_length - TOPIC_ALIAS_PROPERTY_SIZE;
+        }
+    }
+#endif
+    portEXIT_CRITICAL(&stats_lock);
+    if (publish_msg_id < 0) {
+        ESP_LOGE(TAG, "publish failed, msg_id=%d", publish_msg_id);
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "sent publish successful, msg_id=%d", publish_msg_id);
+    *msg_id = publish_msg_id;
+    return ESP_OK;
 }
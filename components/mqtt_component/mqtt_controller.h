@@ -11,11 +11,50 @@
 #define MQTT_CONTROLLER_H
 
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "mqtt_client.h"
 
 typedef void (*mqtt5_event_handler_t)(void *handler_args, esp_event_base_t base,
                                       int32_t event_id, void *event_data);
 
+/**
+ * @brief Number of heap allocations made by esp_mqtt5_client_set_user_property
+ * for a list of 'count' properties (list handle, item, key and value copy)
+ */
+#define MQTT_USER_PROPERTY_ALLOCATIONS(count) (1 + 3 * (count))
+
+/**
+ * @brief Publish statistics
+ */
+typedef struct {
+    // Successful and failed esp_mqtt_client_publish calls
+    uint32_t publishes;
+    // Number of times the publish user property list was built
+    uint32_t property_builds;
+    // Heap allocations made by the controller for the publish properties,
+    // divided by 'publishes' this is the per-publish allocation count
+    uint32_t property_allocations;
+    // Publishes that sent the full topic to establish a topic alias
+    uint32_t alias_registrations;
+    // Publishes that sent only the topic alias
+    uint32_t aliased_publishes;
+    // Net PUBLISH header bytes saved by topic aliases (the alias property
+    // costs 3 bytes, the topic string is omitted)
+    int32_t alias_bytes_saved;
+    // Successful connections to the broker
+    uint32_t connects;
+    // Connections that resumed the previous session (no resubscribe needed)
+    uint32_t sessions_resumed;
+    // Reconnect attempts made by the backoff timer
+    uint32_t reconnect_attempts;
+    // Reconnects that had to restart the client task (drops the outbox)
+    uint32_t client_restarts;
+    // Duration of the last connect (TCP + TLS handshake + CONNACK)
+    uint32_t last_connect_time_ms;
+    // Peak heap usage during the last connect
+    uint32_t last_connect_heap_peak;
+} mqtt_controller_stats_t;
+
 extern esp_mqtt5_user_property_item_t user_property_arr[];
 extern const size_t user_property_arr_size;
 extern esp_mqtt5_disconnect_property_config_t disconnect_property;
@@ -25,18 +64,106 @@ extern "C" {
 #endif
 
 /**
- * @brief Initiazize MQTT client (and also the WiFi connection)
+ * @brief Initiazize MQTT client (and also the WiFi connection), the client is
+ * reconnected with a jittered exponential backoff
+ *
+ * The connection events are posted to the event bus. When a reconnect is
+ * due, EVENT_MQTT_RECONNECT is posted and the receiver has to call
+ * mqtt_controller_reconnect.
  *
+ * @return esp_err_t ESP_ERR_INVALID_STATE if already initialized
  */
-esp_err_t mqtt_controller_init(QueueHandle_t *general_event_queue);
+esp_err_t mqtt_controller_init(void);
 void log_error_if_nonzero(const char *message, int error_code);
 void print_user_property(mqtt5_user_property_handle_t user_property);
 
 /**
- * @brief Publish a message to the MQTT broker
+ * @brief Publish a message to the MQTT broker (DEFAULT_TOPIC)
+ *
+ * @param data Null terminated message
+ * @return esp_err_t ESP_OK if the message was handed to the client
+ */
+esp_err_t mqtt_controller_publish(char *data);
+
+/**
+ * @brief Publish a message to a topic of the MQTT broker, the first
+ * CONFIG_MQTT_TOPIC_ALIAS_MAXIMUM topics get a topic alias automatically
+ * (the topic is copied, topics longer than
+ * CONFIG_MQTT_TOPIC_ALIAS_TOPIC_LENGTH don't get one)
+ *
+ * @param topic Null terminated topic, only used during the call
+ * @param data Null terminated message
+ * @return esp_err_t ESP_OK if the message was handed to the client
+ */
+esp_err_t mqtt_controller_publish_to(const char *topic, const char *data);
+
+/**
+ * @brief Publish a message to a topic of the MQTT broker and get its message
+ * id, for matching the MQTT_EVENT_PUBLISHED acknowledgement (see
+ * latency_trace_expect_ack)
+ *
+ * @param topic Null terminated topic, only used during the call
+ * @param data Null terminated message
+ * @param msg_id Output message id, only written on ESP_OK
+ * @return esp_err_t ESP_OK if the message was handed to the client
+ */
+esp_err_t mqtt_controller_publish_with_id(const char *topic, const char *data,
+                                          int *msg_id);
+
+/**
+ * @brief Publish a binary message (e.g. CBOR) to a topic of the MQTT broker,
+ * sent with the MQTT5 content type instead of the UTF-8 payload format
+ * indicator
+ *
+ * @param topic Null terminated topic, only used during the call
+ * @param data Message
+ * @param length Message length in bytes, 0 for a null terminated string
+ * @param content_type MIME type of the message (e.g. "application/cbor"),
+ * NULL for a UTF-8 string
+ * @param msg_id Output message id, only written on ESP_OK
+ * @return esp_err_t ESP_OK if the message was handed to the client
+ */
+esp_err_t mqtt_controller_publish_binary(const char *topic, const void *data,
+                                         size_t length,
+                                         const char *content_type,
+                                         int *msg_id);
+
+/**
+ * @brief Reconnect the client on EVENT_MQTT_RECONNECT, restarts the client
+ * task if it can't reconnect on its own (blocks until the task is stopped)
+ *
+ */
+void mqtt_controller_reconnect(void);
+
+/**
+ * @brief Rebuild the cached publish properties on the next publish, call
+ * after changing user_property_arr
+ *
+ */
+void mqtt_controller_invalidate_properties(void);
+
+/**
+ * @brief Get the publish and connection statistics
+ *
+ * @param stats Output statistics
+ */
+void mqtt_controller_get_stats(mqtt_controller_stats_t *stats);
+
+/**
+ * @brief Get the handle of the MQTT client task (e.g. for its stack
+ * high-water mark), the task is re-created when the client is restarted
+ *
+ * @return TaskHandle_t NULL before the client's first connect attempt
+ */
+TaskHandle_t mqtt_controller_get_task_handle(void);
+
+/**
+ * @brief Get the size of the MQTT outbox (messages waiting to be sent or
+ * acknowledged)
  *
+ * @return size_t Bytes, 0 before mqtt_controller_init
  */
-void mqtt_controller_publish(char *data);
+size_t mqtt_controller_get_outbox_size(void);
 
 #ifdef __cplusplus
 }
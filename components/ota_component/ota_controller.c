@@ -11,11 +11,13 @@
 
 #include <sys/socket.h>
 
+#include "cert_store.h"
 #include "esp_event.h"
 #include "esp_http_client.h"
 #include "esp_https_ota.h"
 #include "esp_log.h"
 #include "esp_ota_ops.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -29,6 +31,9 @@ extern const uint8_t server_cert_pem_end[] asm("_binary_ca_cert_pem_end");
 
 #define OTA_URL_SIZE 256
 
+// Start of the HTTPS connection, for measuring the TLS handshake
+static int64_t connect_start_us = 0;
+
 esp_err_t _http_event_handler(esp_http_client_event_t *evt) {
     switch (evt->event_id) {
         case HTTP_EVENT_ERROR:
@@ -36,6 +41,9 @@ esp_err_t _http_event_handler(esp_http_client_event_t *evt) {
             break;
         case HTTP_EVENT_ON_CONNECTED:
             ESP_LOGD(TAG, "HTTP_EVENT_ON_CONNECTED");
+            ESP_LOGI(TAG, "Connected (TCP + TLS) in %lld ms, free heap %lu",
+                     (esp_timer_get_time() - connect_start_us) / 1000,
+                     (unsigned long)esp_get_free_heap_size());
             break;
         case HTTP_EVENT_HEADER_SENT:
             ESP_LOGD(TAG, "HTTP_EVENT_HEADER_SENT");
@@ -95,10 +103,22 @@ esp_err_t ota_start(void) {
      */
     esp_wifi_set_ps(WIFI_PS_NONE);
 
+    // Parsed on the first update only, later updates reuse the certificates
+    esp_err_t ret = cert_store_add(server_cert_pem_start, server_cert_pem_end);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to add the server certificate");
+        return ret;
+    }
+
     esp_http_client_config_t config = {
         .url = CONFIG_EXAMPLE_FIRMWARE_UPGRADE_URL,
-        .cert_pem = (char *)server_cert_pem_start,
+        .use_global_ca_store = true,
         .skip_cert_common_name_check = true,
+#if CONFIG_TLS_SESSION_RESUMPTION
+        // Reconnects during the download (e.g. after a redirect or a dropped
+        // keep-alive connection) resume the TLS session
+        .save_client_session = true,
+#endif
         .event_handler = _http_event_handler,
         .keep_alive_enable = true,
     };
@@ -107,7 +127,8 @@ esp_err_t ota_start(void) {
         .http_config = &config,
     };
     ESP_LOGI(TAG, "Attempting to download update from %s", config.url);
-    esp_err_t ret = esp_https_ota(&ota_config);
+    connect_start_us = esp_timer_get_time();
+    ret = esp_https_ota(&ota_config);
     if (ret == ESP_OK) {
         ESP_LOGI(TAG, "OTA Succeed, Rebooting...");
         esp_restart();
@@ -0,0 +1,114 @@
+/**
+ * @file sample_log_file_flash.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief File backed NOR flash emulation for testing the sample log on a host
+ * (not part of the firmware build)
+ * @version 0.1
+ * @date 2025-05-20
+ *
+ */
+
+#include "sample_log_file_flash.h"
+
+#include <string.h>
+
+static esp_err_t sample_log_file_flash_read(void* context, size_t offset,
+                                            void* data, size_t length) {
+    FILE* file = context;
+
+    if ((fseek(file, (long)offset, SEEK_SET) != 0) ||
+        (fread(data, 1, length, file) != length)) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t sample_log_file_flash_write(void* context, size_t offset,
+                                             const void* data, size_t length) {
+    FILE* file = context;
+    const uint8_t* bytes = data;
+    uint8_t buffer[64];
+
+    while (length > 0) {
+        size_t chunk = (length < sizeof(buffer)) ? length : sizeof(buffer);
+        if (sample_log_file_flash_read(file, offset, buffer, chunk) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        // NOR flash can only clear bits
+        for (size_t i = 0; i < chunk; i++) {
+            buffer[i] &= bytes[i];
+        }
+        if ((fseek(file, (long)offset, SEEK_SET) != 0) ||
+            (fwrite(buffer, 1, chunk, file) != chunk)) {
+            return ESP_FAIL;
+        }
+        offset += chunk;
+        bytes += chunk;
+        length -= chunk;
+    }
+
+    return (fflush(file) == 0) ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t sample_log_file_flash_erase_sector(void* context,
+                                                    size_t offset) {
+    FILE* file = context;
+    uint8_t erased[SAMPLE_LOG_SECTOR_SIZE];
+
+    if ((offset % SAMPLE_LOG_SECTOR_SIZE) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(erased, 0xFF, sizeof(erased));
+    if ((fseek(file, (long)offset, SEEK_SET) != 0) ||
+        (fwrite(erased, 1, sizeof(erased), file) != sizeof(erased))) {
+        return ESP_FAIL;
+    }
+
+    return (fflush(file) == 0) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t sample_log_file_flash_open(sample_log_flash_t* flash,
+                                     const char* path, size_t size) {
+    if ((size == 0) || ((size % SAMPLE_LOG_SECTOR_SIZE) != 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    FILE* file = fopen(path, "r+b");
+    if (file == NULL) {
+        file = fopen(path, "w+b");
+        if (file == NULL) {
+            return ESP_FAIL;
+        }
+    }
+
+    flash->context = file;
+    flash->size = size;
+    flash->read = sample_log_file_flash_read;
+    flash->write = sample_log_file_flash_write;
+    flash->erase_sector = sample_log_file_flash_erase_sector;
+
+    // Extend a new (or short) image with erased sectors
+    fseek(file, 0, SEEK_END);
+    long current_size = ftell(file);
+    if (current_size < 0) {
+        current_size = 0;
+    }
+    size_t erased_from = (size_t)current_size -
+                         ((size_t)current_size % SAMPLE_LOG_SECTOR_SIZE);
+    for (size_t offset = erased_from; offset < size;
+         offset += SAMPLE_LOG_SECTOR_SIZE) {
+        if (sample_log_file_flash_erase_sector(file, offset) != ESP_OK) {
+            fclose(file);
+            return ESP_FAIL;
+        }
+    }
+
+    return ESP_OK;
+}
+
+void sample_log_file_flash_close(sample_log_flash_t* flash) {
+    if (flash->context != NULL) {
+        fclose(flash->context);
+        flash->context = NULL;
+    }
+}
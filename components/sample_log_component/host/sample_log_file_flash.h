@@ -0,0 +1,48 @@
+/**
+ * @file sample_log_file_flash.h
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief File backed NOR flash emulation for testing the sample log on a host
+ * (not part of the firmware build)
+ * @version 0.1
+ * @date 2025-05-20
+ *
+ */
+
+#ifndef SAMPLE_LOG_FILE_FLASH_H
+#define SAMPLE_LOG_FILE_FLASH_H
+
+#include <stdio.h>
+
+#include "sample_log.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Open (or create) a flash image file, a new image starts erased
+ *
+ * Writes are ANDed into the existing contents like on NOR flash, so writing
+ * over an unerased location corrupts the data instead of silently
+ * succeeding. The image survives a process restart, which emulates a reboot.
+ *
+ * @param flash Output flash access
+ * @param path Image file path
+ * @param size Image size in bytes (multiple of SAMPLE_LOG_SECTOR_SIZE)
+ * @return esp_err_t
+ */
+esp_err_t sample_log_file_flash_open(sample_log_flash_t *flash,
+                                     const char *path, size_t size);
+
+/**
+ * @brief Close a flash image opened with sample_log_file_flash_open
+ *
+ * @param flash The flash access
+ */
+void sample_log_file_flash_close(sample_log_flash_t *flash);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SAMPLE_LOG_FILE_FLASH_H
@@ -0,0 +1,202 @@
+/**
+ * @file sample_log_test.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Tests the sample log on a host with the file backed flash
+ * emulation: append, peek/consume, sector wrap-around and recovery after a
+ * remount (not part of the firmware build)
+ * @version 0.1
+ * @date 2025-05-30
+ *
+ * Build (esp_err.h from ESP-IDF and the sdkconfig.h of a configured build,
+ * e.g. after idf.py reconfigure):
+ *   gcc -O2 -I$IDF_PATH/components/esp_common/include -Ibuild/config
+ *       -Icomponents/sample_log_component
+ *       -Icomponents/sample_log_component/host
+ *       -Icomponents/batch_component -Icomponents/i2c_components
+ *       components/sample_log_component/host/sample_log_test.c
+ *       components/sample_log_component/host/sample_log_file_flash.c
+ *       components/sample_log_component/sample_log.c -o sample_log_test
+ *
+ * Usage:
+ *   sample_log_test [IMAGE]
+ *
+ * IMAGE is the flash image file (default sample_log_test.img), it is deleted
+ * before the test. Exits with 1 if any check fails.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sample_log.h"
+#include "sample_log_file_flash.h"
+
+// Small log so the tests wrap around quickly
+#define TEST_SECTORS 4
+#define TEST_FLASH_SIZE (TEST_SECTORS * SAMPLE_LOG_SECTOR_SIZE)
+#define TEST_PEEK_SAMPLES 12
+
+#define CHECK(condition)                                                   \
+    do {                                                                   \
+        if (!(condition)) {                                                \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition);   \
+            failures++;                                                    \
+        }                                                                  \
+    } while (0)
+
+static unsigned int failures = 0;
+static const char *image_path = "sample_log_test.img";
+static sample_log_flash_t flash;
+
+/**
+ * @brief Helper for a sample whose values encode its sequence number
+ *
+ */
+static sensor_batch_sample_t make_sample(int sequence) {
+    sensor_batch_sample_t sample;
+
+    memset(&sample, 0, sizeof(sample));
+    sample.timestamp_us = (int64_t)sequence * 1000;
+    sample.data.humidity.centi = (int16_t)sequence;
+    sample.data.temperature.centi = (int16_t)-sequence;
+    return sample;
+}
+
+/**
+ * @brief Helper that appends the samples first..last - 1
+ *
+ */
+static void append_range(int first, int last) {
+    for (int sequence = first; sequence < last; sequence++) {
+        sensor_batch_sample_t sample = make_sample(sequence);
+        CHECK(sample_log_append(&sample) == ESP_OK);
+    }
+}
+
+/**
+ * @brief Helper that emulates a reboot: closes the image and mounts the log
+ * again from its contents
+ *
+ */
+static void remount(void) {
+    sample_log_file_flash_close(&flash);
+    CHECK(sample_log_file_flash_open(&flash, image_path, TEST_FLASH_SIZE) ==
+          ESP_OK);
+    CHECK(sample_log_init(&flash) == ESP_OK);
+}
+
+/**
+ * @brief Helper that replays the whole backlog, returns the sequence number
+ * after the last replayed sample (-1 if the samples were out of order)
+ *
+ */
+static int replay_all(int expected) {
+    sensor_batch_sample_t samples[TEST_PEEK_SAMPLES];
+    size_t count = 0;
+
+    while ((count = sample_log_peek(samples, TEST_PEEK_SAMPLES)) > 0) {
+        for (size_t i = 0; i < count; i++) {
+            if ((samples[i].data.humidity.centi != expected) ||
+                (samples[i].data.temperature.centi != -expected)) {
+                printf("FAIL replay: sample %d, expected %d\n",
+                       samples[i].data.humidity.centi, expected);
+                return -1;
+            }
+            expected++;
+        }
+        CHECK(sample_log_consume(count) == ESP_OK);
+    }
+    return expected;
+}
+
+static void test_append_consume(void) {
+    sensor_batch_sample_t samples[TEST_PEEK_SAMPLES];
+
+    CHECK(sample_log_pending() == 0);
+    append_range(0, 300);
+    CHECK(sample_log_pending() == 300);
+
+    // Peeking doesn't consume, samples of this boot keep their timestamps
+    CHECK(sample_log_peek(samples, TEST_PEEK_SAMPLES) == TEST_PEEK_SAMPLES);
+    CHECK(sample_log_peek(samples, TEST_PEEK_SAMPLES) == TEST_PEEK_SAMPLES);
+    CHECK(samples[0].data.humidity.centi == 0);
+    CHECK(samples[TEST_PEEK_SAMPLES - 1].timestamp_us ==
+          (TEST_PEEK_SAMPLES - 1) * 1000);
+    CHECK(sample_log_consume(TEST_PEEK_SAMPLES) == ESP_OK);
+    CHECK(sample_log_pending() == 300 - TEST_PEEK_SAMPLES);
+}
+
+static void test_remount(void) {
+    sensor_batch_sample_t samples[TEST_PEEK_SAMPLES];
+
+    // The backlog and the replay position survive a reboot, the timestamps
+    // of the previous boot don't
+    remount();
+    CHECK(sample_log_pending() == 300 - TEST_PEEK_SAMPLES);
+    CHECK(sample_log_peek(samples, 1) == 1);
+    CHECK(samples[0].data.humidity.centi == TEST_PEEK_SAMPLES);
+    CHECK(samples[0].timestamp_us == SAMPLE_LOG_TIMESTAMP_UNKNOWN);
+}
+
+static void test_wrap(void) {
+    sensor_batch_sample_t samples[TEST_PEEK_SAMPLES];
+    sample_log_stats_t stats;
+
+    // Several times the capacity, the oldest sectors are erased round robin
+    append_range(300, 1000);
+    sample_log_get_stats(&stats);
+    printf("after wrap: %lu pending, %lu overwritten, %lu erases\n",
+           (unsigned long)stats.pending, (unsigned long)stats.overwritten,
+           (unsigned long)stats.erases);
+    CHECK(stats.pending < TEST_SECTORS * SAMPLE_LOG_RECORDS_PER_SECTOR);
+    CHECK(stats.pending + stats.overwritten == 1000 - TEST_PEEK_SAMPLES);
+    CHECK(stats.erases > 0);
+
+    // The newest samples are kept, in order
+    int first = 1000 - (int)stats.pending;
+    CHECK(sample_log_peek(samples, 1) == 1);
+    CHECK(samples[0].data.humidity.centi == first);
+
+    // A reboot after the wrap finds the same backlog
+    remount();
+    CHECK(sample_log_pending() == stats.pending);
+    CHECK(replay_all(first) == 1000);
+    CHECK(sample_log_pending() == 0);
+}
+
+static void test_remount_empty(void) {
+    sensor_batch_sample_t sample = make_sample(5);
+
+    // A fully replayed log stays empty after a reboot
+    remount();
+    CHECK(sample_log_pending() == 0);
+
+    CHECK(sample_log_append(&sample) == ESP_OK);
+    remount();
+    CHECK(sample_log_pending() == 1);
+    CHECK(replay_all(5) == 6);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        image_path = argv[1];
+    }
+
+    remove(image_path);
+    if ((sample_log_file_flash_open(&flash, image_path, TEST_FLASH_SIZE) !=
+         ESP_OK) ||
+        (sample_log_init(&flash) != ESP_OK)) {
+        printf("FAIL: can't create %s\n", image_path);
+        return 1;
+    }
+
+    test_append_consume();
+    test_remount();
+    test_wrap();
+    test_remount_empty();
+
+    sample_log_file_flash_close(&flash);
+    remove(image_path);
+
+    printf("%s: %u failures\n", (failures == 0) ? "OK" : "FAIL", failures);
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,424 @@
+/**
+ * @file sample_log.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Persistent append-only log of ChipCap2 samples (store-and-forward
+ * during MQTT/Wi-Fi outages)
+ * @version 0.1
+ * @date 2025-05-20
+ *
+ */
+
+#include "sample_log.h"
+
+#include <string.h>
+
+#define SECTOR_MAGIC 0x534C4F47u  // "SLOG"
+#define SECTOR_VERSION 1
+// Record states, a record goes ERASED -> VALID -> CONSUMED by only clearing
+// bits, so no erase is needed to consume it
+#define RECORD_STATE_ERASED 0xFFFFFFFFu
+#define RECORD_STATE_VALID 0xA5A5A5A5u
+#define RECORD_STATE_CONSUMED 0x00000000u
+
+/**
+ * @brief Sector header, stored in the first record slot of every sector
+ */
+typedef struct {
+    uint32_t magic;
+    // Incremented for every newly started sector, the highest one is the
+    // sector currently written to
+    uint32_t sequence;
+    uint16_t version;
+    uint8_t reserved[SAMPLE_LOG_RECORD_SIZE - 10];
+} sample_log_sector_header_t;
+
+/**
+ * @brief Sample record
+ */
+typedef struct {
+    uint32_t state;
+    // Boot the sample was recorded in (timestamps are only comparable within
+    // the same boot)
+    uint32_t boot_id;
+    int64_t timestamp_us;
+    int16_t humidity_centi;
+    int16_t temperature_centi;
+    uint8_t status;
+    uint8_t reserved[7];
+    // Over everything except the state
+    uint32_t crc;
+} sample_log_record_t;
+
+_Static_assert(sizeof(sample_log_sector_header_t) == SAMPLE_LOG_RECORD_SIZE,
+               "sector header must fill a record slot");
+_Static_assert(sizeof(sample_log_record_t) == SAMPLE_LOG_RECORD_SIZE,
+               "record size mismatch");
+
+/**
+ * @brief Position of a record slot
+ */
+typedef struct {
+    size_t sector;
+    size_t slot;
+} sample_log_position_t;
+
+static sample_log_flash_t log_flash;
+static size_t sector_count = 0;
+static uint32_t head_sequence = 0;
+// Next slot to write to
+static sample_log_position_t head = {0};
+// Oldest pending record (only valid while pending > 0)
+static sample_log_position_t tail = {0};
+static uint32_t boot_id = 0;
+static sample_log_stats_t stats = {0};
+
+/**
+ * @brief Helper for the CRC-32 (IEEE) of a record, nibble table to keep it
+ * small
+ *
+ */
+static uint32_t sample_log_crc32(const void* data, size_t length) {
+    static const uint32_t table[16] = {
+        0x00000000u, 0x1DB71064u, 0x3B6E20C8u, 0x26D930ACu,
+        0x76DC4190u, 0x6B6B51F4u, 0x4DB26158u, 0x5005713Cu,
+        0xEDB88320u, 0xF00F9344u, 0xD6D6A3E8u, 0xCB61B38Cu,
+        0x9B64C2B0u, 0x86D3D2D4u, 0xA00AE278u, 0xBDBDF21Cu};
+    const uint8_t* bytes = data;
+    uint32_t crc = 0xFFFFFFFFu;
+
+    for (size_t i = 0; i < length; i++) {
+        crc ^= bytes[i];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+
+    return ~crc;
+}
+
+static uint32_t sample_log_record_crc(const sample_log_record_t* record) {
+    return sample_log_crc32(&record->boot_id,
+                            offsetof(sample_log_record_t, crc) -
+                                offsetof(sample_log_record_t, boot_id));
+}
+
+static size_t sample_log_offset(sample_log_position_t position) {
+    // Slot 0 is the sector header
+    return (position.sector * SAMPLE_LOG_SECTOR_SIZE) +
+           ((position.slot + 1) * SAMPLE_LOG_RECORD_SIZE);
+}
+
+static bool sample_log_position_equal(sample_log_position_t a,
+                                      sample_log_position_t b) {
+    return (a.sector == b.sector) && (a.slot == b.slot);
+}
+
+static sample_log_position_t sample_log_next(sample_log_position_t position) {
+    position.slot++;
+    if (position.slot >= SAMPLE_LOG_RECORDS_PER_SECTOR) {
+        position.slot = 0;
+        position.sector = (position.sector + 1) % sector_count;
+    }
+    return position;
+}
+
+static esp_err_t sample_log_read_record(sample_log_position_t position,
+                                        sample_log_record_t* record) {
+    return log_flash.read(log_flash.context, sample_log_offset(position),
+                          record, sizeof(*record));
+}
+
+/**
+ * @brief Helper for checking if a record holds a pending sample
+ *
+ */
+static bool sample_log_record_pending(const sample_log_record_t* record) {
+    return (record->state == RECORD_STATE_VALID) &&
+           (record->crc == sample_log_record_crc(record));
+}
+
+static esp_err_t sample_log_read_header(size_t sector,
+                                        sample_log_sector_header_t* header) {
+    return log_flash.read(log_flash.context, sector * SAMPLE_LOG_SECTOR_SIZE,
+                          header, sizeof(*header));
+}
+
+/**
+ * @brief Helper for erasing a sector and writing its header
+ *
+ */
+static esp_err_t sample_log_start_sector(size_t sector, uint32_t sequence) {
+    sample_log_sector_header_t header;
+
+    esp_err_t result = log_flash.erase_sector(log_flash.context,
+                                              sector * SAMPLE_LOG_SECTOR_SIZE);
+    if (result != ESP_OK) {
+        return result;
+    }
+    stats.erases++;
+
+    memset(&header, 0xFF, sizeof(header));
+    header.magic = SECTOR_MAGIC;
+    header.sequence = sequence;
+    header.version = SECTOR_VERSION;
+    return log_flash.write(log_flash.context, sector * SAMPLE_LOG_SECTOR_SIZE,
+                           &header, sizeof(header));
+}
+
+/**
+ * @brief Helper for moving the tail to the next pending record (or the head)
+ *
+ */
+static void sample_log_advance_tail(void) {
+    sample_log_record_t record;
+
+    while (!sample_log_position_equal(tail, head)) {
+        if ((sample_log_read_record(tail, &record) == ESP_OK) &&
+            sample_log_record_pending(&record)) {
+            return;
+        }
+        tail = sample_log_next(tail);
+    }
+}
+
+/**
+ * @brief Helper for recovering the log state from the flash contents
+ *
+ */
+static esp_err_t sample_log_mount(void) {
+    sample_log_sector_header_t header;
+    sample_log_record_t record;
+    bool found = false;
+    uint32_t max_boot_id = 0;
+    bool any_record = false;
+
+    // The sector with the highest sequence is the one being written to
+    for (size_t sector = 0; sector < sector_count; sector++) {
+        esp_err_t result = sample_log_read_header(sector, &header);
+        if (result != ESP_OK) {
+            return result;
+        }
+        if ((header.magic != SECTOR_MAGIC) ||
+            (header.version != SECTOR_VERSION)) {
+            continue;
+        }
+        if (!found || (header.sequence > head_sequence)) {
+            head_sequence = header.sequence;
+            head.sector = sector;
+            found = true;
+        }
+    }
+
+    if (!found) {
+        // Fresh (or foreign) flash contents, format the first sector
+        head_sequence = 1;
+        head.sector = 0;
+        head.slot = 0;
+        tail = head;
+        boot_id = 0;
+        return sample_log_start_sector(0, head_sequence);
+    }
+
+    // The oldest sector follows the head sector, sectors that were never
+    // used (no header) are skipped
+    sample_log_position_t position = {
+        .sector = (head.sector + 1) % sector_count, .slot = 0};
+    for (size_t i = 0; i < sector_count; i++) {
+        if ((sample_log_read_header(position.sector, &header) == ESP_OK) &&
+            (header.magic == SECTOR_MAGIC) &&
+            (header.version == SECTOR_VERSION)) {
+            break;
+        }
+        position.sector = (position.sector + 1) % sector_count;
+    }
+
+    // Walk all records up to the first free slot of the head sector
+    bool tail_found = false;
+    head.slot = SAMPLE_LOG_RECORDS_PER_SECTOR;
+    for (;;) {
+        esp_err_t result = sample_log_read_record(position, &record);
+        if (result != ESP_OK) {
+            return result;
+        }
+
+        if ((position.sector == head.sector) &&
+            (record.state == RECORD_STATE_ERASED)) {
+            head.slot = position.slot;
+            break;
+        }
+
+        if (record.state != RECORD_STATE_ERASED) {
+            if (record.crc == sample_log_record_crc(&record)) {
+                if (!any_record || (record.boot_id > max_boot_id)) {
+                    max_boot_id = record.boot_id;
+                }
+                any_record = true;
+                if (record.state == RECORD_STATE_VALID) {
+                    if (!tail_found) {
+                        tail = position;
+                        tail_found = true;
+                    }
+                    stats.pending++;
+                }
+            } else {
+                stats.corrupted++;
+            }
+        }
+
+        if ((position.sector == head.sector) &&
+            (position.slot == SAMPLE_LOG_RECORDS_PER_SECTOR - 1)) {
+            // Head sector is full, the next append starts a new sector
+            break;
+        }
+        position = sample_log_next(position);
+    }
+
+    if (!tail_found) {
+        tail = head;
+    }
+    boot_id = any_record ? (max_boot_id + 1) : 0;
+
+    return ESP_OK;
+}
+
+esp_err_t sample_log_init(const sample_log_flash_t* flash) {
+    if ((flash == NULL) || (flash->size < 2 * SAMPLE_LOG_SECTOR_SIZE) ||
+        ((flash->size % SAMPLE_LOG_SECTOR_SIZE) != 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    log_flash = *flash;
+    sector_count = flash->size / SAMPLE_LOG_SECTOR_SIZE;
+    memset(&stats, 0, sizeof(stats));
+
+    return sample_log_mount();
+}
+
+esp_err_t sample_log_append(const sensor_batch_sample_t* sample) {
+    sample_log_record_t record;
+    esp_err_t result = ESP_OK;
+
+    if (sector_count == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (head.slot >= SAMPLE_LOG_RECORDS_PER_SECTOR) {
+        // Round robin over all sectors, the oldest one is erased
+        size_t next_sector = (head.sector + 1) % sector_count;
+        sample_log_position_t position = {.sector = next_sector, .slot = 0};
+        for (size_t i = 0; i < SAMPLE_LOG_RECORDS_PER_SECTOR; i++) {
+            if ((sample_log_read_record(position, &record) == ESP_OK) &&
+                sample_log_record_pending(&record)) {
+                stats.overwritten++;
+                stats.pending--;
+            }
+            position.slot++;
+        }
+
+        result = sample_log_start_sector(next_sector, head_sequence + 1);
+        if (result != ESP_OK) {
+            return result;
+        }
+        head_sequence++;
+        head.sector = next_sector;
+        head.slot = 0;
+
+        // The pending samples of the erased sector are gone
+        if (stats.pending == 0) {
+            tail = head;
+        } else if (tail.sector == next_sector) {
+            tail.sector = (next_sector + 1) % sector_count;
+            tail.slot = 0;
+            sample_log_advance_tail();
+        }
+    }
+
+    memset(&record, 0xFF, sizeof(record));
+    record.state = RECORD_STATE_VALID;
+    record.boot_id = boot_id;
+    record.timestamp_us = sample->timestamp_us;
+    record.humidity_centi = sample->data.humidity.centi;
+    record.temperature_centi = sample->data.temperature.centi;
+    record.status = (uint8_t)sample->data.status;
+    record.crc = sample_log_record_crc(&record);
+
+    result = log_flash.write(log_flash.context, sample_log_offset(head),
+                             &record, sizeof(record));
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    if (stats.pending == 0) {
+        tail = head;
+    }
+    head.slot++;
+    stats.pending++;
+    stats.appended++;
+
+    return ESP_OK;
+}
+
+size_t sample_log_pending(void) { return stats.pending; }
+
+size_t sample_log_peek(sensor_batch_sample_t* samples, size_t max_samples) {
+    sample_log_record_t record;
+    sample_log_position_t position = tail;
+    size_t count = 0;
+
+    while ((count < max_samples) && (count < stats.pending) &&
+           !sample_log_position_equal(position, head)) {
+        if ((sample_log_read_record(position, &record) == ESP_OK) &&
+            sample_log_record_pending(&record)) {
+            sensor_batch_sample_t* sample = &samples[count++];
+            memset(sample, 0, sizeof(*sample));
+            sample->timestamp_us = (record.boot_id == boot_id)
+                                       ? record.timestamp_us
+                                       : SAMPLE_LOG_TIMESTAMP_UNKNOWN;
+            sample->data.humidity.centi = record.humidity_centi;
+            sample->data.humidity.value =
+                (float)record.humidity_centi / 100.0f;
+            sample->data.temperature.centi = record.temperature_centi;
+            sample->data.temperature.value =
+                (float)record.temperature_centi / 100.0f;
+            sample->data.status = (i2c_chipcap2_status_t)record.status;
+        }
+        position = sample_log_next(position);
+    }
+
+    return count;
+}
+
+esp_err_t sample_log_consume(size_t count) {
+    const uint32_t consumed_state = RECORD_STATE_CONSUMED;
+
+    while ((count > 0) && (stats.pending > 0)) {
+        sample_log_advance_tail();
+        if (sample_log_position_equal(tail, head)) {
+            break;
+        }
+
+        // Clearing the state bits needs no erase
+        esp_err_t result =
+            log_flash.write(log_flash.context, sample_log_offset(tail),
+                            &consumed_state, sizeof(consumed_state));
+        if (result != ESP_OK) {
+            return result;
+        }
+
+        tail = sample_log_next(tail);
+        stats.pending--;
+        stats.consumed++;
+        count--;
+    }
+
+    if (stats.pending == 0) {
+        tail = head;
+    } else {
+        sample_log_advance_tail();
+    }
+
+    return ESP_OK;
+}
+
+void sample_log_get_stats(sample_log_stats_t* out_stats) {
+    *out_stats = stats;
+}
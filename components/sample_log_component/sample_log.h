@@ -0,0 +1,148 @@
+/**
+ * @file sample_log.h
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Persistent append-only log of ChipCap2 samples (store-and-forward
+ * during MQTT/Wi-Fi outages)
+ * @version 0.1
+ * @date 2025-05-20
+ *
+ */
+
+#ifndef SAMPLE_LOG_H
+#define SAMPLE_LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "sensor_batch.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Flash erase unit, the log size must be a multiple of it
+ */
+#define SAMPLE_LOG_SECTOR_SIZE 4096
+
+/**
+ * @brief Size of a single record (and of the sector header), records never
+ * straddle a sector boundary
+ */
+#define SAMPLE_LOG_RECORD_SIZE 32
+
+/**
+ * @brief Records per sector, the first slot holds the sector header
+ */
+#define SAMPLE_LOG_RECORDS_PER_SECTOR \
+    ((SAMPLE_LOG_SECTOR_SIZE / SAMPLE_LOG_RECORD_SIZE) - 1)
+
+/**
+ * @brief Timestamp of samples recorded during a previous boot, their
+ * esp_timer_get_time based timestamp can't be related to the current time
+ */
+#define SAMPLE_LOG_TIMESTAMP_UNKNOWN SENSOR_BATCH_TIMESTAMP_UNKNOWN
+
+/**
+ * @brief NOR flash access used by the log, writes may only clear bits and
+ * erasing a sector sets all of its bytes to 0xFF
+ */
+typedef struct {
+    void *context;
+    // Size of the flash area in bytes (multiple of SAMPLE_LOG_SECTOR_SIZE)
+    size_t size;
+    esp_err_t (*read)(void *context, size_t offset, void *data,
+                      size_t length);
+    esp_err_t (*write)(void *context, size_t offset, const void *data,
+                       size_t length);
+    esp_err_t (*erase_sector)(void *context, size_t offset);
+} sample_log_flash_t;
+
+/**
+ * @brief Sample log statistics
+ */
+typedef struct {
+    // Samples waiting to be replayed
+    uint32_t pending;
+    // Samples stored since startup
+    uint32_t appended;
+    // Samples replayed (consumed) since startup
+    uint32_t consumed;
+    // Unreplayed samples lost because the log wrapped around
+    uint32_t overwritten;
+    // Sector erases since startup
+    uint32_t erases;
+    // Records skipped because of a failed CRC check (e.g. power loss)
+    uint32_t corrupted;
+} sample_log_stats_t;
+
+/**
+ * @brief Open the sample log on a flash partition
+ *
+ * @param flash Output flash access
+ * @param label Partition label (data partition, see partitions.csv)
+ * @return esp_err_t ESP_ERR_NOT_FOUND if there is no such partition
+ */
+esp_err_t sample_log_partition_open(sample_log_flash_t *flash,
+                                    const char *label);
+
+/**
+ * @brief Mount the log, recovers the write position and the replay backlog
+ * from the flash contents (formats the flash if there is no log yet)
+ *
+ * The log is not thread safe, all functions have to be called from the same
+ * task.
+ *
+ * @param flash Flash access, copied
+ * @return esp_err_t
+ */
+esp_err_t sample_log_init(const sample_log_flash_t *flash);
+
+/**
+ * @brief Append a sample to the log, the sectors are used round robin so
+ * the oldest sector is erased (wear levelling) once the log is full
+ *
+ * @param sample The sample to store
+ * @return esp_err_t
+ */
+esp_err_t sample_log_append(const sensor_batch_sample_t *sample);
+
+/**
+ * @brief Number of samples waiting to be replayed
+ *
+ * @return size_t
+ */
+size_t sample_log_pending(void);
+
+/**
+ * @brief Read the oldest pending samples without consuming them
+ *
+ * @param samples Output array
+ * @param max_samples Size of the output array
+ * @return size_t Number of samples read
+ */
+size_t sample_log_peek(sensor_batch_sample_t *samples, size_t max_samples);
+
+/**
+ * @brief Mark the oldest pending samples as replayed
+ *
+ * @param count Number of samples, usually the count returned by
+ * sample_log_peek
+ * @return esp_err_t
+ */
+esp_err_t sample_log_consume(size_t count);
+
+/**
+ * @brief Get the sample log statistics
+ *
+ * @param stats Output statistics
+ */
+void sample_log_get_stats(sample_log_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SAMPLE_LOG_H
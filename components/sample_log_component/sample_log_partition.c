@@ -0,0 +1,50 @@
+/**
+ * @file sample_log_partition.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Flash partition backend of the sample log
+ * @version 0.1
+ * @date 2025-05-20
+ *
+ */
+
+#include "esp_partition.h"
+#include "sample_log.h"
+
+static esp_err_t sample_log_partition_read(void* context, size_t offset,
+                                           void* data, size_t length) {
+    return esp_partition_read((const esp_partition_t*)context, offset, data,
+                              length);
+}
+
+static esp_err_t sample_log_partition_write(void* context, size_t offset,
+                                            const void* data, size_t length) {
+    return esp_partition_write((const esp_partition_t*)context, offset, data,
+                               length);
+}
+
+static esp_err_t sample_log_partition_erase_sector(void* context,
+                                                   size_t offset) {
+    return esp_partition_erase_range((const esp_partition_t*)context, offset,
+                                     SAMPLE_LOG_SECTOR_SIZE);
+}
+
+esp_err_t sample_log_partition_open(sample_log_flash_t* flash,
+                                    const char* label) {
+    // Custom data subtype, see partitions.csv
+    const esp_partition_t* partition = esp_partition_find_first(
+        ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)0x40, label);
+    if (partition == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (partition->erase_size != SAMPLE_LOG_SECTOR_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    flash->context = (void*)partition;
+    flash->size = partition->size;
+    flash->read = sample_log_partition_read;
+    flash->write = sample_log_partition_write;
+    flash->erase_sector = sample_log_partition_erase_sector;
+
+    return ESP_OK;
+}
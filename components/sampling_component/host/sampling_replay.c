@@ -0,0 +1,321 @@
+/**
+ * @file sampling_replay.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Replays recorded humidity/temperature traces through the adaptive
+ * sampling scheduler on a host and compares it with fixed rate sampling
+ * (not part of the firmware build)
+ * @version 0.1
+ * @date 2025-05-25
+ *
+ * Build (the scheduler only needs esp_err.h from ESP-IDF):
+ *   gcc -O2 -I$IDF_PATH/components/esp_common/include
+ *       -Icomponents/sampling_component
+ *       components/sampling_component/host/sampling_replay.c
+ *       components/sampling_component/sampling_scheduler.c
+ *       components/sampling_component/publish_deadband.c -lm
+ *       -o sampling_replay
+ *
+ * Usage:
+ *   sampling_replay [--fixed MS] [--min MS] [--max MS] [--humidity CENTI]
+ *                   [--temperature CENTI] [--deadband-humidity CENTI]
+ *                   [--deadband-temperature CENTI] [--heartbeat MS]
+ *                   trace.csv...
+ *   sampling_replay --generate SECONDS > synthetic.csv
+ *
+ * A trace has one "seconds,humidity,temperature" line per reading, recorded
+ * at a higher rate than the fastest sampling interval (e.g. 1 s). Lines that
+ * don't parse (header, comments) are skipped. For every trace the number of
+ * publishes and the reconstruction error are printed: the receiver holds the
+ * last published value until the next one, the error is measured against
+ * every trace reading. The "deadband" row is adaptive sampling with the
+ * publish deadband applied to the samples.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "publish_deadband.h"
+#include "sampling_scheduler.h"
+
+/**
+ * @brief A reading of a trace
+ */
+typedef struct {
+    double seconds;
+    double humidity;
+    double temperature;
+} trace_point_t;
+
+/**
+ * @brief Result of replaying a trace
+ */
+typedef struct {
+    uint32_t publishes;
+    double humidity_rms;
+    double humidity_max;
+    double temperature_rms;
+    double temperature_max;
+} replay_result_t;
+
+/**
+ * @brief Helper for loading a trace, returns the number of readings
+ *
+ */
+static size_t load_trace(const char* path, trace_point_t** trace) {
+    FILE* file = fopen(path, "r");
+    char line[256];
+    size_t count = 0;
+    size_t capacity = 0;
+
+    *trace = NULL;
+    if (file == NULL) {
+        return 0;
+    }
+    while (fgets(line, sizeof(line), file) != NULL) {
+        trace_point_t point;
+        if (sscanf(line, "%lf,%lf,%lf", &point.seconds, &point.humidity,
+                   &point.temperature) != 3) {
+            continue;
+        }
+        // Readings must be in time order
+        if ((count > 0) && (point.seconds <= (*trace)[count - 1].seconds)) {
+            continue;
+        }
+        if (count == capacity) {
+            capacity = (capacity == 0) ? 1024 : capacity * 2;
+            trace_point_t* grown = realloc(*trace, capacity * sizeof(**trace));
+            if (grown == NULL) {
+                break;
+            }
+            *trace = grown;
+        }
+        (*trace)[count++] = point;
+    }
+    fclose(file);
+
+    return count;
+}
+
+/**
+ * @brief Helper for the value at a time between two readings (linear)
+ *
+ */
+static double interpolate(double seconds, double seconds_a, double value_a,
+                          double seconds_b, double value_b) {
+    if (seconds_b <= seconds_a) {
+        return value_b;
+    }
+    return value_a +
+           ((value_b - value_a) * (seconds - seconds_a) /
+            (seconds_b - seconds_a));
+}
+
+/**
+ * @brief Replay a trace through the scheduler and optionally the deadband
+ * (NULL publishes every sample)
+ *
+ */
+static void replay(const trace_point_t* trace, size_t count,
+                   const sampling_policy_t* policy,
+                   const publish_deadband_config_t* deadband_config,
+                   replay_result_t* result) {
+    sampling_scheduler_t scheduler;
+    publish_deadband_t deadband;
+    double next_seconds = trace[0].seconds;
+    double held_humidity = 0;
+    double held_temperature = 0;
+    double humidity_squares = 0;
+    double temperature_squares = 0;
+
+    *result = (replay_result_t){0};
+    sampling_scheduler_init(&scheduler, policy);
+    if (deadband_config != NULL) {
+        publish_deadband_init(&deadband, deadband_config);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        // Samples due since the previous reading, taken at their exact time
+        while (next_seconds <= trace[i].seconds) {
+            const trace_point_t* previous = &trace[(i > 0) ? (i - 1) : 0];
+            double humidity =
+                interpolate(next_seconds, previous->seconds, previous->humidity,
+                            trace[i].seconds, trace[i].humidity);
+            double temperature = interpolate(
+                next_seconds, previous->seconds, previous->temperature,
+                trace[i].seconds, trace[i].temperature);
+            // The firmware works with the sensor's hundredths
+            int16_t humidity_centi = (int16_t)lround(humidity * 100);
+            int16_t temperature_centi = (int16_t)lround(temperature * 100);
+
+            uint32_t interval_ms = sampling_scheduler_update(
+                &scheduler, humidity_centi, temperature_centi);
+            if ((deadband_config == NULL) ||
+                publish_deadband_check(&deadband, humidity_centi,
+                                       temperature_centi,
+                                       (int64_t)(next_seconds * 1e6), false)) {
+                held_humidity = humidity_centi / 100.0;
+                held_temperature = temperature_centi / 100.0;
+                result->publishes++;
+            }
+            next_seconds += interval_ms / 1000.0;
+        }
+
+        double humidity_error = fabs(trace[i].humidity - held_humidity);
+        double temperature_error =
+            fabs(trace[i].temperature - held_temperature);
+        humidity_squares += humidity_error * humidity_error;
+        temperature_squares += temperature_error * temperature_error;
+        result->humidity_max = fmax(result->humidity_max, humidity_error);
+        result->temperature_max =
+            fmax(result->temperature_max, temperature_error);
+    }
+
+    result->humidity_rms = sqrt(humidity_squares / count);
+    result->temperature_rms = sqrt(temperature_squares / count);
+}
+
+/**
+ * @brief Helper for printing a result
+ *
+ */
+static void print_result(const char* name, const replay_result_t* result,
+                         double hours) {
+    printf("  %-9s %8lu publishes %8.1f/h   RH rms %.3f max %.3f   "
+           "T rms %.3f max %.3f\n",
+           name, (unsigned long)result->publishes,
+           (hours > 0) ? (result->publishes / hours) : 0.0,
+           result->humidity_rms, result->humidity_max,
+           result->temperature_rms, result->temperature_max);
+}
+
+/**
+ * @brief Write a synthetic one-reading-per-second trace: a daily cycle,
+ * sensor noise and a few window openings (fast humidity/temperature drops
+ * with a slow recovery)
+ *
+ */
+static void generate_trace(long seconds) {
+    uint32_t random_state = 12345;
+
+    printf("seconds,humidity,temperature\n");
+    for (long t = 0; t < seconds; t++) {
+        double day = 2 * M_PI * (t % 86400) / 86400.0;
+        double humidity = 45 - 5 * sin(day);
+        double temperature = 22 + 2 * sin(day);
+
+        // A window is opened for 10 minutes every 6 hours
+        long event = t % (6 * 3600);
+        if (event > (3 * 3600)) {
+            double since = (event - (3 * 3600)) / 60.0;
+            double drop = (since < 10) ? (1 - exp(-since / 2))
+                                       : exp(-(since - 10) / 20);
+            humidity -= 10 * drop;
+            temperature -= 3 * drop;
+        }
+
+        // +-0.02 noise, within the sensor's resolution
+        random_state = random_state * 1103515245u + 12345u;
+        double noise = ((int)((random_state >> 16) % 5) - 2) / 100.0;
+        printf("%ld,%.2f,%.2f\n", t, humidity + noise, temperature + noise);
+    }
+}
+
+int main(int argc, char** argv) {
+    uint32_t fixed_ms = 5000;
+    sampling_policy_t policy = {
+        .min_interval_ms = 5000,
+        .max_interval_ms = 300000,
+        .humidity_threshold_centi = 50,
+        .temperature_threshold_centi = 20,
+    };
+    publish_deadband_config_t deadband_config = {
+        .humidity_centi = 30,
+        .temperature_centi = 10,
+        .heartbeat_ms = 900000,
+    };
+    int first_trace = argc;
+
+    for (int i = 1; i < argc; i++) {
+        bool has_value = (i + 1) < argc;
+        if ((strcmp(argv[i], "--generate") == 0) && has_value) {
+            generate_trace(atol(argv[i + 1]));
+            return 0;
+        } else if ((strcmp(argv[i], "--fixed") == 0) && has_value) {
+            fixed_ms = (uint32_t)atol(argv[++i]);
+        } else if ((strcmp(argv[i], "--min") == 0) && has_value) {
+            policy.min_interval_ms = (uint32_t)atol(argv[++i]);
+        } else if ((strcmp(argv[i], "--max") == 0) && has_value) {
+            policy.max_interval_ms = (uint32_t)atol(argv[++i]);
+        } else if ((strcmp(argv[i], "--humidity") == 0) && has_value) {
+            policy.humidity_threshold_centi = (uint16_t)atoi(argv[++i]);
+        } else if ((strcmp(argv[i], "--temperature") == 0) && has_value) {
+            policy.temperature_threshold_centi = (uint16_t)atoi(argv[++i]);
+        } else if ((strcmp(argv[i], "--deadband-humidity") == 0) &&
+                   has_value) {
+            deadband_config.humidity_centi = (uint16_t)atoi(argv[++i]);
+        } else if ((strcmp(argv[i], "--deadband-temperature") == 0) &&
+                   has_value) {
+            deadband_config.temperature_centi = (uint16_t)atoi(argv[++i]);
+        } else if ((strcmp(argv[i], "--heartbeat") == 0) && has_value) {
+            deadband_config.heartbeat_ms = (uint32_t)atol(argv[++i]);
+        } else {
+            first_trace = i;
+            break;
+        }
+    }
+
+    sampling_policy_t fixed_policy = {
+        .min_interval_ms = fixed_ms,
+        .max_interval_ms = fixed_ms,
+    };
+    if ((first_trace >= argc) ||
+        (sampling_policy_validate(&policy) != ESP_OK) ||
+        (sampling_policy_validate(&fixed_policy) != ESP_OK)) {
+        fprintf(stderr,
+                "usage: %s [--fixed MS] [--min MS] [--max MS] "
+                "[--humidity CENTI] [--temperature CENTI]\n"
+                "       [--deadband-humidity CENTI] "
+                "[--deadband-temperature CENTI] [--heartbeat MS] "
+                "trace.csv...\n"
+                "       %s --generate SECONDS\n",
+                argv[0], argv[0]);
+        return 2;
+    }
+
+    printf("adaptive: %lu..%lu ms, thresholds %u centi-%%RH / %u "
+           "centi-C, fixed: %lu ms\n",
+           (unsigned long)policy.min_interval_ms,
+           (unsigned long)policy.max_interval_ms,
+           policy.humidity_threshold_centi, policy.temperature_threshold_centi,
+           (unsigned long)fixed_ms);
+    printf("deadband: %u centi-%%RH / %u centi-C, heartbeat %lu ms\n",
+           deadband_config.humidity_centi, deadband_config.temperature_centi,
+           (unsigned long)deadband_config.heartbeat_ms);
+    for (int i = first_trace; i < argc; i++) {
+        trace_point_t* trace;
+        size_t count = load_trace(argv[i], &trace);
+        if (count == 0) {
+            fprintf(stderr, "%s: no readings\n", argv[i]);
+            free(trace);
+            continue;
+        }
+
+        double hours = (trace[count - 1].seconds - trace[0].seconds) / 3600;
+        replay_result_t fixed;
+        replay_result_t adaptive;
+        replay_result_t deadband;
+        replay(trace, count, &fixed_policy, NULL, &fixed);
+        replay(trace, count, &policy, NULL, &adaptive);
+        replay(trace, count, &policy, &deadband_config, &deadband);
+
+        printf("%s: %zu readings, %.1f h\n", argv[i], count, hours);
+        print_result("fixed", &fixed, hours);
+        print_result("adaptive", &adaptive, hours);
+        print_result("deadband", &deadband, hours);
+        free(trace);
+    }
+
+    return 0;
+}
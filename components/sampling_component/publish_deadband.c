@@ -0,0 +1,53 @@
+/**
+ * @file publish_deadband.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Report by exception, samples are only published when they moved
+ * more than a deadband since the last published sample or when the
+ * heartbeat expired
+ * @version 0.1
+ * @date 2025-05-26
+ *
+ */
+
+#include "publish_deadband.h"
+
+#include <stdlib.h>
+
+void publish_deadband_init(publish_deadband_t* deadband,
+                           const publish_deadband_config_t* config) {
+    *deadband = (publish_deadband_t){
+        .config = *config,
+    };
+}
+
+bool publish_deadband_check(publish_deadband_t* deadband,
+                            int16_t humidity_centi, int16_t temperature_centi,
+                            int64_t now_us, bool force) {
+    const publish_deadband_config_t* config = &deadband->config;
+    bool publish = force || !deadband->has_published;
+
+    if (!publish) {
+        // Measured against the last published sample, so a slow drift is
+        // published once it adds up to more than the deadband
+        int humidity_change = abs(humidity_centi - deadband->humidity_centi);
+        int temperature_change =
+            abs(temperature_centi - deadband->temperature_centi);
+        publish = (humidity_change > config->humidity_centi) ||
+                  (temperature_change > config->temperature_centi) ||
+                  ((config->heartbeat_ms > 0) &&
+                   ((now_us - deadband->published_us) >=
+                    ((int64_t)config->heartbeat_ms * 1000)));
+    }
+
+    if (!publish) {
+        deadband->suppressed++;
+        return false;
+    }
+
+    deadband->has_published = true;
+    deadband->humidity_centi = humidity_centi;
+    deadband->temperature_centi = temperature_centi;
+    deadband->published_us = now_us;
+    deadband->passed++;
+    return true;
+}
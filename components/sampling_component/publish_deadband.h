@@ -0,0 +1,78 @@
+/**
+ * @file publish_deadband.h
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Report by exception, samples are only published when they moved
+ * more than a deadband since the last published sample or when the
+ * heartbeat expired
+ * @version 0.1
+ * @date 2025-05-26
+ *
+ */
+
+#ifndef PUBLISH_DEADBAND_H
+#define PUBLISH_DEADBAND_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Deadband configuration
+ */
+typedef struct {
+    // Changes up to these values (in hundredths, centi-%RH / centi-°C) since
+    // the last published sample are not published
+    uint16_t humidity_centi;
+    uint16_t temperature_centi;
+    // Longest time without a publish, 0 disables the heartbeat
+    uint32_t heartbeat_ms;
+} publish_deadband_config_t;
+
+/**
+ * @brief Deadband state
+ */
+typedef struct {
+    publish_deadband_config_t config;
+    // Last published sample
+    bool has_published;
+    int16_t humidity_centi;
+    int16_t temperature_centi;
+    int64_t published_us;
+    // Samples passed / suppressed since startup
+    uint32_t passed;
+    uint32_t suppressed;
+} publish_deadband_t;
+
+/**
+ * @brief Initialize a deadband, the first sample is always published
+ *
+ * @param deadband The deadband
+ * @param config The configuration, copied
+ */
+void publish_deadband_init(publish_deadband_t *deadband,
+                           const publish_deadband_config_t *config);
+
+/**
+ * @brief Check if a sample should be published, a published sample becomes
+ * the new reference
+ *
+ * @param deadband The deadband
+ * @param humidity_centi Humidity in centi-%RH
+ * @param temperature_centi Temperature in centi-°C
+ * @param now_us Current time (esp_timer_get_time)
+ * @param force Publish regardless of the deadband (e.g. requested by the
+ * user), still becomes the reference
+ * @return true if the sample should be published
+ */
+bool publish_deadband_check(publish_deadband_t *deadband,
+                            int16_t humidity_centi, int16_t temperature_centi,
+                            int64_t now_us, bool force);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // PUBLISH_DEADBAND_H
@@ -0,0 +1,78 @@
+/**
+ * @file sampling_scheduler.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Adaptive sampling interval, fast while the humidity/temperature
+ * change and backing off while they are stable
+ * @version 0.1
+ * @date 2025-05-25
+ *
+ */
+
+#include "sampling_scheduler.h"
+
+#include <stdlib.h>
+
+esp_err_t sampling_policy_validate(const sampling_policy_t* policy) {
+    if ((policy == NULL) ||
+        (policy->min_interval_ms < SAMPLING_INTERVAL_MIN_MS) ||
+        (policy->max_interval_ms > SAMPLING_INTERVAL_MAX_MS) ||
+        (policy->min_interval_ms > policy->max_interval_ms)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+esp_err_t sampling_scheduler_init(sampling_scheduler_t* scheduler,
+                                  const sampling_policy_t* policy) {
+    if (sampling_policy_validate(policy) != ESP_OK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *scheduler = (sampling_scheduler_t){
+        .policy = *policy,
+        .interval_ms = policy->min_interval_ms,
+    };
+    return ESP_OK;
+}
+
+esp_err_t sampling_scheduler_set_policy(sampling_scheduler_t* scheduler,
+                                        const sampling_policy_t* policy) {
+    if (sampling_policy_validate(policy) != ESP_OK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    scheduler->policy = *policy;
+    scheduler->interval_ms = policy->min_interval_ms;
+    return ESP_OK;
+}
+
+uint32_t sampling_scheduler_update(sampling_scheduler_t* scheduler,
+                                   int16_t humidity_centi,
+                                   int16_t temperature_centi) {
+    const sampling_policy_t* policy = &scheduler->policy;
+    bool changed = true;
+
+    if (scheduler->has_previous) {
+        int humidity_change = abs(humidity_centi - scheduler->humidity_centi);
+        int temperature_change =
+            abs(temperature_centi - scheduler->temperature_centi);
+        changed = (humidity_change > policy->humidity_threshold_centi) ||
+                  (temperature_change > policy->temperature_threshold_centi);
+    }
+    scheduler->has_previous = true;
+    scheduler->humidity_centi = humidity_centi;
+    scheduler->temperature_centi = temperature_centi;
+    scheduler->samples++;
+
+    if (changed) {
+        // Catch the change at full rate
+        scheduler->changed_samples++;
+        scheduler->interval_ms = policy->min_interval_ms;
+    } else if (scheduler->interval_ms <= (policy->max_interval_ms / 2)) {
+        scheduler->interval_ms *= 2;
+    } else {
+        scheduler->interval_ms = policy->max_interval_ms;
+    }
+
+    return scheduler->interval_ms;
+}
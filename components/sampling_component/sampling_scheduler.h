@@ -0,0 +1,112 @@
+/**
+ * @file sampling_scheduler.h
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Adaptive sampling interval, fast while the humidity/temperature
+ * change and backing off while they are stable
+ * @version 0.1
+ * @date 2025-05-25
+ *
+ */
+
+#ifndef SAMPLING_SCHEDULER_H
+#define SAMPLING_SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Shortest accepted sampling interval (a ChipCap2 conversion takes
+ * up to ~50 ms)
+ */
+#define SAMPLING_INTERVAL_MIN_MS 500
+
+/**
+ * @brief Longest accepted sampling interval (1 day)
+ */
+#define SAMPLING_INTERVAL_MAX_MS 86400000
+
+/**
+ * @brief Sampling policy
+ */
+typedef struct {
+    // Interval while the signal changes
+    uint32_t min_interval_ms;
+    // Interval the backoff stops at while the signal is stable
+    uint32_t max_interval_ms;
+    // Change between two samples that counts as changing, in hundredths
+    // (centi-%RH / centi-°C)
+    uint16_t humidity_threshold_centi;
+    uint16_t temperature_threshold_centi;
+} sampling_policy_t;
+
+/**
+ * @brief Scheduler state, the interval drops to the minimum as soon as a
+ * sample moved more than a threshold and doubles (up to the maximum) after
+ * every sample that didn't
+ */
+typedef struct {
+    sampling_policy_t policy;
+    uint32_t interval_ms;
+    // Previous sample, the changes are measured against it
+    bool has_previous;
+    int16_t humidity_centi;
+    int16_t temperature_centi;
+    // Samples that moved more than a threshold / all samples
+    uint32_t changed_samples;
+    uint32_t samples;
+} sampling_scheduler_t;
+
+/**
+ * @brief Check a policy
+ *
+ * @param policy The policy
+ * @return esp_err_t ESP_ERR_INVALID_ARG if an interval is out of range or
+ * the minimum is above the maximum
+ */
+esp_err_t sampling_policy_validate(const sampling_policy_t *policy);
+
+/**
+ * @brief Initialize a scheduler, the first interval is the minimum
+ *
+ * @param scheduler The scheduler
+ * @param policy The policy, copied
+ * @return esp_err_t ESP_ERR_INVALID_ARG for an invalid policy
+ */
+esp_err_t sampling_scheduler_init(sampling_scheduler_t *scheduler,
+                                  const sampling_policy_t *policy);
+
+/**
+ * @brief Replace the policy, the next interval is the new minimum so the
+ * new policy takes effect right away
+ *
+ * @param scheduler The scheduler
+ * @param policy The policy, copied
+ * @return esp_err_t ESP_ERR_INVALID_ARG for an invalid policy (the current
+ * policy is kept)
+ */
+esp_err_t sampling_scheduler_set_policy(sampling_scheduler_t *scheduler,
+                                        const sampling_policy_t *policy);
+
+/**
+ * @brief Feed a sample and get the time until the next one
+ *
+ * @param scheduler The scheduler
+ * @param humidity_centi Humidity in centi-%RH
+ * @param temperature_centi Temperature in centi-°C
+ * @return uint32_t Interval until the next sample in milliseconds
+ */
+uint32_t sampling_scheduler_update(sampling_scheduler_t *scheduler,
+                                   int16_t humidity_centi,
+                                   int16_t temperature_centi);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SAMPLING_SCHEDULER_H
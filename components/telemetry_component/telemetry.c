@@ -0,0 +1,105 @@
+/**
+ * @file telemetry.c
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Runtime heap, stack and queue metrics for fleet monitoring
+ * @version 0.1
+ * @date 2025-05-24
+ *
+ */
+
+#include "telemetry.h"
+
+#include <stdio.h>
+
+#include "esp_heap_caps.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "gpio_controller.h"
+#include "mqtt_controller.h"
+
+static TaskHandle_t main_task = NULL;
+
+/**
+ * @brief Helper for the stack high-water mark of a task
+ *
+ */
+static uint32_t telemetry_stack_free(TaskHandle_t task) {
+    if (task == NULL) {
+        return TELEMETRY_STACK_UNKNOWN;
+    }
+    // In bytes on ESP-IDF (the stack type is 8 bits wide)
+    return (uint32_t)uxTaskGetStackHighWaterMark(task);
+}
+
+/**
+ * @brief Helper for formatting a stack high-water mark
+ *
+ */
+static const char* telemetry_stack_string(uint32_t stack_free, char* buffer,
+                                          size_t buffer_size) {
+    if (stack_free == TELEMETRY_STACK_UNKNOWN) {
+        return "null";
+    }
+    snprintf(buffer, buffer_size, "%lu", (unsigned long)stack_free);
+    return buffer;
+}
+
+void telemetry_init(void) { main_task = xTaskGetCurrentTaskHandle(); }
+
+void telemetry_sample(telemetry_metrics_t* metrics) {
+    event_bus_stats_t event_stats;
+
+    metrics->uptime_s = (uint32_t)(esp_timer_get_time() / 1000000);
+    metrics->free_heap = esp_get_free_heap_size();
+    metrics->minimum_free_heap = esp_get_minimum_free_heap_size();
+    metrics->largest_free_block =
+        heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT);
+
+    metrics->stack_free[TELEMETRY_TASK_MAIN] = telemetry_stack_free(main_task);
+    metrics->stack_free[TELEMETRY_TASK_GPIO] =
+        telemetry_stack_free(gpio_controller_get_task_handle());
+    metrics->stack_free[TELEMETRY_TASK_MQTT] =
+        telemetry_stack_free(mqtt_controller_get_task_handle());
+
+    event_bus_get_stats(&event_stats);
+    metrics->events_dropped = 0;
+    for (size_t i = 0; i < EVENT_BUS_LANE_COUNT; i++) {
+        metrics->events_waiting[i] = event_stats.lanes[i].waiting;
+        metrics->events_dropped += event_stats.lanes[i].dropped;
+    }
+    metrics->mqtt_outbox = (uint32_t)mqtt_controller_get_outbox_size();
+    metrics->publishes_suppressed = 0;
+}
+
+esp_err_t telemetry_format_json(const telemetry_metrics_t* metrics,
+                                char* buffer, size_t buffer_size) {
+    char stacks[TELEMETRY_TASK_COUNT][12];
+
+    int written = snprintf(
+        buffer, buffer_size,
+        "{\"up\":%lu,\"heap\":[%lu,%lu,%lu],\"stack\":[%s,%s,%s],"
+        "\"events\":[%lu,%lu,%lu],\"dropped\":%lu,\"outbox\":%lu,"
+        "\"suppressed\":%lu}",
+        (unsigned long)metrics->uptime_s, (unsigned long)metrics->free_heap,
+        (unsigned long)metrics->minimum_free_heap,
+        (unsigned long)metrics->largest_free_block,
+        telemetry_stack_string(metrics->stack_free[TELEMETRY_TASK_MAIN],
+                               stacks[0], sizeof(stacks[0])),
+        telemetry_stack_string(metrics->stack_free[TELEMETRY_TASK_GPIO],
+                               stacks[1], sizeof(stacks[1])),
+        telemetry_stack_string(metrics->stack_free[TELEMETRY_TASK_MQTT],
+                               stacks[2], sizeof(stacks[2])),
+        (unsigned long)metrics->events_waiting[EVENT_BUS_LANE_HIGH],
+        (unsigned long)metrics->events_waiting[EVENT_BUS_LANE_NORMAL],
+        (unsigned long)metrics->events_waiting[EVENT_BUS_LANE_LOW],
+        (unsigned long)metrics->events_dropped,
+        (unsigned long)metrics->mqtt_outbox,
+        (unsigned long)metrics->publishes_suppressed);
+    if ((written < 0) || ((size_t)written >= buffer_size)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    return ESP_OK;
+}
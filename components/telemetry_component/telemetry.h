@@ -0,0 +1,96 @@
+/**
+ * @file telemetry.h
+ * @author Matic Kukovec (https://github.com/matkuki)
+ * @brief Runtime heap, stack and queue metrics for fleet monitoring
+ * @version 0.1
+ * @date 2025-05-24
+ *
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "event_bus.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Stack high-water mark of a task that doesn't exist (yet)
+ */
+#define TELEMETRY_STACK_UNKNOWN UINT32_MAX
+
+/**
+ * @brief Tasks whose stack high-water marks are sampled
+ */
+typedef enum {
+    TELEMETRY_TASK_MAIN = 0,
+    TELEMETRY_TASK_GPIO,
+    TELEMETRY_TASK_MQTT,
+    TELEMETRY_TASK_COUNT,
+} telemetry_task_t;
+
+/**
+ * @brief A sample of the runtime metrics
+ */
+typedef struct {
+    // Seconds since startup
+    uint32_t uptime_s;
+    // Free heap right now
+    uint32_t free_heap;
+    // Lowest free heap since startup
+    uint32_t minimum_free_heap;
+    // Largest allocatable block, far below free_heap means fragmentation
+    uint32_t largest_free_block;
+    // Least free stack since the task started, in bytes
+    // (TELEMETRY_STACK_UNKNOWN if the task doesn't exist)
+    uint32_t stack_free[TELEMETRY_TASK_COUNT];
+    // Events queued on the event bus lanes
+    uint32_t events_waiting[EVENT_BUS_LANE_COUNT];
+    // Events dropped by the event bus since startup (all lanes)
+    uint32_t events_dropped;
+    // Bytes in the MQTT outbox
+    uint32_t mqtt_outbox;
+    // Periodic publishes suppressed by the deadband since startup, the
+    // deadband is owned by the application which fills this in
+    uint32_t publishes_suppressed;
+} telemetry_metrics_t;
+
+/**
+ * @brief Initialize the telemetry, must be called from the main task (its
+ * stack is sampled as TELEMETRY_TASK_MAIN)
+ *
+ */
+void telemetry_init(void);
+
+/**
+ * @brief Sample the runtime metrics (publishes_suppressed is set to 0)
+ *
+ * @param metrics Output metrics
+ */
+void telemetry_sample(telemetry_metrics_t *metrics);
+
+/**
+ * @brief Format metrics as compact JSON, e.g.
+ * {"up":60,"heap":[free,minimum,largest],"stack":[main,gpio,mqtt],
+ * "events":[high,normal,low],"dropped":0,"outbox":0,"suppressed":0} (null
+ * for unknown stacks)
+ *
+ * @param metrics The metrics
+ * @param buffer Output buffer
+ * @param buffer_size Size of the output buffer
+ * @return esp_err_t ESP_ERR_INVALID_SIZE if the buffer is too small
+ */
+esp_err_t telemetry_format_json(const telemetry_metrics_t *metrics,
+                                char *buffer, size_t buffer_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // TELEMETRY_H
@@ -9,7 +9,11 @@
 
 #include "uart_comm.h"
 
+#include <stdarg.h>
+#include <stdatomic.h>
+
 #include "driver/uart.h"
+#include "esp_cpu.h"
 #include "esp_log.h"
 #include "esp_system.h"
 #include "freertos/FreeRTOS.h"
@@ -44,6 +48,156 @@
 // state on receive pin
 #define ECHO_READ_TOUT (3)  // 3.5T * 8 = 28 ticks, TOUT=3 -> ~24..33 ticks
 
+// Asynchronous logging: callers format directly into a slot of a lock-free
+// queue and a low priority task drains the queue to the UART
+// (always a power of two, positions are masked)
+#define LOG_SLOT_COUNT (1U << CONFIG_UART_LOG_SLOT_COUNT_BITS)
+#define LOG_SLOT_MASK (LOG_SLOT_COUNT - 1)
+#define LOG_TASK_STACK_SIZE (2048)
+#define LOG_TASK_PRIO (1)
+// Caller latency benchmark: rounds of one queue full of lines each
+#define BENCHMARK_ROUNDS 8
+
+/**
+ * @brief Log queue slot, the sequence number tells whether the slot is free
+ * for the producer (sequence == position) or holds a committed line for the
+ * drain task (sequence == position + 1)
+ */
+typedef struct {
+    atomic_uint_fast32_t sequence;
+    uint8_t length;
+    char data[UART_COMM_LINE_SIZE];
+} uart_comm_log_slot_t;
+
+static uart_comm_log_slot_t log_slots[LOG_SLOT_COUNT];
+static atomic_uint_fast32_t log_enqueue_position = 0;
+// Only touched by the drain task
+static uint32_t log_dequeue_position = 0;
+static TaskHandle_t log_task_handle = NULL;
+// Statistics
+static atomic_uint_fast32_t log_lines_queued = 0;
+static atomic_uint_fast32_t log_lines_dropped = 0;
+static atomic_uint_fast32_t log_lines_truncated = 0;
+static uint32_t log_lines_written = 0;
+static uint32_t log_write_errors = 0;
+
+/**
+ * @brief Helper for reserving a free slot, never blocks
+ *
+ * @return uart_comm_log_slot_t* NULL if the queue is full
+ */
+static uart_comm_log_slot_t* uart_comm_log_reserve(uint32_t *position) {
+    // Not initialized yet, there is no task to drain the queue
+    if (log_task_handle == NULL) {
+        return NULL;
+    }
+
+    uint_fast32_t pos =
+        atomic_load_explicit(&log_enqueue_position, memory_order_relaxed);
+    for (;;) {
+        uart_comm_log_slot_t* slot = &log_slots[pos & LOG_SLOT_MASK];
+        uint32_t sequence =
+            atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        int32_t difference = (int32_t)(sequence - pos);
+
+        if (difference == 0) {
+            // Slot is free, claim it (on failure pos is reloaded)
+            if (atomic_compare_exchange_weak_explicit(
+                    &log_enqueue_position, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed)) {
+                *position = (uint32_t)pos;
+                return slot;
+            }
+        } else if (difference < 0) {
+            // The drain task has not consumed this slot yet, queue is full
+            return NULL;
+        } else {
+            pos = atomic_load_explicit(&log_enqueue_position,
+                                       memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * @brief Helper for handing a filled slot over to the drain task
+ *
+ */
+static void uart_comm_log_commit(uart_comm_log_slot_t* slot, uint32_t position,
+                                 int length) {
+    if (length >= UART_COMM_LINE_SIZE) {
+        length = UART_COMM_LINE_SIZE - 1;
+        atomic_fetch_add_explicit(&log_lines_truncated, 1,
+                                  memory_order_relaxed);
+    } else if (length < 0) {
+        length = 0;
+    }
+    slot->length = (uint8_t)length;
+
+    atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+    atomic_fetch_add_explicit(&log_lines_queued, 1, memory_order_relaxed);
+
+    if (log_task_handle != NULL) {
+        xTaskNotifyGive(log_task_handle);
+    }
+}
+
+/**
+ * @brief Helper for counting a line that did not fit into the queue
+ *
+ */
+static void uart_comm_log_drop(void) {
+    atomic_fetch_add_explicit(&log_lines_dropped, 1, memory_order_relaxed);
+}
+
+/**
+ * @brief Drain task, writes the committed lines to the UART in order
+ *
+ */
+static void uart_comm_log_task(void* arg) {
+    uint32_t reported_drops = 0;
+    char report[48];
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        for (;;) {
+            uart_comm_log_slot_t* slot =
+                &log_slots[log_dequeue_position & LOG_SLOT_MASK];
+            uint32_t sequence =
+                atomic_load_explicit(&slot->sequence, memory_order_acquire);
+            if (sequence != log_dequeue_position + 1) {
+                // Empty, or the producer has not committed the slot yet (it
+                // notifies again on commit)
+                break;
+            }
+
+            if (uart_write_bytes(ECHO_UART_PORT, slot->data, slot->length) ==
+                slot->length) {
+                log_lines_written++;
+            } else {
+                log_write_errors++;
+            }
+
+            // Release the slot for the producers of the next lap
+            atomic_store_explicit(&slot->sequence,
+                                  log_dequeue_position + LOG_SLOT_COUNT,
+                                  memory_order_release);
+            log_dequeue_position++;
+        }
+
+        // Report dropped lines once the queue has been drained
+        uint32_t drops =
+            atomic_load_explicit(&log_lines_dropped, memory_order_relaxed);
+        if (drops != reported_drops) {
+            int length = snprintf(report, sizeof(report),
+                                  "[UART-LOG] %lu line(s) dropped\r\n",
+                                  (unsigned long)(drops - reported_drops));
+            uart_write_bytes(ECHO_UART_PORT, report, length);
+            reported_drops = drops;
+        }
+    }
+}
+
 void uart_comm_init(void) {
     uart_config_t uart_config = {
         .baud_rate = BAUD_RATE,
@@ -73,36 +227,276 @@ void uart_comm_init(void) {
 
     // Set read timeout of UART TOUT feature
     ESP_ERROR_CHECK(uart_set_rx_timeout(ECHO_UART_PORT, ECHO_READ_TOUT));
+
+    // Start the asynchronous logging, lines sent before this are dropped
+    for (uint32_t i = 0; i < LOG_SLOT_COUNT; i++) {
+        atomic_init(&log_slots[i].sequence, i);
+    }
+    atomic_store(&log_enqueue_position, 0);
+    log_dequeue_position = 0;
+    if (xTaskCreate(uart_comm_log_task, "uart_comm_log_task",
+                    LOG_TASK_STACK_SIZE, NULL, LOG_TASK_PRIO,
+                    &log_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create the logging task.");
+        abort();
+    }
 }
 
 void uart_comm_send(const char* str, uint8_t length) {
-    if (uart_write_bytes(ECHO_UART_PORT, str, length) != length) {
-        ESP_LOGE(TAG, "Send data critical failure.");
-        // Handle a failure
-        abort();
+    // Split into line sized chunks, each chunk is queued independently
+    while (length > 0) {
+        uint8_t chunk = (length < UART_COMM_LINE_SIZE - 1)
+                            ? length
+                            : (UART_COMM_LINE_SIZE - 1);
+        uint32_t position = 0;
+        uart_comm_log_slot_t* slot = uart_comm_log_reserve(&position);
+        if (slot == NULL) {
+            uart_comm_log_drop();
+            return;
+        }
+        memcpy(slot->data, str, chunk);
+        uart_comm_log_commit(slot, position, chunk);
+
+        str += chunk;
+        length -= chunk;
     }
 }
 
-void uart_comm_vsend(const char* format, ...) {
-    // Character buffer, you can increase the size if needed
-    char buffer[128];
+// Parentheses stop the binary log macro from expanding
+void(uart_comm_vsend)(const char* format, ...) {
+    uint32_t position = 0;
+    uart_comm_log_slot_t* slot = uart_comm_log_reserve(&position);
+    if (slot == NULL) {
+        // Never block the caller, the drain task reports the drops
+        uart_comm_log_drop();
+        return;
+    }
 
     // Initialize the variable arguments
     va_list args;
     // Initialize internal variable argument things
     va_start(args, format);
 
-    // Format the string
-    int len = vsnprintf(buffer, sizeof(buffer), format, args);
+    // Format the string directly into the queue slot
+    int len = vsnprintf(slot->data, sizeof(slot->data), format, args);
+
+    // Clean up internal variable argument things
+    va_end(args);
+
+    uart_comm_log_commit(slot, position, len);
+}
 
-    // Zero the remaining unused bytes (if any)
-    if (len > 0 && len < sizeof(buffer)) {
-        memset(buffer + len, 0, sizeof(buffer) - len);
+/**
+ * @brief Helper for appending raw little endian bytes to a trace frame
+ *
+ */
+static bool uart_comm_trace_append(uint8_t* frame, size_t* offset,
+                                   uint64_t value, size_t size) {
+    // The last byte stays reserved, same as for the text lines
+    if (*offset + size > UART_COMM_LINE_SIZE - 1) {
+        return false;
+    }
+    for (size_t i = 0; i < size; i++) {
+        frame[(*offset)++] = (uint8_t)(value >> (8 * i));
+    }
+    return true;
+}
+
+void uart_comm_trace(const char* format, ...) {
+    uint32_t position = 0;
+    uart_comm_log_slot_t* slot = uart_comm_log_reserve(&position);
+    if (slot == NULL) {
+        uart_comm_log_drop();
+        return;
+    }
+
+    uint8_t* frame = (uint8_t*)slot->data;
+    size_t offset = UART_COMM_TRACE_HEADER_SIZE;
+    bool fits = true;
+    uint32_t address = (uint32_t)(uintptr_t)format;
+
+    frame[0] = UART_COMM_TRACE_SYNC;
+    frame[1] = (uint8_t)address;
+    frame[2] = (uint8_t)(address >> 8);
+    frame[3] = (uint8_t)(address >> 16);
+    frame[4] = (uint8_t)(address >> 24);
+
+    va_list args;
+    va_start(args, format);
+
+    // Only the argument types are decoded, the host does the formatting
+    for (const char* c = format; fits && (*c != '\0'); c++) {
+        if (*c != '%') {
+            continue;
+        }
+        c++;
+        // Flags, width and precision ('*' takes an int argument)
+        while ((*c != '\0') && (strchr("-+ #0123456789.*", *c) != NULL)) {
+            if (*c == '*') {
+                fits = uart_comm_trace_append(frame, &offset,
+                                              (uint32_t)va_arg(args, int), 4);
+            }
+            c++;
+        }
+        // Length modifiers, intmax_t ('j') is 64-bit like long long
+        int longs = 0;
+        while ((*c != '\0') && (strchr("hlzjt", *c) != NULL)) {
+            if (*c == 'l') {
+                longs++;
+            } else if (*c == 'j') {
+                longs = 2;
+            }
+            c++;
+        }
+
+        switch (*c) {
+            case 'd':
+            case 'i':
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o':
+            case 'c':
+                if (longs >= 2) {
+                    fits = uart_comm_trace_append(
+                        frame, &offset,
+                        (uint64_t)va_arg(args, long long), 8);
+                } else if (longs == 1) {
+                    fits = uart_comm_trace_append(
+                        frame, &offset, (uint32_t)va_arg(args, long), 4);
+                } else {
+                    fits = uart_comm_trace_append(
+                        frame, &offset, (uint32_t)va_arg(args, int), 4);
+                }
+                break;
+            case 'p':
+                fits = uart_comm_trace_append(
+                    frame, &offset, (uintptr_t)va_arg(args, void*), 4);
+                break;
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A': {
+                double number = va_arg(args, double);
+                uint64_t bits = 0;
+                memcpy(&bits, &number, sizeof(bits));
+                fits = uart_comm_trace_append(frame, &offset, bits, 8);
+                break;
+            }
+            case 's': {
+                // Copied including the null terminator
+                const char* string = va_arg(args, const char*);
+                if (string == NULL) {
+                    string = "(null)";
+                }
+                do {
+                    fits = uart_comm_trace_append(frame, &offset,
+                                                  (uint8_t)*string, 1);
+                } while (fits && (*string++ != '\0'));
+                break;
+            }
+            case '\0':
+                // Dangling '%' at the end of the format
+                c--;
+                break;
+            default:
+                // '%%' and unsupported conversions take no argument
+                break;
+        }
     }
 
-    // Clean up internal variable argument things
     va_end(args);
 
-    // Send the buffer over the UART
-    uart_comm_send(buffer, len);
-}
\ No newline at end of file
+    if (!fits) {
+        atomic_fetch_add_explicit(&log_lines_truncated, 1,
+                                  memory_order_relaxed);
+    }
+    frame[5] = (uint8_t)(offset - UART_COMM_TRACE_HEADER_SIZE);
+    uart_comm_log_commit(slot, position, (int)offset);
+}
+
+void uart_comm_get_stats(uart_comm_stats_t* stats) {
+    stats->lines_queued =
+        atomic_load_explicit(&log_lines_queued, memory_order_relaxed);
+    stats->lines_dropped =
+        atomic_load_explicit(&log_lines_dropped, memory_order_relaxed);
+    stats->lines_truncated =
+        atomic_load_explicit(&log_lines_truncated, memory_order_relaxed);
+    stats->lines_written = log_lines_written;
+    stats->write_errors = log_write_errors;
+}
+
+#if CONFIG_UART_LOG_BENCHMARK
+/**
+ * @brief Helper that waits until the drain task has written every queued
+ * line and the UART has sent it
+ *
+ */
+static void uart_comm_benchmark_wait_idle(void) {
+    while (log_lines_written + log_write_errors <
+           atomic_load_explicit(&log_lines_queued, memory_order_relaxed)) {
+        vTaskDelay(1);
+    }
+    uart_wait_tx_done(ECHO_UART_PORT, portMAX_DELAY);
+}
+
+/**
+ * @brief Helper that sends a line the way uart_comm_vsend did before the
+ * queue: formatted on the caller's stack, then a blocking UART write
+ *
+ */
+static void uart_comm_benchmark_blocking_vsend(const char* format, ...) {
+    char buffer[UART_COMM_LINE_SIZE];
+    va_list args;
+
+    va_start(args, format);
+    int len = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    if (len >= (int)sizeof(buffer)) {
+        len = sizeof(buffer) - 1;
+    }
+    if (len > 0) {
+        uart_write_bytes(ECHO_UART_PORT, buffer, len);
+    }
+}
+
+void uart_comm_benchmark(void) {
+    uint32_t queued_cycles = 0;
+    uint32_t blocking_cycles = 0;
+    uint32_t lines = 0;
+
+    for (uint32_t round = 0; round < BENCHMARK_ROUNDS; round++) {
+        // A queue full of lines per round, so none are dropped
+        uart_comm_benchmark_wait_idle();
+        uint32_t start = esp_cpu_get_cycle_count();
+        for (uint32_t i = 0; i < LOG_SLOT_COUNT; i++) {
+            // Parentheses stop the binary log macro from expanding
+            (uart_comm_vsend)("[UART-BENCH] queued line %lu, value %d\r\n",
+                              (unsigned long)i, -12345);
+        }
+        queued_cycles += esp_cpu_get_cycle_count() - start;
+
+        uart_comm_benchmark_wait_idle();
+        start = esp_cpu_get_cycle_count();
+        for (uint32_t i = 0; i < LOG_SLOT_COUNT; i++) {
+            uart_comm_benchmark_blocking_vsend(
+                "[UART-BENCH] direct line %lu, value %d\r\n",
+                (unsigned long)i, -12345);
+        }
+        blocking_cycles += esp_cpu_get_cycle_count() - start;
+        lines += LOG_SLOT_COUNT;
+    }
+
+    uart_comm_benchmark_wait_idle();
+    (uart_comm_vsend)(
+        "[UART-BENCH] caller cycles per line: queued %lu, blocking %lu "
+        "(%lu lines)\r\n",
+        (unsigned long)(queued_cycles / lines),
+        (unsigned long)(blocking_cycles / lines), (unsigned long)lines);
+}
+#endif
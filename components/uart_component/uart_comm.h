@@ -10,22 +10,59 @@
 #ifndef UART_COMM_H
 #define UART_COMM_H
 
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "sdkconfig.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /**
- * @brief UART RS485 initialization
+ * @brief Maximum length of a single queued line (including the null
+ * terminator), longer lines are truncated
+ */
+#define UART_COMM_LINE_SIZE 128
+
+/**
+ * @brief Binary log frame: UART_COMM_TRACE_SYNC, 32-bit little endian
+ * address of the format string in the firmware ELF, payload length byte,
+ * then the raw arguments (see uart_trace_decode.py)
+ */
+#define UART_COMM_TRACE_SYNC 0x1E
+#define UART_COMM_TRACE_HEADER_SIZE 6
+// Section holding the format strings, placed into flash rodata
+#define UART_COMM_TRACE_SECTION ".rodata.uart_trace_fmt"
+
+/**
+ * @brief Asynchronous logging statistics
+ */
+typedef struct {
+    // Lines handed over to the drain task
+    uint32_t lines_queued;
+    // Lines dropped because the queue was full
+    uint32_t lines_dropped;
+    // Lines longer than UART_COMM_LINE_SIZE - 1
+    uint32_t lines_truncated;
+    // Lines written to the UART by the drain task
+    uint32_t lines_written;
+    // Failed UART writes
+    uint32_t write_errors;
+} uart_comm_stats_t;
+
+/**
+ * @brief UART RS485 initialization, also starts the logging drain task
  *
  */
 void uart_comm_init(void);
 
 /**
- * @brief Send (transmit) a string over the UART module
+ * @brief Send (transmit) a string over the UART module, the string is queued
+ * and sent by the drain task (never blocks, the string is dropped if the
+ * queue is full)
  *
  * @param str String buffer to send over UART
  * @param length The length of the string buffer
@@ -34,11 +71,53 @@ void uart_comm_send(const char* str, uint8_t length);
 
 /**
  * @brief Send (transmit) a formatted string over the UART module (uses
- * vsnprintf internally)
+ * vsnprintf internally), the line is formatted directly into the queue and
+ * sent by the drain task (never blocks, the line is dropped if the queue is
+ * full)
  *
  */
 void uart_comm_vsend(const char* format, ...);
 
+/**
+ * @brief Queue a binary log frame, the format string is not formatted on
+ * target but decoded on the host. Use uart_comm_vsend with a string literal
+ * format instead of calling this directly.
+ *
+ * Supported conversions: integers (including l/ll/j/h/z modifiers), c, p,
+ * floating point (sent as 8 byte doubles) and s (copied into the frame).
+ *
+ * @param format Format string placed in UART_COMM_TRACE_SECTION
+ */
+void uart_comm_trace(const char* format, ...);
+
+#if CONFIG_UART_LOG_BINARY
+// Store the format string in the firmware image and only send its address
+// and the raw arguments, requires a string literal format
+#define uart_comm_vsend(format, ...)                                         \
+    do {                                                                     \
+        static const char uart_comm_trace_format[]                           \
+            __attribute__((section(UART_COMM_TRACE_SECTION))) = format;      \
+        uart_comm_trace(uart_comm_trace_format, ##__VA_ARGS__);              \
+    } while (0)
+#endif
+
+/**
+ * @brief Get the asynchronous logging statistics
+ *
+ * @param stats Output statistics
+ */
+void uart_comm_get_stats(uart_comm_stats_t* stats);
+
+#if CONFIG_UART_LOG_BENCHMARK
+/**
+ * @brief Measure the caller latency of uart_comm_vsend against a blocking
+ * UART write of the same lines (the logging before the queue) and log the
+ * CPU cycles per line of both, blocks until all lines are sent
+ *
+ */
+void uart_comm_benchmark(void);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -7,44 +7,106 @@
  * @date 2025-04-14
  *
  */
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 
+#include "cjson_cbor.h"
 #include "cjson_component.h"
+#include "cjson_pool.h"
+#include "cjson_tokens.h"
 #include "custom_data_types.h"
 #include "driver/i2c_master.h"
 #include "esp_log.h"
+#include "esp_system.h"
 #include "esp_timer.h"
+#include "event_bus.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "gpio_controller.h"
 #include "i2c_chipcap2.h"
 #include "i2c_controller.h"
+#include "latency_trace.h"
 #include "led.h"
+#include "mqtt_commands.h"
 #include "mqtt_controller.h"
 #include "ota_controller.h"
+#include "publish_deadband.h"
+#include "sample_log.h"
+#include "sampling_scheduler.h"
 #include "sdkconfig.h"
+#include "sensor_batch.h"
+#include "telemetry.h"
 #include "uart_comm.h"
 #include "wifi_controller.h"
 
 // Functionality enabling/disabling macros
 #define MQTT_ENABLED 1
+#if defined(CONFIG_SAMPLE_LOG_ENABLED) && (MQTT_ENABLED == 1)
+#define SAMPLE_LOG_ACTIVE 1
+#else
+#define SAMPLE_LOG_ACTIVE 0
+#endif
 
 // General
 static const char* TAG = "matic's supermini demo";
+#if CONFIG_SENSOR_PAYLOAD_CBOR
+static uint8_t cbor_message_buffer[96] = {0};
+#else
 static char message_buffer[200] = {0};
-// Queues
-static QueueHandle_t general_event_queue = NULL;
-// Mutexes
-SemaphoreHandle_t read_and_publish_mutex;
+#endif
 // Timers
 TimerHandle_t read_publish_timer;
 bool button_hold_flag = false;
 // ChipCap2 sensor
 static i2c_chipcap2_data_t chipcap2_out_data = {0};
+// Actions performed when the pending ChipCap2 measurement completes
+#define SENSOR_ACTION_PUBLISH (1 << 0)
+#define SENSOR_ACTION_BATCH (1 << 1)
+#define SENSOR_ACTION_TRACE (1 << 2)
+#define SENSOR_ACTION_SCHEDULE (1 << 3)
+// Requested by the user, bypasses the deadband
+#define SENSOR_ACTION_FORCE (1 << 4)
+static uint8_t sensor_pending_actions = 0;
+// Adaptive period of read_publish_timer, the MQTT task hands new policies
+// over through the mailbox (single slot queue that always holds the current
+// policy)
+static sampling_scheduler_t sampling_scheduler;
+static QueueHandle_t sampling_policy_mailbox = NULL;
+#if CONFIG_PUBLISH_DEADBAND_ENABLED
+// Report by exception of the periodic samples
+static publish_deadband_t publish_deadband;
+#endif
+#if CONFIG_SENSOR_BATCH_ENABLED
+// Batched publishing, sized for the worst case of ~30 bytes per sample
+static char batch_message_buffer[128 + SENSOR_BATCH_CAPACITY * 30] = {0};
+static sensor_batch_sample_t batch_publish_samples[SENSOR_BATCH_CAPACITY];
+static uint32_t batch_publish_count = 0;
+static uint32_t batch_publish_bytes = 0;
+#endif
+#if SAMPLE_LOG_ACTIVE
+// Store-and-forward of the samples taken while MQTT is offline
+#define SAMPLE_LOG_PARTITION_LABEL "sample_log"
+static bool mqtt_online = false;
+static bool sample_log_ready = false;
+static TimerHandle_t sample_log_replay_timer = NULL;
+static char replay_message_buffer[128 + CONFIG_SAMPLE_LOG_REPLAY_BATCH * 30] =
+    {0};
+static sensor_batch_sample_t replay_samples[CONFIG_SAMPLE_LOG_REPLAY_BATCH];
+#endif
 
-int64_t start_time = 0;
-int64_t end_time = 0;
+// Latency trace of the read-and-publish round trip in progress, the
+// receive time of the command and the end of the last recorded span
+static int64_t trace_received_us = 0;
+static int64_t trace_span_start_us = 0;
+#if MQTT_ENABLED == 1
+static char latency_message_buffer[2048] = {0};
+#endif
+#if CONFIG_TELEMETRY_ENABLED
+// Runtime metrics, published periodically on their own topic
+static TimerHandle_t telemetry_timer = NULL;
+static char telemetry_message_buffer[224] = {0};
+#endif
 
 /**
  * @brief Callback that fires when the timer elapses
@@ -52,8 +114,70 @@ int64_t end_time = 0;
  * @param xTimer Timer handle to the timer that spawned the event
  */
 static void timer_callback(TimerHandle_t xTimer) {
-    event_t new_event = EVENT_TIMER_ELAPSED;
-    xQueueSend(general_event_queue, &new_event, portMAX_DELAY);
+    // Never blocks the timer task, a tick that is still queued absorbs this
+    // one (coalesced)
+    event_bus_post(EVENT_TIMER_ELAPSED);
+}
+
+#if CONFIG_TELEMETRY_ENABLED
+/**
+ * @brief Callback of the telemetry timer
+ *
+ * @param xTimer Timer handle to the timer that spawned the event
+ */
+static void telemetry_timer_callback(TimerHandle_t xTimer) {
+    event_bus_post(EVENT_TELEMETRY);
+}
+#endif
+
+/**
+ * @brief Helper for the read&publish timer period of a sampling interval.
+ * While batching, the batch is only flushed when a sample is taken, so the
+ * period is capped to the batch flush interval.
+ *
+ */
+static TickType_t sampling_timer_period(uint32_t interval_ms) {
+#if CONFIG_SENSOR_BATCH_ENABLED
+    if (interval_ms > (CONFIG_SENSOR_BATCH_FLUSH_INTERVAL * 1000)) {
+        interval_ms = CONFIG_SENSOR_BATCH_FLUSH_INTERVAL * 1000;
+    }
+#endif
+    return pdMS_TO_TICKS(interval_ms);
+}
+
+/**
+ * @brief Initialize the adaptive sampling from the menuconfig policy
+ *
+ */
+static void sampling_init(void) {
+    sampling_policy_t policy = {
+        .min_interval_ms = CONFIG_SAMPLING_MIN_INTERVAL_MS,
+        .max_interval_ms = CONFIG_SAMPLING_MAX_INTERVAL_MS,
+        .humidity_threshold_centi = CONFIG_SAMPLING_HUMIDITY_THRESHOLD,
+        .temperature_threshold_centi = CONFIG_SAMPLING_TEMPERATURE_THRESHOLD,
+    };
+
+    if (sampling_scheduler_init(&sampling_scheduler, &policy) != ESP_OK) {
+        uart_comm_vsend(
+            "[SAMPLING-ERROR] Invalid policy, sampling at the fastest "
+            "interval!\r\n");
+        policy.max_interval_ms = policy.min_interval_ms;
+        sampling_scheduler_init(&sampling_scheduler, &policy);
+    }
+
+    sampling_policy_mailbox = xQueueCreate(1, sizeof(sampling_policy_t));
+    if (sampling_policy_mailbox != NULL) {
+        xQueueOverwrite(sampling_policy_mailbox, &sampling_scheduler.policy);
+    }
+
+#if CONFIG_PUBLISH_DEADBAND_ENABLED
+    publish_deadband_config_t deadband_config = {
+        .humidity_centi = CONFIG_PUBLISH_DEADBAND_HUMIDITY,
+        .temperature_centi = CONFIG_PUBLISH_DEADBAND_TEMPERATURE,
+        .heartbeat_ms = CONFIG_PUBLISH_HEARTBEAT_S * 1000,
+    };
+    publish_deadband_init(&publish_deadband, &deadband_config);
+#endif
 }
 
 /**
@@ -61,14 +185,16 @@ static void timer_callback(TimerHandle_t xTimer) {
  *
  */
 void timers_init(void) {
-    // Create a software timer for read&publish ChipCap2 data every 5 seconds
-    // (periodic, 5 seconds)
+    // Create a software timer for read&publish ChipCap2 data, its period is
+    // changed after every sample by the sampling scheduler
+    sampling_init();
+    TickType_t period = sampling_timer_period(sampling_scheduler.interval_ms);
     read_publish_timer =
-        xTimerCreate("ReadPublishTimer",   // Timer name (for debugging)
-                     pdMS_TO_TICKS(5000),  // Timer period in ticks (5000 ms)
-                     pdTRUE,               // Auto-reload (true = periodic)
-                     NULL,                 // Optional timer ID
-                     timer_callback        // Callback function
+        xTimerCreate("ReadPublishTimer",  // Timer name (for debugging)
+                     period,              // Timer period in ticks
+                     pdTRUE,              // Auto-reload (true = periodic)
+                     NULL,                // Optional timer ID
+                     timer_callback       // Callback function
         );
     if (read_publish_timer != NULL) {
         // Start the timer (no delay before starting)
@@ -78,52 +204,460 @@ void timers_init(void) {
     } else {
         uart_comm_vsend("Failed to create read&publish timer!\r\n");
     }
+
+#if CONFIG_TELEMETRY_ENABLED
+    telemetry_timer =
+        xTimerCreate("TelemetryTimer",
+                     pdMS_TO_TICKS(CONFIG_TELEMETRY_INTERVAL_S * 1000), pdTRUE,
+                     NULL, telemetry_timer_callback);
+    if ((telemetry_timer == NULL) ||
+        (xTimerStart(telemetry_timer, 0) != pdPASS)) {
+        uart_comm_vsend("Failed to start telemetry timer!\r\n");
+    }
+#endif
 }
 
+#if SAMPLE_LOG_ACTIVE
 /**
- * @brief Reads ChipCap2 sensor data through I2C and publishes it to the MQTT
- * broker as a JSON string
+ * @brief Callback of the replay timer
  *
- * @param message A message that is sent on the UART when the data is read and
- * published
+ * @param xTimer Timer handle to the timer that spawned the event
  */
-static void read_and_publish_sensor_data(const char* message) {
-    if (xSemaphoreTake(read_and_publish_mutex, portMAX_DELAY) == pdTRUE) {
-        led_toggle();
-        esp_err_t result = ESP_OK;
+static void sample_log_replay_timer_callback(TimerHandle_t xTimer) {
+    // A missed replay tick only delays the replay
+    event_bus_post(EVENT_SAMPLE_LOG_REPLAY);
+}
+
+/**
+ * @brief Mounts the sample log partition and creates the replay timer
+ *
+ */
+static void sample_log_storage_init(void) {
+    sample_log_flash_t flash;
+
+    esp_err_t result =
+        sample_log_partition_open(&flash, SAMPLE_LOG_PARTITION_LABEL);
+    if (result == ESP_OK) {
+        result = sample_log_init(&flash);
+    }
+    if (result != ESP_OK) {
+        uart_comm_vsend("[SAMPLE-LOG-ERROR] Mounting failed: %s\r\n",
+                        esp_err_to_name(result));
+        return;
+    }
+
+    sample_log_replay_timer =
+        xTimerCreate("SampleLogReplayTimer",
+                     pdMS_TO_TICKS(CONFIG_SAMPLE_LOG_REPLAY_INTERVAL_MS),
+                     pdTRUE, NULL, sample_log_replay_timer_callback);
+    if (sample_log_replay_timer == NULL) {
+        uart_comm_vsend("Failed to create sample log replay timer!\r\n");
+        return;
+    }
+
+    sample_log_ready = true;
+    uart_comm_vsend("[SAMPLE-LOG] %u samples pending\r\n",
+                    (unsigned)sample_log_pending());
+}
+
+/**
+ * @brief Stores samples in the sample log, used while MQTT is offline or
+ * when a publish fails
+ *
+ * @param samples Samples, oldest first
+ * @param sample_count Number of samples
+ */
+static void sample_log_store(const sensor_batch_sample_t* samples,
+                             size_t sample_count) {
+    for (size_t i = 0; i < sample_count; i++) {
+        esp_err_t result = sample_log_append(&samples[i]);
+        if (result != ESP_OK) {
+            uart_comm_vsend("[SAMPLE-LOG-ERROR] Append failed: %s\r\n",
+                            esp_err_to_name(result));
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Publishes the next batch of stored samples, the replay timer keeps
+ * posting EVENT_SAMPLE_LOG_REPLAY until the log is empty
+ *
+ */
+static void replay_sample_log(void) {
+    if (!sample_log_ready || !mqtt_online) {
+        return;
+    }
 
-        // Two read's are needed, the first one doesn't retrieve the humidity
-        // data correctly!
-        for (int i = 0; i < 2; i++) {
-            result = i2c_chipcap2_read(&chipcap2_out_data);
+    size_t sample_count =
+        sample_log_peek(replay_samples, CONFIG_SAMPLE_LOG_REPLAY_BATCH);
+    if (sample_count == 0) {
+        xTimerStop(sample_log_replay_timer, 0);
+        sample_log_stats_t stats;
+        sample_log_get_stats(&stats);
+        uart_comm_vsend(
+            "[SAMPLE-LOG] Replay done, %lu replayed / %lu overwritten\r\n",
+            (unsigned long)stats.consumed, (unsigned long)stats.overwritten);
+        return;
+    }
+
+    esp_err_t result = sensor_batch_format_json(
+        replay_samples, sample_count, esp_timer_get_time(),
+        replay_message_buffer, sizeof(replay_message_buffer));
+    if (result == ESP_OK) {
+        result = mqtt_controller_publish(replay_message_buffer);
+    }
+    if (result != ESP_OK) {
+        // Retried on the next tick, the samples stay in the log
+        return;
+    }
+
+    sample_log_consume(sample_count);
+    uart_comm_vsend("[SAMPLE-LOG] Replayed %u samples, %u pending\r\n",
+                    (unsigned)sample_count, (unsigned)sample_log_pending());
+}
+#endif
+
+/**
+ * @brief Helper for ending a span of the traced round trip, the next span
+ * starts where this one ends
+ *
+ */
+static int64_t trace_span_end(latency_trace_stage_t stage) {
+    int64_t now_us = esp_timer_get_time();
+    latency_trace_record(stage, now_us - trace_span_start_us);
+    trace_span_start_us = now_us;
+    return now_us;
+}
+
+#if CONFIG_SENSOR_PAYLOAD_CBOR
+/**
+ * @brief Prints binary data over UART as hex, 32 bytes per line
+ *
+ */
+static void uart_send_hex(const uint8_t* data, size_t length) {
+    static const char hex_digits[] = "0123456789abcdef";
+    char line[2 * 32 + 1];
+
+    for (size_t offset = 0; offset < length; offset += 32) {
+        size_t chunk = ((length - offset) < 32) ? (length - offset) : 32;
+        for (size_t i = 0; i < chunk; i++) {
+            line[2 * i] = hex_digits[data[offset + i] >> 4];
+            line[2 * i + 1] = hex_digits[data[offset + i] & 0x0F];
         }
+        line[2 * chunk] = '\0';
+        uart_comm_vsend("%s\r\n", line);
+    }
+}
+#endif
+
+/**
+ * @brief Publishes the last ChipCap2 sensor data to the MQTT broker as a JSON
+ * string (or CBOR, see CONFIG_SENSOR_PAYLOAD_ENCODING)
+ *
+ * @param traced Record the encode/publish spans and wait for the PUBACK
+ */
+static void publish_sensor_data(bool traced) {
+#if CONFIG_SENSOR_PAYLOAD_CBOR
+    size_t cbor_length = 0;
+    esp_err_t result = cjson_format_chipcap2_data_cbor_prebuffered(
+        &chipcap2_out_data, cbor_message_buffer, sizeof(cbor_message_buffer),
+        &cbor_length);
+#else
+    esp_err_t result = cjson_format_chipcap2_data_prebuffered(
+        &chipcap2_out_data, message_buffer, sizeof(message_buffer));
+#endif
+    if (result != ESP_OK) {
+        return;
+    }
+    if (traced) {
+        trace_span_end(LATENCY_TRACE_STAGE_ENCODE);
+    }
 
-        if (result == ESP_OK) {
-            result = cjson_format_chipcap2_data_prebuffered(
-                &chipcap2_out_data, message_buffer, 200);
-            if (result == ESP_OK) {
 #if MQTT_ENABLED == 1
-                mqtt_controller_publish(message_buffer);
+    int msg_id;
+#if CONFIG_SENSOR_PAYLOAD_CBOR
+    result = mqtt_controller_publish_binary(DEFAULT_TOPIC, cbor_message_buffer,
+                                            cbor_length,
+                                            CJSON_CBOR_CONTENT_TYPE, &msg_id);
 #else
-                uart_comm_vsend("MQTT not enabled, skipping publishing.\r\n");
+    result =
+        mqtt_controller_publish_with_id(DEFAULT_TOPIC, message_buffer, &msg_id);
 #endif
-                uart_comm_vsend("ChipCap2 JSON data:\r\n");
-                uart_comm_vsend(message_buffer);
-                uart_comm_vsend("\r\n");
-            }
-        } else {
-            uart_comm_vsend(
-                "[CHIPCAP2-ERROR] Something went wrong with the "
-                "measurement!\r\n");
-            return;
-        }
+    if (traced && (result == ESP_OK)) {
+        int64_t publish_us = trace_span_end(LATENCY_TRACE_STAGE_PUBLISH);
+        latency_trace_expect_ack(msg_id, publish_us, trace_received_us);
+    }
+#if SAMPLE_LOG_ACTIVE
+    if ((result != ESP_OK) && sample_log_ready) {
+        sensor_batch_sample_t sample = {
+            .timestamp_us = esp_timer_get_time(),
+            .data = chipcap2_out_data,
+        };
+        sample_log_store(&sample, 1);
+    }
+#endif
+#else
+    uart_comm_vsend("MQTT not enabled, skipping publishing.\r\n");
+#endif
+#if CONFIG_SENSOR_PAYLOAD_CBOR
+    uart_comm_vsend("ChipCap2 CBOR data (%u bytes):\r\n",
+                    (unsigned int)cbor_length);
+    uart_send_hex(cbor_message_buffer, cbor_length);
+#else
+    uart_comm_vsend("ChipCap2 JSON data:\r\n");
+    uart_comm_vsend("%s", message_buffer);
+    uart_comm_vsend("\r\n");
+#endif
+}
 
-        uart_comm_vsend(message);
+#if CONFIG_SENSOR_BATCH_ENABLED
+/**
+ * @brief Publishes all batched ChipCap2 samples as a single JSON message
+ *
+ */
+static void publish_sensor_batch(void) {
+    int64_t now_us = esp_timer_get_time();
+    size_t sample_count = sensor_batch_drain(batch_publish_samples,
+                                             SENSOR_BATCH_CAPACITY);
+    if (sample_count == 0) {
+        return;
+    }
+
+    esp_err_t result = sensor_batch_format_json(
+        batch_publish_samples, sample_count, now_us, batch_message_buffer,
+        sizeof(batch_message_buffer));
+    if (result != ESP_OK) {
+        return;
+    }
 
-        xSemaphoreGive(read_and_publish_mutex);
+#if MQTT_ENABLED == 1
+    result = mqtt_controller_publish(batch_message_buffer);
+#if SAMPLE_LOG_ACTIVE
+    if ((result != ESP_OK) && sample_log_ready) {
+        sample_log_store(batch_publish_samples, sample_count);
+        return;
+    }
+#endif
+#else
+    uart_comm_vsend("MQTT not enabled, skipping publishing.\r\n");
+#endif
+
+    // Bytes-on-wire statistics (payload only)
+    size_t payload_length = strlen(batch_message_buffer);
+    batch_publish_count++;
+    batch_publish_bytes += payload_length;
+    uart_comm_vsend(
+        "[BATCH] %u samples, %u bytes, total %lu publishes / %lu bytes\r\n",
+        (unsigned)sample_count, (unsigned)payload_length,
+        (unsigned long)batch_publish_count, (unsigned long)batch_publish_bytes);
+}
+#endif
+
+/**
+ * @brief Starts an asynchronous ChipCap2 measurement, the requested actions
+ * are performed when the EVENT_SENSOR_DATA_READY event is received, so the
+ * main loop keeps handling events during the conversion. A request that
+ * arrives while a measurement is in progress is served by that measurement.
+ *
+ * @param actions SENSOR_ACTION_* flags
+ */
+static void request_sensor_data(uint8_t actions) {
+    sensor_pending_actions |= actions;
+    if (i2c_chipcap2_measurement_busy()) {
+        return;
+    }
+
+    led_toggle();
+    if (i2c_chipcap2_measurement_start() != ESP_OK) {
+        sensor_pending_actions = 0;
+        uart_comm_vsend(
+            "[CHIPCAP2-ERROR] Something went wrong with the "
+            "measurement!\r\n");
     }
 }
 
+/**
+ * @brief Fetches the finished ChipCap2 measurement and performs the pending
+ * actions (publish, batch, timing)
+ *
+ */
+static void handle_sensor_data_ready(void) {
+    esp_err_t result = i2c_chipcap2_measurement_fetch(&chipcap2_out_data);
+
+    // Stale data, a re-fetch was scheduled and the event will be posted again
+    if (result == ESP_ERR_NOT_FINISHED) {
+        return;
+    }
+
+    uint8_t actions = sensor_pending_actions;
+#if CONFIG_SENSOR_BATCH_ENABLED
+    // Before the deadband and the sample log clear the batch action
+    bool timer_sample = (actions & SENSOR_ACTION_BATCH) != 0;
+#endif
+    sensor_pending_actions = 0;
+    if ((actions & SENSOR_ACTION_TRACE) && (result == ESP_OK)) {
+        trace_span_end(LATENCY_TRACE_STAGE_MEASURE);
+    }
+    if ((actions & SENSOR_ACTION_SCHEDULE) && (result == ESP_OK)) {
+        // Fast while the signal changes, slower while it is stable
+        uint32_t interval_ms = sampling_scheduler_update(
+            &sampling_scheduler, chipcap2_out_data.humidity.centi,
+            chipcap2_out_data.temperature.centi);
+        xTimerChangePeriod(read_publish_timer,
+                           sampling_timer_period(interval_ms), 0);
+    }
+
+    if (result == ESP_ERR_INVALID_RESPONSE) {
+        uart_comm_vsend(
+            "[CHIPCAP2-ERROR] Invalid data (status: %d, re-fetches: %d)!\r\n",
+            chipcap2_out_data.status, chipcap2_out_data.stale_retries);
+        return;
+    } else if (result != ESP_OK) {
+        uart_comm_vsend(
+            "[CHIPCAP2-ERROR] Something went wrong with the "
+            "measurement!\r\n");
+        return;
+    }
+
+#if CONFIG_PUBLISH_DEADBAND_ENABLED
+    // Unchanged samples are neither published, batched nor stored. Only
+    // valid samples reach the deadband, a failed measurement must not
+    // become its reference or count as suppressed.
+    if ((actions & (SENSOR_ACTION_PUBLISH | SENSOR_ACTION_BATCH)) &&
+        !publish_deadband_check(&publish_deadband,
+                                chipcap2_out_data.humidity.centi,
+                                chipcap2_out_data.temperature.centi,
+                                esp_timer_get_time(),
+                                (actions & SENSOR_ACTION_FORCE) != 0)) {
+        actions &= ~(SENSOR_ACTION_PUBLISH | SENSOR_ACTION_BATCH);
+        uart_comm_vsend("[DEADBAND] Unchanged, not published (%lu total)\r\n",
+                        (unsigned long)publish_deadband.suppressed);
+    }
+#endif
+
+#if SAMPLE_LOG_ACTIVE
+    // Offline, the samples are replayed from flash after the reconnect
+    if (!mqtt_online && sample_log_ready &&
+        (actions & (SENSOR_ACTION_PUBLISH | SENSOR_ACTION_BATCH))) {
+        sensor_batch_sample_t sample = {
+            .timestamp_us = esp_timer_get_time(),
+            .data = chipcap2_out_data,
+        };
+        sample_log_store(&sample, 1);
+        actions &= ~(SENSOR_ACTION_PUBLISH | SENSOR_ACTION_BATCH);
+    }
+#endif
+
+#if CONFIG_SENSOR_BATCH_ENABLED
+    if (actions & SENSOR_ACTION_BATCH) {
+        sensor_batch_add(&chipcap2_out_data, esp_timer_get_time());
+    }
+    // Every timer sample checks the flush, also one that wasn't batched
+    if (timer_sample && sensor_batch_flush_due(esp_timer_get_time())) {
+        publish_sensor_batch();
+    }
+#endif
+
+    if (actions & SENSOR_ACTION_PUBLISH) {
+        publish_sensor_data((actions & SENSOR_ACTION_TRACE) != 0);
+    }
+
+    if (actions & SENSOR_ACTION_TRACE) {
+        // Until the publish was handed to the client, the PUBACK is recorded
+        // by the trace
+        int64_t delta_ms = (esp_timer_get_time() - trace_received_us) / 1000;
+        uart_comm_vsend("[TIMING] %lld ms\r\n", delta_ms);
+    }
+}
+
+#if CONFIG_TELEMETRY_ENABLED
+/**
+ * @brief Samples the runtime metrics and publishes them to the 'telemetry'
+ * subtopic
+ *
+ */
+static void publish_telemetry(void) {
+    telemetry_metrics_t metrics;
+
+    telemetry_sample(&metrics);
+#if CONFIG_PUBLISH_DEADBAND_ENABLED
+    metrics.publishes_suppressed = publish_deadband.suppressed;
+#endif
+    if (telemetry_format_json(&metrics, telemetry_message_buffer,
+                              sizeof(telemetry_message_buffer)) != ESP_OK) {
+        return;
+    }
+    cjson_pool_stats_t pool_stats;
+    cjson_pool_get_stats(&pool_stats);
+    uart_comm_vsend(
+        "[TELEMETRY] free heap %lu, minimum %lu, largest block %lu, cJSON "
+        "pool peak %u/%u slots\r\n",
+        (unsigned long)metrics.free_heap,
+        (unsigned long)metrics.minimum_free_heap,
+        (unsigned long)metrics.largest_free_block,
+        (unsigned)pool_stats.high_water_mark, (unsigned)pool_stats.capacity);
+#if MQTT_ENABLED == 1
+    mqtt_controller_publish_to(DEFAULT_TOPIC "/telemetry",
+                               telemetry_message_buffer);
+#endif
+}
+#endif
+
+/**
+ * @brief Prints the latency histogram summaries over UART and publishes the
+ * full histograms to the 'latency' subtopic
+ *
+ */
+static void dump_latency_trace(void) {
+    latency_trace_summary_t summary;
+
+    for (size_t i = 0; i < LATENCY_TRACE_STAGE_COUNT; i++) {
+        latency_trace_get_summary(i, &summary);
+        uart_comm_vsend(
+            "[LATENCY] %-8s n %lu, min %lu, p50 %lu, p99 %lu, max %lu us\r\n",
+            latency_trace_stage_name(i), (unsigned long)summary.count,
+            (unsigned long)summary.min, (unsigned long)summary.p50,
+            (unsigned long)summary.p99, (unsigned long)summary.max);
+    }
+    uart_comm_vsend("[LATENCY] unacknowledged %lu\r\n",
+                    (unsigned long)latency_trace_unacknowledged());
+
+#if MQTT_ENABLED == 1
+    if (latency_trace_format_json(latency_message_buffer,
+                                  sizeof(latency_message_buffer)) != ESP_OK) {
+        uart_comm_vsend("[LATENCY] Histograms don't fit the message!\r\n");
+        return;
+    }
+    mqtt_controller_publish_to(DEFAULT_TOPIC "/latency",
+                               latency_message_buffer);
+#endif
+}
+
+#if MQTT_ENABLED == 1
+/**
+ * @brief Prints the MQTT connection statistics and the free heap, the heap
+ * must stay flat over any number of reconnects
+ *
+ */
+static void print_mqtt_connection_stats(void) {
+    mqtt_controller_stats_t stats;
+
+    mqtt_controller_get_stats(&stats);
+    uart_comm_vsend(
+        "[MQTT] connects %lu, resumed %lu, reconnect attempts %lu, "
+        "restarts %lu, free heap %lu, minimum %lu, connect %lu ms, "
+        "connect heap peak %lu\r\n",
+        (unsigned long)stats.connects, (unsigned long)stats.sessions_resumed,
+        (unsigned long)stats.reconnect_attempts,
+        (unsigned long)stats.client_restarts,
+        (unsigned long)esp_get_free_heap_size(),
+        (unsigned long)esp_get_minimum_free_heap_size(),
+        (unsigned long)stats.last_connect_time_ms,
+        (unsigned long)stats.last_connect_heap_peak);
+}
+#endif
+
 /**
  * @brief Toggle LED 'blink_count' number of times
  *
@@ -142,6 +676,120 @@ void blink(int blink_count) {
     led_off();
 }
 
+/**
+ * @brief Helper for reading an optional number argument
+ *
+ */
+static bool command_number_arg(const cjson_tokens_t* json, int args,
+                               const char* name, double* value) {
+    return (json != NULL) &&
+           (cjson_tokens_get_number(json, cjson_tokens_find(json, args, name),
+                                    value) == ESP_OK);
+}
+
+/**
+ * @brief 'set-sampling' command handler, runs in the MQTT task. The given
+ * members replace those of the current policy, e.g.
+ * {"min_ms": 5000, "max_ms": 300000, "humidity": 0.5, "temperature": 0.2}
+ * (thresholds in %RH / degrees Celsius)
+ *
+ */
+static esp_err_t command_set_sampling(const cjson_tokens_t* json, int args,
+                                      void* context) {
+    sampling_policy_t policy;
+    double value;
+
+    if ((sampling_policy_mailbox == NULL) ||
+        (xQueuePeek(sampling_policy_mailbox, &policy, 0) != pdPASS)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // Range checked before the conversion, a double outside the uint32_t
+    // range has no defined conversion
+    if (command_number_arg(json, args, "min_ms", &value)) {
+        if (!((value >= SAMPLING_INTERVAL_MIN_MS) &&
+              (value <= SAMPLING_INTERVAL_MAX_MS))) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        policy.min_interval_ms = (uint32_t)value;
+    }
+    if (command_number_arg(json, args, "max_ms", &value)) {
+        if (!((value >= SAMPLING_INTERVAL_MIN_MS) &&
+              (value <= SAMPLING_INTERVAL_MAX_MS))) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        policy.max_interval_ms = (uint32_t)value;
+    }
+    if (command_number_arg(json, args, "humidity", &value)) {
+        if ((value < 0) || (value > 100)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        policy.humidity_threshold_centi = (uint16_t)lround(value * 100);
+    }
+    if (command_number_arg(json, args, "temperature", &value)) {
+        if ((value < 0) || (value > 100)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        policy.temperature_threshold_centi = (uint16_t)lround(value * 100);
+    }
+    if (sampling_policy_validate(&policy) != ESP_OK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xQueueOverwrite(sampling_policy_mailbox, &policy);
+    return ESP_OK;
+}
+
+/**
+ * @brief Applies the policy set over MQTT, the next sample is taken after
+ * the new fastest interval
+ *
+ */
+static void apply_sampling_policy(void) {
+    sampling_policy_t policy;
+
+    if (xQueuePeek(sampling_policy_mailbox, &policy, 0) != pdPASS) {
+        return;
+    }
+    sampling_scheduler_set_policy(&sampling_scheduler, &policy);
+    xTimerChangePeriod(read_publish_timer,
+                       sampling_timer_period(sampling_scheduler.interval_ms),
+                       0);
+    uart_comm_vsend(
+        "[SAMPLING] %lu..%lu ms, thresholds %u centi-%%RH / %u centi-C\r\n",
+        (unsigned long)policy.min_interval_ms,
+        (unsigned long)policy.max_interval_ms,
+        (unsigned)policy.humidity_threshold_centi,
+        (unsigned)policy.temperature_threshold_centi);
+}
+
+/**
+ * @brief Commands accepted over MQTT
+ *
+ */
+static const mqtt_command_t mqtt_command_table[] = {
+    {
+        .topic = DEFAULT_TOPIC,
+        .name = "read-and-publish",
+        .event = EVENT_MESSAGE_READ_AND_PUBLISH,
+    },
+    {
+        .topic = DEFAULT_TOPIC,
+        .name = "update-firmware",
+        .event = EVENT_MESSAGE_UPDATE_FIRMWARE,
+    },
+    {
+        .topic = DEFAULT_TOPIC,
+        .name = "dump-latency",
+        .event = EVENT_MESSAGE_DUMP_LATENCY,
+    },
+    {
+        .topic = DEFAULT_TOPIC,
+        .name = "set-sampling",
+        .handler = command_set_sampling,
+        .event = EVENT_SAMPLING_POLICY,
+    },
+};
+
 /**
  * @brief Main program entry point function
  *
@@ -150,10 +798,26 @@ void app_main(void) {
     // Initialize the UART communication
     uart_comm_init();
     uart_comm_vsend("UART COMM initialised.\r\n");
+#if CONFIG_UART_LOG_BENCHMARK
+    uart_comm_benchmark();
+#endif
+
+#if CONFIG_TELEMETRY_ENABLED
+    // Runs on the main task, its stack is sampled
+    telemetry_init();
+#endif
+
+    // Event bus, before any component that posts events
+    uart_comm_vsend("Initialising event bus ...\r\n");
+    if (event_bus_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create the event bus.\n");
+        return;
+    }
+    uart_comm_vsend("Event bus initialised.\r\n");
 
     // GPIO initialization
     uart_comm_vsend("Initialising GPIO ...\r\n");
-    gpio_controller_init(&general_event_queue);
+    gpio_controller_init();
     uart_comm_vsend("GPIO initialised.\r\n");
 
     // Re-provision check
@@ -173,20 +837,25 @@ void app_main(void) {
 
     led_on();
 
-    // Create general event queue
-    uart_comm_vsend("Initialising queues ...\r\n");
-    general_event_queue = xQueueCreate(10, sizeof(event_t));
-    if (general_event_queue == NULL) {
-        ESP_LOGE(TAG, "Failed to create general queue.\n");
-        return;
-    }
-    uart_comm_vsend("Queues initialised.\r\n");
+    // cJSON item pool initialization
+    uart_comm_vsend("Initialising cJSON pool ...\r\n");
+    ESP_ERROR_CHECK(cjson_pool_init());
+    uart_comm_vsend("cJSON pool initialised.\r\n");
+
+    // Latency trace, before the first command can arrive over MQTT
+    ESP_ERROR_CHECK(latency_trace_init());
 
     // I2C initialization
     uart_comm_vsend("Initialising I2C ...\r\n");
     i2c_controller_init();
     uart_comm_vsend("I2C initialised.\r\n");
 
+#if SAMPLE_LOG_ACTIVE
+    uart_comm_vsend("Initialising sample log ...\r\n");
+    sample_log_storage_init();
+    uart_comm_vsend("Sample log initialised.\r\n");
+#endif
+
     uart_comm_vsend("Initialising Wifi connection ...\r\n");
     ESP_ERROR_CHECK(wifi_controller_connect(reprovision_flag));
     uart_comm_vsend("Wifi connection initialised.\r\n");
@@ -194,7 +863,11 @@ void app_main(void) {
 // MQTT inizialization
 #if MQTT_ENABLED == 1
     uart_comm_vsend("Initialising MQTT ...\r\n");
-    ESP_ERROR_CHECK(mqtt_controller_init(&general_event_queue));
+    for (size_t i = 0;
+         i < sizeof(mqtt_command_table) / sizeof(mqtt_command_table[0]); i++) {
+        ESP_ERROR_CHECK(mqtt_commands_register(&mqtt_command_table[i]));
+    }
+    ESP_ERROR_CHECK(mqtt_controller_init());
     uart_comm_vsend("MQTT initialised.\r\n");
 #else
     uart_comm_vsend("MQTT not enabled, skipping initialization.\r\n");
@@ -202,13 +875,6 @@ void app_main(void) {
 
     timers_init();
 
-    // Initialize mutexes
-    read_and_publish_mutex = xSemaphoreCreateMutex();
-    if (read_and_publish_mutex == NULL) {
-        uart_comm_vsend("Error initializing mutexes!\r\n");
-        return;
-    }
-
     led_off();
 
     // Visual signal for initialization completion
@@ -217,15 +883,16 @@ void app_main(void) {
     led_off();
 
     // Main event handling loop
-    event_t event = EVENT_NONE;
+    event_bus_event_t event;
     while (1) {
-        // Get an item from the general queue and handle it accordingly
-        if (xQueueReceive(general_event_queue, &event, portMAX_DELAY) ==
-            pdPASS) {
-            switch (event) {
+        // Get the next event from the event bus (highest priority lane
+        // first) and handle it accordingly
+        if (event_bus_receive(&event, portMAX_DELAY)) {
+            switch (event.type) {
                 case EVENT_BUTTON_PRESS:
-                    read_and_publish_sensor_data("[EVENT] BUTTON-PRESSED\r\n");
-                    event = EVENT_NONE;
+                    uart_comm_vsend("[EVENT] BUTTON-PRESSED\r\n");
+                    request_sensor_data(SENSOR_ACTION_PUBLISH |
+                                        SENSOR_ACTION_FORCE);
                     break;
 
                 case EVENT_BUTTON_HOLD:
@@ -233,54 +900,121 @@ void app_main(void) {
                     uart_comm_vsend("Reprovisioning the Wifi ...\r\n");
                     wifi_controller_reprovision();
                     uart_comm_vsend("Wifi provisioned again.\r\n");
-                    event = EVENT_NONE;
                     break;
 
                 case EVENT_MESSAGE_READ_AND_PUBLISH:
-                    read_and_publish_sensor_data(
+                    uart_comm_vsend(
                         "[EVENT] MQTT-READ-AND-PUBLISH-RECEIVED\r\n");
-                    end_time = esp_timer_get_time();
-                    int64_t delta_us = (end_time - start_time) / 1000;
-                    uart_comm_vsend("[TIMING] %lld ms\r\n", delta_us);
-                    event = EVENT_NONE;
+                    // The event's value is the time between the command's
+                    // arrival and the post
+                    trace_received_us = event.timestamp_us - event.value;
+                    trace_span_start_us = event.timestamp_us;
+                    latency_trace_record(LATENCY_TRACE_STAGE_RECEIVE,
+                                         event.value);
+                    trace_span_end(LATENCY_TRACE_STAGE_QUEUE);
+                    request_sensor_data(SENSOR_ACTION_PUBLISH |
+                                        SENSOR_ACTION_TRACE |
+                                        SENSOR_ACTION_FORCE);
                     break;
 
                 case EVENT_MESSAGE_UPDATE_FIRMWARE:
                     uart_comm_vsend(
                         "[EVENT] MQTT-UPDATE-FIRMWARE-RECEIVED\r\n");
                     ota_start();
-                    event = EVENT_NONE;
+                    break;
+
+#if CONFIG_TELEMETRY_ENABLED
+                case EVENT_TELEMETRY:
+                    publish_telemetry();
+                    break;
+#endif
+
+                case EVENT_MESSAGE_DUMP_LATENCY:
+                    uart_comm_vsend("[EVENT] MQTT-DUMP-LATENCY-RECEIVED\r\n");
+                    dump_latency_trace();
                     break;
 
                 case EVENT_TIMER_ELAPSED:
-                    read_and_publish_sensor_data("[EVENT] TIMER-ELAPSED\r\n");
-                    event = EVENT_NONE;
+                    uart_comm_vsend("[EVENT] TIMER-ELAPSED\r\n");
+#if CONFIG_SENSOR_BATCH_ENABLED
+                    request_sensor_data(SENSOR_ACTION_BATCH |
+                                        SENSOR_ACTION_SCHEDULE);
+#else
+                    request_sensor_data(SENSOR_ACTION_PUBLISH |
+                                        SENSOR_ACTION_SCHEDULE);
+#endif
+                    break;
+
+                case EVENT_SAMPLING_POLICY:
+                    uart_comm_vsend("[EVENT] MQTT-SET-SAMPLING-RECEIVED\r\n");
+                    apply_sampling_policy();
+                    break;
+
+                case EVENT_SENSOR_DATA_READY:
+                    handle_sensor_data_ready();
                     break;
 
                 case EVENT_MQTT_CONNECTED:
                     uart_comm_vsend("[EVENT] MQTT-CONNECTED\r\n");
-                    event = EVENT_NONE;
+#if MQTT_ENABLED == 1
+                    print_mqtt_connection_stats();
+#endif
+#if SAMPLE_LOG_ACTIVE
+                    mqtt_online = true;
+                    if (sample_log_ready && (sample_log_pending() > 0)) {
+                        xTimerStart(sample_log_replay_timer, 0);
+                    }
+#endif
+                    break;
+
+                case EVENT_MQTT_RECONNECT:
+#if MQTT_ENABLED == 1
+                    uart_comm_vsend("[EVENT] MQTT-RECONNECT\r\n");
+                    mqtt_controller_reconnect();
+#endif
+                    break;
+
+                case EVENT_SAMPLE_LOG_REPLAY:
+#if SAMPLE_LOG_ACTIVE
+                    replay_sample_log();
+#endif
                     break;
 
                 case EVENT_MQTT_DISCONNECTED:
 #if MQTT_ENABLED == 1
                     uart_comm_vsend("[EVENT] MQTT-DISCONNECTED\r\n");
-                    uart_comm_vsend("Re-initialising MQTT ...\r\n");
-                    ESP_ERROR_CHECK(mqtt_controller_init(&general_event_queue));
-                    uart_comm_vsend("MQTT re-initialised.\r\n");
+#if SAMPLE_LOG_ACTIVE
+                    mqtt_online = false;
+                    if (sample_log_ready) {
+                        xTimerStop(sample_log_replay_timer, 0);
+#if CONFIG_SENSOR_BATCH_ENABLED
+                        // Don't lose the batched samples if the outage lasts
+                        size_t sample_count = sensor_batch_drain(
+                            batch_publish_samples, SENSOR_BATCH_CAPACITY);
+                        sample_log_store(batch_publish_samples, sample_count);
+#endif
+                    }
+#endif
+                    // The MQTT controller posts EVENT_MQTT_RECONNECT (backoff)
+                    uart_comm_vsend("Waiting for the MQTT reconnect ...\r\n");
 #else
                     uart_comm_vsend(
                         "[EVENT] MQTT not enabled, skipping "
                         "re-initialization.\r\n");
 #endif
-
-                    blink(5);
-                    event = EVENT_NONE;
                     break;
 
                 default:
                     break;
             }
+
+            // Every event is a complete publish/command cycle, no cJSON
+            // allocation may outlive it
+            if (cjson_pool_reset() != ESP_OK) {
+                uart_comm_vsend(
+                    "[CJSON-ERROR] Allocations left after event %d!\r\n",
+                    event.type);
+            }
         }
     }
 }
@@ -0,0 +1,213 @@
+#!/usr/bin/env python3
+# Broker flap test for the MQTT reconnect manager.
+#
+# Runs a local Mosquitto broker (MQTT5 over TLS on port 8883), takes it away
+# and restores it repeatedly and reads the board's UART. With "--outage kill"
+# the broker process is killed (new TLS ticket keys and no MQTT session after
+# the restart, every reconnect is a full handshake and a resubscribe). With
+# "--outage proxy" (default) the board connects through a TCP proxy that drops
+# and refuses connections during the outage, the broker keeps running so TLS
+# sessions and the MQTT session can be resumed. After every reconnect the
+# firmware prints a "[MQTT] connects ..., free heap ..." line, the test fails if
+# the board doesn't reconnect or if the free heap keeps shrinking. The connect
+# time and the peak heap usage of the connect (TCP + TLS handshake + CONNACK)
+# are summarized at the end, run it with and without "TLS" -> "Resume TLS
+# sessions" to compare the full and the abbreviated handshake.
+#
+# The firmware has to be built with "Broker URL" pointing to this machine
+# (e.g. mqtts://192.168.1.10) and with the matching CA certificate embedded as
+# components/mqtt_component/cacert.pem.
+#
+# Usage:
+#   python mqtt_reconnect_test.py -p /dev/ttyUSB0 --certfile server_cert.pem
+#       --keyfile server_key.pem --cycles 50
+import argparse
+import os
+import random
+import re
+import select
+import socket
+import statistics
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+from typing import List
+from typing import Optional
+
+import serial
+
+CONNECTED_PATTERN = re.compile(
+    r'\[MQTT\] connects (\d+), resumed (\d+), reconnect attempts (\d+), '
+    r'restarts (\d+), free heap (\d+), minimum (\d+), connect (\d+) ms, '
+    r'connect heap peak (\d+)')
+
+
+def start_broker(config_path: str) -> subprocess.Popen:
+    return subprocess.Popen(['mosquitto', '-c', config_path],
+                            stdout=subprocess.DEVNULL,
+                            stderr=subprocess.DEVNULL)
+
+
+def stop_broker(broker: subprocess.Popen) -> None:
+    # SIGKILL, the board sees the connection drop without a DISCONNECT
+    broker.kill()
+    broker.wait()
+
+
+class OutageProxy:
+    """TCP forwarder that can drop all connections and refuse new ones."""
+
+    def __init__(self, port: int, broker_port: int) -> None:
+        self.broker_port = broker_port
+        self.available = True
+        self.connections: List[socket.socket] = []
+        self.lock = threading.Lock()
+        self.server = socket.create_server(('', port))
+        threading.Thread(target=self.accept, daemon=True).start()
+
+    def accept(self) -> None:
+        while True:
+            client, _ = self.server.accept()
+            if not self.available:
+                client.close()
+                continue
+            try:
+                broker = socket.create_connection(
+                    ('127.0.0.1', self.broker_port))
+            except OSError:
+                client.close()
+                continue
+            with self.lock:
+                self.connections += [client, broker]
+            threading.Thread(target=self.forward, args=(client, broker),
+                             daemon=True).start()
+
+    def forward(self, client: socket.socket, broker: socket.socket) -> None:
+        peers = {client: broker, broker: client}
+        try:
+            while True:
+                readable, _, _ = select.select(list(peers), [], [])
+                for sock in readable:
+                    data = sock.recv(4096)
+                    if not data:
+                        return
+                    peers[sock].sendall(data)
+        except (OSError, ValueError):
+            # Closed by set_available()
+            pass
+        finally:
+            client.close()
+            broker.close()
+            with self.lock:
+                self.connections = [sock for sock in self.connections
+                                    if sock not in peers]
+
+    def set_available(self, available: bool) -> None:
+        self.available = available
+        if not available:
+            with self.lock:
+                for sock in self.connections:
+                    # shutdown() wakes up the forwarding thread, close()
+                    # alone wouldn't while it waits in select()
+                    try:
+                        sock.shutdown(socket.SHUT_RDWR)
+                    except OSError:
+                        pass
+                    sock.close()
+                self.connections.clear()
+
+
+def wait_for_connect(connection: serial.Serial,
+                     timeout: float) -> Optional[re.Match]:
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        line = connection.readline().decode('utf-8', 'replace')
+        if line:
+            sys.stdout.write(line)
+        match = CONNECTED_PATTERN.search(line)
+        if match:
+            return match
+    return None
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(
+        description='Kill/restore a local broker and check the reconnects')
+    parser.add_argument('-p', '--port', required=True, help='board UART')
+    parser.add_argument('-b', '--baud', type=int, default=115200)
+    parser.add_argument('--certfile', required=True)
+    parser.add_argument('--keyfile', required=True)
+    parser.add_argument('--cycles', type=int, default=30)
+    parser.add_argument('--outage', choices=['proxy', 'kill'],
+                        default='proxy')
+    parser.add_argument('--max-outage', type=float, default=20.0,
+                        help='longest broker outage in seconds')
+    parser.add_argument('--warmup', type=int, default=3,
+                        help='cycles ignored for the heap check')
+    parser.add_argument('--heap-tolerance', type=int, default=1024,
+                        help='allowed free heap drop in bytes')
+    arguments = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as directory:
+        config_path = os.path.join(directory, 'mosquitto.conf')
+        with open(config_path, 'w', encoding='utf-8') as config:
+            # Behind the proxy the broker listens on another port
+            listen_port = 8883 if arguments.outage == 'kill' else 18883
+            config.write(f'listener {listen_port}\n'
+                         'allow_anonymous true\n'
+                         'persistence false\n'
+                         f'certfile {os.path.abspath(arguments.certfile)}\n'
+                         f'keyfile {os.path.abspath(arguments.keyfile)}\n')
+
+        free_heap: List[int] = []
+        connect_ms: List[int] = []
+        connect_heap: List[int] = []
+        broker = start_broker(config_path)
+        proxy = None
+        if arguments.outage == 'proxy':
+            proxy = OutageProxy(8883, 18883)
+        try:
+            with serial.Serial(arguments.port, arguments.baud,
+                               timeout=0.5) as connection:
+                for cycle in range(arguments.cycles):
+                    # Worst case reconnect delay is the backoff maximum
+                    match = wait_for_connect(connection, 120.0)
+                    if match is None:
+                        print(f'FAIL: no reconnect in cycle {cycle}')
+                        return 1
+                    free_heap.append(int(match.group(5)))
+                    connect_ms.append(int(match.group(7)))
+                    connect_heap.append(int(match.group(8)))
+
+                    time.sleep(random.uniform(1.0, 5.0))
+                    if proxy is not None:
+                        proxy.set_available(False)
+                    else:
+                        stop_broker(broker)
+                    time.sleep(random.uniform(0.5, arguments.max_outage))
+                    if proxy is not None:
+                        proxy.set_available(True)
+                    else:
+                        broker = start_broker(config_path)
+        finally:
+            stop_broker(broker)
+
+    settled = free_heap[arguments.warmup:]
+    print(f'free heap per reconnect: {free_heap}')
+    # The first connect is always a full handshake
+    if len(connect_ms) > 1:
+        print(f'first connect: {connect_ms[0]} ms, '
+              f'heap peak {connect_heap[0]} bytes')
+        print(f'reconnects: {statistics.median(connect_ms[1:])} ms median, '
+              f'heap peak {max(connect_heap[1:])} bytes')
+    if settled and (settled[0] - min(settled) > arguments.heap_tolerance):
+        print(f'FAIL: free heap dropped by {settled[0] - min(settled)} bytes')
+        return 1
+    print('OK')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
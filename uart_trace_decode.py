@@ -0,0 +1,186 @@
+#!/usr/bin/env python3
+# Decoder for the binary UART log format (CONFIG_UART_LOG_BINARY).
+#
+# Frame: 0x1E, 32-bit little endian address of the format string in the
+# firmware ELF, payload length byte, raw little endian arguments. Everything
+# outside of frames is plain text and is passed through as-is.
+#
+# Usage:
+#   python uart_trace_decode.py build/esp32c3_supermini_demo.elf -p /dev/ttyUSB0
+#   python uart_trace_decode.py build/esp32c3_supermini_demo.elf capture.bin
+import argparse
+import re
+import struct
+import sys
+from typing import BinaryIO
+from typing import Dict
+from typing import Iterator
+from typing import List
+from typing import Tuple
+
+from elftools.elf.constants import SH_FLAGS
+from elftools.elf.elffile import ELFFile
+
+TRACE_SYNC = 0x1E
+TRACE_HEADER_SIZE = 6
+
+# Same conversions as uart_comm_trace() on target
+SPEC_PATTERN = re.compile(
+    r'%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d*))?(hh|h|ll|l|z|j|t)?([diuxXocpfFeEgGaAs%])')
+
+
+class FormatStrings:
+    """Reads null terminated strings from the allocated ELF sections."""
+
+    def __init__(self, elf_path: str) -> None:
+        self.sections: List[Tuple[int, bytes]] = []
+        self.cache: Dict[int, str] = {}
+        with open(elf_path, 'rb') as elf_file:
+            elf = ELFFile(elf_file)
+            for section in elf.iter_sections():
+                if not (section['sh_flags'] & SH_FLAGS.SHF_ALLOC):
+                    continue
+                if section['sh_type'] == 'SHT_NOBITS':
+                    continue
+                self.sections.append((section['sh_addr'], section.data()))
+
+    def get(self, address: int) -> str:
+        if address in self.cache:
+            return self.cache[address]
+        for start, data in self.sections:
+            if start <= address < start + len(data):
+                end = data.find(b'\0', address - start)
+                if end < 0:
+                    end = len(data)
+                text = data[address - start:end].decode('utf-8', 'replace')
+                self.cache[address] = text
+                return text
+        raise KeyError(f'no format string at 0x{address:08x}')
+
+
+def format_frame(format_string: str, payload: bytes) -> str:
+    offset = 0
+
+    def take(size: int) -> bytes:
+        nonlocal offset
+        if offset + size > len(payload):
+            raise ValueError('truncated')
+        chunk = payload[offset:offset + size]
+        offset += size
+        return chunk
+
+    def take_int(signed: bool, size: int) -> int:
+        return int.from_bytes(take(size), 'little', signed=signed)
+
+    def replace(match: 're.Match[str]') -> str:
+        nonlocal offset
+        flags, width, precision, length, conversion = match.groups()
+        if conversion == '%':
+            return '%'
+        if width == '*':
+            width = str(take_int(True, 4))
+        if precision == '*':
+            precision = str(take_int(True, 4))
+        spec = '%' + flags + (width or '')
+        if precision is not None:
+            spec += '.' + precision
+        # long long and intmax_t are 64-bit on the RV32 target
+        size = 8 if length in ('ll', 'j') else 4
+
+        if conversion in 'di':
+            return (spec + 'd') % take_int(True, size)
+        if conversion in 'uxXo':
+            value = take_int(False, size)
+            return (spec + ('d' if conversion == 'u' else conversion)) % value
+        if conversion == 'c':
+            return (spec + 'c') % chr(take_int(False, 4) & 0xFF)
+        if conversion == 'p':
+            return (spec + 's') % f'0x{take_int(False, 4):x}'
+        if conversion in 'fFeEgGaA':
+            (value,) = struct.unpack('<d', take(8))
+            if conversion in 'aA':
+                return (spec + 's') % value.hex()
+            return (spec + conversion) % value
+        # 's', copied including the null terminator
+        end = payload.find(b'\0', offset)
+        if end < 0:
+            end = len(payload)
+        text = payload[offset:end].decode('utf-8', 'replace')
+        offset = end + 1
+        return (spec + 's') % text
+
+    try:
+        return SPEC_PATTERN.sub(replace, format_string)
+    except ValueError:
+        return SPEC_PATTERN.sub('?', format_string) + ' [truncated frame]\r\n'
+
+
+def decode(stream: Iterator[bytes], strings: FormatStrings) -> Iterator[str]:
+    buffer = bytearray()
+    for chunk in stream:
+        buffer.extend(chunk)
+        while buffer:
+            sync = buffer.find(TRACE_SYNC)
+            if sync != 0:
+                # Plain text up to the next frame
+                text = buffer if sync < 0 else buffer[:sync]
+                yield text.decode('utf-8', 'replace')
+                del buffer[:len(text)]
+                continue
+            if len(buffer) < TRACE_HEADER_SIZE:
+                break
+            length = buffer[5]
+            if len(buffer) < TRACE_HEADER_SIZE + length:
+                break
+            (address,) = struct.unpack_from('<I', buffer, 1)
+            payload = bytes(buffer[TRACE_HEADER_SIZE:TRACE_HEADER_SIZE + length])
+            del buffer[:TRACE_HEADER_SIZE + length]
+            try:
+                yield format_frame(strings.get(address), payload)
+            except KeyError as error:
+                yield f'[TRACE-DECODE-ERROR] {error.args[0]}\r\n'
+
+
+def read_file(file: BinaryIO) -> Iterator[bytes]:
+    while True:
+        chunk = file.read(4096)
+        if not chunk:
+            return
+        yield chunk
+
+
+def read_serial(port: str, baud: int) -> Iterator[bytes]:
+    import serial
+
+    with serial.Serial(port, baud, timeout=0.1) as connection:
+        while True:
+            chunk = connection.read(4096)
+            if chunk:
+                yield chunk
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(
+        description='Decode the binary UART log format')
+    parser.add_argument('elf', help='firmware ELF the log was produced by')
+    parser.add_argument('input', nargs='?', default='-',
+                        help='captured UART output (default: stdin)')
+    parser.add_argument('-p', '--port', help='read from a serial port instead')
+    parser.add_argument('-b', '--baud', type=int, default=115200)
+    arguments = parser.parse_args()
+
+    strings = FormatStrings(arguments.elf)
+    if arguments.port:
+        stream = read_serial(arguments.port, arguments.baud)
+    elif arguments.input == '-':
+        stream = read_file(sys.stdin.buffer)
+    else:
+        stream = read_file(open(arguments.input, 'rb'))
+
+    for text in decode(stream, strings):
+        sys.stdout.write(text)
+        sys.stdout.flush()
+
+
+if __name__ == '__main__':
+    main()